@@ -29,6 +29,7 @@
 #include "log.h"
 #include "misc.h"
 #include "setting.h"
+#include "trace.h"
 
 typedef struct
 {
@@ -42,6 +43,9 @@ static const GOptionEntry entries[] =
 {
     { "version", 'v', 0, G_OPTION_ARG_NONE, NULL,
       N_("Print the version and exit"), NULL },
+    { "trace", 0, 0, G_OPTION_ARG_FILENAME, NULL,
+      N_("Log timing statistics when reading and saving files, and write a trace to FILE unless it is empty"),
+      N_("FILE") },
     { NULL }
 };
 
@@ -282,6 +286,67 @@ et_application_activate (GApplication *application)
     }
 }
 
+/*
+ * remove_arguments:
+ * @argv: the command-line arguments
+ * @n_remove: the number of arguments to remove from the start of @argv
+ */
+static void
+remove_arguments (gchar **argv,
+                  gsize n_remove)
+{
+    gsize i;
+
+    for (i = 0; i < n_remove; i++)
+    {
+        g_free (argv[i]);
+    }
+
+    memmove (argv, &argv[n_remove],
+             (g_strv_length (&argv[n_remove]) + 1) * sizeof (gchar *));
+}
+
+/*
+ * take_trace_option:
+ * @argv: the command-line arguments
+ *
+ * Enable tracing if the --trace option was given, either as --trace=FILE or
+ * as --trace FILE, and remove it from @argv, as it only applies to this
+ * process.
+ *
+ * Returns: %FALSE if the option was given without its argument, %TRUE
+ *          otherwise
+ */
+static gboolean
+take_trace_option (gchar **argv)
+{
+    gsize i;
+
+    for (i = 1; argv[i] != NULL; i++)
+    {
+        if (g_str_has_prefix (argv[i], "--trace="))
+        {
+            et_trace_init (argv[i] + strlen ("--trace="));
+            remove_arguments (&argv[i], 1);
+            break;
+        }
+        else if (strcmp (argv[i], "--trace") == 0)
+        {
+            if (argv[i + 1] == NULL)
+            {
+                g_printerr ("%s\n", _("Missing argument for --trace"));
+                return FALSE;
+            }
+
+            et_trace_init (argv[i + 1]);
+            remove_arguments (&argv[i], 2);
+            break;
+        }
+    }
+
+    return TRUE;
+}
+
 /*
  * et_application_local_command_line:
  * @application: the application
@@ -302,6 +367,13 @@ et_application_local_command_line (GApplication *application,
     guint n_args;
     gchar **argv;
 
+    /* Before registering, so that the files read at startup are traced. */
+    if (!take_trace_option (*arguments))
+    {
+        *exit_status = 1;
+        return TRUE;
+    }
+
     /* Try to register. */
     if (!g_application_register (application, NULL, &error))
     {
@@ -507,6 +579,8 @@ static void
 et_application_shutdown (GApplication *application)
 {
     Charset_Insert_Locales_Destroy ();
+    et_trace_shutdown ();
+    et_log_shutdown ();
 
     G_APPLICATION_CLASS (et_application_parent_class)->shutdown (application);
 }
@@ -518,6 +592,9 @@ et_application_startup (GApplication *application)
     GMenuModel *appmenu;
     GMenuModel *menubar;
 
+    /* Unless it was enabled on the command line. */
+    et_trace_init (NULL);
+
     g_action_map_add_action_entries (G_ACTION_MAP (application), actions,
                                      G_N_ELEMENTS (actions), application);
 
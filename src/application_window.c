@@ -46,6 +46,7 @@
 #ifdef ENABLE_OPUS
 #include "opus_header.h"
 #endif
+#include "payload_index.h"
 #include "picture.h"
 #include "playlist_dialog.h"
 #include "preferences_dialog.h"
@@ -1174,6 +1175,146 @@ on_show_playlist (GSimpleAction *action,
     }
 }
 
+/*
+ * Find the displayed files which have the same audio payload as another file,
+ * whatever their tags, and select all but the first file of each group, so
+ * that the copies can be deleted. The groups are listed in the log.
+ */
+static void
+on_find_duplicates (GSimpleAction *action,
+                    GVariant *variant,
+                    gpointer user_data)
+{
+    EtApplicationWindowPrivate *priv;
+    EtApplicationWindow *self;
+    EtPayloadIndex *index;
+    EtPayloadScan *scan;
+    EtWorkerJob *job;
+    GHashTable *copies;
+    GList *groups;
+    GList *l;
+    gchar *index_path;
+    gchar *msg;
+    guint n_copies = 0;
+    guint i;
+    gboolean stopped;
+    GError *error = NULL;
+
+    g_return_if_fail (ETCore->ETFileDisplayedList != NULL);
+
+    self = ET_APPLICATION_WINDOW (user_data);
+    priv = et_application_window_get_instance_private (self);
+
+    et_application_window_update_et_file_from_ui (self);
+
+    /* The digests of the files which did not change since the last search
+     * are kept between sessions. */
+    index = et_payload_index_new ();
+    index_path = g_build_filename (g_get_user_cache_dir (), PACKAGE_TARNAME,
+                                   "payload-index", NULL);
+
+    if (!et_payload_index_load (index, index_path, &error))
+    {
+        g_debug ("Error loading payload index: %s", error->message);
+        g_clear_error (&error);
+    }
+
+    scan = et_payload_scan_new (index);
+
+    for (l = g_list_first (ETCore->ETFileDisplayedList); l != NULL;
+         l = g_list_next (l))
+    {
+        ET_File *ETFile = l->data;
+
+        et_payload_scan_add (scan,
+                             ((File_Name *)ETFile->FileNameCur->data)->value,
+                             ETFile->ETFileDescription->FileType, ETFile);
+    }
+
+    et_application_window_disable_command_actions (self);
+    et_application_window_browser_set_sensitive (self, FALSE);
+    et_application_window_status_bar_message (self,
+                                              _("Searching for duplicate files…"),
+                                              FALSE);
+
+    job = et_payload_scan_start (scan, ET_WORKER_JOB_MAX_FILE_THREADS);
+    stopped = !et_application_window_run_job (self, job);
+    et_payload_scan_wait (scan, stopped);
+
+    /* Even after stopping, the files which were read are not read again. */
+    if (!et_payload_index_save (index, index_path, &error))
+    {
+        Log_Print (LOG_ERROR, _("Cannot save the payload index ‘%s’: %s"),
+                   index_path, error->message);
+        g_clear_error (&error);
+    }
+
+    for (l = g_list_first (ETCore->ETFileDisplayedList), i = 0; l != NULL;
+         l = g_list_next (l), i++)
+    {
+        const GError *file_error = et_payload_scan_get_error (scan, i);
+
+        if (file_error)
+        {
+            Log_Print (LOG_ERROR,
+                       _("Cannot read the audio data of file ‘%s’: %s"),
+                       ((File_Name *)((ET_File *)l->data)->FileNameCur->data)->value_utf8,
+                       file_error->message);
+        }
+    }
+
+    groups = et_payload_scan_get_groups (scan);
+    copies = g_hash_table_new (NULL, NULL);
+
+    for (l = groups; l != NULL; l = g_list_next (l))
+    {
+        GList *group = l->data;
+        GList *m;
+
+        Log_Print (LOG_INFO, _("Duplicates of file ‘%s’:"),
+                   ((File_Name *)((ET_File *)group->data)->FileNameCur->data)->value_utf8);
+
+        for (m = g_list_next (group); m != NULL; m = g_list_next (m))
+        {
+            Log_Print (LOG_INFO, "%s",
+                       ((File_Name *)((ET_File *)m->data)->FileNameCur->data)->value_utf8);
+            g_hash_table_add (copies, m->data);
+            n_copies++;
+        }
+
+        g_list_free (group);
+    }
+
+    g_list_free (groups);
+
+    et_browser_select_files (ET_BROWSER (priv->browser), copies);
+    g_hash_table_destroy (copies);
+
+    et_payload_scan_free (scan);
+    et_payload_index_free (index);
+    g_free (index_path);
+
+    et_application_window_browser_set_sensitive (self, TRUE);
+    et_application_window_update_actions (self);
+    et_application_window_progress_set_text (self, "");
+    et_application_window_progress_set_fraction (self, 0.0);
+
+    if (stopped)
+    {
+        msg = g_strdup (_("Searching for duplicate files was stopped"));
+    }
+    else
+    {
+        msg = g_strdup_printf (ngettext ("Found one duplicate file",
+                                         "Found %u duplicate files",
+                                         n_copies),
+                               n_copies);
+    }
+
+    et_application_window_status_bar_message (self, msg, TRUE);
+    g_free (msg);
+}
+
 static void
 on_go_home (GSimpleAction *action,
             GVariant *variant,
@@ -1525,6 +1666,7 @@ static const GActionEntry actions[] =
     { "show-cddb", on_show_cddb },
     { "show-load-filenames", on_show_load_filenames },
     { "show-playlist", on_show_playlist },
+    { "find-duplicates", on_find_duplicates },
     /* Go menu. */
     { "go-home", on_go_home },
     { "go-desktop", on_go_desktop },
@@ -1803,6 +1945,57 @@ et_application_window_status_bar_message (EtApplicationWindow *self,
                            with_timer);
 }
 
+/*
+ * et_application_window_run_job:
+ * @self: the application window
+ * @job: a job, which wakes up the main loop after each item
+ *
+ * Show the progress of @job, with the stop button enabled, until it finishes
+ * or the stop button is pressed, and wait for its worker threads. The items
+ * which were not started when the stop button was pressed are skipped.
+ *
+ * Returns: %TRUE if all the items were processed, %FALSE if the job was
+ *          stopped
+ */
+gboolean
+et_application_window_run_job (EtApplicationWindow *self,
+                               EtWorkerJob *job)
+{
+    GAction *stop_action;
+    gchar progress_bar_text[30];
+    guint n_items;
+    gboolean stopped;
+
+    g_return_val_if_fail (ET_APPLICATION_WINDOW (self), FALSE);
+    g_return_val_if_fail (job != NULL, FALSE);
+
+    n_items = et_worker_job_get_n_items (job);
+
+    Main_Stop_Button_Pressed = FALSE;
+    stop_action = g_action_map_lookup_action (G_ACTION_MAP (self), "stop");
+    g_simple_action_set_enabled (G_SIMPLE_ACTION (stop_action), TRUE);
+
+    while (!et_worker_job_is_finished (job) && !Main_Stop_Button_Pressed)
+    {
+        guint n_done = et_worker_job_get_n_done (job);
+
+        et_application_window_progress_set_fraction (self,
+                                                     n_done / (double) n_items);
+        g_snprintf (progress_bar_text, 30, "%u/%u", n_done, n_items);
+        et_application_window_progress_set_text (self, progress_bar_text);
+
+        gtk_main_iteration ();
+    }
+
+    stopped = Main_Stop_Button_Pressed;
+    et_worker_job_wait (job, stopped);
+
+    Main_Stop_Button_Pressed = FALSE;
+    g_simple_action_set_enabled (G_SIMPLE_ACTION (stop_action), FALSE);
+
+    return !stopped;
+}
+
 GtkWidget *
 et_application_window_get_log_area (EtApplicationWindow *self)
 {
@@ -2530,6 +2723,7 @@ et_application_window_disable_command_actions (EtApplicationWindow *self)
     set_action_state (self, "save-force", FALSE);
     set_action_state (self, "undo-last-changes", FALSE);
     set_action_state (self, "redo-last-changes", FALSE);
+    set_action_state (self, "find-duplicates", FALSE);
 
     /* FIXME: "Scanner" menu commands */
     /*set_action_state (self, "scan-mode", FALSE);*/
@@ -2582,6 +2776,7 @@ et_application_window_update_actions (EtApplicationWindow *self)
         set_action_state (self, "undo-last-changes", FALSE);
         set_action_state (self, "redo-last-changes", FALSE);
         set_action_state (self, "find", FALSE);
+        set_action_state (self, "find-duplicates", FALSE);
         set_action_state (self, "show-load-filenames", FALSE);
         set_action_state (self, "show-playlist", FALSE);
         set_action_state (self, "run-player", FALSE);
@@ -2616,6 +2811,7 @@ et_application_window_update_actions (EtApplicationWindow *self)
         /* FIXME set_action_state (self, "sort-mode", TRUE); */
         set_action_state (self, "remove-tags", TRUE);
         set_action_state (self, "find", TRUE);
+        set_action_state (self, "find-duplicates", TRUE);
         set_action_state (self, "show-load-filenames", TRUE);
         set_action_state (self, "show-playlist", TRUE);
         set_action_state (self, "run-player", TRUE);
@@ -2968,6 +3164,51 @@ et_application_window_browser_refresh_file_in_list (EtApplicationWindow *self,
     et_browser_refresh_file_in_list (ET_BROWSER (priv->browser), file);
 }
 
+/*
+ * et_application_window_browser_refresh_changes:
+ * @self: the application window
+ *
+ * Refresh only the files which changed since the views were last refreshed
+ * this way, as queued by et_file_list_queue_change(). In the artist and album
+ * view, the lists are rebuilt if the artist or the album of a file changed,
+ * as the file may then belong to other rows.
+ */
+void
+et_application_window_browser_refresh_changes (EtApplicationWindow *self)
+{
+    EtApplicationWindowPrivate *priv;
+    GList *files;
+    EtFileChanges changes;
+    GVariant *variant;
+
+    g_return_if_fail (ET_APPLICATION_WINDOW (self));
+
+    priv = et_application_window_get_instance_private (self);
+
+    files = et_file_list_take_changes (&changes);
+
+    if (files == NULL)
+    {
+        return;
+    }
+
+    variant = g_action_group_get_action_state (G_ACTION_GROUP (self),
+                                               "file-artist-view");
+
+    if ((changes & ET_FILE_CHANGED_GROUP)
+        && strcmp (g_variant_get_string (variant, NULL), "artist") == 0)
+    {
+        et_application_window_browser_toggle_display_mode (self);
+    }
+    else
+    {
+        et_browser_refresh_files (ET_BROWSER (priv->browser), files);
+    }
+
+    g_variant_unref (variant);
+    g_list_free (files);
+}
+
 static void
 quit_confirmed (EtApplicationWindow *self)
 {
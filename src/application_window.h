@@ -24,6 +24,7 @@
 G_BEGIN_DECLS
 
 #include "et_core.h"
+#include "worker_job.h"
 
 #define ET_TYPE_APPLICATION_WINDOW (et_application_window_get_type ())
 #define ET_APPLICATION_WINDOW(object) (G_TYPE_CHECK_INSTANCE_CAST ((object), ET_TYPE_APPLICATION_WINDOW, EtApplicationWindow))
@@ -87,10 +88,12 @@ ET_File * et_application_window_browser_select_file_by_dlm (EtApplicationWindow
 void et_application_window_browser_unselect_all (EtApplicationWindow *self);
 void et_application_window_browser_refresh_list (EtApplicationWindow *self);
 void et_application_window_browser_refresh_file_in_list (EtApplicationWindow *self, const ET_File *file);
+void et_application_window_browser_refresh_changes (EtApplicationWindow *self);
 void et_application_window_scan_dialog_update_previews (EtApplicationWindow *self);
 void et_application_window_progress_set_fraction (EtApplicationWindow *self, gdouble fraction);
 void et_application_window_progress_set_text (EtApplicationWindow *self, const gchar *text);
 void et_application_window_status_bar_message (EtApplicationWindow *self, const gchar *message, gboolean with_timer);
+gboolean et_application_window_run_job (EtApplicationWindow *self, EtWorkerJob *job);
 void et_application_window_quit (EtApplicationWindow *self);
 
 G_END_DECLS
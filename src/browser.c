@@ -44,6 +44,7 @@
 #include "log.h"
 #include "misc.h"
 #include "setting.h"
+#include "trace.h"
 
 #include "win32/win32dep.h"
 
@@ -76,6 +77,18 @@ typedef struct
     GtkWidget *directory_view; /* Tree of directories. */
     GtkWidget *directory_view_menu;
     GtkTreeStore *directory_model;
+    GtkTreeViewColumn *directory_column;
+    GtkCellRenderer *directory_icon_renderer;
+
+    /* Directory nodes which are being read, see expand_cb(). */
+    GList *expansions;
+    guint expand_synchronously;
+
+    /* Icons of directory nodes, which are looked up when they are shown. */
+    GIcon *folder_icon;
+    GHashTable *icon_queries;
+    GCancellable *icon_cancellable;
+    guint icons_idle_id;
 
     GtkListStore *run_program_model;
 
@@ -111,6 +124,36 @@ typedef enum
     ET_PATH_STATE_CLOSED
 } EtPathState;
 
+/* Number of directories read at a time when expanding a node. */
+#define BROWSER_EXPAND_BATCH_SIZE 100
+
+#define BROWSER_EXPAND_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+                                  G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," \
+                                  G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+                                  G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+                                  G_FILE_ATTRIBUTE_UNIX_NLINK
+
+/*
+ * EtBrowserExpansion:
+ * @browser: the browser which owns the directory tree
+ * @node: the node of the directory which is being read
+ * @enumerator: the enumerator of the directory, once it is open
+ * @cancellable: cancelled when the node is collapsed or the browser destroyed
+ * @show_hidden: whether hidden directories are shown
+ * @has_dummy: whether the dummy child of @node has not been removed yet
+ *
+ * The state of a directory node which is being read in the background.
+ */
+typedef struct
+{
+    EtBrowser *browser;
+    GtkTreeRowReference *node;
+    GFileEnumerator *enumerator;
+    GCancellable *cancellable;
+    gboolean show_hidden;
+    gboolean has_dummy;
+} EtBrowserExpansion;
+
 enum
 {
     LIST_FILE_NAME,
@@ -183,6 +226,10 @@ static void Browser_Tree_Handle_Rename (EtBrowser *self,
                                         const gchar *old_path,
                                         const gchar *new_path);
 
+static void get_row_appearance (const ET_File *ETFile, gboolean otherdir,
+                                gboolean changed_bold, PangoWeight *weight,
+                                const GdkRGBA **background,
+                                const GdkRGBA **foreground);
 static void Browser_List_Set_Row_Appearance (EtBrowser *self, GtkTreeIter *iter);
 static gint Browser_List_Sort_Func (GtkTreeModel *model, GtkTreeIter *a,
                                     GtkTreeIter *b, gpointer data);
@@ -200,11 +247,11 @@ static void Browser_Album_List_Row_Selected (EtBrowser *self,
                                              GtkTreeSelection *selection);
 static void Browser_Album_List_Set_Row_Appearance (EtBrowser *self, GtkTreeIter *row);
 
-static gboolean check_for_subdir (const gchar *path);
-
 static GtkTreePath *Find_Child_Node (EtBrowser *self, GtkTreeIter *parent, gchar *searchtext);
 
 static GIcon *get_gicon_for_path (const gchar *path, EtPathState path_state);
+static GIcon *get_gicon_for_info (GFileInfo *info, EtPathState path_state);
+static gboolean cancel_expansions (EtBrowser *self, GtkTreePath *path);
 
 /* For window to rename a directory */
 static void Destroy_Rename_Directory_Window (EtBrowser *self);
@@ -1078,6 +1125,10 @@ et_browser_select_dir (EtBrowser *self,
     /* Don't check here if the path is valid. It will be done later when
      * selecting a node in the tree */
 
+    /* The children of each node along the path must be in the tree as soon as
+     * the node is expanded, so do not read them in the background. */
+    priv->expand_synchronously++;
+
     et_browser_set_current_path (self, file);
     current_path = g_file_get_path (file);
 
@@ -1089,6 +1140,8 @@ et_browser_select_dir (EtBrowser *self,
     if (!et_browser_win32_get_drive_root (self, parts[0], &parentNode,
                                           &rootPath))
     {
+        priv->expand_synchronously--;
+        g_strfreev (parts);
         return;
     }
 #else /* !G_OS_WIN32 */
@@ -1096,6 +1149,8 @@ et_browser_select_dir (EtBrowser *self,
                                         &parentNode))
     {
         g_message ("%s", "priv->directory_model is empty");
+        priv->expand_synchronously--;
+        g_strfreev (parts);
         return;
     }
 
@@ -1116,6 +1171,12 @@ et_browser_select_dir (EtBrowser *self,
             continue;
         }
 
+        rootPath = gtk_tree_model_get_path (GTK_TREE_MODEL (priv->directory_model),
+                                            &parentNode);
+        gtk_tree_view_expand_to_path (GTK_TREE_VIEW (priv->directory_view),
+                                      rootPath);
+        gtk_tree_path_free (rootPath);
+
         if (!gtk_tree_model_iter_children(GTK_TREE_MODEL(priv->directory_model), &currentNode, &parentNode))
         {
             gchar *path, *parent_path;
@@ -1145,7 +1206,7 @@ et_browser_select_dir (EtBrowser *self,
                                                    &iter, &parentNode, 0,
                                                    TREE_COLUMN_DIR_NAME, parts[index],
                                                    TREE_COLUMN_FULL_PATH, path,
-                                                   TREE_COLUMN_HAS_SUBDIR, check_for_subdir (current_path),
+                                                   TREE_COLUMN_HAS_SUBDIR, FALSE,
                                                    TREE_COLUMN_SCANNED, TRUE,
                                                    TREE_COLUMN_ICON, icon, -1);
 
@@ -1185,22 +1246,19 @@ et_browser_select_dir (EtBrowser *self,
             {
                 /* Path was not found in tree, such as when a hidden path was
                  * passed in, but hidden paths are set to not be displayed. */
+                priv->expand_synchronously--;
                 g_strfreev (parts);
                 return;
             }
         } while (1);
 
         parentNode = currentNode;
-        rootPath = gtk_tree_model_get_path(GTK_TREE_MODEL(priv->directory_model), &parentNode);
-        if (rootPath)
-        {
-            gtk_tree_view_expand_to_path (GTK_TREE_VIEW (priv->directory_view),
-                                          rootPath);
-            gtk_tree_path_free(rootPath);
-        }
         index++;
     }
 
+    /* The last directory of the path can be read in the background. */
+    priv->expand_synchronously--;
+
     rootPath = gtk_tree_model_get_path(GTK_TREE_MODEL(priv->directory_model), &parentNode);
     if (rootPath)
     {
@@ -1297,6 +1355,38 @@ et_browser_clear_file_model (EtBrowser *self)
     g_signal_handler_unblock (selection, priv->file_selected_handler);
 }
 
+/*
+ * Check whether two UTF-8 paths are in the same directory. The directory
+ * parts are usually identical bytes, in which case they are not copied and
+ * collated.
+ */
+static gboolean
+is_same_directory (const gchar *path1_utf8,
+                   const gchar *path2_utf8)
+{
+    const gchar *separator1 = strrchr (path1_utf8, G_DIR_SEPARATOR);
+    const gchar *separator2 = strrchr (path2_utf8, G_DIR_SEPARATOR);
+    gchar *dir1_utf8;
+    gchar *dir2_utf8;
+    gboolean result;
+
+    if (separator1 && separator2
+        && separator1 - path1_utf8 == separator2 - path2_utf8
+        && strncmp (path1_utf8, path2_utf8, separator1 - path1_utf8) == 0)
+    {
+        return TRUE;
+    }
+
+    dir1_utf8 = g_path_get_dirname (path1_utf8);
+    dir2_utf8 = g_path_get_dirname (path2_utf8);
+    result = g_utf8_collate (dir1_utf8, dir2_utf8) == 0;
+
+    g_free (dir1_utf8);
+    g_free (dir2_utf8);
+
+    return result;
+}
+
 /*
  * Loads the specified etfilelist into the browser list
  * Also supports optionally selecting a specific etfile
@@ -1308,41 +1398,70 @@ et_browser_load_file_list (EtBrowser *self,
                            const ET_File *etfile_to_select)
 {
     EtBrowserPrivate *priv;
+    GtkTreeSelection *selection;
+    GtkTreeSortable *sortable;
+    gint sort_column_id;
+    GtkSortType sort_order;
     GList *l;
-    gboolean activate_bg_color = 0;
+    const gchar *previous_filename_utf8 = NULL;
+    gboolean activate_bg_color = FALSE;
+    gboolean changed_bold;
     GtkTreeIter rowIter;
+    GtkTreeIter select_iter;
+    gboolean have_select_iter = FALSE;
+    gint64 trace_start;
 
     g_return_if_fail (ET_BROWSER (self));
 
     priv = et_browser_get_instance_private (self);
 
+    trace_start = et_trace_begin ();
+
     et_browser_clear_file_model (self);
 
+    /* Fill the model while it is detached from the view and unsorted, so
+     * that neither the view nor the order is updated for each row. The list
+     * is already sorted by ET_Sort_File_List(), in the same order. */
+    selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->file_view));
+    sortable = GTK_TREE_SORTABLE (priv->file_model);
+    gtk_tree_sortable_get_sort_column_id (sortable, &sort_column_id,
+                                          &sort_order);
+
+    g_signal_handler_block (selection, priv->file_selected_handler);
+    g_object_ref (priv->file_model);
+    gtk_tree_view_set_model (GTK_TREE_VIEW (priv->file_view), NULL);
+    gtk_tree_sortable_set_sort_column_id (sortable,
+                                          GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID,
+                                          GTK_SORT_ASCENDING);
+
+    changed_bold = g_settings_get_boolean (MainSettings, "file-changed-bold");
+
     for (l = g_list_first (etfilelist); l != NULL; l = g_list_next (l))
     {
-        guint fileKey = ((ET_File *)l->data)->ETFileKey;
-        const gchar *current_filename_utf8 = ((File_Name *)((ET_File *)l->data)->FileNameCur->data)->value_utf8;
+        const ET_File *ETFile = l->data;
+        const gchar *current_filename_utf8 = ((File_Name *)ETFile->FileNameCur->data)->value_utf8;
         gchar *basename_utf8 = g_path_get_basename (current_filename_utf8);
-        File_Tag *FileTag = ((File_Tag *)((ET_File *)l->data)->FileTag->data);
+        File_Tag *FileTag = (File_Tag *)ETFile->FileTag->data;
         gchar *track;
         gchar *disc;
+        PangoWeight weight;
+        const GdkRGBA *background;
+        const GdkRGBA *foreground;
 
         // Change background color when changing directory (the first row must not be changed)
-        if (gtk_tree_model_iter_n_children(GTK_TREE_MODEL(priv->file_model), NULL) > 0)
+        if (previous_filename_utf8
+            && !is_same_directory (previous_filename_utf8,
+                                   current_filename_utf8))
         {
-            gchar *dir1_utf8;
-            gchar *dir2_utf8;
-            const gchar *previous_filename_utf8 = ((File_Name *)((ET_File *)l->prev->data)->FileNameCur->data)->value_utf8;
-
-            dir1_utf8 = g_path_get_dirname(previous_filename_utf8);
-            dir2_utf8 = g_path_get_dirname(current_filename_utf8);
+            activate_bg_color = !activate_bg_color;
+        }
 
-            if (g_utf8_collate(dir1_utf8, dir2_utf8) != 0)
-                activate_bg_color = !activate_bg_color;
+        previous_filename_utf8 = current_filename_utf8;
 
-            g_free(dir1_utf8);
-            g_free(dir2_utf8);
-        }
+        /* Set appearance of the row with its values, rather than
+         * afterwards. */
+        get_row_appearance (ETFile, activate_bg_color, changed_bold, &weight,
+                            &background, &foreground);
 
         /* File list displays the current filename (name on disc) and tag
          * fields. */
@@ -1355,7 +1474,7 @@ et_browser_load_file_list (EtBrowser *self,
         gtk_list_store_insert_with_values (priv->file_model, &rowIter, G_MAXINT,
                                            LIST_FILE_NAME, basename_utf8,
                                            LIST_FILE_POINTER, l->data,
-                                           LIST_FILE_KEY, fileKey,
+                                           LIST_FILE_KEY, ETFile->ETFileKey,
                                            LIST_FILE_OTHERDIR,
                                            activate_bg_color,
                                            LIST_FILE_TITLE, FileTag->title,
@@ -1376,20 +1495,38 @@ et_browser_load_file_list (EtBrowser *self,
                                            FileTag->copyright,
                                            LIST_FILE_URL, FileTag->url,
                                            LIST_FILE_ENCODED_BY,
-                                           FileTag->encoded_by, -1);
+                                           FileTag->encoded_by,
+                                           LIST_FONT_WEIGHT, weight,
+                                           LIST_ROW_BACKGROUND, background,
+                                           LIST_ROW_FOREGROUND, foreground,
+                                           -1);
         g_free(basename_utf8);
         g_free(track);
         g_free (disc);
 
-        if (etfile_to_select == l->data)
+        if (etfile_to_select == ETFile)
         {
-            Browser_List_Select_File_By_Iter (self, &rowIter, TRUE);
-            //ET_Display_File_Data_To_UI (l->data);
+            /* The iters of a GtkListStore persist across sorting. */
+            select_iter = rowIter;
+            have_select_iter = TRUE;
         }
+    }
+
+    /* Sort and attach the model once. */
+    gtk_tree_sortable_set_sort_column_id (sortable, sort_column_id,
+                                          sort_order);
+    gtk_tree_view_set_model (GTK_TREE_VIEW (priv->file_view),
+                             GTK_TREE_MODEL (priv->file_model));
+    g_object_unref (priv->file_model);
+    g_signal_handler_unblock (selection, priv->file_selected_handler);
 
-        /* Set appearance of the row. */
-        Browser_List_Set_Row_Appearance (self, &rowIter);
+    if (have_select_iter)
+    {
+        Browser_List_Select_File_By_Iter (self, &select_iter, TRUE);
+        //ET_Display_File_Data_To_UI (l->data);
     }
+
+    et_trace_end (trace_start, "browser", "load-file-list", NULL);
 }
 
 
@@ -1512,104 +1649,93 @@ et_browser_refresh_list (EtBrowser *self)
 
 
 /*
- * Update state of one file in the list after changes (without clearing the clist!)
- *  - Refresh filename is file saved,
- *  - Change color is something change on the file
+ * Search the row of @ETFile in the list of files, to update it.
  */
-void
-et_browser_refresh_file_in_list (EtBrowser *self,
-                                 const ET_File *ETFile)
+static gboolean
+et_browser_find_file_row (EtBrowser *self,
+                          const ET_File *ETFile,
+                          GtkTreeIter *iter)
 {
     EtBrowserPrivate *priv;
     GList *selectedRow = NULL;
-    GVariant *variant;
     GtkTreeSelection *selection;
-    GtkTreeIter selectedIter;
     const ET_File *etfile;
-    const File_Tag *FileTag;
-    const File_Name *FileName;
-    gboolean row_found = FALSE;
-    gchar *current_basename_utf8;
-    gchar *track;
-    gchar *disc;
     gboolean valid;
-    gchar *artist, *album;
-
-    g_return_if_fail (ET_BROWSER (self));
 
     priv = et_browser_get_instance_private (self);
 
-    if (!ETCore->ETFileDisplayedList || !priv->file_view || !ETFile ||
-        gtk_tree_model_iter_n_children(GTK_TREE_MODEL(priv->file_model), NULL) == 0)
-    {
-        return;
-    }
-
-    // Search the row of the modified file to update it (when found: row_found=TRUE)
     // 1/3. Get position of ETFile in ETFileList
-    if (row_found == FALSE)
+    valid = gtk_tree_model_iter_nth_child (GTK_TREE_MODEL(priv->file_model), iter, NULL,
+                                           et_displayed_file_list_get_index (ETFile) - 1);
+    if (valid)
     {
-        valid = gtk_tree_model_iter_nth_child (GTK_TREE_MODEL(priv->file_model), &selectedIter, NULL, ETFile->IndexKey-1);
-        if (valid)
+        gtk_tree_model_get(GTK_TREE_MODEL(priv->file_model), iter,
+                       LIST_FILE_POINTER, &etfile, -1);
+        if (ETFile->ETFileKey == etfile->ETFileKey)
         {
-            gtk_tree_model_get(GTK_TREE_MODEL(priv->file_model), &selectedIter,
-                           LIST_FILE_POINTER, &etfile, -1);
-            if (ETFile->ETFileKey == etfile->ETFileKey)
-            {
-                row_found = TRUE;
-            }
+            return TRUE;
         }
     }
 
     // 2/3. Try with the selected file in list (works only if we select the same file)
-    if (row_found == FALSE)
+    selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->file_view));
+    selectedRow = gtk_tree_selection_get_selected_rows(selection, NULL);
+    if (selectedRow && selectedRow->data != NULL)
     {
-        selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->file_view));
-        selectedRow = gtk_tree_selection_get_selected_rows(selection, NULL);
-        if (selectedRow && selectedRow->data != NULL)
+        valid = gtk_tree_model_get_iter(GTK_TREE_MODEL(priv->file_model), iter,
+                                (GtkTreePath*) selectedRow->data);
+        if (valid)
         {
-            valid = gtk_tree_model_get_iter(GTK_TREE_MODEL(priv->file_model), &selectedIter,
-                                    (GtkTreePath*) selectedRow->data);
-            if (valid)
+            gtk_tree_model_get(GTK_TREE_MODEL(priv->file_model), iter,
+                               LIST_FILE_POINTER, &etfile, -1);
+            if (ETFile->ETFileKey == etfile->ETFileKey)
             {
-                gtk_tree_model_get(GTK_TREE_MODEL(priv->file_model), &selectedIter,
-                                   LIST_FILE_POINTER, &etfile, -1);
-                if (ETFile->ETFileKey == etfile->ETFileKey)
-                {
-                    row_found = TRUE;
-                }
+                g_list_free_full (selectedRow,
+                                  (GDestroyNotify)gtk_tree_path_free);
+                return TRUE;
             }
         }
-
-        g_list_free_full (selectedRow, (GDestroyNotify)gtk_tree_path_free);
     }
 
+    g_list_free_full (selectedRow, (GDestroyNotify)gtk_tree_path_free);
+
     // 3/3. Fails, now we browse the full list to find it
-    if (row_found == FALSE)
+    valid = gtk_tree_model_get_iter_first(GTK_TREE_MODEL(priv->file_model), iter);
+    while (valid)
     {
-        valid = gtk_tree_model_get_iter_first(GTK_TREE_MODEL(priv->file_model), &selectedIter);
-        while (valid)
+        gtk_tree_model_get(GTK_TREE_MODEL(priv->file_model), iter,
+                           LIST_FILE_POINTER, &etfile, -1);
+        if (ETFile->ETFileKey == etfile->ETFileKey)
         {
-            gtk_tree_model_get(GTK_TREE_MODEL(priv->file_model), &selectedIter,
-                               LIST_FILE_POINTER, &etfile, -1);
-            if (ETFile->ETFileKey == etfile->ETFileKey)
-            {
-                row_found = TRUE;
-                break;
-            } else
-            {
-                valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(priv->file_model), &selectedIter);
-            }
+            return TRUE;
         }
+
+        valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(priv->file_model), iter);
     }
 
     // Error somewhere...
-    if (row_found == FALSE)
-        return;
+    return FALSE;
+}
+
+/*
+ * Display the filename and refresh the other fields of the row of @ETFile.
+ */
+static void
+et_browser_set_file_row (EtBrowser *self,
+                         GtkTreeIter *iter,
+                         const ET_File *ETFile)
+{
+    EtBrowserPrivate *priv;
+    const File_Tag *FileTag;
+    const File_Name *FileName;
+    gchar *current_basename_utf8;
+    gchar *track;
+    gchar *disc;
+
+    priv = et_browser_get_instance_private (self);
 
-    // Displayed the filename and refresh other fields
-    FileName = (File_Name *)etfile->FileNameCur->data;
-    FileTag  = (File_Tag *)etfile->FileTag->data;
+    FileName = (File_Name *)ETFile->FileNameCur->data;
+    FileTag  = (File_Tag *)ETFile->FileTag->data;
 
     current_basename_utf8 = g_path_get_basename(FileName->value_utf8);
     track = g_strconcat(FileTag->track ? FileTag->track : "",FileTag->track_total ? "/" : NULL,FileTag->track_total,NULL);
@@ -1617,7 +1743,7 @@ et_browser_refresh_file_in_list (EtBrowser *self,
                          FileTag->disc_total ? "/" : NULL, FileTag->disc_total,
                          NULL);
 
-    gtk_list_store_set(priv->file_model, &selectedIter,
+    gtk_list_store_set(priv->file_model, iter,
                        LIST_FILE_NAME,          current_basename_utf8,
                        LIST_FILE_TITLE,         FileTag->title,
                        LIST_FILE_ARTIST,        FileTag->artist,
@@ -1639,78 +1765,224 @@ et_browser_refresh_file_in_list (EtBrowser *self,
     g_free (disc);
 
     /* Change appearance (line to red) if filename changed. */
-    Browser_List_Set_Row_Appearance (self, &selectedIter);
+    Browser_List_Set_Row_Appearance (self, iter);
+}
+
+/*
+ * When displaying the artist and album lists, refresh the color of the rows
+ * of the artists and albums of @files, walking each list once.
+ */
+static void
+et_browser_refresh_artist_album_rows (EtBrowser *self,
+                                      GList *files)
+{
+    EtBrowserPrivate *priv;
+    GVariant *variant;
+    GtkTreeIter iter;
+    gboolean valid;
+    GList *l;
+
+    priv = et_browser_get_instance_private (self);
 
     variant = g_action_group_get_action_state (G_ACTION_GROUP (MainWindow),
                                                "file-artist-view");
 
-    /* When displaying Artist + Album lists => refresh also rows color. */
-    if (strcmp (g_variant_get_string (variant, NULL), "artist") == 0)
+    if (strcmp (g_variant_get_string (variant, NULL), "artist") != 0)
+    {
+        g_variant_unref (variant);
+        return;
+    }
+
+    g_variant_unref (variant);
+
+    valid = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (priv->artist_model),
+                                           &iter);
+
+    while (valid)
     {
-        gchar *current_artist = ((File_Tag *)ETFile->FileTag->data)->artist;
-        gchar *current_album  = ((File_Tag *)ETFile->FileTag->data)->album;
+        gchar *artist;
 
-        valid = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (priv->artist_model),
-                                               &selectedIter);
+        gtk_tree_model_get (GTK_TREE_MODEL (priv->artist_model), &iter,
+                            ARTIST_NAME, &artist, -1);
 
-        while (valid)
+        for (l = files; l != NULL; l = g_list_next (l))
         {
-                gtk_tree_model_get (GTK_TREE_MODEL (priv->artist_model),
-                                    &selectedIter, ARTIST_NAME, &artist, -1);
+            const gchar *current_artist = ((File_Tag *)((ET_File *)l->data)->FileTag->data)->artist;
 
-                if ((!current_artist && !artist)
-                    || (current_artist && artist
-                        && g_utf8_collate (current_artist, artist) == 0))
-                {
-                    /* Set color of the row. */
-                    Browser_Artist_List_Set_Row_Appearance (self,
-                                                            &selectedIter);
-                    g_free (artist);
-                    break;
-                }
+            if ((!current_artist && !artist)
+                || (current_artist && artist
+                    && g_utf8_collate (current_artist, artist) == 0))
+            {
+                /* Set color of the row. */
+                Browser_Artist_List_Set_Row_Appearance (self, &iter);
+                break;
+            }
+        }
 
-                g_free (artist);
+        g_free (artist);
 
-                valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->artist_model),
-                                                  &selectedIter);
-        }
+        valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->artist_model),
+                                          &iter);
+    }
+
+    //
+    // FIX ME : see also if we must add a new line / or change list of the ETFile
+    //
+    valid = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (priv->album_model),
+                                           &iter);
 
-        //
-        // FIX ME : see also if we must add a new line / or change list of the ETFile
-        //
-        valid = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (priv->album_model),
-                                               &selectedIter);
+    while (valid)
+    {
+        gchar *album;
 
-        while (valid)
+        gtk_tree_model_get (GTK_TREE_MODEL (priv->album_model), &iter,
+                            ALBUM_NAME, &album, -1);
+
+        for (l = files; l != NULL; l = g_list_next (l))
         {
-            gtk_tree_model_get (GTK_TREE_MODEL (priv->album_model),
-                                &selectedIter, ALBUM_NAME, &album, -1);
+            const gchar *current_album = ((File_Tag *)((ET_File *)l->data)->FileTag->data)->album;
 
             if ((!current_album && !album)
                 || (current_album && album
                     && g_utf8_collate (current_album, album) == 0))
             {
                 /* Set color of the row. */
-                Browser_Album_List_Set_Row_Appearance (self, &selectedIter);
-                g_free (album);
+                Browser_Album_List_Set_Row_Appearance (self, &iter);
                 break;
             }
+        }
 
-            g_free (album);
+        g_free (album);
 
-            valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->album_model),
-                                              &selectedIter);
-        }
+        valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->album_model),
+                                          &iter);
+    }
+}
+
+/*
+ * Update state of one file in the list after changes (without clearing the clist!)
+ *  - Refresh filename is file saved,
+ *  - Change color is something change on the file
+ */
+void
+et_browser_refresh_file_in_list (EtBrowser *self,
+                                 const ET_File *ETFile)
+{
+    EtBrowserPrivate *priv;
+    GtkTreeIter selectedIter;
+    GList *files;
 
-        //
-        // FIX ME : see also if we must add a new line / or change list of the ETFile
-        //
+    g_return_if_fail (ET_BROWSER (self));
+
+    priv = et_browser_get_instance_private (self);
+
+    if (!ETCore->ETFileDisplayedList || !priv->file_view || !ETFile ||
+        gtk_tree_model_iter_n_children(GTK_TREE_MODEL(priv->file_model), NULL) == 0)
+    {
+        return;
     }
 
-    g_variant_unref (variant);
+    if (!et_browser_find_file_row (self, ETFile, &selectedIter))
+    {
+        return;
+    }
+
+    et_browser_set_file_row (self, &selectedIter, ETFile);
+
+    files = g_list_prepend (NULL, (gpointer)ETFile);
+    et_browser_refresh_artist_album_rows (self, files);
+    g_list_free (files);
+}
+
+/*
+ * et_browser_refresh_files:
+ * @self: the browser
+ * @files: (element-type ET_File): the files which changed
+ *
+ * Update the rows of @files only, as et_browser_refresh_file_in_list() does
+ * for a single file, rather than all the rows as et_browser_refresh_list()
+ * does. The artist and album lists are walked once for all the files.
+ */
+void
+et_browser_refresh_files (EtBrowser *self,
+                          GList *files)
+{
+    EtBrowserPrivate *priv;
+    GList *l;
+
+    g_return_if_fail (ET_BROWSER (self));
+
+    priv = et_browser_get_instance_private (self);
+
+    if (!files || !ETCore->ETFileDisplayedList || !priv->file_view
+        || gtk_tree_model_iter_n_children (GTK_TREE_MODEL (priv->file_model),
+                                           NULL) == 0)
+    {
+        return;
+    }
+
+    for (l = files; l != NULL; l = g_list_next (l))
+    {
+        GtkTreeIter iter;
+
+        /* The file may not be displayed, in the artist and album view. */
+        if (et_browser_find_file_row (self, l->data, &iter))
+        {
+            et_browser_set_file_row (self, &iter, l->data);
+        }
+    }
+
+    et_browser_refresh_artist_album_rows (self, files);
 }
 
 
+/*
+ * get_row_appearance:
+ * @ETFile: the file of the row
+ * @otherdir: whether the row is in a directory with an alternate background
+ * @changed_bold: the value of the file-changed-bold setting
+ * @weight: (out): the font weight of the row
+ * @background: (out): the background color of the row, or %NULL
+ * @foreground: (out): the foreground color of the row, or %NULL
+ *
+ * Decide the appearance of a row of the file list, which changes the
+ * background according to LIST_FILE_OTHERDIR and the foreground according to
+ * the file status (saved or not).
+ */
+static void
+get_row_appearance (const ET_File *ETFile,
+                    gboolean otherdir,
+                    gboolean changed_bold,
+                    PangoWeight *weight,
+                    const GdkRGBA **background,
+                    const GdkRGBA **foreground)
+{
+    static const GdkRGBA LIGHT_BLUE = { 0.866, 0.933, 1.0, 1.0 };
+
+    // Must change background color?
+    *background = otherdir ? &LIGHT_BLUE : NULL;
+
+    // Set text to bold/red if 'filename' or 'tag' changed
+    if (!et_file_check_saved (ETFile))
+    {
+        if (changed_bold)
+        {
+            *weight = PANGO_WEIGHT_BOLD;
+            *foreground = NULL;
+        }
+        else
+        {
+            *weight = PANGO_WEIGHT_NORMAL;
+            *foreground = &RED;
+        }
+    }
+    else
+    {
+        *weight = PANGO_WEIGHT_NORMAL;
+        *foreground = NULL;
+    }
+}
+
 /*
  * Set the appearance of the row
  *  - change background according LIST_FILE_OTHERDIR
@@ -1722,8 +1994,9 @@ Browser_List_Set_Row_Appearance (EtBrowser *self, GtkTreeIter *iter)
     EtBrowserPrivate *priv;
     ET_File *rowETFile = NULL;
     gboolean otherdir = FALSE;
-    const GdkRGBA LIGHT_BLUE = { 0.866, 0.933, 1.0, 1.0 };
+    PangoWeight weight;
     const GdkRGBA *background;
+    const GdkRGBA *foreground;
     //gchar *temp = NULL;
 
     priv = et_browser_get_instance_private (self);
@@ -1738,35 +2011,15 @@ Browser_List_Set_Row_Appearance (EtBrowser *self, GtkTreeIter *iter)
                        //LIST_FILE_NAME,      &temp,
                        -1);
 
-    // Must change background color?
-    if (otherdir)
-        background = &LIGHT_BLUE;
-    else
-        background = NULL;
+    get_row_appearance (rowETFile, otherdir,
+                        g_settings_get_boolean (MainSettings,
+                                                "file-changed-bold"),
+                        &weight, &background, &foreground);
 
-    // Set text to bold/red if 'filename' or 'tag' changed
-    if (!et_file_check_saved (rowETFile))
-    {
-        if (g_settings_get_boolean (MainSettings, "file-changed-bold"))
-        {
-            gtk_list_store_set(priv->file_model, iter,
-                               LIST_FONT_WEIGHT,    PANGO_WEIGHT_BOLD,
-                               LIST_ROW_BACKGROUND, background,
-                               LIST_ROW_FOREGROUND, NULL, -1);
-        } else
-        {
-            gtk_list_store_set(priv->file_model, iter,
-                               LIST_FONT_WEIGHT,    PANGO_WEIGHT_NORMAL,
-                               LIST_ROW_BACKGROUND, background,
-                               LIST_ROW_FOREGROUND, &RED, -1);
-        }
-    } else
-    {
-        gtk_list_store_set(priv->file_model, iter,
-                           LIST_FONT_WEIGHT,    PANGO_WEIGHT_NORMAL,
-                           LIST_ROW_BACKGROUND, background,
-                           LIST_ROW_FOREGROUND, NULL ,-1);
-    }
+    gtk_list_store_set (priv->file_model, iter,
+                        LIST_FONT_WEIGHT, weight,
+                        LIST_ROW_BACKGROUND, background,
+                        LIST_ROW_FOREGROUND, foreground, -1);
 
     // Update text fields
     // Don't do it here
@@ -2348,15 +2601,67 @@ et_browser_invert_selection (EtBrowser *self)
     }
 }
 
+/*
+ * et_browser_select_files:
+ * @files: (element-type ET_File): a set of files
+ *
+ * Select the files of the list which are in @files, and unselect the others,
+ * in a single pass over the list.
+ */
 void
-et_browser_clear_artist_model (EtBrowser *self)
+et_browser_select_files (EtBrowser *self,
+                         GHashTable *files)
 {
     EtBrowserPrivate *priv;
+    GtkTreeIter iter;
     GtkTreeSelection *selection;
-
-    /* Empty Model, Disable Browser_Artist_List_Row_Selected() during clear
-     * because it may be called and may crash.
-    */
+    gboolean valid;
+
+    priv = et_browser_get_instance_private (self);
+
+    g_return_if_fail (priv->file_model != NULL || priv->file_view != NULL);
+
+    selection = et_browser_get_selection (self);
+
+    if (!selection)
+    {
+        return;
+    }
+
+    /* As in et_browser_invert_selection(), the files are not displayed one
+     * by one as they are selected. */
+    g_signal_handler_block (selection, priv->file_selected_handler);
+    gtk_tree_selection_unselect_all (selection);
+
+    for (valid = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (priv->file_model),
+                                                &iter);
+         valid;
+         valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->file_model),
+                                           &iter))
+    {
+        ET_File *ETFile;
+
+        gtk_tree_model_get (GTK_TREE_MODEL (priv->file_model), &iter,
+                            LIST_FILE_POINTER, &ETFile, -1);
+
+        if (g_hash_table_contains (files, ETFile))
+        {
+            gtk_tree_selection_select_iter (selection, &iter);
+        }
+    }
+
+    g_signal_handler_unblock (selection, priv->file_selected_handler);
+}
+
+void
+et_browser_clear_artist_model (EtBrowser *self)
+{
+    EtBrowserPrivate *priv;
+    GtkTreeSelection *selection;
+
+    /* Empty Model, Disable Browser_Artist_List_Row_Selected() during clear
+     * because it may be called and may crash.
+    */
 
     priv = et_browser_get_instance_private (self);
 
@@ -3128,6 +3433,7 @@ Browser_Tree_Initialize (EtBrowser *self)
 
     g_return_if_fail (priv->directory_model != NULL);
 
+    cancel_expansions (self, NULL);
     gtk_tree_store_clear (priv->directory_model);
 
 #ifdef G_OS_WIN32
@@ -3419,53 +3725,62 @@ Find_Child_Node (EtBrowser *self, GtkTreeIter *parentnode, gchar *childtext)
 }
 
 /*
- * check_for_subdir:
- * @path: (type filename): the path to test
+ * get_gicon_for_info:
+ * @info: information about a path, with the access attributes
+ * @path_state: whether the icon should be shown open or closed
  *
- * Check if @path has any subdirectories.
+ * Check the permissions in @info (authorized?, readonly?, unreadable?) and
+ * return an appropriate icon.
  *
- * Returns: %TRUE if subdirectories exist, %FALSE otherwise
+ * Returns: an icon corresponding to @info
  */
-static gboolean
-check_for_subdir (const gchar *path)
+static GIcon *
+get_gicon_for_info (GFileInfo *info, EtPathState path_state)
 {
-    GFile *dir;
-    GFileEnumerator *enumerator;
-
-    dir = g_file_new_for_path (path);
-    enumerator = g_file_enumerate_children (dir,
-                                            G_FILE_ATTRIBUTE_STANDARD_TYPE ","
-                                            G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN,
-                                            G_FILE_QUERY_INFO_NONE,
-                                            NULL, NULL);
-    g_object_unref (dir);
+    GIcon *folder_icon;
+    GIcon *emblem_icon;
+    GIcon *emblemed_icon;
+    GEmblem *emblem;
 
-    if (enumerator)
+    switch (path_state)
     {
-        GFileInfo *childinfo;
+        case ET_PATH_STATE_OPEN:
+            folder_icon = g_themed_icon_new ("folder-open");
+            break;
+        case ET_PATH_STATE_CLOSED:
+            folder_icon = g_themed_icon_new ("folder");
+            break;
+        default:
+            g_assert_not_reached ();
+    }
 
-        while ((childinfo = g_file_enumerator_next_file (enumerator,
-                                                         NULL, NULL)))
-        {
-            if ((g_file_info_get_file_type (childinfo) ==
-                 G_FILE_TYPE_DIRECTORY) &&
-                (g_settings_get_boolean (MainSettings, "browse-show-hidden")
-                 || !g_file_info_get_is_hidden (childinfo)))
-            {
-                g_object_unref (childinfo);
-                g_file_enumerator_close (enumerator, NULL, NULL);
-                g_object_unref (enumerator);
-                return TRUE;
-            }
+    if (!g_file_info_get_attribute_boolean (info,
+                                            G_FILE_ATTRIBUTE_ACCESS_CAN_READ))
+    {
+        emblem_icon = g_themed_icon_new ("emblem-unreadable");
+        emblem = g_emblem_new_with_origin (emblem_icon,
+                                           G_EMBLEM_ORIGIN_LIVEMETADATA);
+        emblemed_icon = g_emblemed_icon_new (folder_icon, emblem);
+        g_object_unref (folder_icon);
+        g_object_unref (emblem_icon);
+        g_object_unref (emblem);
 
-            g_object_unref (childinfo);
-        }
+        folder_icon = emblemed_icon;
+    }
+    else if (!g_file_info_get_attribute_boolean (info, G_FILE_ATTRIBUTE_ACCESS_CAN_WRITE))
+    {
+        emblem_icon = g_themed_icon_new ("emblem-readonly");
+        emblem = g_emblem_new_with_origin (emblem_icon,
+                                           G_EMBLEM_ORIGIN_LIVEMETADATA);
+        emblemed_icon = g_emblemed_icon_new (folder_icon, emblem);
+        g_object_unref (folder_icon);
+        g_object_unref (emblem_icon);
+        g_object_unref (emblem);
 
-        g_file_enumerator_close (enumerator, NULL, NULL);
-        g_object_unref (enumerator);
+        folder_icon = emblemed_icon;
     }
 
-    return FALSE;
+    return folder_icon;
 }
 
 /*
@@ -3481,26 +3796,11 @@ check_for_subdir (const gchar *path)
 static GIcon *
 get_gicon_for_path (const gchar *path, EtPathState path_state)
 {
-    GIcon *folder_icon;
-    GIcon *emblem_icon;
-    GIcon *emblemed_icon;
-    GEmblem *emblem;
+    GIcon *icon;
     GFile *file;
     GFileInfo *info;
     GError *error = NULL;
 
-    switch (path_state)
-    {
-        case ET_PATH_STATE_OPEN:
-            folder_icon = g_themed_icon_new ("folder-open");
-            break;
-        case ET_PATH_STATE_CLOSED:
-            folder_icon = g_themed_icon_new ("folder");
-            break;
-        default:
-            g_assert_not_reached ();
-    }
-
     file = g_file_new_for_path (path);
     info = g_file_query_info (file, G_FILE_ATTRIBUTE_ACCESS_CAN_READ ","
                               G_FILE_ATTRIBUTE_ACCESS_CAN_WRITE,
@@ -3517,55 +3817,635 @@ get_gicon_for_path (const gchar *path, EtPathState path_state)
                                            FALSE);
     }
 
-    if (!g_file_info_get_attribute_boolean (info,
-                                            G_FILE_ATTRIBUTE_ACCESS_CAN_READ))
+    icon = get_gicon_for_info (info, path_state);
+
+    g_object_unref (file);
+    g_object_unref (info);
+
+    return icon;
+}
+
+/*
+ * EtBrowserIconQuery:
+ * @browser: the browser which owns the directory tree
+ * @node: the node of which to set the icon
+ *
+ * A query of the permissions of a directory in the tree, to set its icon.
+ */
+typedef struct
+{
+    EtBrowser *browser;
+    GtkTreeRowReference *node;
+} EtBrowserIconQuery;
+
+/*
+ * Set the icon of a directory node, once its permissions are known.
+ */
+static void
+on_directory_icon_query_info (GObject *source,
+                              GAsyncResult *result,
+                              gpointer user_data)
+{
+    EtBrowserIconQuery *query = user_data;
+    EtBrowserPrivate *priv;
+    GtkTreePath *path;
+    GFileInfo *info;
+    GError *error = NULL;
+
+    priv = et_browser_get_instance_private (query->browser);
+    info = g_file_query_info_finish (G_FILE (source), result, &error);
+    path = gtk_tree_row_reference_get_path (query->node);
+
+    if (g_cancellable_is_cancelled (priv->icon_cancellable) || path == NULL)
     {
-        emblem_icon = g_themed_icon_new ("emblem-unreadable");
-        emblem = g_emblem_new_with_origin (emblem_icon,
-                                           G_EMBLEM_ORIGIN_LIVEMETADATA);
-        emblemed_icon = g_emblemed_icon_new (folder_icon, emblem);
-        g_object_unref (folder_icon);
-        g_object_unref (emblem_icon);
-        g_object_unref (emblem);
+        /* The browser was destroyed, or the node removed. */
+        g_clear_error (&error);
+    }
+    else
+    {
+        GtkTreeIter iter;
+        GIcon *icon;
 
-        folder_icon = emblemed_icon;
+        if (info == NULL)
+        {
+            g_warning ("Error while querying path information: %s",
+                       error->message);
+            g_clear_error (&error);
+            info = g_file_info_new ();
+            g_file_info_set_attribute_boolean (info,
+                                               G_FILE_ATTRIBUTE_ACCESS_CAN_READ,
+                                               FALSE);
+        }
+
+        gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->directory_model),
+                                 &iter, path);
+        gtk_tree_model_get (GTK_TREE_MODEL (priv->directory_model), &iter,
+                            TREE_COLUMN_ICON, &icon, -1);
+
+        /* Unless the node was expanded since, and has its open icon. */
+        if (icon == priv->folder_icon)
+        {
+            g_object_unref (icon);
+            icon = get_gicon_for_info (info, ET_PATH_STATE_CLOSED);
+            gtk_tree_store_set (priv->directory_model, &iter,
+                                TREE_COLUMN_ICON, icon, -1);
+        }
+
+        g_clear_object (&icon);
     }
-    else if (!g_file_info_get_attribute_boolean (info, G_FILE_ATTRIBUTE_ACCESS_CAN_WRITE))
+
+    gtk_tree_path_free (path);
+    g_clear_object (&info);
+    gtk_tree_row_reference_free (query->node);
+    g_object_unref (query->browser);
+    g_slice_free (EtBrowserIconQuery, query);
+}
+
+/*
+ * get_next_visible_row:
+ * @self: an #EtBrowser
+ * @iter: a node in the directory tree
+ *
+ * Move @iter to the next row shown in the directory view, following the
+ * children of the expanded nodes.
+ *
+ * Returns: %TRUE if @iter was moved, %FALSE if it was the last row
+ */
+static gboolean
+get_next_visible_row (EtBrowser *self, GtkTreeIter *iter)
+{
+    EtBrowserPrivate *priv;
+    GtkTreeModel *model;
+    GtkTreeIter child;
+    GtkTreePath *path;
+    gboolean expanded;
+
+    priv = et_browser_get_instance_private (self);
+    model = GTK_TREE_MODEL (priv->directory_model);
+
+    path = gtk_tree_model_get_path (model, iter);
+    expanded = gtk_tree_view_row_expanded (GTK_TREE_VIEW (priv->directory_view),
+                                           path);
+    gtk_tree_path_free (path);
+
+    if (expanded && gtk_tree_model_iter_children (model, &child, iter))
     {
-        emblem_icon = g_themed_icon_new ("emblem-readonly");
-        emblem = g_emblem_new_with_origin (emblem_icon,
-                                           G_EMBLEM_ORIGIN_LIVEMETADATA);
-        emblemed_icon = g_emblemed_icon_new (folder_icon, emblem);
-        g_object_unref (folder_icon);
-        g_object_unref (emblem_icon);
-        g_object_unref (emblem);
+        *iter = child;
+        return TRUE;
+    }
 
-        folder_icon = emblemed_icon;
+    do
+    {
+        GtkTreeIter parent;
+
+        child = *iter;
+
+        if (gtk_tree_model_iter_next (model, &child))
+        {
+            *iter = child;
+            return TRUE;
+        }
+
+        if (!gtk_tree_model_iter_parent (model, &parent, iter))
+        {
+            return FALSE;
+        }
+
+        *iter = parent;
+    } while (TRUE);
+}
+
+/*
+ * Look up the icons of the directories which are shown in the tree, but which
+ * were inserted without one.
+ */
+static gboolean
+update_visible_directory_icons (gpointer user_data)
+{
+    EtBrowser *self;
+    EtBrowserPrivate *priv;
+    GtkTreeModel *model;
+    GtkTreePath *start;
+    GtkTreePath *end;
+    GtkTreeIter iter;
+
+    self = ET_BROWSER (user_data);
+    priv = et_browser_get_instance_private (self);
+    model = GTK_TREE_MODEL (priv->directory_model);
+    priv->icons_idle_id = 0;
+
+    if (!gtk_tree_view_get_visible_range (GTK_TREE_VIEW (priv->directory_view),
+                                          &start, &end))
+    {
+        return G_SOURCE_REMOVE;
     }
 
-    g_object_unref (file);
-    g_object_unref (info);
+    if (gtk_tree_model_get_iter (model, &iter, start))
+    {
+        do
+        {
+            GtkTreePath *path;
+            gchar *full_path;
+            GIcon *icon;
+            gboolean at_end;
 
-    return folder_icon;
+            gtk_tree_model_get (model, &iter, TREE_COLUMN_FULL_PATH,
+                                &full_path, TREE_COLUMN_ICON, &icon, -1);
+            path = gtk_tree_model_get_path (model, &iter);
+
+            /* Dummy nodes have no path. */
+            if (icon == NULL && full_path != NULL)
+            {
+                EtBrowserIconQuery *query;
+                GFile *file;
+
+                /* Mark the node as queried, with the plain folder icon. */
+                gtk_tree_store_set (priv->directory_model, &iter,
+                                    TREE_COLUMN_ICON, priv->folder_icon, -1);
+
+                query = g_slice_new (EtBrowserIconQuery);
+                query->browser = g_object_ref (self);
+                query->node = gtk_tree_row_reference_new (model, path);
+
+                file = g_file_new_for_path (full_path);
+                g_file_query_info_async (file,
+                                         G_FILE_ATTRIBUTE_ACCESS_CAN_READ ","
+                                         G_FILE_ATTRIBUTE_ACCESS_CAN_WRITE,
+                                         G_FILE_QUERY_INFO_NONE,
+                                         G_PRIORITY_DEFAULT,
+                                         priv->icon_cancellable,
+                                         on_directory_icon_query_info, query);
+                g_object_unref (file);
+            }
+
+            at_end = gtk_tree_path_compare (path, end) >= 0;
+
+            gtk_tree_path_free (path);
+            g_clear_object (&icon);
+            g_free (full_path);
+
+            if (at_end)
+            {
+                break;
+            }
+        } while (get_next_visible_row (self, &iter));
+    }
+
+    gtk_tree_path_free (start);
+    gtk_tree_path_free (end);
+
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * Show the icon of a directory node. Child directories are inserted without
+ * an icon, as checking the permissions of thousands of directories on a
+ * network file system takes a long time, so show a plain folder until the
+ * permissions of the rows which are actually shown have been checked.
+ */
+static void
+directory_icon_data_func (GtkTreeViewColumn *column,
+                          GtkCellRenderer *cell,
+                          GtkTreeModel *model,
+                          GtkTreeIter *iter,
+                          gpointer user_data)
+{
+    EtBrowserPrivate *priv;
+    gchar *full_path;
+    GIcon *icon;
+
+    priv = et_browser_get_instance_private (ET_BROWSER (user_data));
+
+    gtk_tree_model_get (model, iter, TREE_COLUMN_FULL_PATH, &full_path,
+                        TREE_COLUMN_ICON, &icon, -1);
+
+    /* Dummy nodes have no path, and no icon. */
+    if (icon == NULL && full_path != NULL)
+    {
+        icon = g_object_ref (priv->folder_icon);
+
+        if (priv->icons_idle_id == 0)
+        {
+            priv->icons_idle_id = g_idle_add (update_visible_directory_icons,
+                                              user_data);
+        }
+    }
+
+    g_object_set (cell, "gicon", icon, NULL);
+    g_clear_object (&icon);
+    g_free (full_path);
+}
+
+/*
+ * insert_child_directories:
+ * @self: an #EtBrowser
+ * @parent: the node of the directory which is being read
+ * @enumerator: the enumerator of the directory
+ * @infos: (element-type GFileInfo): information about children of the
+ *         directory
+ * @show_hidden: whether to insert hidden directories
+ *
+ * Insert nodes for the directories in @infos as children of @parent. Neither
+ * the subdirectories nor the permissions of each directory are checked, as
+ * that would mean reading each of them: the icon is looked up when the node is
+ * shown, and a dummy child is inserted if the directory may have
+ * subdirectories, so that it can be expanded.
+ *
+ * Returns: the number of directories which were inserted
+ */
+static guint
+insert_child_directories (EtBrowser *self,
+                          GtkTreeIter *parent,
+                          GFileEnumerator *enumerator,
+                          GList *infos,
+                          gboolean show_hidden)
+{
+    EtBrowserPrivate *priv;
+    GList *l;
+    guint n_inserted = 0;
+
+    priv = et_browser_get_instance_private (self);
+
+    for (l = infos; l != NULL; l = g_list_next (l))
+    {
+        GFileInfo *info = l->data;
+        GFile *child;
+        gchar *path;
+        gboolean has_subdir;
+        GtkTreeIter iter;
+        GtkTreeIter dummy_iter;
+
+        if (g_file_info_get_file_type (info) != G_FILE_TYPE_DIRECTORY
+            || (!show_hidden && g_file_info_get_is_hidden (info)))
+        {
+            continue;
+        }
+
+        child = g_file_enumerator_get_child (enumerator, info);
+        path = g_file_get_path (child);
+
+        /* A directory is linked from its parent, from itself and from each of
+         * its subdirectories, so a link count of 2 means that it has none.
+         * Some file systems do not count the links of directories, and report
+         * 1, in which case the directory is assumed to have some: if it turns
+         * out to be empty, the dummy node is removed when it is expanded. */
+        has_subdir = !g_file_info_has_attribute (info,
+                                                 G_FILE_ATTRIBUTE_UNIX_NLINK)
+                     || g_file_info_get_attribute_uint32 (info,
+                                                          G_FILE_ATTRIBUTE_UNIX_NLINK) != 2;
+
+        gtk_tree_store_insert_with_values (priv->directory_model, &iter,
+                                           parent, G_MAXINT,
+                                           TREE_COLUMN_DIR_NAME,
+                                           g_file_info_get_display_name (info),
+                                           TREE_COLUMN_FULL_PATH, path,
+                                           TREE_COLUMN_HAS_SUBDIR, !has_subdir,
+                                           TREE_COLUMN_SCANNED, FALSE, -1);
+
+        if (has_subdir)
+        {
+            /* Insert a dummy node. */
+            gtk_tree_store_append (priv->directory_model, &dummy_iter, &iter);
+        }
+
+        n_inserted++;
+        g_free (path);
+        g_object_unref (child);
+    }
+
+    return n_inserted;
+}
+
+/*
+ * remove_dummy_node:
+ * @self: an #EtBrowser
+ * @parent: a node of the directory tree
+ *
+ * Remove the dummy child of @parent, which has no path.
+ */
+static void
+remove_dummy_node (EtBrowser *self, GtkTreeIter *parent)
+{
+    EtBrowserPrivate *priv;
+    GtkTreeIter iter;
+
+    priv = et_browser_get_instance_private (self);
+
+    if (!gtk_tree_model_iter_children (GTK_TREE_MODEL (priv->directory_model),
+                                       &iter, parent))
+    {
+        return;
+    }
+
+    do
+    {
+        gchar *path;
+
+        gtk_tree_model_get (GTK_TREE_MODEL (priv->directory_model), &iter,
+                            TREE_COLUMN_FULL_PATH, &path, -1);
+
+        if (path == NULL)
+        {
+            gtk_tree_store_remove (priv->directory_model, &iter);
+            return;
+        }
+
+        g_free (path);
+    } while (gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->directory_model),
+                                       &iter));
+}
+
+/*
+ * finish_expansion:
+ * @self: an #EtBrowser
+ * @iter: the node of the directory which was read
+ * @readable: whether the directory could be read
+ *
+ * Show the node of the directory as open, once its children were inserted.
+ */
+static void
+finish_expansion (EtBrowser *self, GtkTreeIter *iter, gboolean readable)
+{
+    EtBrowserPrivate *priv;
+    gchar *path;
+    GIcon *icon;
+#ifdef G_OS_WIN32
+    GtkTreePath *tree_path;
+    gint depth;
+#endif /* G_OS_WIN32 */
+
+    priv = et_browser_get_instance_private (self);
+
+    if (readable)
+    {
+        remove_dummy_node (self, iter);
+    }
+
+    gtk_tree_model_get (GTK_TREE_MODEL (priv->directory_model), iter,
+                        TREE_COLUMN_FULL_PATH, &path, -1);
+    icon = get_gicon_for_path (path, ET_PATH_STATE_OPEN);
+
+#ifdef G_OS_WIN32
+    tree_path = gtk_tree_model_get_path (GTK_TREE_MODEL (priv->directory_model),
+                                         iter);
+    depth = gtk_tree_path_get_depth (tree_path);
+    gtk_tree_path_free (tree_path);
+
+    // set open folder pixmap except on drive (depth == 0)
+    if (depth > 1)
+    {
+        // update the icon of the node to opened folder :-)
+        gtk_tree_store_set (priv->directory_model, iter,
+                            TREE_COLUMN_ICON, icon, -1);
+    }
+#else /* !G_OS_WIN32 */
+    // update the icon of the node to opened folder :-)
+    gtk_tree_store_set (priv->directory_model, iter, TREE_COLUMN_ICON, icon,
+                        -1);
+#endif /* !G_OS_WIN32 */
+
+    g_object_unref (icon);
+    g_free (path);
+}
+
+static void
+et_browser_expansion_free (EtBrowserExpansion *expansion)
+{
+    if (expansion->enumerator)
+    {
+        g_file_enumerator_close_async (expansion->enumerator,
+                                       G_PRIORITY_DEFAULT, NULL, NULL, NULL);
+        g_object_unref (expansion->enumerator);
+    }
+
+    g_object_unref (expansion->cancellable);
+    gtk_tree_row_reference_free (expansion->node);
+    g_object_unref (expansion->browser);
+    g_slice_free (EtBrowserExpansion, expansion);
+}
+
+/*
+ * et_browser_expansion_finish:
+ * @expansion: the expansion which is finished
+ * @readable: whether the directory could be read
+ *
+ * Finish reading a directory in the background, unless the expansion was
+ * cancelled, and free @expansion.
+ */
+static void
+et_browser_expansion_finish (EtBrowserExpansion *expansion, gboolean readable)
+{
+    EtBrowserPrivate *priv;
+    GtkTreePath *path;
+
+    priv = et_browser_get_instance_private (expansion->browser);
+
+    /* A cancelled expansion was already removed from the list. */
+    if (!g_cancellable_is_cancelled (expansion->cancellable))
+    {
+        priv->expansions = g_list_remove (priv->expansions, expansion);
+        path = gtk_tree_row_reference_get_path (expansion->node);
+
+        if (path)
+        {
+            GtkTreeIter iter;
+
+            gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->directory_model),
+                                     &iter, path);
+            finish_expansion (expansion->browser, &iter, readable);
+            gtk_tree_path_free (path);
+        }
+    }
+
+    et_browser_expansion_free (expansion);
+}
+
+static void
+on_expand_next_files (GObject *source,
+                      GAsyncResult *result,
+                      gpointer user_data)
+{
+    EtBrowserExpansion *expansion = user_data;
+    EtBrowserPrivate *priv;
+    GList *infos;
+    GtkTreePath *path;
+    GtkTreeIter iter;
+    GError *error = NULL;
+
+    priv = et_browser_get_instance_private (expansion->browser);
+    infos = g_file_enumerator_next_files_finish (G_FILE_ENUMERATOR (source),
+                                                 result, &error);
+
+    if (infos == NULL)
+    {
+        /* As when reading the directory in one go, an error stops the reading
+         * and what was read so far is kept. */
+        g_clear_error (&error);
+        et_browser_expansion_finish (expansion, TRUE);
+        return;
+    }
+
+    path = gtk_tree_row_reference_get_path (expansion->node);
+
+    if (g_cancellable_is_cancelled (expansion->cancellable) || path == NULL)
+    {
+        g_list_free_full (infos, g_object_unref);
+        et_browser_expansion_finish (expansion, FALSE);
+        return;
+    }
+
+    gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->directory_model), &iter,
+                             path);
+    gtk_tree_path_free (path);
+
+    if (insert_child_directories (expansion->browser, &iter,
+                                  expansion->enumerator, infos,
+                                  expansion->show_hidden) > 0
+        && expansion->has_dummy)
+    {
+        /* Now that the node has other children, the dummy node can be removed
+         * without collapsing it. */
+        remove_dummy_node (expansion->browser, &iter);
+        expansion->has_dummy = FALSE;
+    }
+
+    g_list_free_full (infos, g_object_unref);
+
+    g_file_enumerator_next_files_async (expansion->enumerator,
+                                        BROWSER_EXPAND_BATCH_SIZE,
+                                        G_PRIORITY_DEFAULT,
+                                        expansion->cancellable,
+                                        on_expand_next_files, expansion);
+}
+
+static void
+on_expand_enumerate_children (GObject *source,
+                              GAsyncResult *result,
+                              gpointer user_data)
+{
+    EtBrowserExpansion *expansion = user_data;
+    GError *error = NULL;
+
+    expansion->enumerator = g_file_enumerate_children_finish (G_FILE (source),
+                                                              result, &error);
+
+    if (expansion->enumerator == NULL
+        || g_cancellable_is_cancelled (expansion->cancellable))
+    {
+        /* The dummy node of an unreadable directory is kept. */
+        g_clear_error (&error);
+        et_browser_expansion_finish (expansion, FALSE);
+        return;
+    }
+
+    g_file_enumerator_next_files_async (expansion->enumerator,
+                                        BROWSER_EXPAND_BATCH_SIZE,
+                                        G_PRIORITY_DEFAULT,
+                                        expansion->cancellable,
+                                        on_expand_next_files, expansion);
+}
+
+/*
+ * cancel_expansions:
+ * @self: an #EtBrowser
+ * @path: (allow-none): a node of the directory tree, or %NULL for all nodes
+ *
+ * Stop reading in the background the directories of @path and of its
+ * descendants.
+ *
+ * Returns: %TRUE if an expansion was cancelled, %FALSE otherwise
+ */
+static gboolean
+cancel_expansions (EtBrowser *self, GtkTreePath *path)
+{
+    EtBrowserPrivate *priv;
+    GList *l;
+    gboolean cancelled = FALSE;
+
+    priv = et_browser_get_instance_private (self);
+
+    l = priv->expansions;
+
+    while (l != NULL)
+    {
+        GList *next = g_list_next (l);
+        EtBrowserExpansion *expansion = l->data;
+        GtkTreePath *node_path;
+
+        node_path = gtk_tree_row_reference_get_path (expansion->node);
+
+        if (path == NULL || node_path == NULL
+            || gtk_tree_path_compare (node_path, path) == 0
+            || gtk_tree_path_is_descendant (node_path, path))
+        {
+            /* The expansion is freed once its pending operation returns. */
+            g_cancellable_cancel (expansion->cancellable);
+            priv->expansions = g_list_delete_link (priv->expansions, l);
+            cancelled = TRUE;
+        }
+
+        gtk_tree_path_free (node_path);
+        l = next;
+    }
+
+    return cancelled;
 }
 
 /*
  * Open up a node on the browser tree
- * Scanning and showing all subdirectories
+ * Scanning and showing all subdirectories. The directory is read in batches in
+ * the background, so that a big directory does not block the interface,
+ * unless the children must be in the tree as soon as the node is expanded, as
+ * in et_browser_select_dir().
  */
 static void
 expand_cb (EtBrowser *self, GtkTreeIter *iter, GtkTreePath *gtreePath, GtkTreeView *tree)
 {
     EtBrowserPrivate *priv;
     GFile *dir;
-    GFileEnumerator *enumerator;
-    gchar *fullpath_file;
     gchar *parentPath;
     gboolean treeScanned;
-    gboolean has_subdir = FALSE;
-    GtkTreeIter currentIter;
-    GtkTreeIter subNodeIter;
-    GIcon *icon;
+    gboolean show_hidden;
 
     priv = et_browser_get_instance_private (self);
 
@@ -3576,105 +4456,120 @@ expand_cb (EtBrowser *self, GtkTreeIter *iter, GtkTreePath *gtreePath, GtkTreeVi
                        TREE_COLUMN_SCANNED,   &treeScanned, -1);
 
     if (treeScanned)
-        return;
-
-    dir = g_file_new_for_path (parentPath);
-    enumerator = g_file_enumerate_children (dir,
-                                            G_FILE_ATTRIBUTE_STANDARD_TYPE ","
-                                            G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME ","
-                                            G_FILE_ATTRIBUTE_STANDARD_NAME ","
-                                            G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN,
-                                            G_FILE_QUERY_INFO_NONE,
-                                            NULL, NULL);
-
-    if (enumerator)
     {
-        GFileInfo *childinfo;
+        GtkTreeIter child;
+        gboolean valid;
+        gboolean has_dummy = FALSE;
 
-        while ((childinfo = g_file_enumerator_next_file (enumerator,
-                                                         NULL, NULL))
-               != NULL)
+        /* If the directory is still being read in the background, but its
+         * children are needed now, read it again in one go. */
+        if (priv->expand_synchronously == 0
+            || !cancel_expansions (self, gtreePath))
         {
-            GFile *child;
-            gboolean isdir;
+            g_free (parentPath);
+            return;
+        }
 
-            child = g_file_enumerator_get_child (enumerator, childinfo);
-            fullpath_file = g_file_get_path (child);
-            isdir = g_file_info_get_file_type (childinfo) == G_FILE_TYPE_DIRECTORY;
+        /* Remove the children which were read, but keep a single dummy node,
+         * so that the node stays expanded. */
+        gtk_tree_store_append (priv->directory_model, &child, iter);
+        valid = gtk_tree_model_iter_children (GTK_TREE_MODEL (priv->directory_model),
+                                              &child, iter);
 
-            if (isdir &&
-                (g_settings_get_boolean (MainSettings, "browse-show-hidden")
-                 || !g_file_info_get_is_hidden (childinfo)))
-            {
-                const gchar *dirname_utf8;
-                dirname_utf8 = g_file_info_get_display_name (childinfo);
-
-                has_subdir = check_for_subdir (fullpath_file);
-
-                /* Select pixmap according permissions for the directory. */
-                icon = get_gicon_for_path (fullpath_file,
-                                           ET_PATH_STATE_CLOSED);
-
-                gtk_tree_store_insert_with_values (priv->directory_model,
-                                                   &currentIter, iter,
-                                                   G_MAXINT,
-                                                   TREE_COLUMN_DIR_NAME,
-                                                   dirname_utf8,
-                                                   TREE_COLUMN_FULL_PATH,
-                                                   fullpath_file,
-                                                   TREE_COLUMN_HAS_SUBDIR,
-                                                   !has_subdir,
-                                                   TREE_COLUMN_SCANNED, FALSE,
-                                                   TREE_COLUMN_ICON, icon, -1);
+        while (valid)
+        {
+            gchar *path;
 
-                if (has_subdir)
-                {
-                    /* Insert a dummy node. */
-                    gtk_tree_store_append(priv->directory_model, &subNodeIter, &currentIter);
-                }
+            gtk_tree_model_get (GTK_TREE_MODEL (priv->directory_model),
+                                &child, TREE_COLUMN_FULL_PATH, &path, -1);
 
-                g_object_unref (icon);
+            if (path == NULL && !has_dummy)
+            {
+                has_dummy = TRUE;
+                valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->directory_model),
+                                                  &child);
+            }
+            else
+            {
+                valid = gtk_tree_store_remove (priv->directory_model, &child);
             }
 
-            g_free (fullpath_file);
-            g_object_unref (childinfo);
-            g_object_unref (child);
+            g_free (path);
         }
+    }
 
-        g_file_enumerator_close (enumerator, NULL, NULL);
-        g_object_unref (enumerator);
+    /* Sorting is enabled before inserting the children, so that each of them
+     * is inserted at its place, rather than sorting all of them again. */
+    gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(priv->directory_model),
+                                         TREE_COLUMN_DIR_NAME, GTK_SORT_ASCENDING);
 
-        /* Remove dummy node. */
-        gtk_tree_model_iter_children (GTK_TREE_MODEL (priv->directory_model),
-                                      &subNodeIter, iter);
-        gtk_tree_store_remove (priv->directory_model, &subNodeIter);
+#ifdef G_OS_WIN32
+    /* Drives are never marked as scanned, see collapse_cb(). */
+    if (gtk_tree_path_get_depth (gtreePath) > 1)
+#endif /* G_OS_WIN32 */
+    {
+        /* Mark the node straight away, so that it is not read again if it is
+         * expanded before the reading has finished. */
+        gtk_tree_store_set (priv->directory_model, iter, TREE_COLUMN_SCANNED,
+                            TRUE, -1);
     }
 
-    g_object_unref (dir);
-    icon = get_gicon_for_path (parentPath, ET_PATH_STATE_OPEN);
+    dir = g_file_new_for_path (parentPath);
+    show_hidden = g_settings_get_boolean (MainSettings, "browse-show-hidden");
 
-#ifdef G_OS_WIN32
-    // set open folder pixmap except on drive (depth == 0)
-    if (gtk_tree_path_get_depth(gtreePath) > 1)
+    if (priv->expand_synchronously > 0)
     {
-        // update the icon of the node to opened folder :-)
-        gtk_tree_store_set(priv->directory_model, iter,
-                           TREE_COLUMN_SCANNED, TRUE,
-                           TREE_COLUMN_ICON, icon,
-                           -1);
+        GFileEnumerator *enumerator;
+        gboolean readable;
+
+        enumerator = g_file_enumerate_children (dir, BROWSER_EXPAND_ATTRIBUTES,
+                                                G_FILE_QUERY_INFO_NONE, NULL,
+                                                NULL);
+
+        readable = enumerator != NULL;
+
+        if (enumerator)
+        {
+            GList *infos;
+
+            while ((infos = g_file_enumerator_next_files (enumerator,
+                                                          BROWSER_EXPAND_BATCH_SIZE,
+                                                          NULL, NULL)))
+            {
+                insert_child_directories (self, iter, enumerator, infos,
+                                          show_hidden);
+                g_list_free_full (infos, g_object_unref);
+            }
+
+            g_file_enumerator_close (enumerator, NULL, NULL);
+            g_object_unref (enumerator);
+        }
+
+        finish_expansion (self, iter, readable);
     }
-#else /* !G_OS_WIN32 */
-    // update the icon of the node to opened folder :-)
-    gtk_tree_store_set(priv->directory_model, iter,
-                       TREE_COLUMN_SCANNED, TRUE,
-                       TREE_COLUMN_ICON, icon,
-                       -1);
-#endif /* !G_OS_WIN32 */
+    else
+    {
+        EtBrowserExpansion *expansion;
 
-    gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(priv->directory_model),
-                                         TREE_COLUMN_DIR_NAME, GTK_SORT_ASCENDING);
+        expansion = g_slice_new0 (EtBrowserExpansion);
+        expansion->browser = g_object_ref (self);
+        expansion->node = gtk_tree_row_reference_new (GTK_TREE_MODEL (priv->directory_model),
+                                                      gtreePath);
+        expansion->cancellable = g_cancellable_new ();
+        expansion->show_hidden = show_hidden;
+        expansion->has_dummy = TRUE;
 
-    g_object_unref (icon);
+        priv->expansions = g_list_prepend (priv->expansions, expansion);
+
+        g_file_enumerate_children_async (dir, BROWSER_EXPAND_ATTRIBUTES,
+                                         G_FILE_QUERY_INFO_NONE,
+                                         G_PRIORITY_DEFAULT,
+                                         expansion->cancellable,
+                                         on_expand_enumerate_children,
+                                         expansion);
+    }
+
+    g_object_unref (dir);
     g_free(parentPath);
 }
 
@@ -3693,6 +4588,9 @@ collapse_cb (EtBrowser *self, GtkTreeIter *iter, GtkTreePath *treePath, GtkTreeV
 
     g_return_if_fail (priv->directory_model != NULL);
 
+    /* Stop reading the directory, and its subdirectories, in the background. */
+    cancel_expansions (self, treePath);
+
     gtk_tree_model_get (GTK_TREE_MODEL (priv->directory_model), iter,
                         TREE_COLUMN_FULL_PATH, &path, -1);
 
@@ -3917,6 +4815,12 @@ create_browser (EtBrowser *self)
                               gtk_bin_get_child (GTK_BIN (priv->entry_combo)));
 
     /* The tree view */
+    priv->folder_icon = g_themed_icon_new ("folder");
+    priv->icon_cancellable = g_cancellable_new ();
+    gtk_tree_view_column_set_cell_data_func (priv->directory_column,
+                                             priv->directory_icon_renderer,
+                                             directory_icon_data_func, self,
+                                             NULL);
     Browser_Tree_Initialize (self);
 
     /* Create popup menu on browser tree view. */
@@ -4964,6 +5868,21 @@ et_browser_destroy (GtkWidget *widget)
         /* The model is disposed when the combo box is disposed. */
     }
 
+    /* Pending reads of directories and of their permissions keep a reference
+     * on the browser, so stop them. */
+    cancel_expansions (ET_BROWSER (widget), NULL);
+
+    if (priv->icon_cancellable)
+    {
+        g_cancellable_cancel (priv->icon_cancellable);
+    }
+
+    if (priv->icons_idle_id != 0)
+    {
+        g_source_remove (priv->icons_idle_id);
+        priv->icons_idle_id = 0;
+    }
+
     GTK_WIDGET_CLASS (et_browser_parent_class)->destroy (widget);
 }
 
@@ -4976,6 +5895,8 @@ et_browser_finalize (GObject *object)
 
     g_clear_object (&priv->current_path);
     g_clear_object (&priv->run_program_model);
+    g_clear_object (&priv->folder_icon);
+    g_clear_object (&priv->icon_cancellable);
 
     G_OBJECT_CLASS (et_browser_parent_class)->finalize (object);
 }
@@ -5023,6 +5944,10 @@ void et_browser_class_init (EtBrowserClass *klass)
                                                   directory_model);
     gtk_widget_class_bind_template_child_private (widget_class, EtBrowser,
                                                   directory_view);
+    gtk_widget_class_bind_template_child_private (widget_class, EtBrowser,
+                                                  directory_column);
+    gtk_widget_class_bind_template_child_private (widget_class, EtBrowser,
+                                                  directory_icon_renderer);
     gtk_widget_class_bind_template_callback (widget_class, collapse_cb);
     gtk_widget_class_bind_template_callback (widget_class, expand_cb);
     gtk_widget_class_bind_template_callback (widget_class,
@@ -25,6 +25,7 @@
 #include "charset.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <glib/gi18n.h>
 
 #ifdef HAVE_LANGINFO_CODESET
@@ -394,6 +395,351 @@ const gchar *get_locale (void)
 
 
 
+/*
+ * Conversions are done for every text field of every file which is read, so
+ * the iconv descriptors, which are expensive to open, are kept for reuse. The
+ * cache is per thread, as a descriptor holds conversion state.
+ */
+static void
+converter_free (gpointer data)
+{
+    g_iconv_close ((GIConv)data);
+}
+
+static void
+converters_free (gpointer data)
+{
+    g_hash_table_unref ((GHashTable *)data);
+}
+
+static GPrivate converters = G_PRIVATE_INIT (converters_free);
+
+static GIConv
+get_converter (const gchar *to_codeset,
+               const gchar *from_codeset,
+               GError **error)
+{
+    GHashTable *table;
+    gchar *key;
+    GIConv cd;
+
+    table = g_private_get (&converters);
+
+    if (table == NULL)
+    {
+        table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                       converter_free);
+        g_private_set (&converters, table);
+    }
+
+    key = g_strconcat (to_codeset, "\n", from_codeset, NULL);
+    cd = g_hash_table_lookup (table, key);
+
+    if (cd != NULL)
+    {
+        g_free (key);
+
+        /* Return to the initial shift state. */
+        g_iconv (cd, NULL, NULL, NULL, NULL);
+
+        return cd;
+    }
+
+    cd = g_iconv_open (to_codeset, from_codeset);
+
+    if (cd == (GIConv)-1)
+    {
+        g_free (key);
+        g_set_error (error, G_CONVERT_ERROR, G_CONVERT_ERROR_NO_CONVERSION,
+                     _("Conversion from character set ‘%s’ to ‘%s’ is not supported"),
+                     from_codeset, to_codeset);
+        return (GIConv)-1;
+    }
+
+    g_hash_table_insert (table, key, cd);
+
+    return cd;
+}
+
+static gboolean
+codeset_has_prefix (const gchar *codeset,
+                    const gchar *prefix)
+{
+    return g_ascii_strncasecmp (codeset, prefix, strlen (prefix)) == 0;
+}
+
+static gboolean
+codeset_is_utf8 (const gchar *codeset)
+{
+    return g_ascii_strcasecmp (codeset, "UTF-8") == 0
+           || g_ascii_strcasecmp (codeset, "UTF8") == 0;
+}
+
+static gboolean
+codeset_is_latin1 (const gchar *codeset)
+{
+    return g_ascii_strcasecmp (codeset, "ISO-8859-1") == 0
+           || g_ascii_strcasecmp (codeset, "ISO8859-1") == 0
+           || g_ascii_strcasecmp (codeset, "ISO_8859-1") == 0
+           || g_ascii_strcasecmp (codeset, "LATIN1") == 0;
+}
+
+/*
+ * Whether ASCII text is unchanged in the codeset. This is deliberately
+ * conservative: some multibyte encodings, such as Shift_JIS, map parts of the
+ * ASCII range to other characters, and UTF-7 treats '+' specially.
+ */
+static gboolean
+codeset_is_ascii_compatible (const gchar *codeset)
+{
+    static const gchar * const prefixes[] =
+    {
+        "UTF-8", "UTF8", "ISO-8859-", "ISO8859-", "ISO_8859-", "LATIN",
+        "WINDOWS-125", "CP125", "KOI8-", "ASCII", "US-ASCII", "ANSI_X3.4"
+    };
+    gsize i;
+
+    for (i = 0; i < G_N_ELEMENTS (prefixes); i++)
+    {
+        if (codeset_has_prefix (codeset, prefixes[i]))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/*
+ * Return the length of the ASCII prefix of @string, checking a word at a
+ * time.
+ */
+static gsize
+ascii_prefix_length (const gchar *string,
+                     gsize length)
+{
+    const guchar *p = (const guchar *)string;
+    const gsize high_bits = ((gsize)-1 / 0xff) * 0x80;
+    gsize i = 0;
+
+    for (; i + sizeof (gsize) <= length; i += sizeof (gsize))
+    {
+        gsize word;
+
+        memcpy (&word, p + i, sizeof (word));
+
+        if (word & high_bits)
+        {
+            break;
+        }
+    }
+
+    for (; i < length; i++)
+    {
+        if (p[i] & 0x80)
+        {
+            break;
+        }
+    }
+
+    return i;
+}
+
+/*
+ * et_charset_utf8_validate:
+ * @string: a string
+ * @length: the length of @string in bytes, or -1 if it is nul-terminated
+ * @end: return location for the end of the valid data, or %NULL
+ *
+ * Like g_utf8_validate(), but with a fast path for runs of ASCII, which make
+ * up most tag fields.
+ *
+ * Returns: %TRUE if @string is valid UTF-8, %FALSE otherwise
+ */
+gboolean
+et_charset_utf8_validate (const gchar *string,
+                          gssize length,
+                          const gchar **end)
+{
+    gsize len;
+    gsize prefix;
+
+    g_return_val_if_fail (string != NULL, FALSE);
+
+    len = length < 0 ? strlen (string) : (gsize)length;
+    prefix = ascii_prefix_length (string, len);
+
+    /* As with g_utf8_validate(), nul bytes within @length are invalid. */
+    if (length >= 0)
+    {
+        const gchar *nul = memchr (string, '\0', prefix);
+
+        if (nul)
+        {
+            if (end)
+            {
+                *end = nul;
+            }
+
+            return FALSE;
+        }
+    }
+
+    if (prefix == len)
+    {
+        if (end)
+        {
+            *end = string + len;
+        }
+
+        return TRUE;
+    }
+
+    return g_utf8_validate (string + prefix, len - prefix, end);
+}
+
+static gchar *
+latin1_to_utf8 (const gchar *string,
+                gsize length,
+                gsize *bytes_written)
+{
+    const guchar *p = (const guchar *)string;
+    gchar *output;
+    gchar *q;
+    gsize i;
+
+    output = g_malloc (length * 2 + 1);
+    q = output;
+
+    for (i = 0; i < length; i++)
+    {
+        if (p[i] < 0x80)
+        {
+            *q++ = p[i];
+        }
+        else
+        {
+            *q++ = 0xc0 | (p[i] >> 6);
+            *q++ = 0x80 | (p[i] & 0x3f);
+        }
+    }
+
+    *q = '\0';
+
+    if (bytes_written)
+    {
+        *bytes_written = q - output;
+    }
+
+    return output;
+}
+
+/*
+ * et_charset_convert:
+ * @string: the string to convert
+ * @length: the length of @string in bytes, or -1 if it is nul-terminated
+ * @to_codeset: the character set to convert to
+ * @from_codeset: the character set of @string
+ * @bytes_read: return location for the number of bytes converted, or %NULL
+ * @bytes_written: return location for the length of the result, or %NULL
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * A replacement for g_convert(), which reuses the iconv descriptors, and
+ * avoids iconv altogether for ASCII strings, Latin-1 to UTF-8 and UTF-8 to
+ * UTF-8.
+ *
+ * Returns: the converted, nul-terminated string, or %NULL on error
+ */
+gchar *
+et_charset_convert (const gchar *string,
+                    gssize length,
+                    const gchar *to_codeset,
+                    const gchar *from_codeset,
+                    gsize *bytes_read,
+                    gsize *bytes_written,
+                    GError **error)
+{
+    gsize len;
+    GIConv cd;
+
+    g_return_val_if_fail (string != NULL, NULL);
+    g_return_val_if_fail (to_codeset != NULL && from_codeset != NULL, NULL);
+
+    len = length < 0 ? strlen (string) : (gsize)length;
+
+    if (codeset_is_ascii_compatible (from_codeset)
+        && codeset_is_ascii_compatible (to_codeset)
+        && ascii_prefix_length (string, len) == len)
+    {
+        gchar *output = g_malloc (len + 1);
+
+        memcpy (output, string, len);
+        output[len] = '\0';
+
+        if (bytes_read)
+        {
+            *bytes_read = len;
+        }
+
+        if (bytes_written)
+        {
+            *bytes_written = len;
+        }
+
+        return output;
+    }
+
+    if (codeset_is_utf8 (to_codeset))
+    {
+        if (codeset_is_latin1 (from_codeset))
+        {
+            if (bytes_read)
+            {
+                *bytes_read = len;
+            }
+
+            return latin1_to_utf8 (string, len, bytes_written);
+        }
+        else if (codeset_is_utf8 (from_codeset)
+                 && et_charset_utf8_validate (string, len, NULL))
+        {
+            /* Invalid input falls back to iconv, which reports the error
+             * and its position as g_convert() does. */
+            if (bytes_read)
+            {
+                *bytes_read = len;
+            }
+
+            if (bytes_written)
+            {
+                *bytes_written = len;
+            }
+
+            return g_strndup (string, len);
+        }
+    }
+
+    cd = get_converter (to_codeset, from_codeset, error);
+
+    if (cd == (GIConv)-1)
+    {
+        if (bytes_read)
+        {
+            *bytes_read = 0;
+        }
+
+        if (bytes_written)
+        {
+            *bytes_written = 0;
+        }
+
+        return NULL;
+    }
+
+    return g_convert_with_iconv (string, len, cd, bytes_read, bytes_written,
+                                 error);
+}
+
 /*
  * convert_string : (don't use with UTF-16 strings)
  *  - display_error : if TRUE, may return an escaped string and display an error
@@ -417,7 +763,8 @@ convert_string_1 (const gchar *string, gssize length, const gchar *from_codeset,
 
     g_return_val_if_fail (string != NULL, NULL);
 
-    output = g_convert(string, length, to_codeset, from_codeset, NULL, &bytes_written, &error);
+    output = et_charset_convert (string, length, to_codeset, from_codeset, NULL,
+                                 &bytes_written, &error);
     //output = g_convert_with_fallback(string, length, to_codeset, from_codeset, "?", NULL, &bytes_written, &error);
 
     if (output == NULL)
@@ -434,7 +781,7 @@ convert_string_1 (const gchar *string, gssize length, const gchar *from_codeset,
         // Return the input string without converting it. If the string is
         // displayed in the UI, it must be in UTF-8!
         if ( (g_ascii_strcasecmp(to_codeset, "UTF-8"))
-        ||   (g_utf8_validate(string, -1, NULL)) )
+        ||   (et_charset_utf8_validate (string, -1, NULL)) )
         {
             return g_strdup(string);
         }
@@ -515,7 +862,8 @@ filename_from_display (const gchar *string)
                  * be silently discarded.
                  */
                 gchar *enc = g_strconcat (*filename_encodings, "//IGNORE", NULL);
-                ret = g_convert (string, -1, enc, "UTF-8", NULL, NULL, &error);
+                ret = et_charset_convert (string, -1, enc, "UTF-8", NULL, NULL,
+                                          &error);
 
                 if (!ret)
                 {
@@ -540,8 +888,8 @@ filename_from_display (const gchar *string)
         /* Guess the legacy (pre-Unicode) filesystem encoding from the locale.
          * For example, fr_FR.UTF-8 => fr_FR => ISO-8859-1. */
         legacy_encoding = get_encoding_from_locale (get_locale ());
-        ret = g_convert (string, -1, legacy_encoding, "UTF-8", NULL, NULL,
-                         &error);
+        ret = et_charset_convert (string, -1, legacy_encoding, "UTF-8", NULL,
+                                  NULL, &error);
 
         if (!ret)
         {
@@ -554,8 +902,8 @@ filename_from_display (const gchar *string)
     if (!ret)
     {
         /* Failing that, try ISO-8859-1. */
-        ret = g_convert (string, -1, "ISO-8859-1", "UTF-8", NULL, NULL,
-                         &error);
+        ret = et_charset_convert (string, -1, "ISO-8859-1", "UTF-8", NULL,
+                                  NULL, &error);
 
         if (!ret)
         {
@@ -600,7 +948,7 @@ Try_To_Validate_Utf8_String (const gchar *string)
 
     g_return_val_if_fail (string != NULL, NULL);
 
-    if (g_utf8_validate (string, -1, NULL))
+    if (et_charset_utf8_validate (string, -1, NULL))
     {
         /* String already in UTF-8. */
         ret = g_strdup (string);
@@ -612,8 +960,8 @@ Try_To_Validate_Utf8_String (const gchar *string)
         /* Guess the legacy (pre-Unicode) encoding associated with the locale.
          * For example, fr_FR.UTF-8 => fr_FR => ISO-8859-1. */
         legacy_encoding = get_encoding_from_locale (get_locale ());
-        ret = g_convert (string, -1, "UTF-8", legacy_encoding, NULL, NULL,
-                         &error);
+        ret = et_charset_convert (string, -1, "UTF-8", legacy_encoding, NULL,
+                                  NULL, &error);
 
         if (!ret)
         {
@@ -621,8 +969,8 @@ Try_To_Validate_Utf8_String (const gchar *string)
             g_debug ("Error converting string to legacy encoding '%s': %s",
                      legacy_encoding, error->message);
             g_clear_error (&error);
-            ret = g_convert (string, -1, "UTF-8", "ISO-8859-1", NULL, NULL,
-                             &error);
+            ret = et_charset_convert (string, -1, "UTF-8", "ISO-8859-1",
+                                      NULL, NULL, &error);
         }
 
         if (!ret)
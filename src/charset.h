@@ -27,6 +27,9 @@ G_BEGIN_DECLS
 const char  *get_encoding_from_locale (const char *locale);
 const gchar *get_locale               (void);
 
+gchar *et_charset_convert (const gchar *string, gssize length, const gchar *to_codeset, const gchar *from_codeset, gsize *bytes_read, gsize *bytes_written, GError **error);
+gboolean et_charset_utf8_validate (const gchar *string, gssize length, const gchar **end);
+
 gchar *convert_string   (const gchar *string, const gchar *from_codeset, const gchar *to_codeset, const gboolean display_error);
 gchar *convert_string_1 (const gchar *string, gssize length, const gchar *from_codeset, const gchar *to_codeset, const gboolean display_error);
 
@@ -18,11 +18,19 @@
  * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+#include "config.h"
+
 #include "crc32.h"
+
+#include <glib/gi18n.h>
+
 #include "id3_tag.h"
 
 #define BUFFERSIZE 16384   /* (16k) buffer size for reading from the file */
 
+/* Past this number of files, the cache is emptied rather than growing. */
+#define CRC32_CACHE_SIZE 65536
+
 /* TODO: Use GChecksum if https://bugzilla.gnome.org/show_bug.cgi?id=523149
  * is fixed and CRC32 support is added to GLib.
  */
@@ -109,7 +117,7 @@ crc32_file_with_ID3_tag (GFile *file,
 {
     gchar buf[BUFFERSIZE], *p;
     gint nr;
-    guint32 crc = ~0, crc32_total = ~0;
+    guint32 crc = ~0;
     guchar tmp_id3[4];
     glong id3v2size = 0;
     GFileInfo *info;
@@ -234,7 +242,6 @@ crc32_file_with_ID3_tag (GFile *file,
         for (p = buf; nr--; ++p)
         {
             crc = (crc >> 8) ^ crc32table[(crc ^ *p) & 0xff];
-            crc32_total = (crc >> 8) ^ crc32table[(crc32_total ^ *p) & 0xff];
         }
     }
 
@@ -256,3 +263,282 @@ error:
     nr = -1;
     goto out;
 }
+
+/* Cache of the CRC32 values, keyed by the URI, modification time and size of
+ * each file, so that scanning the same files again does not read them. */
+static GMutex crc32_cache_mutex;
+static GHashTable *crc32_cache;
+
+static gchar *
+crc32_cache_key_new (GFile *file,
+                     GFileInfo *info)
+{
+    gchar *uri;
+    gchar *key;
+
+    uri = g_file_get_uri (file);
+    key = g_strdup_printf ("%s\n%" G_GUINT64_FORMAT ".%u\n%" G_GOFFSET_FORMAT,
+                           uri,
+                           g_file_info_get_attribute_uint64 (info,
+                                                             G_FILE_ATTRIBUTE_TIME_MODIFIED),
+                           g_file_info_get_attribute_uint32 (info,
+                                                             G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC),
+                           g_file_info_get_size (info));
+    g_free (uri);
+
+    return key;
+}
+
+/*
+ * et_crc32_file_cached:
+ * @file: a file from which to read audio data
+ * @crc32: (out): the CRC32 value
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Calculate the CRC32 value of audio data, as crc32_file_with_ID3_tag() does,
+ * unless the value is known from an earlier call for the same file, with the
+ * same modification time and size. This can be called from any thread.
+ *
+ * Returns: %TRUE if the CRC calculation was successful, %FALSE otherwise
+ */
+gboolean
+et_crc32_file_cached (GFile *file,
+                      guint32 *crc32,
+                      GError **error)
+{
+    GFileInfo *info;
+    gchar *key;
+    gpointer value;
+    gboolean found;
+
+    g_return_val_if_fail (file != NULL, FALSE);
+    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+    info = g_file_query_info (file,
+                              G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                              G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                              G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                              G_FILE_QUERY_INFO_NONE, NULL, error);
+
+    if (!info)
+    {
+        return FALSE;
+    }
+
+    key = crc32_cache_key_new (file, info);
+    g_object_unref (info);
+
+    g_mutex_lock (&crc32_cache_mutex);
+    found = crc32_cache
+            && g_hash_table_lookup_extended (crc32_cache, key, NULL, &value);
+    g_mutex_unlock (&crc32_cache_mutex);
+
+    if (found)
+    {
+        *crc32 = GPOINTER_TO_UINT (value);
+        g_free (key);
+        return TRUE;
+    }
+
+    if (!crc32_file_with_ID3_tag (file, crc32, error))
+    {
+        g_free (key);
+        return FALSE;
+    }
+
+    g_mutex_lock (&crc32_cache_mutex);
+
+    if (!crc32_cache)
+    {
+        crc32_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                             NULL);
+    }
+    else if (g_hash_table_size (crc32_cache) >= CRC32_CACHE_SIZE)
+    {
+        g_hash_table_remove_all (crc32_cache);
+    }
+
+    g_hash_table_replace (crc32_cache, key, GUINT_TO_POINTER (*crc32));
+    g_mutex_unlock (&crc32_cache_mutex);
+
+    return TRUE;
+}
+
+/*
+ * EtCrc32JobResult:
+ * @done: whether the file was read
+ * @crc32: the CRC32 value, if there was no error
+ * @error: the reason that the value could not be calculated, or %NULL
+ */
+typedef struct
+{
+    gboolean done;
+    guint32 crc32;
+    GError *error;
+} EtCrc32JobResult;
+
+/*
+ * EtCrc32Job:
+ * @files: (array length=n_files): the files to read
+ * @results: (array length=n_files): the results, in the same order as @files
+ * @n_files: the number of files
+ * @worker_job: the job which reads the files on the worker threads
+ */
+struct _EtCrc32Job
+{
+    GFile **files;
+    EtCrc32JobResult *results;
+    guint n_files;
+    EtWorkerJob *worker_job;
+};
+
+static void
+et_crc32_job_read_file (guint index,
+                        gpointer user_data)
+{
+    EtCrc32Job *job = user_data;
+    EtCrc32JobResult *result = &job->results[index];
+
+    et_crc32_file_cached (job->files[index], &result->crc32, &result->error);
+    result->done = TRUE;
+}
+
+/*
+ * et_crc32_job_new:
+ * @files: (element-type GFile): the files to read
+ * @max_threads: the maximum number of files to read at the same time
+ *
+ * Start calculating the CRC32 values of @files, as et_crc32_file_cached()
+ * does, on up to @max_threads worker threads. The progress can be followed
+ * with the #EtWorkerJob from et_crc32_job_get_worker_job().
+ *
+ * Returns: a new #EtCrc32Job, to be freed with et_crc32_job_free()
+ */
+EtCrc32Job *
+et_crc32_job_new (GList *files,
+                  guint max_threads)
+{
+    EtCrc32Job *job;
+    GList *l;
+    guint i;
+
+    g_return_val_if_fail (max_threads > 0, NULL);
+
+    job = g_slice_new0 (EtCrc32Job);
+    job->n_files = g_list_length (files);
+    job->files = g_new (GFile *, job->n_files);
+    job->results = g_new0 (EtCrc32JobResult, job->n_files);
+
+    for (l = files, i = 0; l != NULL; l = g_list_next (l), i++)
+    {
+        /* The workers do not share the GFiles of the caller. */
+        job->files[i] = g_file_dup (G_FILE (l->data));
+    }
+
+    job->worker_job = et_worker_job_new ("crc32", job->n_files, max_threads,
+                                         et_crc32_job_read_file, job);
+
+    return job;
+}
+
+/*
+ * et_crc32_job_get_worker_job:
+ * @job: the job
+ *
+ * Returns: (transfer none): the job which reads the files, one item per file
+ */
+EtWorkerJob *
+et_crc32_job_get_worker_job (EtCrc32Job *job)
+{
+    g_return_val_if_fail (job != NULL, NULL);
+
+    return job->worker_job;
+}
+
+/*
+ * et_crc32_job_wait:
+ * @job: the job
+ * @cancel: %TRUE to skip the files which have not been started yet
+ *
+ * Wait for the worker threads to finish, after which the results can be
+ * retrieved with et_crc32_job_get_result().
+ */
+void
+et_crc32_job_wait (EtCrc32Job *job,
+                   gboolean cancel)
+{
+    g_return_if_fail (job != NULL);
+
+    et_worker_job_wait (job->worker_job, cancel);
+}
+
+/*
+ * et_crc32_job_get_result:
+ * @job: the job
+ * @index: the index of a file, in the list passed to et_crc32_job_new()
+ * @crc32: (out): the CRC32 value
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Get the CRC32 value of a file, once et_crc32_job_wait() has returned.
+ *
+ * Returns: %TRUE if the CRC calculation was successful, %FALSE if it failed or
+ *          if the job was cancelled before the file was read
+ */
+gboolean
+et_crc32_job_get_result (EtCrc32Job *job,
+                         guint index,
+                         guint32 *crc32,
+                         GError **error)
+{
+    const EtCrc32JobResult *result;
+
+    g_return_val_if_fail (job != NULL, FALSE);
+    g_return_val_if_fail (index < job->n_files, FALSE);
+    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+    result = &job->results[index];
+
+    if (!result->done)
+    {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                             _("The file was not read"));
+        return FALSE;
+    }
+
+    if (result->error)
+    {
+        g_propagate_error (error, g_error_copy (result->error));
+        return FALSE;
+    }
+
+    *crc32 = result->crc32;
+
+    return TRUE;
+}
+
+/*
+ * et_crc32_job_free:
+ * @job: the job
+ *
+ * Cancel the files which have not been started yet, wait for the worker
+ * threads, and free @job.
+ */
+void
+et_crc32_job_free (EtCrc32Job *job)
+{
+    guint i;
+
+    g_return_if_fail (job != NULL);
+
+    et_worker_job_free (job->worker_job);
+
+    for (i = 0; i < job->n_files; i++)
+    {
+        g_object_unref (job->files[i]);
+        g_clear_error (&job->results[i].error);
+    }
+
+    g_free (job->files);
+    g_free (job->results);
+    g_slice_free (EtCrc32Job, job);
+}
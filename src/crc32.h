@@ -24,9 +24,26 @@
 #include <glib.h>
 #include <gio/gio.h>
 
+#include "worker_job.h"
+
 G_BEGIN_DECLS
 
 gboolean crc32_file_with_ID3_tag (GFile *file, guint32 *crc32, GError **err);
+gboolean et_crc32_file_cached (GFile *file, guint32 *crc32, GError **error);
+
+/*
+ * EtCrc32Job:
+ *
+ * Calculates the CRC32 values of a list of files on a few worker threads, so
+ * that the main loop keeps running while the files are read.
+ */
+typedef struct _EtCrc32Job EtCrc32Job;
+
+EtCrc32Job * et_crc32_job_new (GList *files, guint max_threads);
+EtWorkerJob * et_crc32_job_get_worker_job (EtCrc32Job *job);
+void et_crc32_job_wait (EtCrc32Job *job, gboolean cancel);
+gboolean et_crc32_job_get_result (EtCrc32Job *job, guint index, guint32 *crc32, GError **error);
+void et_crc32_job_free (EtCrc32Job *job);
 
 G_END_DECLS
 
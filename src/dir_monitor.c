@@ -0,0 +1,391 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "dir_monitor.h"
+
+#include <string.h>
+
+/*
+ * EtDirMonitor:
+ * @recursive: whether directories which appear in a watched directory are
+ *             watched too
+ * @show_hidden: whether hidden directories are watched when they appear
+ * @func: the function which is called with the changes
+ * @user_data: the data to pass to @func
+ * @watches: (element-type filename GFileMonitor): the watched directories,
+ *           by path
+ * @pending: (element-type filename GFile): the files which changed since
+ *           @func was last called, by path
+ * @flush_id: the source which calls @func, or 0
+ */
+struct _EtDirMonitor
+{
+    gboolean recursive;
+    gboolean show_hidden;
+    EtDirMonitorFunc func;
+    gpointer user_data;
+    GHashTable *watches;
+    GHashTable *pending;
+    guint flush_id;
+};
+
+static void et_dir_monitor_add_tree (EtDirMonitor *monitor, GFile *dir);
+
+static gboolean
+on_flush_timeout (gpointer user_data)
+{
+    EtDirMonitor *monitor = user_data;
+    GList *files;
+
+    monitor->flush_id = 0;
+
+    files = g_hash_table_get_values (monitor->pending);
+
+    if (monitor->func (files, monitor->user_data))
+    {
+        g_hash_table_remove_all (monitor->pending);
+    }
+    else
+    {
+        /* Try again later, with the changes which arrive in between. */
+        monitor->flush_id = g_timeout_add (ET_DIR_MONITOR_DELAY,
+                                           on_flush_timeout, monitor);
+    }
+
+    g_list_free (files);
+
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * et_dir_monitor_queue:
+ * @monitor: the monitor
+ * @file: a file which changed
+ *
+ * Add @file to the changes which are reported after the next delay. A file
+ * which changes several times, as when it is written in chunks, is reported
+ * once.
+ */
+static void
+et_dir_monitor_queue (EtDirMonitor *monitor,
+                      GFile *file)
+{
+    gchar *path;
+
+    path = g_file_get_path (file);
+
+    if (path == NULL)
+    {
+        return;
+    }
+
+    g_hash_table_replace (monitor->pending, path, g_object_ref (file));
+
+    if (monitor->flush_id == 0)
+    {
+        monitor->flush_id = g_timeout_add (ET_DIR_MONITOR_DELAY,
+                                           on_flush_timeout, monitor);
+    }
+}
+
+/*
+ * et_dir_monitor_remove_tree:
+ * @monitor: the monitor
+ * @dir: a directory which was deleted or moved away
+ *
+ * Stop watching @dir and the directories below it.
+ */
+static void
+et_dir_monitor_remove_tree (EtDirMonitor *monitor,
+                            GFile *dir)
+{
+    gchar *path;
+    gchar *prefix;
+    gsize prefix_len;
+    GHashTableIter iter;
+    gpointer key;
+
+    path = g_file_get_path (dir);
+
+    if (path == NULL || !g_hash_table_remove (monitor->watches, path))
+    {
+        /* Not a watched directory. */
+        g_free (path);
+        return;
+    }
+
+    prefix = g_strconcat (path, G_DIR_SEPARATOR_S, NULL);
+    prefix_len = strlen (prefix);
+
+    g_hash_table_iter_init (&iter, monitor->watches);
+
+    while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+        if (strncmp (key, prefix, prefix_len) == 0)
+        {
+            g_hash_table_iter_remove (&iter);
+        }
+    }
+
+    g_free (prefix);
+    g_free (path);
+}
+
+/*
+ * et_dir_monitor_check_new:
+ * @monitor: the monitor
+ * @file: a file which appeared in a watched directory
+ *
+ * If @file is a directory, and directories are watched recursively, watch it
+ * and report the files in it, which appeared with it.
+ */
+static void
+et_dir_monitor_check_new (EtDirMonitor *monitor,
+                          GFile *file)
+{
+    GFileInfo *info;
+
+    if (!monitor->recursive)
+    {
+        return;
+    }
+
+    info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                              G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN,
+                              G_FILE_QUERY_INFO_NONE, NULL, NULL);
+
+    if (info == NULL)
+    {
+        return;
+    }
+
+    if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY
+        && (monitor->show_hidden || !g_file_info_get_is_hidden (info)))
+    {
+        et_dir_monitor_add_tree (monitor, file);
+    }
+
+    g_object_unref (info);
+}
+
+static void
+on_watch_changed (GFileMonitor *file_monitor,
+                  GFile *file,
+                  GFile *other_file,
+                  GFileMonitorEvent event_type,
+                  gpointer user_data)
+{
+    EtDirMonitor *monitor = user_data;
+
+    switch (event_type)
+    {
+        case G_FILE_MONITOR_EVENT_CHANGED:
+        case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+            et_dir_monitor_queue (monitor, file);
+            break;
+        case G_FILE_MONITOR_EVENT_CREATED:
+            et_dir_monitor_queue (monitor, file);
+            et_dir_monitor_check_new (monitor, file);
+            break;
+        case G_FILE_MONITOR_EVENT_DELETED:
+            et_dir_monitor_queue (monitor, file);
+            et_dir_monitor_remove_tree (monitor, file);
+            break;
+        case G_FILE_MONITOR_EVENT_MOVED:
+            et_dir_monitor_queue (monitor, file);
+            et_dir_monitor_remove_tree (monitor, file);
+
+            if (other_file)
+            {
+                et_dir_monitor_queue (monitor, other_file);
+                et_dir_monitor_check_new (monitor, other_file);
+            }
+            break;
+        case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+        case G_FILE_MONITOR_EVENT_PRE_UNMOUNT:
+        case G_FILE_MONITOR_EVENT_UNMOUNTED:
+        default:
+            break;
+    }
+}
+
+static void
+et_dir_monitor_watch_free (gpointer data)
+{
+    GFileMonitor *file_monitor = data;
+
+    g_signal_handlers_disconnect_matched (file_monitor, G_SIGNAL_MATCH_FUNC,
+                                          0, 0, NULL, on_watch_changed, NULL);
+    g_file_monitor_cancel (file_monitor);
+    g_object_unref (file_monitor);
+}
+
+/*
+ * et_dir_monitor_add_tree:
+ * @monitor: the monitor
+ * @dir: a directory which appeared in a watched directory
+ *
+ * Watch @dir and the directories below it, and report the files in them.
+ */
+static void
+et_dir_monitor_add_tree (EtDirMonitor *monitor,
+                         GFile *dir)
+{
+    GFileEnumerator *enumerator;
+    GFileInfo *info;
+
+    et_dir_monitor_add (monitor, dir);
+
+    enumerator = g_file_enumerate_children (dir,
+                                            G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                            G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                                            G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN,
+                                            G_FILE_QUERY_INFO_NONE, NULL,
+                                            NULL);
+
+    if (enumerator == NULL)
+    {
+        return;
+    }
+
+    while ((info = g_file_enumerator_next_file (enumerator, NULL, NULL)))
+    {
+        GFile *child;
+
+        child = g_file_enumerator_get_child (enumerator, info);
+
+        if (g_file_info_get_file_type (info) != G_FILE_TYPE_DIRECTORY)
+        {
+            et_dir_monitor_queue (monitor, child);
+        }
+        else if (monitor->show_hidden || !g_file_info_get_is_hidden (info))
+        {
+            et_dir_monitor_add_tree (monitor, child);
+        }
+
+        g_object_unref (child);
+        g_object_unref (info);
+    }
+
+    g_file_enumerator_close (enumerator, NULL, NULL);
+    g_object_unref (enumerator);
+}
+
+/*
+ * et_dir_monitor_new:
+ * @recursive: whether to watch the directories which appear in the watched
+ *             directories
+ * @show_hidden: whether to watch hidden directories which appear
+ * @func: the function to call with the changes
+ * @user_data: the data to pass to @func
+ *
+ * Create a monitor, which does not watch any directory until
+ * et_dir_monitor_add() is called.
+ *
+ * Returns: a new #EtDirMonitor, free with et_dir_monitor_free()
+ */
+EtDirMonitor *
+et_dir_monitor_new (gboolean recursive,
+                    gboolean show_hidden,
+                    EtDirMonitorFunc func,
+                    gpointer user_data)
+{
+    EtDirMonitor *monitor;
+
+    g_return_val_if_fail (func != NULL, NULL);
+
+    monitor = g_slice_new0 (EtDirMonitor);
+    monitor->recursive = recursive;
+    monitor->show_hidden = show_hidden;
+    monitor->func = func;
+    monitor->user_data = user_data;
+    monitor->watches = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                              et_dir_monitor_watch_free);
+    monitor->pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                              g_object_unref);
+
+    return monitor;
+}
+
+/*
+ * et_dir_monitor_add:
+ * @monitor: the monitor
+ * @dir: a directory
+ *
+ * Watch the files in @dir, but not the existing directories below it, which
+ * must be added separately, as they are found when reading @dir anyway.
+ */
+void
+et_dir_monitor_add (EtDirMonitor *monitor,
+                    GFile *dir)
+{
+    GFileMonitor *file_monitor;
+    gchar *path;
+    GError *error = NULL;
+
+    g_return_if_fail (monitor != NULL);
+    g_return_if_fail (G_IS_FILE (dir));
+
+    path = g_file_get_path (dir);
+
+    if (path == NULL || g_hash_table_contains (monitor->watches, path))
+    {
+        g_free (path);
+        return;
+    }
+
+    file_monitor = g_file_monitor_directory (dir, G_FILE_MONITOR_SEND_MOVED,
+                                             NULL, &error);
+
+    if (file_monitor == NULL)
+    {
+        /* The directory is simply not watched, as if watching was disabled. */
+        g_debug ("Cannot watch directory ‘%s’: %s", path, error->message);
+        g_error_free (error);
+        g_free (path);
+        return;
+    }
+
+    g_signal_connect (file_monitor, "changed", G_CALLBACK (on_watch_changed),
+                      monitor);
+    g_hash_table_insert (monitor->watches, path, file_monitor);
+}
+
+/*
+ * et_dir_monitor_free:
+ * @monitor: the monitor
+ *
+ * Stop watching all the directories, dropping the changes which were not
+ * reported yet, and free @monitor.
+ */
+void
+et_dir_monitor_free (EtDirMonitor *monitor)
+{
+    g_return_if_fail (monitor != NULL);
+
+    if (monitor->flush_id != 0)
+    {
+        g_source_remove (monitor->flush_id);
+    }
+
+    g_hash_table_destroy (monitor->watches);
+    g_hash_table_destroy (monitor->pending);
+    g_slice_free (EtDirMonitor, monitor);
+}
@@ -0,0 +1,60 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ET_DIR_MONITOR_H_
+#define ET_DIR_MONITOR_H_
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* Delay, in milliseconds, during which changes are collected before they are
+ * reported together. */
+#define ET_DIR_MONITOR_DELAY 500
+
+/*
+ * EtDirMonitorFunc:
+ * @files: (element-type GFile): the files and directories which were created,
+ *         deleted, changed or moved, each listed once
+ * @user_data: the data passed to et_dir_monitor_new()
+ *
+ * Called from the main loop with the changes which were collected during
+ * %ET_DIR_MONITOR_DELAY. The files were not checked, so they may not exist
+ * any more.
+ *
+ * Returns: %TRUE if the changes were handled, %FALSE to be called again with
+ * them, and any later changes, after another delay
+ */
+typedef gboolean (*EtDirMonitorFunc) (GList *files, gpointer user_data);
+
+/*
+ * EtDirMonitor:
+ *
+ * Watches a set of directories for changes made by other programs, and
+ * reports them in batches, so that only the files which changed need to be
+ * read again.
+ */
+typedef struct _EtDirMonitor EtDirMonitor;
+
+EtDirMonitor * et_dir_monitor_new (gboolean recursive, gboolean show_hidden, EtDirMonitorFunc func, gpointer user_data);
+void et_dir_monitor_add (EtDirMonitor *monitor, GFile *dir);
+void et_dir_monitor_free (EtDirMonitor *monitor);
+
+G_END_DECLS
+
+#endif /* !ET_DIR_MONITOR_H_ */
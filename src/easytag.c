@@ -32,11 +32,15 @@
 #include "id3_tag.h"
 #include "log.h"
 #include "misc.h"
+#include "prefetch.h"
+#include "rename_plan.h"
 #include "cddb_dialog.h"
 #include "setting.h"
 #include "scan_dialog.h"
 #include "et_core.h"
 #include "charset.h"
+#include "dir_monitor.h"
+#include "trace.h"
 
 #include "win32/win32dep.h"
 
@@ -58,14 +62,18 @@ static gint SF_ButtonPressed_Rename_File;
 
 static gboolean Write_File_Tag (ET_File *ETFile, gboolean hide_msgbox);
 static gint Save_File (ET_File *ETFile, gboolean multiple_files,
-                       gboolean force_saving_files);
+                       gboolean force_saving_files,
+                       EtRenamePlan *rename_plan);
+static void Rename_Planned_Files (EtRenamePlan *rename_plan);
 static gint Save_Selected_Files_With_Answer (gboolean force_saving_files);
 static gint Save_List_Of_Files (GList *etfilelist,
                                 gboolean force_saving_files);
 
 static GList *read_directory_recursively (GList *file_list,
                                           GFileEnumerator *dir_enumerator,
-                                          gboolean recurse);
+                                          gboolean recurse,
+                                          EtDirMonitor *monitor);
+static gboolean on_directory_changed (GList *files, gpointer user_data);
 static void Open_Quit_Recursion_Function_Window (void);
 static void Destroy_Quit_Recursion_Function_Window (void);
 static void et_on_quit_recursion_response (GtkDialog *dialog, gint response_id,
@@ -134,9 +142,9 @@ Save_List_Of_Files (GList *etfilelist, gboolean force_saving_files)
     File_Name *FileNameNew;
     double     fraction;
     GAction *action;
-    GVariant *variant;
     GtkWidget *widget_focused;
     GtkTreePath *currentPath = NULL;
+    EtRenamePlan *rename_plan;
 
     g_return_val_if_fail (ETCore != NULL, FALSE);
 
@@ -256,6 +264,11 @@ Save_List_Of_Files (GList *etfilelist, gboolean force_saving_files)
         }
     }
 
+    /* Files are renamed together once all of them have been confirmed, so
+     * that each new directory is only created once, and files can swap
+     * names. */
+    rename_plan = et_rename_plan_new ();
+
     for (l = etfilelist; l != NULL && !Main_Stop_Button_Pressed;
          l = g_list_next (l))
     {
@@ -288,10 +301,15 @@ Save_List_Of_Files (GList *etfilelist, gboolean force_saving_files)
             // Save tag and rename file
             saving_answer = Save_File ((ET_File *)l->data,
                                        nb_files_to_save > 1 ? TRUE : FALSE,
-                                       force_saving_files);
+                                       force_saving_files, rename_plan);
 
             if (saving_answer == -1)
             {
+                /* Files which were confirmed before stopping are still
+                 * renamed. */
+                Rename_Planned_Files (rename_plan);
+                et_rename_plan_free (rename_plan);
+
                 /* Stop saving files + reinit progress bar */
                 et_application_window_progress_set_text (window, "");
                 et_application_window_progress_set_fraction (window, 0.0);
@@ -316,6 +334,9 @@ Save_List_Of_Files (GList *etfilelist, gboolean force_saving_files)
     if (currentPath)
         gtk_tree_path_free(currentPath);
 
+    Rename_Planned_Files (rename_plan);
+    et_rename_plan_free (rename_plan);
+
     if (Main_Stop_Button_Pressed)
         msg = g_strdup (_("Saving files was stopped"));
     else
@@ -332,18 +353,6 @@ Save_List_Of_Files (GList *etfilelist, gboolean force_saving_files)
                                                           etfile_save_position,
                                                           TRUE);
 
-    /* FIXME: Find out why this is a special case for the artist/album mode. */
-    action = g_action_map_lookup_action (G_ACTION_MAP (MainWindow),
-                                         "file-artist-view");
-    variant = g_action_get_state (action);
-
-    if (strcmp (g_variant_get_string (variant, NULL), "artist") == 0)
-    {
-        et_application_window_browser_toggle_display_mode (window);
-    }
-
-    g_variant_unref (variant);
-
     /* To update state of command buttons */
     et_application_window_update_actions (ET_APPLICATION_WINDOW (MainWindow));
     et_application_window_browser_set_sensitive (window, TRUE);
@@ -357,7 +366,13 @@ Save_List_Of_Files (GList *etfilelist, gboolean force_saving_files)
     et_application_window_progress_set_fraction (window, 0.0);
     et_application_window_status_bar_message (window, msg, TRUE);
     g_free(msg);
-    et_application_window_browser_refresh_list (window);
+
+    /* Only the rows of the files which were saved, or edited before, need to
+     * be refreshed. */
+    et_application_window_browser_refresh_changes (window);
+
+    et_trace_log_statistics (_("Saving files"));
+
     return TRUE;
 }
 
@@ -371,7 +386,7 @@ Save_List_Of_Files (GList *etfilelist, gboolean force_saving_files)
  */
 static gint
 Save_File (ET_File *ETFile, gboolean multiple_files,
-           gboolean force_saving_files)
+           gboolean force_saving_files, EtRenamePlan *rename_plan)
 {
     const File_Tag *FileTag;
     const File_Name *FileNameNew;
@@ -625,59 +640,13 @@ Save_File (ET_File *ETFile, gboolean multiple_files,
         {
             case GTK_RESPONSE_YES:
             {
-                gboolean rc;
-                GError *error = NULL;
                 const gchar *cur_filename = ((File_Name *)ETFile->FileNameCur->data)->value;
                 const gchar *new_filename = ((File_Name *)ETFile->FileNameNew->data)->value;
-                rc = et_rename_file (cur_filename, new_filename, &error);
-
-                // if 'SF_HideMsgbox_Rename_File is TRUE', then errors are displayed only in log
-                if (!rc)
-                {
-                    if (!SF_HideMsgbox_Rename_File)
-                    {
-                        msgdialog = gtk_message_dialog_new (GTK_WINDOW (MainWindow),
-                                                            GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
-                                                            GTK_MESSAGE_ERROR,
-                                                            GTK_BUTTONS_CLOSE,
-                                                            _("Cannot rename file ‘%s’ to ‘%s’"),
-                                                            filename_cur_utf8,
-                                                            filename_new_utf8);
-                        gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (msgdialog),
-                                                                  "%s",
-                                                                  error->message);
-                        gtk_window_set_title (GTK_WINDOW (msgdialog),
-                                              _("Rename File Error"));
-
-                        gtk_dialog_run (GTK_DIALOG (msgdialog));
-                        gtk_widget_destroy (msgdialog);
-                    }
 
-                    Log_Print (LOG_ERROR,
-                               _("Cannot rename file ‘%s’ to ‘%s’: %s"),
-                               filename_cur_utf8, filename_new_utf8,
-                               error->message);
-
-                    et_application_window_status_bar_message (ET_APPLICATION_WINDOW (MainWindow),
-                                                              _("File(s) not renamed"),
-                                                              TRUE);
-                    g_error_free (error);
-                }
-
-                // if an error occurs when 'SF_HideMsgbox_Rename_File is TRUE', we don't stop saving...
-                if (!rc && !SF_HideMsgbox_Rename_File)
-                {
-                    stop_loop = -1;
-
-                    g_free (basename_cur_utf8);
-                    g_free (basename_new_utf8);
-
-                    return stop_loop;
-                }
-
-                /* Mark after renaming files. */
-                ETFile->FileNameCur = ETFile->FileNameNew;
-                ET_Mark_File_Name_As_Saved (ETFile);
+                /* The file is renamed, and marked as saved, by
+                 * Rename_Planned_Files(). */
+                et_rename_plan_add (rename_plan, cur_filename, new_filename,
+                                    ETFile);
                 break;
             }
             case GTK_RESPONSE_NO:
@@ -706,6 +675,100 @@ Save_File (ET_File *ETFile, gboolean multiple_files,
     return 1;
 }
 
+/* The first file which could not be renamed, to show in a dialog. */
+typedef struct
+{
+    ET_File *ETFile;
+    const GError *error;
+} RenameFailure;
+
+/*
+ * Mark a file as renamed, or report why it could not be renamed.
+ */
+static void
+on_planned_rename_done (const gchar *old_path,
+                        const gchar *new_path,
+                        const GError *error,
+                        gpointer data,
+                        gpointer user_data)
+{
+    ET_File *ETFile = data;
+    RenameFailure *failure = user_data;
+
+    if (error == NULL)
+    {
+        /* Mark after renaming files. */
+        ETFile->FileNameCur = ETFile->FileNameNew;
+        ET_Mark_File_Name_As_Saved (ETFile);
+        return;
+    }
+
+    Log_Print (LOG_ERROR, _("Cannot rename file ‘%s’ to ‘%s’: %s"),
+               ((File_Name *)ETFile->FileNameCur->data)->value_utf8,
+               ((File_Name *)ETFile->FileNameNew->data)->value_utf8,
+               error->message);
+
+    if (failure->error == NULL)
+    {
+        failure->ETFile = ETFile;
+        failure->error = error;
+    }
+}
+
+/*
+ * Rename the files which were confirmed by Save_File(). All errors are logged,
+ * and the first one is shown, unless the user chose to hide the rename
+ * dialogs.
+ */
+static void
+Rename_Planned_Files (EtRenamePlan *rename_plan)
+{
+    gint64 trace_start;
+    RenameFailure failure = { NULL, NULL };
+    GtkWidget *msgdialog;
+
+    if (et_rename_plan_get_length (rename_plan) == 0)
+    {
+        return;
+    }
+
+    trace_start = et_trace_begin ();
+    et_rename_plan_execute (rename_plan);
+    et_trace_end (trace_start, "rename", "execute", NULL);
+
+    et_rename_plan_foreach_result (rename_plan, on_planned_rename_done,
+                                   &failure);
+
+    if (failure.error == NULL)
+    {
+        return;
+    }
+
+    et_application_window_status_bar_message (ET_APPLICATION_WINDOW (MainWindow),
+                                              _("File(s) not renamed"), TRUE);
+
+    /* If 'SF_HideMsgbox_Rename_File' is TRUE, then errors are displayed only
+     * in the log. */
+    if (SF_HideMsgbox_Rename_File)
+    {
+        return;
+    }
+
+    msgdialog = gtk_message_dialog_new (GTK_WINDOW (MainWindow),
+                                        GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                                        GTK_MESSAGE_ERROR,
+                                        GTK_BUTTONS_CLOSE,
+                                        _("Cannot rename file ‘%s’ to ‘%s’"),
+                                        ((File_Name *)failure.ETFile->FileNameCur->data)->value_utf8,
+                                        ((File_Name *)failure.ETFile->FileNameNew->data)->value_utf8);
+    gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (msgdialog),
+                                              "%s", failure.error->message);
+    gtk_window_set_title (GTK_WINDOW (msgdialog), _("Rename File Error"));
+
+    gtk_dialog_run (GTK_DIALOG (msgdialog));
+    gtk_widget_destroy (msgdialog);
+}
+
 /*
  * Write tag of the ETFile
  * Return TRUE => OK
@@ -816,8 +879,10 @@ Read_Directory (const gchar *path_real)
     GList *FileList = NULL;
     GList *l;
     gint   progress_bar_index = 0;
+    EtPrefetch *prefetch;
     GAction *action;
     EtApplicationWindow *window;
+    gint64 trace_start;
 
     g_return_val_if_fail (path_real != NULL, FALSE);
 
@@ -875,6 +940,19 @@ Read_Directory (const gchar *path_real)
         return FALSE;
     }
 
+    /* Watch the directories while they are read, so that the files which
+     * change in the meantime are not missed. */
+    if (g_settings_get_boolean (MainSettings, "browse-watch-changes"))
+    {
+        ETCore->ETDirMonitor = et_dir_monitor_new (g_settings_get_boolean (MainSettings,
+                                                                           "browse-subdir"),
+                                                   g_settings_get_boolean (MainSettings,
+                                                                           "browse-show-hidden"),
+                                                   on_directory_changed,
+                                                   NULL);
+        et_dir_monitor_add (ETCore->ETDirMonitor, dir);
+    }
+
     /* Open the window to quit recursion (since 27/04/2007 : not only into recursion mode) */
     et_application_window_set_busy_cursor (window);
     action = g_action_map_lookup_action (G_ACTION_MAP (MainWindow), "stop");
@@ -887,9 +965,12 @@ Read_Directory (const gchar *path_real)
     et_application_window_status_bar_message (window, msg, FALSE);
     g_free (msg);
     /* Search the supported files. */
+    trace_start = et_trace_begin ();
     FileList = read_directory_recursively (FileList, dir_enumerator,
                                            g_settings_get_boolean (MainSettings,
-                                                                   "browse-subdir"));
+                                                                   "browse-subdir"),
+                                           ETCore->ETDirMonitor);
+    et_trace_end (trace_start, "read", "enumerate", path_real);
     g_file_enumerator_close (dir_enumerator, NULL, &error);
     g_object_unref (dir_enumerator);
     g_object_unref (dir);
@@ -900,6 +981,11 @@ Read_Directory (const gchar *path_real)
     g_snprintf (progress_bar_text, 30, "%d/%u", 0, nbrfile);
     et_application_window_progress_set_text (window, progress_bar_text);
 
+    /* Read ahead the next files while each one is parsed. */
+    prefetch = et_prefetch_new (FileList,
+                                g_settings_get_uint (MainSettings,
+                                                     "load-prefetch-depth"));
+
     // Load the supported files (Extension recognized)
     for (l = FileList; l != NULL && !Main_Stop_Button_Pressed;
          l = g_list_next (l))
@@ -914,6 +1000,7 @@ Read_Directory (const gchar *path_real)
         g_free (filename_real);
         g_free (display_path);
 
+        et_prefetch_advance (prefetch, progress_bar_index);
         ETCore->ETFileList = et_file_list_add (ETCore->ETFileList, file);
 
         /* Update the progress bar. */
@@ -926,6 +1013,7 @@ Read_Directory (const gchar *path_real)
             gtk_main_iteration();
     }
 
+    et_prefetch_free (prefetch);
     g_list_free_full (FileList, g_object_unref);
     et_application_window_progress_set_text (window, "");
 
@@ -995,17 +1083,235 @@ Read_Directory (const gchar *path_real)
     et_application_window_set_normal_cursor (window);
     ReadingDirectory = FALSE;
 
+    et_trace_log_statistics (_("Reading directory"));
+
     return TRUE;
 }
 
 
 
+/*
+ * on_directory_changed:
+ * @files: (element-type GFile): the files and directories which changed
+ * @user_data: unused
+ *
+ * Apply the changes made by other programs in the loaded directories to the
+ * list of files, rather than reading the whole directory again: the files
+ * which were created or modified are read, and the files which were deleted,
+ * or which are in a directory which was deleted, are removed. Files with
+ * unsaved changes are not read again, so that the changes are kept.
+ *
+ * Returns: %TRUE if the changes were applied, %FALSE to apply them later
+ */
+static gboolean
+on_directory_changed (GList *files, gpointer user_data)
+{
+    EtApplicationWindow *window;
+    GHashTable *loaded;
+    GList *removed = NULL;
+    GList *added = NULL;
+    GPtrArray *missing_dirs;
+    GList *l;
+    ET_File *displayed;
+    gchar *displayed_path = NULL;
+    guint n_added = 0;
+    guint n_removed = 0;
+    guint n_reloaded = 0;
+    gboolean show_hidden;
+
+    /* Do not change the list of files while it is read or saved, or while a
+     * dialog runs its own main loop. */
+    if (ReadingDirectory || g_main_depth () > 1)
+    {
+        return FALSE;
+    }
+
+    window = ET_APPLICATION_WINDOW (MainWindow);
+
+    /* Keep the edits in the tag and file areas as unsaved changes. */
+    et_application_window_update_et_file_from_ui (window);
+
+    loaded = g_hash_table_new (g_str_hash, g_str_equal);
+
+    for (l = ETCore->ETFileList; l != NULL; l = g_list_next (l))
+    {
+        ET_File *ETFile = l->data;
+
+        g_hash_table_insert (loaded,
+                             ((File_Name *)ETFile->FileNameCur->data)->value,
+                             ETFile);
+    }
+
+    missing_dirs = g_ptr_array_new_with_free_func (g_free);
+    show_hidden = g_settings_get_boolean (MainSettings, "browse-show-hidden");
+
+    for (l = files; l != NULL; l = g_list_next (l))
+    {
+        GFile *file = l->data;
+        gchar *path;
+        ET_File *ETFile;
+        GFileInfo *info;
+
+        path = g_file_get_path (file);
+        ETFile = g_hash_table_lookup (loaded, path);
+        info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                                  G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","
+                                  G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                  G_FILE_QUERY_INFO_NONE, NULL, NULL);
+
+        if (ETFile && info == NULL)
+        {
+            removed = g_list_prepend (removed, ETFile);
+            n_removed++;
+        }
+        else if (ETFile
+                 && ETFile->FileModificationTime
+                    != g_file_info_get_attribute_uint64 (info,
+                                                         G_FILE_ATTRIBUTE_TIME_MODIFIED))
+        {
+            if (et_file_check_saved (ETFile))
+            {
+                removed = g_list_prepend (removed, ETFile);
+                added = g_list_prepend (added, g_object_ref (file));
+                n_reloaded++;
+            }
+            else
+            {
+                gchar *display_path = g_filename_display_name (path);
+
+                /* The modification time is left as it is, so that the user
+                 * is warned again before saving. */
+                Log_Print (LOG_WARNING,
+                           _("File ‘%s’ was changed by an external program, but was not read again, to keep the unsaved changes"),
+                           display_path);
+                g_free (display_path);
+            }
+        }
+        else if (ETFile == NULL && info != NULL)
+        {
+            gchar *basename = g_file_get_basename (file);
+
+            if (g_file_info_get_file_type (info) == G_FILE_TYPE_REGULAR
+                && et_file_is_supported (basename)
+                && (show_hidden || !g_file_info_get_is_hidden (info)))
+            {
+                added = g_list_prepend (added, g_object_ref (file));
+                n_added++;
+            }
+
+            g_free (basename);
+        }
+        else if (ETFile == NULL)
+        {
+            /* Possibly a directory which was deleted or moved away. */
+            g_ptr_array_add (missing_dirs,
+                             g_strconcat (path, G_DIR_SEPARATOR_S, NULL));
+        }
+
+        g_clear_object (&info);
+        g_free (path);
+    }
+
+    if (missing_dirs->len > 0)
+    {
+        for (l = ETCore->ETFileList; l != NULL; l = g_list_next (l))
+        {
+            ET_File *ETFile = l->data;
+            const gchar *filename = ((File_Name *)ETFile->FileNameCur->data)->value;
+            guint i;
+
+            for (i = 0; i < missing_dirs->len; i++)
+            {
+                const gchar *prefix = g_ptr_array_index (missing_dirs, i);
+
+                if (g_str_has_prefix (filename, prefix)
+                    && !g_list_find (removed, ETFile))
+                {
+                    removed = g_list_prepend (removed, ETFile);
+                    n_removed++;
+                    break;
+                }
+            }
+        }
+    }
+
+    g_ptr_array_free (missing_dirs, TRUE);
+    g_hash_table_destroy (loaded);
+
+    if (removed == NULL && added == NULL)
+    {
+        return TRUE;
+    }
+
+    /* The file shown in the tag area is shown again afterwards, or its
+     * replacement if it was read again. */
+    displayed = ETCore->ETFileDisplayed;
+
+    for (l = removed; l != NULL; l = g_list_next (l))
+    {
+        ET_File *ETFile = l->data;
+
+        if (ETFile == displayed)
+        {
+            displayed_path = g_strdup (((File_Name *)ETFile->FileNameCur->data)->value);
+            displayed = NULL;
+        }
+
+        ET_Remove_File_From_File_List (ETFile);
+    }
+
+    added = g_list_reverse (added);
+
+    for (l = added; l != NULL; l = g_list_next (l))
+    {
+        ETCore->ETFileList = et_file_list_add (ETCore->ETFileList, l->data);
+
+        if (displayed_path && displayed == NULL)
+        {
+            gchar *path = g_file_get_path (l->data);
+
+            if (strcmp (path, displayed_path) == 0)
+            {
+                displayed = g_list_last (ETCore->ETFileList)->data;
+            }
+
+            g_free (path);
+        }
+    }
+
+    if (displayed == NULL)
+    {
+        /* ET_Remove_File_From_File_List() chose another file. */
+        displayed = ETCore->ETFileDisplayed;
+    }
+
+    /* Show the file before the lists are rebuilt, as the tag area is stored
+     * into the displayed file at that point. */
+    if (displayed)
+    {
+        et_application_window_display_et_file (window, displayed);
+    }
+
+    et_application_window_browser_toggle_display_mode (window);
+    et_application_window_update_actions (window);
+
+    Log_Print (LOG_INFO,
+               _("Files changed by an external program: %u added, %u removed, %u read again"),
+               n_added, n_removed, n_reloaded);
+
+    g_list_free_full (added, g_object_unref);
+    g_list_free (removed);
+    g_free (displayed_path);
+
+    return TRUE;
+}
+
 /*
  * Recurse the path to create a list of files. Return a GList of the files found.
  */
 static GList *
 read_directory_recursively (GList *file_list, GFileEnumerator *dir_enumerator,
-                            gboolean recurse)
+                            gboolean recurse, EtDirMonitor *monitor)
 {
     GError *error = NULL;
     GFileInfo *info;
@@ -1067,9 +1373,14 @@ read_directory_recursively (GList *file_list, GFileEnumerator *dir_enumerator,
                         g_object_unref (info);
                         continue;
                     }
+                    if (monitor)
+                    {
+                        et_dir_monitor_add (monitor, child_dir);
+                    }
+
                     file_list = read_directory_recursively (file_list,
                                                             childdir_enumerator,
-                                                            recurse);
+                                                            recurse, monitor);
                     g_object_unref (child_dir);
                     g_file_enumerator_close (childdir_enumerator, NULL,
                                              &error);
@@ -44,7 +44,17 @@ ET_Core_Free (void)
 {
     g_return_if_fail (ETCore != NULL);
 
+    /* Stop watching before the files are freed. */
+    if (ETCore->ETDirMonitor)
+    {
+        et_dir_monitor_free (ETCore->ETDirMonitor);
+        ETCore->ETDirMonitor = NULL;
+    }
+
     /* First frees lists. */
+    g_list_free (ETCore->ETFileChangedList);
+    ETCore->ETFileChangedList = NULL;
+
     if (ETCore->ETFileList)
     {
         et_file_list_free (ETCore->ETFileList);
@@ -26,6 +26,7 @@ G_BEGIN_DECLS
 
 #include <gdk/gdk.h>
 
+#include "dir_monitor.h"
 #include "file.h"
 
 /*
@@ -49,6 +50,7 @@ typedef struct
     guint  ETFileDisplayedList_Length;          // Contains the length of the displayed list
     gfloat ETFileDisplayedList_TotalSize;       // Total of the size of files in displayed list (in bytes)
     gulong ETFileDisplayedList_TotalDuration;   // Total of duration of files in displayed list (in seconds)
+    gboolean ETFileDisplayedList_Renumber;      // Whether IndexKey must be renumbered, see et_displayed_file_list_get_index()
 
     // Displayed item
     ET_File *ETFileDisplayed;           // Pointer to the current ETFile displayed in EasyTAG (may be NULL)
@@ -56,6 +58,12 @@ typedef struct
 
     // History list
     GList *ETHistoryFileList;           // History list of files changes for undo/redo actions
+
+    // Files changed since the views were last refreshed (List of ET_File, see et_file_list_queue_change())
+    GList *ETFileChangedList;
+
+    // Watches the loaded directories for changes by other programs (may be NULL)
+    EtDirMonitor *ETDirMonitor;
 } ET_Core;
 
 extern ET_Core *ETCore; /* Main pointer to structure needed by EasyTAG. */
@@ -56,6 +56,7 @@
 #include "misc.h"
 #include "setting.h"
 #include "charset.h"
+#include "trace.h"
 
 #include "win32/win32dep.h"
 
@@ -963,7 +964,6 @@ ET_Free_File_List_Item (ET_File *ETFile)
             et_file_info_free (ETFile->ETFileInfo);
         }
 
-        g_free(ETFile->ETFileExtension);
         g_slice_free (ET_File, ETFile);
     }
 }
@@ -1281,6 +1281,7 @@ ET_Save_File_Tag_To_HD (ET_File *ETFile, GError **error)
     gboolean state;
     GFile *file;
     GFileInfo *fileinfo;
+    gint64 trace_start;
 
     g_return_val_if_fail (ETFile != NULL, FALSE);
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
@@ -1295,6 +1296,8 @@ ET_Save_File_Tag_To_HD (ET_File *ETFile, GError **error)
     fileinfo = g_file_query_info (file, "time::*", G_FILE_QUERY_INFO_NONE,
                                   NULL, NULL);
 
+    trace_start = et_trace_begin ();
+
     switch (description->TagType)
     {
 #ifdef ENABLE_MP3
@@ -1357,6 +1360,9 @@ ET_Save_File_Tag_To_HD (ET_File *ETFile, GError **error)
             break;
     }
 
+    et_trace_end (trace_start, "write-tag", description->Extension,
+                  cur_filename);
+
     /* Update properties for the file. */
     if (fileinfo)
     {
@@ -1423,9 +1429,13 @@ ET_Manage_Changes_Of_File_Data (ET_File *ETFile,
                                 File_Tag *FileTag)
 {
     gboolean undo_added = FALSE;
+    guint changes = 0;
+    gint64 trace_start;
 
     g_return_val_if_fail (ETFile != NULL, FALSE);
 
+    trace_start = et_trace_begin ();
+
     /*
      * Detect changes of filename and generate the filename undo list
      */
@@ -1437,6 +1447,7 @@ ET_Manage_Changes_Of_File_Data (ET_File *ETFile,
         {
             ET_Add_File_Name_To_List(ETFile,FileName);
             undo_added |= TRUE;
+            changes |= ET_FILE_CHANGED_NAME;
         }else
         {
             et_file_name_free (FileName);
@@ -1452,6 +1463,16 @@ ET_Manage_Changes_Of_File_Data (ET_File *ETFile,
             && et_file_tag_detect_difference ((File_Tag *)(ETFile->FileTag)->data,
                                               FileTag) == TRUE)
         {
+            const File_Tag *old_tag = (File_Tag *)ETFile->FileTag->data;
+
+            changes |= ET_FILE_CHANGED_TAG;
+
+            if (g_strcmp0 (old_tag->artist, FileTag->artist) != 0
+                || g_strcmp0 (old_tag->album, FileTag->album) != 0)
+            {
+                changes |= ET_FILE_CHANGED_GROUP;
+            }
+
             ET_Add_File_Tag_To_List(ETFile,FileTag);
             undo_added |= TRUE;
         }
@@ -1468,8 +1489,12 @@ ET_Manage_Changes_Of_File_Data (ET_File *ETFile,
     {
         ETCore->ETHistoryFileList = et_history_list_add (ETCore->ETHistoryFileList,
                                                          ETFile);
+        et_file_list_queue_change (ETFile, changes);
     }
 
+    et_trace_end (trace_start, "undo", "manage-changes",
+                  ((File_Name *)ETFile->FileNameCur->data)->value);
+
     //return TRUE;
     return undo_added;
 }
@@ -1534,6 +1559,33 @@ ET_Add_File_Tag_To_List (ET_File *ETFile, File_Tag *FileTag)
     return TRUE;
 }
 
+/*
+ * Queue the change of an undo or a redo. The artist and album are not
+ * compared, as the tag which was left is not at hand any more.
+ */
+static void
+et_file_queue_undo_change (ET_File *ETFile,
+                           gboolean filename_changed,
+                           gboolean filetag_changed)
+{
+    guint changes = 0;
+
+    if (filename_changed)
+    {
+        changes |= ET_FILE_CHANGED_NAME;
+    }
+
+    if (filetag_changed)
+    {
+        changes |= ET_FILE_CHANGED_TAG | ET_FILE_CHANGED_GROUP;
+    }
+
+    if (changes != 0)
+    {
+        et_file_list_queue_change (ETFile, changes);
+    }
+}
+
 /*
  * Applies one undo to the ETFile data (to reload the previous data).
  * Returns TRUE if an undo had been applied.
@@ -1574,6 +1626,9 @@ gboolean ET_Undo_File_Data (ET_File *ETFile)
         has_filetag_undo_data  = TRUE;
     }
 
+    et_file_queue_undo_change (ETFile, has_filename_undo_data,
+                               has_filetag_undo_data);
+
     return has_filename_undo_data | has_filetag_undo_data;
 }
 
@@ -1635,6 +1690,9 @@ gboolean ET_Redo_File_Data (ET_File *ETFile)
         has_filetag_redo_data  = TRUE;
     }
 
+    et_file_queue_undo_change (ETFile, has_filename_redo_data,
+                               has_filetag_redo_data);
+
     return has_filename_redo_data | has_filetag_redo_data;
 }
 
@@ -1719,6 +1777,8 @@ ET_Mark_File_Tag_As_Saved (ET_File *ETFile)
     FileTagList = ETFile->FileTagList;
     g_list_foreach(FileTagList,(GFunc)Set_Saved_Value_Of_File_Tag,FALSE); // All other FileTag set to FALSE
     FileTag->saved = TRUE; // The current FileTag set to TRUE
+
+    et_file_list_queue_change (ETFile, ET_FILE_CHANGED_SAVED);
 }
 
 
@@ -1731,6 +1791,8 @@ void ET_Mark_File_Name_As_Saved (ET_File *ETFile)
     FileNameList = ETFile->FileNameList;
     g_list_foreach(FileNameList,(GFunc)Set_Saved_Value_Of_File_Tag,FALSE);
     FileNameNew->saved = TRUE;
+
+    et_file_list_queue_change (ETFile, ET_FILE_CHANGED_SAVED);
 }
 
 /*
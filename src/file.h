@@ -29,6 +29,25 @@ G_BEGIN_DECLS
 #include "file_name.h"
 #include "file_tag.h"
 
+/*
+ * EtFileChanges:
+ * @ET_FILE_CHANGED_NAME: the new filename changed
+ * @ET_FILE_CHANGED_TAG: the tag changed
+ * @ET_FILE_CHANGED_GROUP: the artist or the album changed, so that the file
+ *                         may belong to other rows of the artist and album
+ *                         lists
+ * @ET_FILE_CHANGED_SAVED: the filename or the tag was saved
+ *
+ * The changes to a file since the views were last refreshed.
+ */
+typedef enum
+{
+    ET_FILE_CHANGED_NAME = 1 << 0,
+    ET_FILE_CHANGED_TAG = 1 << 1,
+    ET_FILE_CHANGED_GROUP = 1 << 2,
+    ET_FILE_CHANGED_SAVED = 1 << 3
+} EtFileChanges;
+
 /*
  * Description of each item of the ETFileList list
  */
@@ -41,7 +60,7 @@ typedef struct
     guint64 FileModificationTime; /* Save modification time of the file */
 
     const ET_File_Description *ETFileDescription;
-    gchar               *ETFileExtension;   /* Real extension of the file (keeping the case) (should be placed in ETFileDescription?) */
+    const gchar         *ETFileExtension;   /* Real extension of the file (keeping the case), interned as there are few distinct ones (should be placed in ETFileDescription?) */
     ET_File_Info        *ETFileInfo;        /* Header infos: bitrate, duration, ... */
 
     GList *FileNameCur;       /* Points to item of FileNameList that represents the current value of filename state (i.e. file on hard disk) */
@@ -52,6 +71,8 @@ typedef struct
     GList *FileTag;           /* Points to the current item used of FileTagList */
     GList *FileTagList;       /* Contains the history of changes about file tag data */
     GList *FileTagListBak;    /* Contains items of FileTagList removed by 'undo' procedure but have data currently saved */
+
+    guint Changes;            /* EtFileChanges since the views were last refreshed (not 0 if the file is in ETCore->ETFileChangedList) */
 } ET_File;
 
 /*
@@ -24,6 +24,7 @@
 
 #include "charset.h"
 #include "et_core.h"
+#include "file_list.h"
 #include "log.h"
 #include "setting.h"
 #include "tag_area.h"
@@ -317,7 +318,8 @@ et_file_area_set_file_fields (EtFileArea *self,
     g_free (basename_utf8);
 
     /* Show position of current file in list */
-    text = g_strdup_printf ("%u/%u:", ETFile->IndexKey,
+    text = g_strdup_printf ("%u/%u:",
+                            et_displayed_file_list_get_index (ETFile),
                             ETCore->ETFileDisplayedList_Length);
     gtk_label_set_text (GTK_LABEL (priv->index_label), text);
     g_object_unref (file);
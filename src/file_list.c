@@ -37,6 +37,8 @@
 #include "monkeyaudio_header.h"
 #include "musepack_header.h"
 #include "picture.h"
+#include "read_session.h"
+#include "trace.h"
 #include "ape_tag.h"
 #ifdef ENABLE_MP3
 #include "id3_tag.h"
@@ -147,7 +149,7 @@ ET_File_Key_New (void)
 
 /*
  * et_core_read_file_info:
- * @file: a file from which to read information
+ * @session: the read session of the file from which to read information
  * @ETFileInfo: (out caller-allocates): a file information structure
  * @error: a #GError to provide information on erros, or %NULL to ignore
  *
@@ -157,89 +159,46 @@ ET_File_Key_New (void)
  * Returns: %TRUE on success, %FALSE otherwise
  */
 static gboolean
-et_core_read_file_info (GFile *file,
+et_core_read_file_info (EtReadSession *session,
                         ET_File_Info *ETFileInfo,
                         GError **error)
 {
-    GFileInfo *info;
-
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-    g_return_val_if_fail (file != NULL && ETFileInfo != NULL, FALSE);
-
-    info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE,
-                              G_FILE_QUERY_INFO_NONE, NULL, error);
-
-    if (!info)
-    {
-        g_assert (error == NULL || *error != NULL);
-        return FALSE;
-    }
+    g_return_val_if_fail (session != NULL && ETFileInfo != NULL, FALSE);
 
     ETFileInfo->version    = 0;
     ETFileInfo->bitrate    = 0;
     ETFileInfo->samplerate = 0;
     ETFileInfo->mode       = 0;
-    ETFileInfo->size = g_file_info_get_size (info);
+    ETFileInfo->size = et_read_session_get_size (session);
     ETFileInfo->duration   = 0;
 
-    g_assert (error == NULL || *error == NULL);
-    g_object_unref (info);
-
     return TRUE;
 }
 
 /*
- * et_file_list_add:
- * Add a file to the "main" list. And get all information of the file.
- * The filename passed in should be in raw format, only convert it to UTF8 when
- * displaying it.
+ * et_core_read_file_tag:
+ * @session: the read session of the file
+ * @description: the description of the file type
+ * @FileTag: (out caller-allocates): a tag structure to fill
+ * @display_path: the path of the file, for error messages
+ *
+ * Read the tag of the file with the tag reader for its type, logging any
+ * error.
  */
-GList *
-et_file_list_add (GList *file_list,
-                  GFile *file)
+static void
+et_core_read_file_tag (EtReadSession *session,
+                       const ET_File_Description *description,
+                       File_Tag *FileTag,
+                       const gchar *display_path)
 {
-    GList *result;
-    const ET_File_Description *description;
-    ET_File      *ETFile;
-    File_Name    *FileName;
-    File_Tag     *FileTag;
-    ET_File_Info *ETFileInfo;
-    gchar        *ETFileExtension;
-    guint         ETFileKey;
-    guint         undo_key;
-    GFileInfo *fileinfo;
-    gchar *filename;
-    gchar *display_path;
     GError *error = NULL;
-    gboolean success;
-
-    g_return_val_if_fail (file != NULL, file_list);
-
-    /* Primary Key for this file */
-    ETFileKey = ET_File_Key_New();
-
-    /* Get description of the file */
-    filename = g_file_get_path (file);
-    display_path = g_filename_display_name (filename);
-    description = ET_Get_File_Description (filename);
-
-    /* Get real extension of the file (keeping the case) */
-    ETFileExtension = g_strdup(ET_Get_File_Extension(filename));
-
-    /* Fill the File_Name structure for FileNameList */
-    FileName = et_file_name_new ();
-    FileName->saved      = TRUE;    /* The file hasn't been changed, so it's saved */
-    ET_Set_Filename_File_Name_Item (FileName, display_path, filename);
-
-    /* Fill the File_Tag structure for FileTagList */
-    FileTag = et_file_tag_new ();
-    FileTag->saved = TRUE;    /* The file hasn't been changed, so it's saved */
 
     switch (description->TagType)
     {
 #ifdef ENABLE_MP3
         case ID3_TAG:
-            if (!id3tag_read_file_tag (file, FileTag, &error))
+            if (!id3tag_read_file_tag (session, FileTag, &error))
             {
                 Log_Print (LOG_ERROR,
                            _("Error reading ID3 tag from file ‘%s’: %s"),
@@ -250,7 +209,7 @@ et_file_list_add (GList *file_list,
 #endif
 #ifdef ENABLE_OGG
         case OGG_TAG:
-            if (!ogg_tag_read_file_tag (file, FileTag, &error))
+            if (!ogg_tag_read_file_tag (session, FileTag, &error))
             {
                 Log_Print (LOG_ERROR,
                            _("Error reading tag from Ogg file ‘%s’: %s"),
@@ -261,7 +220,7 @@ et_file_list_add (GList *file_list,
 #endif
 #ifdef ENABLE_FLAC
         case FLAC_TAG:
-            if (!flac_tag_read_file_tag (file, FileTag, &error))
+            if (!flac_tag_read_file_tag (session, FileTag, &error))
             {
                 Log_Print (LOG_ERROR,
                            _("Error reading tag from FLAC file ‘%s’: %s"),
@@ -271,7 +230,7 @@ et_file_list_add (GList *file_list,
             break;
 #endif
         case APE_TAG:
-            if (!ape_tag_read_file_tag (file, FileTag, &error))
+            if (!ape_tag_read_file_tag (session, FileTag, &error))
             {
                 Log_Print (LOG_ERROR,
                            _("Error reading APE tag from file ‘%s’: %s"),
@@ -281,7 +240,7 @@ et_file_list_add (GList *file_list,
             break;
 #ifdef ENABLE_MP4
         case MP4_TAG:
-            if (!mp4tag_read_file_tag (file, FileTag, &error))
+            if (!mp4tag_read_file_tag (session, FileTag, &error))
             {
                 Log_Print (LOG_ERROR,
                            _("Error reading tag from MP4 file ‘%s’: %s"),
@@ -292,7 +251,7 @@ et_file_list_add (GList *file_list,
 #endif
 #ifdef ENABLE_WAVPACK
         case WAVPACK_TAG:
-            if (!wavpack_tag_read_file_tag (file, FileTag, &error))
+            if (!wavpack_tag_read_file_tag (session, FileTag, &error))
             {
                 Log_Print (LOG_ERROR,
                            _("Error reading tag from WavPack file ‘%s’: %s"),
@@ -303,7 +262,7 @@ et_file_list_add (GList *file_list,
 #endif
 #ifdef ENABLE_OPUS
         case OPUS_TAG:
-            if (!et_opus_tag_read_file_tag (file, FileTag, &error))
+            if (!et_opus_tag_read_file_tag (session, FileTag, &error))
             {
                 Log_Print (LOG_ERROR,
                            _("Error reading tag from Opus file ‘%s’: %s"),
@@ -338,61 +297,71 @@ et_file_list_add (GList *file_list,
                        (gint)description->TagType, display_path);
             break;
     }
+}
 
-    if (FileTag->year && g_utf8_strlen (FileTag->year, -1) > 4)
-    {
-        Log_Print (LOG_WARNING,
-                   _("The year value ‘%s’ seems to be invalid in file ‘%s’. The information will be lost when saving"),
-                   FileTag->year, display_path);
-    }
-
-    /* Fill the ET_File_Info structure */
-    ETFileInfo = et_file_info_new ();
+/*
+ * et_core_read_file_header:
+ * @session: the read session of the file
+ * @description: the description of the file type
+ * @ETFileInfo: (out caller-allocates): a file information structure to fill
+ * @display_path: the path of the file, for error messages
+ *
+ * Read the header information of the file with the header reader for its
+ * type, logging any error.
+ */
+static void
+et_core_read_file_header (EtReadSession *session,
+                          const ET_File_Description *description,
+                          ET_File_Info *ETFileInfo,
+                          const gchar *display_path)
+{
+    GError *error = NULL;
+    gboolean success;
 
     switch (description->FileType)
     {
 #if defined ENABLE_MP3 && defined ENABLE_ID3LIB
         case MP3_FILE:
         case MP2_FILE:
-            success = et_mpeg_header_read_file_info (file, ETFileInfo, &error);
+            success = et_mpeg_header_read_file_info (session, ETFileInfo, &error);
             break;
 #endif
 #ifdef ENABLE_OGG
         case OGG_FILE:
-            success = et_ogg_header_read_file_info (file, ETFileInfo, &error);
+            success = et_ogg_header_read_file_info (session, ETFileInfo, &error);
             break;
 #endif
 #ifdef ENABLE_SPEEX
         case SPEEX_FILE:
-            success = et_speex_header_read_file_info (file, ETFileInfo,
+            success = et_speex_header_read_file_info (session, ETFileInfo,
                                                       &error);
             break;
 #endif
 #ifdef ENABLE_FLAC
         case FLAC_FILE:
-            success = et_flac_header_read_file_info (file, ETFileInfo, &error);
+            success = et_flac_header_read_file_info (session, ETFileInfo, &error);
             break;
 #endif
         case MPC_FILE:
-            success = et_mpc_header_read_file_info (file, ETFileInfo, &error);
+            success = et_mpc_header_read_file_info (session, ETFileInfo, &error);
             break;
         case MAC_FILE:
-            success = et_mac_header_read_file_info (file, ETFileInfo, &error);
+            success = et_mac_header_read_file_info (session, ETFileInfo, &error);
             break;
 #ifdef ENABLE_WAVPACK
         case WAVPACK_FILE:
-            success = et_wavpack_header_read_file_info (file, ETFileInfo,
+            success = et_wavpack_header_read_file_info (session, ETFileInfo,
                                                         &error);
             break;
 #endif
 #ifdef ENABLE_MP4
         case MP4_FILE:
-            success = et_mp4_header_read_file_info (file, ETFileInfo, &error);
+            success = et_mp4_header_read_file_info (session, ETFileInfo, &error);
             break;
 #endif
 #ifdef ENABLE_OPUS
         case OPUS_FILE:
-            success = et_opus_read_file_info (file, ETFileInfo, &error);
+            success = et_opus_read_file_info (session, ETFileInfo, &error);
             break;
 #endif
         case OFR_FILE:
@@ -425,7 +394,7 @@ et_file_list_add (GList *file_list,
                        "ETFileInfo: Undefined file type (%d) for file %s",
                        (gint)description->FileType, display_path);
             /* To get at least the file size. */
-            success = et_core_read_file_info (file, ETFileInfo, &error);
+            success = et_core_read_file_info (session, ETFileInfo, &error);
             break;
     }
 
@@ -436,20 +405,102 @@ et_file_list_add (GList *file_list,
                    display_path, error->message);
         g_error_free (error);
     }
+}
 
-    /* Store the modification time of the file to check if the file was changed
-     * before saving */
-    fileinfo = g_file_query_info (file, G_FILE_ATTRIBUTE_TIME_MODIFIED,
-                                  G_FILE_QUERY_INFO_NONE, NULL, NULL);
+/*
+ * et_file_list_add:
+ * Add a file to the "main" list. And get all information of the file.
+ * The filename passed in should be in raw format, only convert it to UTF8 when
+ * displaying it.
+ */
+GList *
+et_file_list_add (GList *file_list,
+                  GFile *file)
+{
+    GList *result;
+    const ET_File_Description *description;
+    ET_File      *ETFile;
+    File_Name    *FileName;
+    File_Tag     *FileTag;
+    ET_File_Info *ETFileInfo;
+    const gchar  *ETFileExtension;
+    guint         ETFileKey;
+    guint         undo_key;
+    EtReadSession *session;
+    gchar *filename;
+    gchar *display_path;
+    gint64 add_start;
+    gint64 trace_start;
+    GError *error = NULL;
+
+    g_return_val_if_fail (file != NULL, file_list);
+
+    add_start = et_trace_begin ();
+
+    /* Primary Key for this file */
+    ETFileKey = ET_File_Key_New();
+
+    /* Get description of the file */
+    filename = g_file_get_path (file);
+    display_path = g_filename_display_name (filename);
+    description = ET_Get_File_Description (filename);
+
+    /* Get real extension of the file (keeping the case) */
+    ETFileExtension = g_intern_string (ET_Get_File_Extension (filename));
+
+    /* Fill the File_Name structure for FileNameList */
+    FileName = et_file_name_new ();
+    FileName->saved      = TRUE;    /* The file hasn't been changed, so it's saved */
+    ET_Set_Filename_File_Name_Item (FileName, display_path, filename);
+
+    /* Fill the File_Tag structure for FileTagList */
+    FileTag = et_file_tag_new ();
+    FileTag->saved = TRUE;    /* The file hasn't been changed, so it's saved */
+
+    /* Fill the ET_File_Info structure */
+    ETFileInfo = et_file_info_new ();
+
+    /* Open the file once for both the tag and the header readers. */
+    trace_start = et_trace_begin ();
+    session = et_read_session_new (file, &error);
+    et_trace_end (trace_start, "read", "open", filename);
+
+    if (session)
+    {
+        trace_start = et_trace_begin ();
+        et_core_read_file_tag (session, description, FileTag, display_path);
+        et_trace_end (trace_start, "read-tag", description->Extension,
+                      filename);
+
+        trace_start = et_trace_begin ();
+        et_core_read_file_header (session, description, ETFileInfo,
+                                  display_path);
+        et_trace_end (trace_start, "read-header", description->Extension,
+                      filename);
+    }
+    else
+    {
+        Log_Print (LOG_ERROR, _("Error while opening file ‘%s’: %s"),
+                   display_path, error->message);
+        g_clear_error (&error);
+    }
+
+    if (FileTag->year && g_utf8_strlen (FileTag->year, -1) > 4)
+    {
+        Log_Print (LOG_WARNING,
+                   _("The year value ‘%s’ seems to be invalid in file ‘%s’. The information will be lost when saving"),
+                   FileTag->year, display_path);
+    }
 
     /* Attach all data defined above to this ETFile item */
     ETFile = ET_File_Item_New();
 
-    if (fileinfo)
+    /* Store the modification time of the file to check if the file was changed
+     * before saving */
+    if (session)
     {
-        ETFile->FileModificationTime = g_file_info_get_attribute_uint64 (fileinfo,
-                                                                         G_FILE_ATTRIBUTE_TIME_MODIFIED);
-        g_object_unref (fileinfo);
+        ETFile->FileModificationTime = et_read_session_get_modification_time (session);
+        et_read_session_free (session);
     }
     else
     {
@@ -481,9 +532,18 @@ et_file_list_add (GList *file_list,
     FileName->key = undo_key;
     ET_Save_File_Name_Internal(ETFile,FileName);
 
-    FileTag = et_file_tag_new ();
-    FileTag->key = undo_key;
-    ET_Save_File_Tag_Internal(ETFile,FileTag);
+    /* Most tags are read already corrected, so only make a corrected copy
+     * of the few which are not. */
+    if (et_file_tag_needs_corrections ((File_Tag *)ETFile->FileTag->data))
+    {
+        FileTag = et_file_tag_new ();
+        FileTag->key = undo_key;
+        ET_Save_File_Tag_Internal(ETFile,FileTag);
+    }
+    else
+    {
+        FileTag = NULL;
+    }
 
     /*
      * Generate undo for the file and the main undo list.
@@ -507,6 +567,8 @@ et_file_list_add (GList *file_list,
 
     //ET_Debug_Print_File_List(ETCore->ETFileList,__FILE__,__LINE__,__FUNCTION__);
 
+    et_trace_end (add_start, "read", "add-file", filename);
+
     g_free (filename);
     g_free (display_path);
 
@@ -774,18 +836,6 @@ ET_Remove_File_From_Artist_Album_List (ET_File *ETFile)
     return FALSE; /* ETFile is NUL, or not found in the list. */
 }
 
-/*
- * Returns the length of the list of displayed files
- */
-static guint
-et_displayed_file_list_length (GList *displayed_list)
-{
-    GList *list;
-
-    list = g_list_first (displayed_list);
-    return g_list_length (list);
-}
-
 /*
  * Renumber the list of displayed files (IndexKey) from 1 to n
  */
@@ -801,6 +851,31 @@ et_displayed_file_list_renumber (GList *displayed_list)
     }
 }
 
+/*
+ * et_displayed_file_list_get_index:
+ * @ETFile: a file of the displayed list
+ *
+ * Get the position of @ETFile in the displayed list, renumbering the list
+ * first if it changed since it was last numbered. The numbering is done here
+ * rather than each time the list changes, as most changes are followed by
+ * others before the position is needed.
+ *
+ * Returns: the position of @ETFile, from 1
+ */
+guint
+et_displayed_file_list_get_index (const ET_File *ETFile)
+{
+    g_return_val_if_fail (ETFile != NULL, 0);
+
+    if (ETCore->ETFileDisplayedList_Renumber)
+    {
+        et_displayed_file_list_renumber (ETCore->ETFileDisplayedList);
+        ETCore->ETFileDisplayedList_Renumber = FALSE;
+    }
+
+    return ETFile->IndexKey;
+}
+
 /*
  * Delete the corresponding file and free the allocated data. Return TRUE if deleted.
  */
@@ -810,14 +885,20 @@ ET_Remove_File_From_File_List (ET_File *ETFile)
     GList *ETFileList = NULL;          // Item containing the ETFile to delete... (in ETCore->ETFileList)
     GList *ETFileDisplayedList = NULL; // Item containing the ETFile to delete... (in ETCore->ETFileDisplayedList)
 
-    // Remove infos of the file
-    ETCore->ETFileDisplayedList_TotalSize     -= ((ET_File_Info *)ETFile->ETFileInfo)->size;
-    ETCore->ETFileDisplayedList_TotalDuration -= ((ET_File_Info *)ETFile->ETFileInfo)->duration;
-
     // Find the ETFileList containing the ETFile item
     ETFileDisplayedList = g_list_find(g_list_first(ETCore->ETFileDisplayedList),ETFile);
     ETFileList = g_list_find (ETCore->ETFileList, ETFile);
 
+    /* Remove infos of the file from the totals of the displayed list, if it
+     * is in it. */
+    if (ETFileDisplayedList)
+    {
+        ETCore->ETFileDisplayedList_Length--;
+        ETCore->ETFileDisplayedList_TotalSize     -= ((ET_File_Info *)ETFile->ETFileInfo)->size;
+        ETCore->ETFileDisplayedList_TotalDuration -= ((ET_File_Info *)ETFile->ETFileInfo)->duration;
+        ETCore->ETFileDisplayedList_Renumber = TRUE;
+    }
+
     // Note : this ETFileList must be used only for ETCore->ETFileDisplayedList, and not ETCore->ETFileDisplayed
     if (ETCore->ETFileDisplayedList == ETFileDisplayedList)
     {
@@ -847,14 +928,41 @@ ET_Remove_File_From_File_List (ET_File *ETFile)
     ETCore->ETFileDisplayedList = g_list_remove (g_list_first (ETCore->ETFileDisplayedList),
                                                  ETFile);
 
-    // Free data of the file
-    ET_Free_File_List_Item(ETFile);
+    /* Remove the undo history of the file, which points to it. The first item
+     * of the history list is always empty. */
+    if (ETCore->ETHistoryFileList)
+    {
+        GList *history = g_list_first (ETCore->ETHistoryFileList);
+        GList *l = history->next;
+
+        while (l != NULL)
+        {
+            GList *next = l->next;
+
+            if (((ET_History_File *)l->data)->ETFile == ETFile)
+            {
+                if (ETCore->ETHistoryFileList == l)
+                {
+                    ETCore->ETHistoryFileList = l->prev;
+                }
+
+                et_history_file_free (l->data);
+                history = g_list_delete_link (history, l);
+            }
+
+            l = next;
+        }
+    }
 
-    /* Recalculate length of ETFileDisplayedList list. */
-    ETCore->ETFileDisplayedList_Length = et_displayed_file_list_length (ETCore->ETFileDisplayedList);
+    /* Remove the file from the changes which were not refreshed yet. */
+    if (ETFile->Changes != 0)
+    {
+        ETCore->ETFileChangedList = g_list_remove (ETCore->ETFileChangedList,
+                                                   ETFile);
+    }
 
-    /* To number the ETFile in the list. */
-    et_displayed_file_list_renumber (ETCore->ETFileDisplayedList);
+    // Free data of the file
+    ET_Free_File_List_Item(ETFile);
 
     // Displaying...
     if (ETCore->ETFileDisplayedList)
@@ -930,169 +1038,356 @@ set_sort_order_for_column_id (gint column_id, GtkTreeViewColumn *column,
 }
 
 /*
- * Sort an 'ETFileList'
+ * Returns the function comparing two ET_File for the given sort mode
  */
-GList *
-ET_Sort_File_List (GList *ETFileList,
-                   EtSortMode Sorting_Type)
+static GCompareFunc
+et_sort_mode_get_compare_func (EtSortMode Sorting_Type)
 {
-    EtApplicationWindow *window;
-    GtkTreeViewColumn *column;
-    GList *etfilelist;
-    gint column_id = Sorting_Type / 2;
-
-    window = ET_APPLICATION_WINDOW (MainWindow);
-    column = et_application_window_browser_get_column_for_column_id (window,
-                                                                     column_id);
-
-    /* Important to rewind before. */
-    etfilelist = g_list_first (ETFileList);
-
-    set_sort_order_for_column_id (column_id, column, Sorting_Type);
-
-    /* Sort... */
     switch (Sorting_Type)
     {
         case ET_SORT_MODE_ASCENDING_FILENAME:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Filename);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Filename;
         case ET_SORT_MODE_DESCENDING_FILENAME:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Filename);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Filename;
         case ET_SORT_MODE_ASCENDING_TITLE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Title);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Title;
         case ET_SORT_MODE_DESCENDING_TITLE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Title);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Title;
         case ET_SORT_MODE_ASCENDING_ARTIST:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Artist);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Artist;
         case ET_SORT_MODE_DESCENDING_ARTIST:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Artist);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Artist;
         case ET_SORT_MODE_ASCENDING_ALBUM_ARTIST:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Album_Artist);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Album_Artist;
         case ET_SORT_MODE_DESCENDING_ALBUM_ARTIST:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Album_Artist);
-            break;
-		case ET_SORT_MODE_ASCENDING_ALBUM:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Album);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Album_Artist;
+        case ET_SORT_MODE_ASCENDING_ALBUM:
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Album;
         case ET_SORT_MODE_DESCENDING_ALBUM:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Album);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Album;
         case ET_SORT_MODE_ASCENDING_YEAR:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Year);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Year;
         case ET_SORT_MODE_DESCENDING_YEAR:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Year);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Year;
         case ET_SORT_MODE_ASCENDING_DISC_NUMBER:
-            etfilelist = g_list_sort (etfilelist,
-                                      (GCompareFunc)et_comp_func_sort_file_by_ascending_disc_number);
-            break;
+            return (GCompareFunc)et_comp_func_sort_file_by_ascending_disc_number;
         case ET_SORT_MODE_DESCENDING_DISC_NUMBER:
-            etfilelist = g_list_sort (etfilelist,
-                                      (GCompareFunc)et_comp_func_sort_file_by_descending_disc_number);
-            break;
+            return (GCompareFunc)et_comp_func_sort_file_by_descending_disc_number;
         case ET_SORT_MODE_ASCENDING_TRACK_NUMBER:
-            etfilelist = g_list_sort (etfilelist,
-                                      (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Track_Number);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Track_Number;
         case ET_SORT_MODE_DESCENDING_TRACK_NUMBER:
-            etfilelist = g_list_sort (etfilelist,
-                                      (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Track_Number);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Track_Number;
         case ET_SORT_MODE_ASCENDING_GENRE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Genre);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Genre;
         case ET_SORT_MODE_DESCENDING_GENRE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Genre);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Genre;
         case ET_SORT_MODE_ASCENDING_COMMENT:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Comment);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Comment;
         case ET_SORT_MODE_DESCENDING_COMMENT:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Comment);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Comment;
         case ET_SORT_MODE_ASCENDING_COMPOSER:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Composer);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Composer;
         case ET_SORT_MODE_DESCENDING_COMPOSER:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Composer);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Composer;
         case ET_SORT_MODE_ASCENDING_ORIG_ARTIST:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Orig_Artist);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Orig_Artist;
         case ET_SORT_MODE_DESCENDING_ORIG_ARTIST:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Orig_Artist);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Orig_Artist;
         case ET_SORT_MODE_ASCENDING_COPYRIGHT:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Copyright);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Copyright;
         case ET_SORT_MODE_DESCENDING_COPYRIGHT:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Copyright);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Copyright;
         case ET_SORT_MODE_ASCENDING_URL:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Url);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Url;
         case ET_SORT_MODE_DESCENDING_URL:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Url);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Url;
         case ET_SORT_MODE_ASCENDING_ENCODED_BY:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Encoded_By);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Encoded_By;
         case ET_SORT_MODE_DESCENDING_ENCODED_BY:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Encoded_By);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Encoded_By;
         case ET_SORT_MODE_ASCENDING_CREATION_DATE:
-            etfilelist = g_list_sort (etfilelist,
-                                      (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Creation_Date);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Creation_Date;
         case ET_SORT_MODE_DESCENDING_CREATION_DATE:
-            etfilelist = g_list_sort (etfilelist,
-                                      (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Creation_Date);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Creation_Date;
         case ET_SORT_MODE_ASCENDING_FILE_TYPE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_File_Type);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_File_Type;
         case ET_SORT_MODE_DESCENDING_FILE_TYPE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_File_Type);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_File_Type;
         case ET_SORT_MODE_ASCENDING_FILE_SIZE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_File_Size);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_File_Size;
         case ET_SORT_MODE_DESCENDING_FILE_SIZE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_File_Size);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_File_Size;
         case ET_SORT_MODE_ASCENDING_FILE_DURATION:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_File_Duration);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_File_Duration;
         case ET_SORT_MODE_DESCENDING_FILE_DURATION:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_File_Duration);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_File_Duration;
         case ET_SORT_MODE_ASCENDING_FILE_BITRATE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_File_Bitrate);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_File_Bitrate;
         case ET_SORT_MODE_DESCENDING_FILE_BITRATE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_File_Bitrate);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_File_Bitrate;
         case ET_SORT_MODE_ASCENDING_FILE_SAMPLERATE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_File_Samplerate);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_File_Samplerate;
         case ET_SORT_MODE_DESCENDING_FILE_SAMPLERATE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_File_Samplerate);
-            break;
+            return (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_File_Samplerate;
         default:
             g_assert_not_reached ();
-            break;
+            return NULL;
+    }
+}
+
+/*
+ * et_file_list_is_sorted:
+ * @file_list: the first item of a list of ET_File
+ * @compare: the function to compare the items with
+ *
+ * Check whether @file_list is already in the order that g_list_sort() would
+ * give it, which is the case when a subset of a sorted list is displayed.
+ *
+ * Returns: %TRUE if no item compares greater than the one after it
+ */
+static gboolean
+et_file_list_is_sorted (GList *file_list,
+                        GCompareFunc compare)
+{
+    GList *l;
+
+    for (l = file_list; l != NULL && l->next != NULL; l = g_list_next (l))
+    {
+        if (compare (l->data, l->next->data) > 0)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/*
+ * EtSortKey:
+ * @link: the list item of the file
+ * @key: the numeric value to sort by
+ * @collate_key: the collate key of the current filename, to sort files with
+ *               the same value
+ *
+ * One entry of the flat array which numeric sorts run over, so that each
+ * comparison does not follow the list, file, tag and string pointers again.
+ */
+typedef struct
+{
+    GList *link;
+    gint64 key;
+    const gchar *collate_key;
+} EtSortKey;
+
+typedef struct
+{
+    gboolean descending;
+    gboolean case_sensitive;
+} EtSortKeyOrder;
+
+/*
+ * Returns the value of a numeric tag field, as the comparison functions in
+ * file.c read it.
+ */
+static gint64
+get_tag_number (const gchar *value)
+{
+    return value ? atoi (value) : 0;
+}
+
+/*
+ * et_sort_mode_get_key:
+ * @Sorting_Type: the sort mode
+ * @ETFile: the file to get the key of
+ * @key: (out): the numeric value to sort @ETFile by
+ * @descending: (out): whether the sort mode is a descending one
+ *
+ * Get the value to sort by, for the sort modes which compare numbers. Files
+ * without a tag or header information sort first, as with the comparison
+ * functions.
+ *
+ * Returns: %TRUE if @Sorting_Type compares numbers, %FALSE otherwise
+ */
+static gboolean
+et_sort_mode_get_key (EtSortMode Sorting_Type,
+                      const ET_File *ETFile,
+                      gint64 *key,
+                      gboolean *descending)
+{
+    const File_Tag *FileTag = ETFile->FileTag->data;
+    const ET_File_Info *info = ETFile->ETFileInfo;
+
+    /* The descending modes follow their ascending mode. */
+    *descending = Sorting_Type % 2 != 0;
+
+    switch (Sorting_Type - (*descending ? 1 : 0))
+    {
+        case ET_SORT_MODE_ASCENDING_YEAR:
+            *key = FileTag ? get_tag_number (FileTag->year) : 0;
+            return TRUE;
+        case ET_SORT_MODE_ASCENDING_DISC_NUMBER:
+            *key = FileTag ? get_tag_number (FileTag->disc_number) : 0;
+            return TRUE;
+        case ET_SORT_MODE_ASCENDING_TRACK_NUMBER:
+            *key = FileTag ? get_tag_number (FileTag->track) : 0;
+            return TRUE;
+        case ET_SORT_MODE_ASCENDING_FILE_TYPE:
+            *key = ETFile->ETFileDescription
+                   ? ETFile->ETFileDescription->FileType : G_MININT64;
+            return TRUE;
+        case ET_SORT_MODE_ASCENDING_FILE_SIZE:
+            *key = info ? info->size : G_MININT64;
+            return TRUE;
+        case ET_SORT_MODE_ASCENDING_FILE_DURATION:
+            *key = info ? info->duration : G_MININT64;
+            return TRUE;
+        case ET_SORT_MODE_ASCENDING_FILE_BITRATE:
+            *key = info ? info->bitrate : G_MININT64;
+            return TRUE;
+        case ET_SORT_MODE_ASCENDING_FILE_SAMPLERATE:
+            *key = info ? info->samplerate : G_MININT64;
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+static gint
+compare_sort_keys (gconstpointer a,
+                   gconstpointer b,
+                   gpointer user_data)
+{
+    const EtSortKeyOrder *order = user_data;
+    const EtSortKey *key1 = order->descending ? b : a;
+    const EtSortKey *key2 = order->descending ? a : b;
+
+    if (key1->key != key2->key)
+    {
+        return key1->key < key2->key ? -1 : 1;
     }
+
+    /* The same second criterion as the comparison functions. */
+    return order->case_sensitive ? strcmp (key1->collate_key,
+                                           key2->collate_key)
+                                 : strcasecmp (key1->collate_key,
+                                               key2->collate_key);
+}
+
+/*
+ * et_file_list_sort_by_key:
+ * @file_list: the first item of a list of ET_File
+ * @Sorting_Type: a sort mode which compares numbers
+ *
+ * Sort @file_list in the same order as g_list_sort() with the comparison
+ * function of @Sorting_Type, but over a flat array of the keys, which are
+ * read from each file only once. The settings are also read only once,
+ * rather than for each comparison.
+ *
+ * Returns: the first item of the sorted list
+ */
+static GList *
+et_file_list_sort_by_key (GList *file_list,
+                          EtSortMode Sorting_Type)
+{
+    EtSortKey *keys;
+    EtSortKeyOrder order;
+    GList *l;
+    guint n_files;
+    guint i;
+    gboolean sorted = TRUE;
+
+    n_files = g_list_length (file_list);
+
+    if (n_files < 2)
+    {
+        return file_list;
+    }
+
+    keys = g_new (EtSortKey, n_files);
+    order.case_sensitive = g_settings_get_boolean (MainSettings,
+                                                   "sort-case-sensitive");
+
+    for (l = file_list, i = 0; l != NULL; l = g_list_next (l), i++)
+    {
+        const ET_File *ETFile = l->data;
+
+        keys[i].link = l;
+        keys[i].collate_key = ((File_Name *)ETFile->FileNameCur->data)->value_ck;
+        et_sort_mode_get_key (Sorting_Type, ETFile, &keys[i].key,
+                              &order.descending);
+    }
+
+    for (i = 1; i < n_files && sorted; i++)
+    {
+        sorted = compare_sort_keys (&keys[i - 1], &keys[i], &order) <= 0;
+    }
+
+    if (!sorted)
+    {
+        /* Stable, as is g_list_sort(). */
+        g_qsort_with_data (keys, n_files, sizeof (EtSortKey),
+                           compare_sort_keys, &order);
+
+        /* Relink the items in the new order. */
+        for (i = 0; i < n_files; i++)
+        {
+            keys[i].link->prev = i > 0 ? keys[i - 1].link : NULL;
+            keys[i].link->next = i + 1 < n_files ? keys[i + 1].link : NULL;
+        }
+
+        file_list = keys[0].link;
+    }
+
+    g_free (keys);
+
+    return file_list;
+}
+
+/*
+ * Sort an 'ETFileList'
+ */
+GList *
+ET_Sort_File_List (GList *ETFileList,
+                   EtSortMode Sorting_Type)
+{
+    EtApplicationWindow *window;
+    GtkTreeViewColumn *column;
+    GList *etfilelist;
+    GCompareFunc compare;
+    gint64 key;
+    gboolean descending;
+    gint column_id = Sorting_Type / 2;
+
+    window = ET_APPLICATION_WINDOW (MainWindow);
+    column = et_application_window_browser_get_column_for_column_id (window,
+                                                                     column_id);
+
+    /* Important to rewind before. */
+    etfilelist = g_list_first (ETFileList);
+
+    set_sort_order_for_column_id (column_id, column, Sorting_Type);
+
+    if (etfilelist
+        && et_sort_mode_get_key (Sorting_Type, etfilelist->data, &key,
+                                 &descending))
+    {
+        etfilelist = et_file_list_sort_by_key (etfilelist, Sorting_Type);
+    }
+    else
+    {
+        /* Sort, unless the list is already in order, as g_list_sort() is
+         * stable and would not change it anyway. */
+        compare = et_sort_mode_get_compare_func (Sorting_Type);
+
+        if (!et_file_list_is_sorted (etfilelist, compare))
+        {
+            etfilelist = g_list_sort (etfilelist, compare);
+        }
+    }
+
     /* Save sorting mode (note: needed when called from UI). */
     g_settings_set_enum (MainSettings, "sort-mode", Sorting_Type);
 
-    //ETFileList = g_list_first(etfilelist);
     return etfilelist;
 }
 
@@ -1173,28 +1468,34 @@ et_displayed_file_list_set (GList *ETFileList)
 
     ETCore->ETFileDisplayedList = g_list_first(ETFileList);
 
-    ETCore->ETFileDisplayedList_Length = et_displayed_file_list_length (ETCore->ETFileDisplayedList);
+    ETCore->ETFileDisplayedList_Length = 0;
     ETCore->ETFileDisplayedList_TotalSize     = 0;
     ETCore->ETFileDisplayedList_TotalDuration = 0;
 
-    // Get size and duration of files in the list
+    /* Get length, size and duration of files in the list, in a single pass.
+     * Later removals update them, rather than counting again. */
     for (l = ETCore->ETFileDisplayedList; l != NULL; l = g_list_next (l))
     {
-        ETCore->ETFileDisplayedList_TotalSize += ((ET_File_Info *)((ET_File *)l->data)->ETFileInfo)->size;
-        ETCore->ETFileDisplayedList_TotalDuration += ((ET_File_Info *)((ET_File *)l->data)->ETFileInfo)->duration;
+        const ET_File_Info *info = ((ET_File *)l->data)->ETFileInfo;
+
+        ETCore->ETFileDisplayedList_Length++;
+        ETCore->ETFileDisplayedList_TotalSize += info->size;
+        ETCore->ETFileDisplayedList_TotalDuration += info->duration;
     }
 
-    /* Sort the file list. */
-    ET_Sort_File_List (ETCore->ETFileDisplayedList,
-                       g_settings_get_enum (MainSettings,
-                                            "sort-mode"));
+    /* Sort the file list. The files of an album are taken from the sorted
+     * main list, so they are usually in order already, and are then only
+     * checked. */
+    ETCore->ETFileDisplayedList = ET_Sort_File_List (ETCore->ETFileDisplayedList,
+                                                     g_settings_get_enum (MainSettings,
+                                                                          "sort-mode"));
 
     /* Synchronize, so that the core file list pointer always points to the
      * head of the list. */
     ETCore->ETFileList = g_list_first (ETCore->ETFileList);
 
-    /* Should renums ETCore->ETFileDisplayedList only! */
-    et_displayed_file_list_renumber (ETCore->ETFileDisplayedList);
+    /* Number the files of ETCore->ETFileDisplayedList only, when needed. */
+    ETCore->ETFileDisplayedList_Renumber = TRUE;
 }
 
 /*
@@ -1335,6 +1636,67 @@ et_history_list_has_redo (GList *history_list)
     return history_list && history_list->next;
 }
 
+/*
+ * et_file_list_queue_change:
+ * @ETFile: a file which changed
+ * @changes: the changes to @ETFile
+ *
+ * Record that @ETFile changed, so that only the files which changed are
+ * refreshed in the views, by et_file_list_take_changes(). A file which
+ * changes several times is queued once.
+ */
+void
+et_file_list_queue_change (ET_File *ETFile,
+                           EtFileChanges changes)
+{
+    g_return_if_fail (ETFile != NULL);
+
+    if (ETFile->Changes == 0)
+    {
+        ETCore->ETFileChangedList = g_list_prepend (ETCore->ETFileChangedList,
+                                                    ETFile);
+    }
+
+    ETFile->Changes |= changes;
+}
+
+/*
+ * et_file_list_take_changes:
+ * @changes: (out) (allow-none): return location for all the changes to the
+ *           files
+ *
+ * Take the files which changed since this was last called, and clear their
+ * changes.
+ *
+ * Returns: (element-type ET_File) (transfer container): the files which
+ * changed, in the order in which they first changed, free with g_list_free()
+ */
+GList *
+et_file_list_take_changes (EtFileChanges *changes)
+{
+    GList *files;
+    GList *l;
+    guint all = 0;
+
+    files = g_list_reverse (ETCore->ETFileChangedList);
+    ETCore->ETFileChangedList = NULL;
+
+    for (l = files; l != NULL; l = g_list_next (l))
+    {
+        ET_File *ETFile = l->data;
+
+        all |= ETFile->Changes;
+        ETFile->Changes = 0;
+    }
+
+    if (changes)
+    {
+        *changes = all;
+    }
+
+    return files;
+}
+
 /*
  * Add a ETFile item to the main undo list of files
  */
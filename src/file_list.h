@@ -44,8 +44,12 @@ GList * ET_Displayed_File_List_Last (void);
 GList * ET_Displayed_File_List_By_Etfile (const ET_File *ETFile);
 
 void et_displayed_file_list_set (GList *ETFileList);
+guint et_displayed_file_list_get_index (const ET_File *ETFile);
 void et_displayed_file_list_free (GList *file_list);
 
+void et_file_list_queue_change (ET_File *ETFile, EtFileChanges changes);
+GList * et_file_list_take_changes (EtFileChanges *changes);
+
 GList * et_history_list_add (GList *history_list, ET_File *ETFile);
 gboolean ET_Add_File_To_History_List (ET_File *ETFile);
 ET_File * ET_Undo_History_File_Data (void);
@@ -49,12 +49,48 @@ et_file_name_free (File_Name *file_name)
 {
     g_return_if_fail (file_name != NULL);
 
+    /* Also frees value_utf8 and value_ck. */
     g_free (file_name->value);
-    g_free (file_name->value_utf8);
-    g_free (file_name->value_ck);
     g_slice_free (File_Name, file_name);
 }
 
+/*
+ * Store the filename, its UTF-8 version and its collate key in a single
+ * allocation, as they are always set and freed together, so that the three
+ * strings of each file of a large directory are one block on the heap.
+ */
+static void
+et_file_name_set_values (File_Name *file_name,
+                         const gchar *value,
+                         const gchar *value_utf8)
+{
+    gchar *collate_key;
+    gsize value_size;
+    gsize utf8_size;
+    gsize ck_size;
+    gchar *block;
+
+    g_return_if_fail (value != NULL && value_utf8 != NULL);
+
+    collate_key = g_utf8_collate_key_for_filename (value_utf8, -1);
+
+    value_size = strlen (value) + 1;
+    utf8_size = strlen (value_utf8) + 1;
+    ck_size = strlen (collate_key) + 1;
+
+    block = g_malloc (value_size + utf8_size + ck_size);
+    memcpy (block, value, value_size);
+    memcpy (block + value_size, value_utf8, utf8_size);
+    memcpy (block + value_size + utf8_size, collate_key, ck_size);
+
+    g_free (file_name->value);
+    file_name->value = block;
+    file_name->value_utf8 = block + value_size;
+    file_name->value_ck = block + value_size + utf8_size;
+
+    g_free (collate_key);
+}
+
 /*
  * Fill content of a FileName item according to the filename passed in argument (UTF-8 filename or not)
  * Calculate also the collate key.
@@ -69,21 +105,21 @@ ET_Set_Filename_File_Name_Item (File_Name *FileName,
 
     if (filename_utf8 && filename)
     {
-        FileName->value_utf8 = g_strdup (filename_utf8);
-        FileName->value = g_strdup (filename);
-        FileName->value_ck = g_utf8_collate_key_for_filename (FileName->value_utf8, -1);
+        et_file_name_set_values (FileName, filename, filename_utf8);
     }
     else if (filename_utf8)
     {
-        FileName->value_utf8 = g_strdup (filename_utf8);
-        FileName->value = filename_from_display (filename_utf8);
-        FileName->value_ck = g_utf8_collate_key_for_filename (FileName->value_utf8, -1);
+        gchar *value = filename_from_display (filename_utf8);
+
+        et_file_name_set_values (FileName, value, filename_utf8);
+        g_free (value);
     }
     else if (filename)
     {
-        FileName->value_utf8 = g_filename_display_name (filename);
-        FileName->value = g_strdup (filename);
-        FileName->value_ck = g_utf8_collate_key_for_filename (FileName->value_utf8, -1);
+        gchar *value_utf8 = g_filename_display_name (filename);
+
+        et_file_name_set_values (FileName, filename, value_utf8);
+        g_free (value_utf8);
     }
 }
 
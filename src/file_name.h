@@ -31,8 +31,8 @@ typedef struct
     guint key;
     gboolean saved; /* Set to TRUE if this filename had been saved */
     gchar *value; /* The filename containing the full path and the extension of the file */
-    gchar *value_utf8; /* Same than "value", but converted to UTF-8 to avoid multiple call to the convertion function */
-    gchar *value_ck; /* Collate key of "value_utf8" to speed up comparison. */
+    gchar *value_utf8; /* Same than "value", but converted to UTF-8 to avoid multiple call to the convertion function. Stored in the same allocation as "value". */
+    gchar *value_ck; /* Collate key of "value_utf8" to speed up comparison. Stored in the same allocation as "value". */
 } File_Name;
 
 File_Name * et_file_name_new (void);
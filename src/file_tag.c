@@ -18,7 +18,11 @@
 
 #include "file_tag.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "misc.h"
+#include "setting.h"
 
 /*
  * Create a new File_Tag structure.
@@ -465,3 +469,94 @@ et_file_tag_detect_difference (const File_Tag *FileTag1,
 
     return FALSE; /* No changes */
 }
+
+/*
+ * Check that a text field is unchanged by ET_Save_File_Tag_Internal(), which
+ * strips whitespace and replaces empty strings with NULL.
+ */
+static gboolean
+text_is_normalized (const gchar *value)
+{
+    gsize length;
+
+    if (value == NULL)
+    {
+        return TRUE;
+    }
+
+    length = strlen (value);
+
+    return length > 0 && !g_ascii_isspace (value[0])
+           && !g_ascii_isspace (value[length - 1]);
+}
+
+/*
+ * Check that a number field is already formatted with the padding from the
+ * settings, as et_track_number_to_string() would do, without allocating.
+ */
+static gboolean
+number_is_normalized (const gchar *value,
+                      const gchar *padded_key,
+                      const gchar *length_key)
+{
+    gchar buffer[32];
+    guint number;
+
+    if (value == NULL)
+    {
+        return TRUE;
+    }
+
+    number = atoi (value);
+
+    if (g_settings_get_boolean (MainSettings, padded_key))
+    {
+        g_snprintf (buffer, sizeof (buffer), "%.*u",
+                    (gint)g_settings_get_uint (MainSettings, length_key),
+                    number);
+    }
+    else
+    {
+        g_snprintf (buffer, sizeof (buffer), "%u", number);
+    }
+
+    return strcmp (value, buffer) == 0;
+}
+
+/*
+ * et_file_tag_needs_corrections:
+ * @file_tag: a tag, as filled by a tag reader
+ *
+ * Check whether the automatic corrections of ET_Save_File_Tag_Internal()
+ * would change @file_tag, so that a corrected copy only has to be made (and
+ * compared with et_file_tag_detect_difference()) for the few tags which need
+ * one.
+ *
+ * Returns: %TRUE if the tag needs corrections, %FALSE otherwise
+ */
+gboolean
+et_file_tag_needs_corrections (const File_Tag *file_tag)
+{
+    g_return_val_if_fail (file_tag != NULL, FALSE);
+
+    return !(text_is_normalized (file_tag->title)
+             && text_is_normalized (file_tag->artist)
+             && text_is_normalized (file_tag->album_artist)
+             && text_is_normalized (file_tag->album)
+             && text_is_normalized (file_tag->disc_number)
+             && text_is_normalized (file_tag->year)
+             && text_is_normalized (file_tag->genre)
+             && text_is_normalized (file_tag->comment)
+             && text_is_normalized (file_tag->composer)
+             && text_is_normalized (file_tag->orig_artist)
+             && text_is_normalized (file_tag->copyright)
+             && text_is_normalized (file_tag->url)
+             && text_is_normalized (file_tag->encoded_by)
+             && number_is_normalized (file_tag->disc_total,
+                                      "tag-disc-padded", "tag-disc-length")
+             && number_is_normalized (file_tag->track, "tag-number-padded",
+                                      "tag-number-length")
+             && number_is_normalized (file_tag->track_total,
+                                      "tag-number-padded",
+                                      "tag-number-length"));
+}
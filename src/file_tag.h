@@ -100,6 +100,7 @@ void et_file_tag_copy_into (File_Tag *destination, const File_Tag *source);
 void et_file_tag_copy_other_into (File_Tag *destination, const File_Tag *source);
 
 gboolean et_file_tag_detect_difference (const File_Tag *FileTag1, const File_Tag  *FileTag2);
+gboolean et_file_tag_needs_corrections (const File_Tag *file_tag);
 
 G_END_DECLS
 
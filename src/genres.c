@@ -0,0 +1,127 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "genres.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The numbers of the genres in id3_genres, sorted by name, ignoring case, for
+ * a binary search. It must be updated together with id3_genres, which the
+ * genres test checks.
+ */
+static const guint8 id3_genres_sorted[] =
+{
+    123, 148, 34, 74, 73, 99, 40, 20, 26, 145, 149, 184, 183, 90, 116, 150,
+    41, 135, 85, 151, 96, 152, 138, 89, 0, 107, 153, 132, 65, 88, 104, 102,
+    154, 97, 136, 61, 141, 1, 32, 112, 128, 57, 140, 2, 139, 58, 3, 125, 50,
+    22, 4, 155, 55, 127, 122, 156, 189, 120, 98, 157, 158, 159, 160, 52, 161,
+    48, 124, 25, 54, 162, 84, 80, 81, 115, 119, 5, 30, 188, 36, 59, 163, 190,
+    164, 126, 38, 49, 91, 6, 79, 129, 137, 7, 35, 100, 165, 166, 131, 187, 19,
+    167, 33, 46, 47, 168, 8, 29, 146, 63, 169, 86, 170, 71, 171, 172, 45, 142,
+    9, 77, 82, 64, 133, 182, 185, 10, 173, 66, 39, 174, 11, 103, 12, 186, 75,
+    134, 13, 53, 62, 109, 175, 176, 117, 23, 108, 92, 191, 67, 93, 177, 43,
+    121, 14, 15, 68, 16, 76, 87, 118, 17, 78, 143, 114, 110, 178, 69, 21, 111,
+    95, 105, 42, 37, 24, 56, 44, 179, 101, 83, 94, 106, 147, 113, 18, 51, 130,
+    144, 60, 70, 31, 72, 27, 180, 28, 181
+};
+
+G_STATIC_ASSERT (G_N_ELEMENTS (id3_genres_sorted) == G_N_ELEMENTS (id3_genres));
+
+static int
+compare_genre_name (const void *name,
+                    const void *number)
+{
+    return g_ascii_strcasecmp (name, id3_genres[*(const guint8 *)number]);
+}
+
+/*
+ * et_genre_lookup:
+ * @name: the name of a genre
+ *
+ * Find the number of the ID3v1 genre called @name, ignoring case.
+ *
+ * Returns: the number of the genre, or -1 if @name is not an ID3v1 genre
+ */
+gint
+et_genre_lookup (const gchar *name)
+{
+    const guint8 *number;
+
+    g_return_val_if_fail (name != NULL, -1);
+
+    number = bsearch (name, id3_genres_sorted,
+                      G_N_ELEMENTS (id3_genres_sorted),
+                      sizeof (*id3_genres_sorted), compare_genre_name);
+
+    return number ? *number : -1;
+}
+
+/*
+ * et_genre_parse_reference:
+ * @genre: a genre, as written in an ID3v2 tag
+ *
+ * Resolve the references to ID3v1 genres by number in @genre:
+ *    - "(<genre_id>)"              -> "(3)"         -> "Dance"
+ *    - "<genre_id>"                -> "3"           -> "Dance"
+ *    - "(<genre_id>)<refinement>"  -> "(3)EuroDance" -> "EuroDance"
+ *    - "<genre_name>"              -> "Dance"       -> "Dance"
+ *
+ * Returns: the name of the genre, which points into @genre or is static, or
+ * %NULL if @genre refers to an unknown genre number
+ */
+const gchar *
+et_genre_parse_reference (const gchar *genre)
+{
+    const gchar *end;
+    gchar *tmp;
+    gulong number;
+
+    g_return_val_if_fail (genre != NULL, NULL);
+
+    if (genre[0] == '(' && g_ascii_isdigit (genre[1])
+        && (end = strchr (genre + 1, ')')))
+    {
+        if (end[1] != '\0')
+        {
+            /* Keep the refinement only. */
+            return end + 1;
+        }
+
+        number = strtol (genre + 1, &tmp, 10);
+
+        if (*tmp != ')')
+        {
+            return genre;
+        }
+    }
+    else
+    {
+        number = strtol (genre, &tmp, 10);
+
+        if (tmp == genre)
+        {
+            return genre;
+        }
+    }
+
+    return number < G_N_ELEMENTS (id3_genres) ? id3_genres[number] : NULL;
+}
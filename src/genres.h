@@ -20,6 +20,10 @@
 #ifndef ET_GENRES_H_
 #define ET_GENRES_H_
 
+#include <glib.h>
+
+G_BEGIN_DECLS
+
 /* GENRE_MAX is the last genre number that can be used */
 #define GENRE_MAX ( sizeof(id3_genres)/sizeof(id3_genres[0]) - 1 )
 
@@ -231,4 +235,9 @@ static const char *id3_genres[] =
     "Psybient"
 };
 
+gint et_genre_lookup (const gchar *name);
+const gchar * et_genre_parse_reference (const gchar *genre);
+
+G_END_DECLS
+
 #endif /* ET_GENRES_H_ */
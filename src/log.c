@@ -24,8 +24,6 @@
 #include <sys/stat.h>
 
 #include "log.h"
-#include "application_window.h"
-#include "easytag.h"
 #include "setting.h"
 #include "charset.h"
 
@@ -53,6 +51,43 @@ enum
 /* File for log. */
 static const gchar LOG_FILE[] = "easytag.log";
 
+/* Maximum number of rows kept in the log list, the oldest rows being removed
+ * first. The log file is not truncated. */
+#define LOG_MAX_ROWS 5000
+/* Delay, in milliseconds, before queued messages are shown and written. */
+#define LOG_FLUSH_DELAY 200
+
+/*
+ * EtLogMessage:
+ * @next: the message which was queued before this one
+ * @kind: the kind of message
+ * @time: the time at which the message was logged
+ * @text: the message
+ *
+ * A message waiting in the queue to be shown and written to the log file.
+ */
+typedef struct _EtLogMessage EtLogMessage;
+
+struct _EtLogMessage
+{
+    EtLogMessage *next;
+    EtLogAreaKind kind;
+    gchar *time;
+    gchar *text;
+};
+
+/* The queued messages, newest first. Messages are pushed from any thread with
+ * a compare-and-swap, and the whole list is taken at once by the main thread,
+ * so that Log_Print() never blocks. */
+static gpointer log_queue = NULL;
+/* Whether a flush of the queue is scheduled. */
+static gint log_flush_pending = 0;
+/* The log area which shows the messages, if it exists. */
+static EtLogArea *log_area = NULL;
+/* The log file, kept open for the lifetime of the application. */
+static GOutputStream *log_ostream = NULL;
+static gboolean log_file_failed = FALSE;
+
 /**************
  * Prototypes *
  **************/
@@ -156,6 +191,10 @@ et_log_area_init (EtLogArea *self)
                       self);
     g_signal_connect (priv->log_view, "button-press-event",
                       G_CALLBACK (on_button_press_event), self);
+
+    /* There is a single log area, which shows the messages of Log_Print(). */
+    log_area = self;
+    g_object_add_weak_pointer (G_OBJECT (self), (gpointer *)&log_area);
 }
 
 
@@ -263,128 +302,272 @@ get_icon_name_from_error_kind (EtLogAreaKind error_kind)
 }
 
 /*
- * Function to use anywhere in the application to send a message to the LogList
+ * log_open_file:
+ *
+ * Open the log file, creating the cache directory if needed. On startup, the
+ * log is cleared. The log is then appended to for the remainder of the
+ * application lifetime, through the same stream, so that each flush reaches
+ * the file on disk.
+ *
+ * Returns: the stream, or %NULL if the file could not be opened
  */
-void
-Log_Print (EtLogAreaKind error_type, const gchar * const format, ...)
+static GOutputStream *
+log_open_file (void)
 {
-    EtLogArea *self;
-    EtLogAreaPrivate *priv;
-    va_list args;
-    gchar *string;
-    gchar *time;
-    GtkTreeIter iter;
-    static gboolean first_time = TRUE;
-    static gchar *file_path = NULL;
+    gchar *cache_path;
+    gchar *file_path;
     GFile *file;
     GFileOutputStream *file_ostream;
     GError *error = NULL;
 
-    self = ET_LOG_AREA (et_application_window_get_log_area (ET_APPLICATION_WINDOW (MainWindow)));
+    if (log_ostream || log_file_failed)
+    {
+        return log_ostream;
+    }
 
-    g_return_if_fail (self != NULL);
+    /* Only try once, rather than for every flush. */
+    log_file_failed = TRUE;
 
-    priv = et_log_area_get_instance_private (self);
+    cache_path = g_build_filename (g_get_user_cache_dir (), PACKAGE_TARNAME,
+                                   NULL);
 
-    va_start (args, format);
-    string = g_strdup_vprintf (format, args);
-    va_end (args);
+    if (!g_file_test (cache_path, G_FILE_TEST_IS_DIR))
+    {
+        gint result = g_mkdir_with_parents (cache_path, S_IRWXU);
 
-    time = Log_Format_Date ();
+        if (result == -1)
+        {
+            g_printerr ("%s", "Unable to create cache directory");
+            g_free (cache_path);
 
-    gtk_list_store_insert_with_values (priv->log_model, &iter, G_MAXINT,
-                                       LOG_ICON_NAME,
-                                       get_icon_name_from_error_kind (error_type),
-                                       LOG_TIME_TEXT, time, LOG_TEXT,
-                                       string, -1);
-    Log_List_Set_Row_Visible (self, &iter);
-    g_free (time);
+            return NULL;
+        }
+    }
 
-    // Store also the messages in the log file.
-    if (!file_path)
-    {
-        gchar *cache_path = g_build_filename (g_get_user_cache_dir (),
-                                              PACKAGE_TARNAME, NULL);
+    file_path = g_build_filename (cache_path, LOG_FILE, NULL);
+    g_free (cache_path);
 
-        if (!g_file_test (cache_path, G_FILE_TEST_IS_DIR))
-        {
-            gint result = g_mkdir_with_parents (cache_path, S_IRWXU);
+    file = g_file_new_for_path (file_path);
 
-            if (result == -1)
-            {
-                g_printerr ("%s", "Unable to create cache directory");
-                g_free (cache_path);
-                g_free (string);
+    /* Clear the log. The stream of g_file_replace() writes to a temporary
+     * file, which only replaces the log when it is closed, so it is not kept
+     * open. */
+    file_ostream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE,
+                                   NULL, &error);
 
-                return;
-            }
+    if (file_ostream)
+    {
+        if (g_output_stream_close (G_OUTPUT_STREAM (file_ostream), NULL,
+                                   &error))
+        {
+            g_object_unref (file_ostream);
+            file_ostream = g_file_append_to (file, G_FILE_CREATE_NONE, NULL,
+                                             &error);
+        }
+        else
+        {
+            g_clear_object (&file_ostream);
         }
+    }
+
+    g_object_unref (file);
 
-        file_path = g_build_filename (cache_path, LOG_FILE, NULL);
-        g_free (cache_path);
+    if (!file_ostream)
+    {
+        g_warning ("Error opening output stream of file '%s' ('%s')",
+                   file_path, error->message);
+        g_error_free (error);
+        g_free (file_path);
+
+        return NULL;
     }
 
-    file = g_file_new_for_path (file_path);
+    g_free (file_path);
+    log_file_failed = FALSE;
+    log_ostream = G_OUTPUT_STREAM (file_ostream);
+
+    return log_ostream;
+}
 
-    /* On startup, the log is cleared. The log is then appended to for the
-     * remainder of the application lifetime. */
-    if (first_time)
+/*
+ * log_flush:
+ *
+ * Take all the queued messages, append them to the log list in one batch and
+ * write them to the log file with a single write. Must be called from the main
+ * thread.
+ */
+static void
+log_flush (void)
+{
+    EtLogMessage *head;
+    EtLogMessage *messages = NULL;
+    EtLogMessage *message;
+    GOutputStream *ostream;
+    GString *data;
+    GtkTreeIter iter;
+
+    /* Cleared first, so that a message queued from now on schedules another
+     * flush. */
+    g_atomic_int_set (&log_flush_pending, 0);
+
+    do
     {
-        file_ostream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE,
-                                       NULL, &error);
+        head = g_atomic_pointer_get (&log_queue);
+    } while (!g_atomic_pointer_compare_and_exchange (&log_queue, head, NULL));
+
+    /* Put the messages back in the order in which they were logged. */
+    while (head)
+    {
+        message = head;
+        head = head->next;
+        message->next = messages;
+        messages = message;
     }
-    else
+
+    if (!messages)
     {
-        file_ostream = g_file_append_to (file, G_FILE_CREATE_NONE, NULL,
-                                         &error);
+        return;
     }
 
-    if (file_ostream)
+    data = g_string_new (NULL);
+
+    for (message = messages; message != NULL; message = message->next)
     {
-        GString *data;
-        gsize bytes_written;
+        if (log_area)
+        {
+            EtLogAreaPrivate *priv;
+
+            priv = et_log_area_get_instance_private (log_area);
+            gtk_list_store_insert_with_values (priv->log_model, &iter,
+                                               G_MAXINT, LOG_ICON_NAME,
+                                               get_icon_name_from_error_kind (message->kind),
+                                               LOG_TIME_TEXT, message->time,
+                                               LOG_TEXT, message->text, -1);
+        }
+
+        g_string_append (data, message->time);
+        g_string_append_c (data, ' ');
+        g_string_append (data, message->text);
+        g_string_append_c (data, '\n');
+    }
 
-        time = Log_Format_Date ();
-        data = g_string_new (time);
-        g_free (time);
+    if (log_area)
+    {
+        EtLogAreaPrivate *priv;
+        GtkTreeModel *model;
+        gint n_rows;
 
-        data = g_string_append_c (data, ' ');
-        data = g_string_append (data, string);
-        g_free (string);
+        priv = et_log_area_get_instance_private (log_area);
+        model = GTK_TREE_MODEL (priv->log_model);
 
-        data = g_string_append_c (data, '\n');
+        /* Bound the memory used by the list. */
+        n_rows = gtk_tree_model_iter_n_children (model, NULL);
 
-        if (!g_output_stream_write_all (G_OUTPUT_STREAM (file_ostream),
-                                        data->str, data->len, &bytes_written,
-                                        NULL, &error))
+        while (n_rows-- > LOG_MAX_ROWS)
+        {
+            GtkTreeIter first;
+
+            if (!gtk_tree_model_get_iter_first (model, &first))
+            {
+                break;
+            }
+
+            gtk_list_store_remove (priv->log_model, &first);
+        }
+
+        /* Only scroll once, to the last message. */
+        Log_List_Set_Row_Visible (log_area, &iter);
+    }
+
+    ostream = log_open_file ();
+
+    if (ostream)
+    {
+        gsize bytes_written;
+        GError *error = NULL;
+
+        if (!g_output_stream_write_all (ostream, data->str, data->len,
+                                        &bytes_written, NULL, &error))
         {
             g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %" G_GSIZE_FORMAT
                      "bytes of data were written", bytes_written, data->len);
 
             /* To avoid recursion of Log_Print. */
-            g_warning ("Error writing to the log file '%s' ('%s')", file_path,
+            g_warning ("Error writing to the log file ('%s')",
                        error->message);
 
             g_error_free (error);
-
-            g_string_free (data, TRUE);
-            g_object_unref (file_ostream);
-            g_object_unref (file);
-
-            return;
         }
+    }
 
-        first_time = FALSE;
+    g_string_free (data, TRUE);
 
-        g_string_free (data, TRUE);
+    while (messages)
+    {
+        message = messages;
+        messages = messages->next;
+        g_free (message->time);
+        g_free (message->text);
+        g_slice_free (EtLogMessage, message);
     }
-    else
+}
+
+static gboolean
+on_log_flush_timeout (gpointer user_data)
+{
+    log_flush ();
+
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * et_log_shutdown:
+ *
+ * Show and write the messages which are still queued, and close the log file.
+ * Called when the application is shutdown.
+ */
+void
+et_log_shutdown (void)
+{
+    log_flush ();
+
+    if (log_ostream)
     {
-        g_warning ("Error opening output stream of file '%s' ('%s')",
-                   file_path, error->message);
-        g_error_free (error);
+        g_output_stream_close (log_ostream, NULL, NULL);
+        g_clear_object (&log_ostream);
     }
+}
 
-    g_object_unref (file_ostream);
-    g_object_unref (file);
+/*
+ * Function to use anywhere in the application to send a message to the
+ * LogList. It can be called from any thread: the message is queued, and shown
+ * and written to the log file shortly afterwards, together with the other
+ * messages logged in the meantime.
+ */
+void
+Log_Print (EtLogAreaKind error_type, const gchar * const format, ...)
+{
+    EtLogMessage *message;
+    gpointer head;
+    va_list args;
+
+    message = g_slice_new (EtLogMessage);
+    message->kind = error_type;
+    message->time = Log_Format_Date ();
+
+    va_start (args, format);
+    message->text = g_strdup_vprintf (format, args);
+    va_end (args);
+
+    do
+    {
+        head = g_atomic_pointer_get (&log_queue);
+        message->next = head;
+    } while (!g_atomic_pointer_compare_and_exchange (&log_queue, head,
+                                                     message));
+
+    if (g_atomic_int_compare_and_exchange (&log_flush_pending, 0, 1))
+    {
+        g_timeout_add (LOG_FLUSH_DELAY, on_log_flush_timeout, NULL);
+    }
 }
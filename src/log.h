@@ -62,6 +62,7 @@ typedef enum
 GType et_log_area_get_type (void);
 GtkWidget * et_log_area_new (void);
 void et_log_area_clear (EtLogArea *self);
+void et_log_shutdown (void);
 void Log_Print (EtLogAreaKind error_type,
                 const gchar * const format, ...) G_GNUC_PRINTF (2, 3);
 
@@ -0,0 +1,1319 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "payload_index.h"
+
+#include <errno.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define READ_BUFFER_SIZE 65536
+#define ID3V1_SIZE 128
+#define APE_FOOTER_SIZE 32
+
+/* The first line of an index file, which changes with the format of the
+ * file or with the way that the digests are calculated. */
+#define INDEX_HEADER "EasyTAG payload index 2\n"
+
+/*
+ * The payload of a file is the part which does not change when the tags are
+ * edited, so that two copies of a recording with different tags have the same
+ * digest. Only the containers are parsed, never the audio itself.
+ */
+typedef struct
+{
+    GInputStream *stream;
+    goffset size;
+    GChecksum *checksum;
+    guchar *buffer;
+    guint8 *digest;
+    /* Whether @digest was taken from the file rather than @checksum. */
+    gboolean digest_set;
+} PayloadReader;
+
+static guint32
+read_be24 (const guchar *data)
+{
+    return ((guint32)data[0] << 16) | (data[1] << 8) | data[2];
+}
+
+static guint32
+read_be32 (const guchar *data)
+{
+    return ((guint32)data[0] << 24) | ((guint32)data[1] << 16)
+           | ((guint32)data[2] << 8) | data[3];
+}
+
+static guint64
+read_be64 (const guchar *data)
+{
+    return ((guint64)read_be32 (data) << 32) | read_be32 (data + 4);
+}
+
+static guint32
+read_le32 (const guchar *data)
+{
+    return data[0] | (data[1] << 8) | ((guint32)data[2] << 16)
+           | ((guint32)data[3] << 24);
+}
+
+static guint64
+read_le64 (const guchar *data)
+{
+    return read_le32 (data) | ((guint64)read_le32 (data + 4) << 32);
+}
+
+static void
+set_truncated_error (GError **error)
+{
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                         _("The file is truncated"));
+}
+
+static void
+set_no_audio_error (GError **error)
+{
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                         _("No audio data was found"));
+}
+
+/*
+ * Read exactly @count bytes at @offset into the buffer of @reader.
+ */
+static gboolean
+read_at (PayloadReader *reader,
+         goffset offset,
+         gsize count,
+         GError **error)
+{
+    gsize bytes_read;
+
+    g_assert (count <= READ_BUFFER_SIZE);
+
+    if (offset < 0 || offset + (goffset)count > reader->size)
+    {
+        set_truncated_error (error);
+        return FALSE;
+    }
+
+    if (!g_seekable_seek (G_SEEKABLE (reader->stream), offset, G_SEEK_SET,
+                          NULL, error)
+        || !g_input_stream_read_all (reader->stream, reader->buffer, count,
+                                     &bytes_read, NULL, error))
+    {
+        return FALSE;
+    }
+
+    if (bytes_read != count)
+    {
+        set_truncated_error (error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+hash_range (PayloadReader *reader,
+            goffset start,
+            goffset length,
+            GError **error)
+{
+    if (!g_seekable_seek (G_SEEKABLE (reader->stream), start, G_SEEK_SET,
+                          NULL, error))
+    {
+        return FALSE;
+    }
+
+    while (length > 0)
+    {
+        gssize n;
+
+        n = g_input_stream_read (reader->stream, reader->buffer,
+                                 MIN (length, READ_BUFFER_SIZE), NULL, error);
+
+        if (n < 0)
+        {
+            return FALSE;
+        }
+        else if (n == 0)
+        {
+            set_truncated_error (error);
+            return FALSE;
+        }
+
+        g_checksum_update (reader->checksum, reader->buffer, n);
+        length -= n;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Find the size of the ID3v2 tag at the start of the file, including its
+ * footer, or 0 if there is none.
+ */
+static goffset
+get_id3v2_size (PayloadReader *reader)
+{
+    const guchar *header = reader->buffer;
+    goffset size;
+
+    if (reader->size < 10 || !read_at (reader, 0, 10, NULL)
+        || memcmp (header, "ID3", 3) != 0 || header[3] == 0xff
+        || ((header[6] | header[7] | header[8] | header[9]) & 0x80))
+    {
+        return 0;
+    }
+
+    size = 10 + (((goffset)header[6] << 21) | (header[7] << 14)
+                 | (header[8] << 7) | header[9]);
+
+    /* Footer present. */
+    if (header[5] & 0x10)
+    {
+        size += 10;
+    }
+
+    return MIN (size, reader->size);
+}
+
+/*
+ * Find the end of the audio data, before any ID3v1 and APEv2 tags, which may
+ * follow each other in either order.
+ */
+static goffset
+get_payload_end (PayloadReader *reader,
+                 goffset start)
+{
+    goffset end = reader->size;
+
+    for (;;)
+    {
+        if (end - start >= ID3V1_SIZE
+            && read_at (reader, end - ID3V1_SIZE, 3, NULL)
+            && memcmp (reader->buffer, "TAG", 3) == 0)
+        {
+            end -= ID3V1_SIZE;
+            continue;
+        }
+
+        if (end - start >= APE_FOOTER_SIZE
+            && read_at (reader, end - APE_FOOTER_SIZE, APE_FOOTER_SIZE, NULL)
+            && memcmp (reader->buffer, "APETAGEX", 8) == 0)
+        {
+            /* The size includes the footer, but not the optional header. */
+            goffset tag_size = read_le32 (reader->buffer + 12);
+
+            if (read_le32 (reader->buffer + 20) & 0x80000000)
+            {
+                tag_size += APE_FOOTER_SIZE;
+            }
+
+            if (tag_size >= APE_FOOTER_SIZE && tag_size <= end - start)
+            {
+                end -= tag_size;
+                continue;
+            }
+        }
+
+        return end;
+    }
+}
+
+/*
+ * MP3, MPC, Monkey's Audio, WavPack and others: everything between the ID3v2
+ * tag at the start and the ID3v1 and APEv2 tags at the end.
+ */
+static gboolean
+hash_tagged (PayloadReader *reader,
+             GError **error)
+{
+    goffset start;
+    goffset end;
+
+    start = get_id3v2_size (reader);
+    end = get_payload_end (reader, start);
+
+    if (end <= start)
+    {
+        set_no_audio_error (error);
+        return FALSE;
+    }
+
+    return hash_range (reader, start, end - start, error);
+}
+
+/*
+ * FLAC: the STREAMINFO block holds the MD5 of the decoded audio, so the file
+ * does not need to be read further. If the encoder did not set it, the audio
+ * frames after the metadata blocks are hashed instead.
+ */
+static gboolean
+hash_flac (PayloadReader *reader,
+           GError **error)
+{
+    goffset pos;
+    goffset end;
+
+    pos = get_id3v2_size (reader);
+
+    if (!read_at (reader, pos, 4, error))
+    {
+        return FALSE;
+    }
+
+    if (memcmp (reader->buffer, "fLaC", 4) != 0)
+    {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                             _("Not a FLAC file"));
+        return FALSE;
+    }
+
+    pos += 4;
+
+    for (;;)
+    {
+        gboolean last;
+        guint type;
+        guint32 length;
+
+        if (!read_at (reader, pos, 4, error))
+        {
+            return FALSE;
+        }
+
+        last = (reader->buffer[0] & 0x80) != 0;
+        type = reader->buffer[0] & 0x7f;
+        length = read_be24 (reader->buffer + 1);
+
+        if (type == 0 && length >= 34)
+        {
+            static const guint8 unset[ET_PAYLOAD_DIGEST_SIZE] = { 0, };
+
+            if (!read_at (reader, pos + 4, 34, error))
+            {
+                return FALSE;
+            }
+
+            if (memcmp (reader->buffer + 18, unset, sizeof (unset)) != 0)
+            {
+                memcpy (reader->digest, reader->buffer + 18,
+                        ET_PAYLOAD_DIGEST_SIZE);
+                reader->digest_set = TRUE;
+                return TRUE;
+            }
+        }
+
+        pos += 4 + length;
+
+        if (last)
+        {
+            break;
+        }
+    }
+
+    end = get_payload_end (reader, pos);
+
+    if (end <= pos)
+    {
+        set_no_audio_error (error);
+        return FALSE;
+    }
+
+    return hash_range (reader, pos, end - pos, error);
+}
+
+/* Granule position of a page on which no packet is completed. */
+#define OGG_NO_GRANULE G_MAXUINT64
+
+/*
+ * Find the number of header packets of an Ogg stream from its first packet,
+ * or 0 if the codec is not known.
+ */
+static guint
+get_ogg_header_count (const guchar *packet,
+                      gsize length)
+{
+    if (length >= 7 && memcmp (packet, "\x01vorbis", 7) == 0)
+    {
+        /* Identification, comment and setup. */
+        return 3;
+    }
+    else if (length >= 8 && memcmp (packet, "OpusHead", 8) == 0)
+    {
+        /* Identification and comment. */
+        return 2;
+    }
+    else if (length >= 80 && memcmp (packet, "Speex   ", 8) == 0)
+    {
+        /* Identification, comment and the extra headers. */
+        return 2 + MIN (read_le32 (packet + 68), 16);
+    }
+
+    return 0;
+}
+
+/*
+ * Ogg Vorbis, Speex and Opus: the bodies of the pages after the header
+ * packets, which are counted from the lacing values. The comment header can
+ * span many pages, such as when it holds cover art, and those pages all have
+ * a granule position of -1 except the last. For unknown codecs, the header
+ * pages are those with a granule position of 0 or -1, before the first audio
+ * page. The page headers are skipped, as their sequence numbers and checksums
+ * change when a longer comment header adds pages.
+ */
+static gboolean
+hash_ogg (PayloadReader *reader,
+          GError **error)
+{
+    goffset pos = 0;
+    goffset hashed = 0;
+    gboolean in_audio = FALSE;
+    guint n_headers = 0;
+    guint n_packets = 0;
+
+    while (pos + 27 <= reader->size)
+    {
+        guchar lacing[255];
+        guint64 granule;
+        guint n_segments;
+        goffset body_length = 0;
+        goffset audio_start = 0;
+        guint i;
+
+        if (!read_at (reader, pos, 27, error))
+        {
+            return FALSE;
+        }
+
+        if (memcmp (reader->buffer, "OggS", 4) != 0)
+        {
+            if (pos == 0)
+            {
+                g_set_error_literal (error, G_IO_ERROR,
+                                     G_IO_ERROR_INVALID_DATA,
+                                     _("Not an Ogg file"));
+                return FALSE;
+            }
+
+            /* Trailing data, such as an ID3v1 tag. */
+            break;
+        }
+
+        granule = read_le64 (reader->buffer + 6);
+        n_segments = reader->buffer[26];
+
+        if (!read_at (reader, pos + 27, n_segments, error))
+        {
+            return FALSE;
+        }
+
+        memcpy (lacing, reader->buffer, n_segments);
+
+        for (i = 0; i < n_segments; i++)
+        {
+            body_length += lacing[i];
+        }
+
+        pos += 27 + n_segments;
+
+        if (pos == 27 + n_segments && body_length > 0)
+        {
+            /* The first page starts with the identification header. */
+            if (!read_at (reader, pos, MIN (body_length, 80), error))
+            {
+                return FALSE;
+            }
+
+            n_headers = get_ogg_header_count (reader->buffer,
+                                              MIN (body_length, 80));
+        }
+
+        if (!in_audio && n_headers > 0)
+        {
+            /* A packet ends with a lacing value of less than 255. */
+            for (i = 0; i < n_segments && !in_audio; i++)
+            {
+                audio_start += lacing[i];
+
+                if (lacing[i] < 255 && ++n_packets == n_headers)
+                {
+                    in_audio = TRUE;
+                }
+            }
+        }
+        else if (!in_audio && granule != 0 && granule != OGG_NO_GRANULE)
+        {
+            in_audio = TRUE;
+        }
+
+        if (in_audio && audio_start < body_length)
+        {
+            if (!hash_range (reader, pos + audio_start,
+                             body_length - audio_start, error))
+            {
+                return FALSE;
+            }
+
+            hashed += body_length - audio_start;
+        }
+
+        pos += body_length;
+    }
+
+    if (hashed == 0)
+    {
+        set_no_audio_error (error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * MP4: the contents of the top-level mdat boxes. The metadata is in the moov
+ * box, which may be before or after them.
+ */
+static gboolean
+hash_mp4 (PayloadReader *reader,
+          GError **error)
+{
+    goffset pos = 0;
+    gboolean hashed = FALSE;
+
+    while (pos + 8 <= reader->size)
+    {
+        guint64 box_size;
+        goffset header_size = 8;
+        gboolean is_mdat;
+
+        if (!read_at (reader, pos, 8, error))
+        {
+            return FALSE;
+        }
+
+        box_size = read_be32 (reader->buffer);
+        is_mdat = memcmp (reader->buffer + 4, "mdat", 4) == 0;
+
+        if (box_size == 1)
+        {
+            /* A 64-bit size follows the type. */
+            if (!read_at (reader, pos + 8, 8, error))
+            {
+                return FALSE;
+            }
+
+            box_size = read_be64 (reader->buffer);
+            header_size = 16;
+        }
+        else if (box_size == 0)
+        {
+            /* The box extends to the end of the file. */
+            box_size = reader->size - pos;
+        }
+
+        if (box_size < (guint64)header_size
+            || box_size > (guint64)(reader->size - pos))
+        {
+            set_truncated_error (error);
+            return FALSE;
+        }
+
+        if (is_mdat)
+        {
+            if (!hash_range (reader, pos + header_size,
+                             box_size - header_size, error))
+            {
+                return FALSE;
+            }
+
+            hashed = TRUE;
+        }
+
+        pos += box_size;
+    }
+
+    if (!hashed)
+    {
+        set_no_audio_error (error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * et_payload_hash_file:
+ * @path: the file to read
+ * @type: the type of the file, which decides how the payload is found
+ * @digest: (out caller-allocates) (array fixed-size=16): the digest
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Calculate a digest of the audio payload of a file, which ignores the tags,
+ * so that copies of the same recording with different tags can be found. This
+ * can be called from any thread.
+ *
+ * Returns: %TRUE if the digest was calculated, %FALSE otherwise
+ */
+gboolean
+et_payload_hash_file (const gchar *path,
+                      ET_File_Type type,
+                      guint8 *digest,
+                      GError **error)
+{
+    GFile *file;
+    GFileInputStream *istream;
+    GFileInfo *info;
+    PayloadReader reader;
+    gboolean result;
+
+    g_return_val_if_fail (path != NULL, FALSE);
+    g_return_val_if_fail (digest != NULL, FALSE);
+    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+    file = g_file_new_for_path (path);
+    istream = g_file_read (file, NULL, error);
+    g_object_unref (file);
+
+    if (!istream)
+    {
+        return FALSE;
+    }
+
+    info = g_file_input_stream_query_info (istream,
+                                           G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                           NULL, error);
+
+    if (!info)
+    {
+        g_object_unref (istream);
+        return FALSE;
+    }
+
+    reader.stream = G_INPUT_STREAM (istream);
+    reader.size = g_file_info_get_size (info);
+    reader.checksum = g_checksum_new (G_CHECKSUM_MD5);
+    reader.buffer = g_malloc (READ_BUFFER_SIZE);
+    reader.digest = digest;
+    reader.digest_set = FALSE;
+    g_object_unref (info);
+
+    switch (type)
+    {
+        case FLAC_FILE:
+            result = hash_flac (&reader, error);
+            break;
+        case OGG_FILE:
+        case SPEEX_FILE:
+        case OPUS_FILE:
+            result = hash_ogg (&reader, error);
+            break;
+        case MP4_FILE:
+            result = hash_mp4 (&reader, error);
+            break;
+        case MP2_FILE:
+        case MP3_FILE:
+        case MPC_FILE:
+        case MAC_FILE:
+        case OFR_FILE:
+        case WAVPACK_FILE:
+        case UNKNOWN_FILE:
+        default:
+            result = hash_tagged (&reader, error);
+            break;
+    }
+
+    if (result && !reader.digest_set)
+    {
+        gsize length = ET_PAYLOAD_DIGEST_SIZE;
+
+        g_checksum_get_digest (reader.checksum, digest, &length);
+    }
+
+    g_free (reader.buffer);
+    g_checksum_free (reader.checksum);
+    g_object_unref (istream);
+
+    return result;
+}
+
+typedef struct
+{
+    gint64 mtime;
+    gint64 size;
+    guint8 digest[ET_PAYLOAD_DIGEST_SIZE];
+} EtPayloadIndexEntry;
+
+struct _EtPayloadIndex
+{
+    /* Path to EtPayloadIndexEntry. */
+    GHashTable *entries;
+};
+
+static void
+et_payload_index_entry_free (EtPayloadIndexEntry *entry)
+{
+    g_slice_free (EtPayloadIndexEntry, entry);
+}
+
+EtPayloadIndex *
+et_payload_index_new (void)
+{
+    EtPayloadIndex *index;
+
+    index = g_slice_new (EtPayloadIndex);
+    index->entries = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                            (GDestroyNotify)et_payload_index_entry_free);
+
+    return index;
+}
+
+void
+et_payload_index_free (EtPayloadIndex *index)
+{
+    g_return_if_fail (index != NULL);
+
+    g_hash_table_destroy (index->entries);
+    g_slice_free (EtPayloadIndex, index);
+}
+
+guint
+et_payload_index_get_length (const EtPayloadIndex *index)
+{
+    g_return_val_if_fail (index != NULL, 0);
+
+    return g_hash_table_size (index->entries);
+}
+
+static void
+et_payload_index_insert (EtPayloadIndex *index,
+                         const gchar *path,
+                         gint64 mtime,
+                         gint64 size,
+                         const guint8 *digest)
+{
+    EtPayloadIndexEntry *entry;
+
+    entry = g_slice_new (EtPayloadIndexEntry);
+    entry->mtime = mtime;
+    entry->size = size;
+    memcpy (entry->digest, digest, ET_PAYLOAD_DIGEST_SIZE);
+
+    g_hash_table_replace (index->entries, g_strdup (path), entry);
+}
+
+/*
+ * Parse a line of an index file: the digest in hexadecimal, the modification
+ * time, the size and the path, separated by spaces.
+ */
+static gboolean
+et_payload_index_parse_line (EtPayloadIndex *index,
+                             const gchar *line)
+{
+    guint8 digest[ET_PAYLOAD_DIGEST_SIZE];
+    gint64 mtime;
+    gint64 size;
+    gchar *end;
+    gsize i;
+
+    for (i = 0; i < ET_PAYLOAD_DIGEST_SIZE; i++)
+    {
+        gint high = g_ascii_xdigit_value (line[2 * i]);
+        gint low;
+
+        if (high < 0)
+        {
+            return FALSE;
+        }
+
+        low = g_ascii_xdigit_value (line[2 * i + 1]);
+
+        if (low < 0)
+        {
+            return FALSE;
+        }
+
+        digest[i] = (high << 4) | low;
+    }
+
+    line += 2 * ET_PAYLOAD_DIGEST_SIZE;
+
+    if (*line++ != ' ')
+    {
+        return FALSE;
+    }
+
+    mtime = g_ascii_strtoll (line, &end, 10);
+
+    if (end == line || *end != ' ')
+    {
+        return FALSE;
+    }
+
+    line = end + 1;
+    size = g_ascii_strtoll (line, &end, 10);
+
+    if (end == line || *end != ' ' || end[1] == '\0')
+    {
+        return FALSE;
+    }
+
+    et_payload_index_insert (index, end + 1, mtime, size, digest);
+
+    return TRUE;
+}
+
+/*
+ * et_payload_index_load:
+ * @index: the index
+ * @filename: the file to load the index from
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Add the entries from an index file, which was written by
+ * et_payload_index_save(). A file written by a version of EasyTAG which
+ * calculated the digests differently is ignored.
+ *
+ * Returns: %TRUE if the file was read, %FALSE otherwise
+ */
+gboolean
+et_payload_index_load (EtPayloadIndex *index,
+                       const gchar *filename,
+                       GError **error)
+{
+    gchar *contents;
+    gchar *line;
+
+    g_return_val_if_fail (index != NULL, FALSE);
+    g_return_val_if_fail (filename != NULL, FALSE);
+    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+    if (!g_file_get_contents (filename, &contents, NULL, error))
+    {
+        return FALSE;
+    }
+
+    if (!g_str_has_prefix (contents, INDEX_HEADER))
+    {
+        g_free (contents);
+        return TRUE;
+    }
+
+    line = contents + strlen (INDEX_HEADER);
+
+    while (*line != '\0')
+    {
+        gchar *next = strchr (line, '\n');
+
+        if (next)
+        {
+            *next++ = '\0';
+        }
+        else
+        {
+            next = line + strlen (line);
+        }
+
+        /* Skip damaged lines, rather than losing the whole index. */
+        if (!et_payload_index_parse_line (index, line))
+        {
+            g_debug ("Ignoring invalid line in payload index: %s", line);
+        }
+
+        line = next;
+    }
+
+    g_free (contents);
+
+    return TRUE;
+}
+
+/*
+ * et_payload_index_save:
+ * @index: the index
+ * @filename: the file to save the index to
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Replace @filename with the entries of @index, creating its directory if
+ * needed.
+ *
+ * Returns: %TRUE if the file was written, %FALSE otherwise
+ */
+gboolean
+et_payload_index_save (const EtPayloadIndex *index,
+                       const gchar *filename,
+                       GError **error)
+{
+    GString *contents;
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+    gchar *dirname;
+    gboolean result;
+
+    g_return_val_if_fail (index != NULL, FALSE);
+    g_return_val_if_fail (filename != NULL, FALSE);
+    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+    contents = g_string_new (INDEX_HEADER);
+    g_hash_table_iter_init (&iter, index->entries);
+
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        const gchar *path = key;
+        const EtPayloadIndexEntry *entry = value;
+        gsize i;
+
+        /* A path with a newline cannot be stored, so it is hashed again
+         * next time. */
+        if (strchr (path, '\n'))
+        {
+            continue;
+        }
+
+        for (i = 0; i < ET_PAYLOAD_DIGEST_SIZE; i++)
+        {
+            g_string_append_printf (contents, "%02x", entry->digest[i]);
+        }
+
+        g_string_append_printf (contents,
+                                " %" G_GINT64_FORMAT " %" G_GINT64_FORMAT " ",
+                                entry->mtime, entry->size);
+        g_string_append (contents, path);
+        g_string_append_c (contents, '\n');
+    }
+
+    dirname = g_path_get_dirname (filename);
+    g_mkdir_with_parents (dirname, 0700);
+    g_free (dirname);
+
+    result = g_file_set_contents (filename, contents->str, contents->len,
+                                  error);
+    g_string_free (contents, TRUE);
+
+    return result;
+}
+
+/*
+ * EtPayloadScanFile:
+ * @path: the file to hash
+ * @type: the type of the file
+ * @data: the data passed to et_payload_scan_add()
+ * @done: whether the file was read, or found in the index
+ * @hashed: whether the digest was calculated, and is not in the index yet
+ * @mtime: the modification time of the file
+ * @size: the size of the file
+ * @digest: the digest of the payload
+ * @error: the reason that the digest could not be calculated, or %NULL
+ */
+typedef struct
+{
+    gchar *path;
+    ET_File_Type type;
+    gpointer data;
+    gboolean done;
+    gboolean hashed;
+    gint64 mtime;
+    gint64 size;
+    guint8 digest[ET_PAYLOAD_DIGEST_SIZE];
+    GError *error;
+} EtPayloadScanFile;
+
+/*
+ * EtPayloadScan:
+ * @index: the index to look the files up in, and to add new digests to
+ * @files: (element-type EtPayloadScanFile): the files to scan
+ * @worker_job: the job which scans the files, once started
+ * @index_updated: whether the results have been added to @index
+ */
+struct _EtPayloadScan
+{
+    EtPayloadIndex *index;
+    GArray *files;
+    EtWorkerJob *worker_job;
+    gboolean index_updated;
+};
+
+/*
+ * et_payload_scan_new:
+ * @index: the index of known digests
+ *
+ * Returns: a new #EtPayloadScan, to be freed with et_payload_scan_free()
+ */
+EtPayloadScan *
+et_payload_scan_new (EtPayloadIndex *index)
+{
+    EtPayloadScan *scan;
+
+    g_return_val_if_fail (index != NULL, NULL);
+
+    scan = g_slice_new0 (EtPayloadScan);
+    scan->index = index;
+    scan->files = g_array_new (FALSE, TRUE, sizeof (EtPayloadScanFile));
+
+    return scan;
+}
+
+/*
+ * et_payload_scan_add:
+ * @scan: the scan
+ * @path: the file to scan
+ * @type: the type of the file
+ * @data: data to return in the groups of et_payload_scan_get_groups()
+ *
+ * Add a file to scan, before et_payload_scan_start() is called.
+ */
+void
+et_payload_scan_add (EtPayloadScan *scan,
+                     const gchar *path,
+                     ET_File_Type type,
+                     gpointer data)
+{
+    EtPayloadScanFile file = { NULL, };
+
+    g_return_if_fail (scan != NULL);
+    g_return_if_fail (path != NULL);
+    g_return_if_fail (scan->worker_job == NULL);
+
+    file.path = g_strdup (path);
+    file.type = type;
+    file.data = data;
+    g_array_append_val (scan->files, file);
+}
+
+static void
+et_payload_scan_file (const EtPayloadIndex *index,
+                      EtPayloadScanFile *file)
+{
+    GStatBuf st;
+    const EtPayloadIndexEntry *entry;
+
+    if (g_stat (file->path, &st) != 0)
+    {
+        gint saved_errno = errno;
+
+        g_set_error_literal (&file->error, G_FILE_ERROR,
+                             g_file_error_from_errno (saved_errno),
+                             g_strerror (saved_errno));
+        return;
+    }
+
+    file->mtime = st.st_mtime;
+    file->size = st.st_size;
+
+    /* The index is not changed while the workers run. */
+    entry = g_hash_table_lookup (index->entries, file->path);
+
+    if (entry && entry->mtime == file->mtime && entry->size == file->size)
+    {
+        memcpy (file->digest, entry->digest, ET_PAYLOAD_DIGEST_SIZE);
+    }
+    else if (et_payload_hash_file (file->path, file->type, file->digest,
+                                   &file->error))
+    {
+        file->hashed = TRUE;
+    }
+}
+
+static void
+et_payload_scan_thread_file (guint index,
+                             gpointer user_data)
+{
+    EtPayloadScan *scan = user_data;
+    EtPayloadScanFile *file;
+
+    file = &g_array_index (scan->files, EtPayloadScanFile, index);
+    et_payload_scan_file (scan->index, file);
+    file->done = TRUE;
+}
+
+/*
+ * et_payload_scan_start:
+ * @scan: the scan
+ * @max_threads: the maximum number of files to read at the same time
+ *
+ * Start scanning the files on up to @max_threads worker threads.
+ *
+ * Returns: (transfer none): the job which scans the files, one item per file,
+ *          to follow the progress with
+ */
+EtWorkerJob *
+et_payload_scan_start (EtPayloadScan *scan,
+                       guint max_threads)
+{
+    g_return_val_if_fail (scan != NULL, NULL);
+    g_return_val_if_fail (max_threads > 0, NULL);
+    g_return_val_if_fail (scan->worker_job == NULL, NULL);
+
+    scan->worker_job = et_worker_job_new ("payload-scan", scan->files->len,
+                                          max_threads,
+                                          et_payload_scan_thread_file, scan);
+
+    return scan->worker_job;
+}
+
+guint
+et_payload_scan_get_n_files (const EtPayloadScan *scan)
+{
+    g_return_val_if_fail (scan != NULL, 0);
+
+    return scan->files->len;
+}
+
+/*
+ * Remove the entries of the files in the scanned directories which no longer
+ * exist, as nothing else removes them. The entries of the other directories
+ * are kept, as they may be on a disk which is not mounted.
+ */
+static void
+et_payload_scan_prune_index (EtPayloadScan *scan)
+{
+    GHashTable *dirs;
+    GHashTable *seen;
+    GHashTableIter iter;
+    gpointer key;
+    guint i;
+
+    dirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    seen = g_hash_table_new (g_str_hash, g_str_equal);
+
+    for (i = 0; i < scan->files->len; i++)
+    {
+        EtPayloadScanFile *file = &g_array_index (scan->files,
+                                                  EtPayloadScanFile, i);
+
+        g_hash_table_add (dirs, g_path_get_dirname (file->path));
+
+        if (file->done && !file->error)
+        {
+            g_hash_table_add (seen, file->path);
+        }
+    }
+
+    g_hash_table_iter_init (&iter, scan->index->entries);
+
+    while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+        const gchar *path = key;
+        gchar *dirname;
+        GStatBuf st;
+
+        if (g_hash_table_contains (seen, path))
+        {
+            continue;
+        }
+
+        dirname = g_path_get_dirname (path);
+
+        if (g_hash_table_contains (dirs, dirname) && g_stat (path, &st) != 0)
+        {
+            g_hash_table_iter_remove (&iter);
+        }
+
+        g_free (dirname);
+    }
+
+    g_hash_table_destroy (seen);
+    g_hash_table_destroy (dirs);
+}
+
+/*
+ * et_payload_scan_wait:
+ * @scan: the scan
+ * @cancel: %TRUE to skip the files which have not been started yet
+ *
+ * Wait for the worker threads to finish, add the new digests to the index,
+ * and remove the entries of the files in the scanned directories which no
+ * longer exist.
+ */
+void
+et_payload_scan_wait (EtPayloadScan *scan,
+                      gboolean cancel)
+{
+    guint i;
+
+    g_return_if_fail (scan != NULL);
+
+    if (scan->worker_job)
+    {
+        et_worker_job_wait (scan->worker_job, cancel);
+    }
+
+    if (scan->index_updated)
+    {
+        return;
+    }
+
+    for (i = 0; i < scan->files->len; i++)
+    {
+        EtPayloadScanFile *file = &g_array_index (scan->files,
+                                                  EtPayloadScanFile, i);
+
+        if (file->hashed)
+        {
+            et_payload_index_insert (scan->index, file->path, file->mtime,
+                                     file->size, file->digest);
+            file->hashed = FALSE;
+        }
+    }
+
+    et_payload_scan_prune_index (scan);
+    scan->index_updated = TRUE;
+}
+
+/*
+ * et_payload_scan_get_error:
+ * @scan: the scan
+ * @index: the index of a file, in the order in which they were added
+ *
+ * Returns: the reason that the file could not be scanned, or %NULL
+ */
+const GError *
+et_payload_scan_get_error (const EtPayloadScan *scan,
+                           guint index)
+{
+    g_return_val_if_fail (scan != NULL, NULL);
+    g_return_val_if_fail (index < scan->files->len, NULL);
+
+    return g_array_index (scan->files, EtPayloadScanFile, index).error;
+}
+
+static guint
+digest_hash (gconstpointer key)
+{
+    guint hash;
+
+    /* The digest is already well distributed. */
+    memcpy (&hash, key, sizeof (hash));
+
+    return hash;
+}
+
+static gboolean
+digest_equal (gconstpointer a,
+              gconstpointer b)
+{
+    return memcmp (a, b, ET_PAYLOAD_DIGEST_SIZE) == 0;
+}
+
+/*
+ * et_payload_scan_get_groups:
+ * @scan: the scan, after et_payload_scan_wait() has returned
+ *
+ * Group the files which have the same payload. Only the groups with more than
+ * one file are returned, in the order of their first file, and the files of
+ * each group are in the order in which they were added.
+ *
+ * Returns: (transfer full) (element-type GList): a list of groups, each of
+ *          which is a list of the data passed to et_payload_scan_add()
+ */
+GList *
+et_payload_scan_get_groups (const EtPayloadScan *scan)
+{
+    GHashTable *groups;
+    GPtrArray *order;
+    GList *result = NULL;
+    guint i;
+
+    g_return_val_if_fail (scan != NULL, NULL);
+
+    /* Digest to GQueue of data. */
+    groups = g_hash_table_new (digest_hash, digest_equal);
+    order = g_ptr_array_new ();
+
+    for (i = 0; i < scan->files->len; i++)
+    {
+        EtPayloadScanFile *file = &g_array_index (scan->files,
+                                                  EtPayloadScanFile, i);
+        GQueue *group;
+
+        if (!file->done || file->error)
+        {
+            continue;
+        }
+
+        group = g_hash_table_lookup (groups, file->digest);
+
+        if (!group)
+        {
+            group = g_queue_new ();
+            g_hash_table_insert (groups, file->digest, group);
+            g_ptr_array_add (order, group);
+        }
+
+        g_queue_push_tail (group, file->data);
+    }
+
+    /* Build the list backwards, to prepend. */
+    for (i = order->len; i > 0; i--)
+    {
+        GQueue *group = g_ptr_array_index (order, i - 1);
+
+        if (group->length > 1)
+        {
+            /* Keep the links of the queue. */
+            result = g_list_prepend (result, group->head);
+            g_queue_init (group);
+        }
+
+        g_queue_free (group);
+    }
+
+    g_ptr_array_free (order, TRUE);
+    g_hash_table_destroy (groups);
+
+    return result;
+}
+
+/*
+ * et_payload_scan_free:
+ * @scan: the scan
+ *
+ * Cancel the files which have not been started yet, wait for the worker
+ * threads, and free @scan. The index is updated as by
+ * et_payload_scan_wait(), if that was not called.
+ */
+void
+et_payload_scan_free (EtPayloadScan *scan)
+{
+    guint i;
+
+    g_return_if_fail (scan != NULL);
+
+    et_payload_scan_wait (scan, TRUE);
+
+    for (i = 0; i < scan->files->len; i++)
+    {
+        EtPayloadScanFile *file = &g_array_index (scan->files,
+                                                  EtPayloadScanFile, i);
+
+        g_free (file->path);
+        g_clear_error (&file->error);
+    }
+
+    if (scan->worker_job)
+    {
+        et_worker_job_free (scan->worker_job);
+    }
+
+    g_array_unref (scan->files);
+    g_slice_free (EtPayloadScan, scan);
+}
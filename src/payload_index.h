@@ -0,0 +1,68 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ET_PAYLOAD_INDEX_H_
+#define ET_PAYLOAD_INDEX_H_
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#include "core_types.h"
+#include "worker_job.h"
+
+/* Size of a payload digest, in bytes. */
+#define ET_PAYLOAD_DIGEST_SIZE 16
+
+gboolean et_payload_hash_file (const gchar *path, ET_File_Type type, guint8 *digest, GError **error);
+
+/*
+ * EtPayloadIndex:
+ *
+ * The payload digests of files, keyed by path, modification time and size,
+ * which can be kept between sessions so that unchanged files are not read
+ * again.
+ */
+typedef struct _EtPayloadIndex EtPayloadIndex;
+
+EtPayloadIndex * et_payload_index_new (void);
+void et_payload_index_free (EtPayloadIndex *index);
+guint et_payload_index_get_length (const EtPayloadIndex *index);
+gboolean et_payload_index_load (EtPayloadIndex *index, const gchar *filename, GError **error);
+gboolean et_payload_index_save (const EtPayloadIndex *index, const gchar *filename, GError **error);
+
+/*
+ * EtPayloadScan:
+ *
+ * Finds the files with identical audio payloads in a list, hashing the files
+ * which are not in an #EtPayloadIndex on a few worker threads.
+ */
+typedef struct _EtPayloadScan EtPayloadScan;
+
+EtPayloadScan * et_payload_scan_new (EtPayloadIndex *index);
+void et_payload_scan_add (EtPayloadScan *scan, const gchar *path, ET_File_Type type, gpointer data);
+EtWorkerJob * et_payload_scan_start (EtPayloadScan *scan, guint max_threads);
+guint et_payload_scan_get_n_files (const EtPayloadScan *scan);
+void et_payload_scan_wait (EtPayloadScan *scan, gboolean cancel);
+const GError * et_payload_scan_get_error (const EtPayloadScan *scan, guint index);
+GList * et_payload_scan_get_groups (const EtPayloadScan *scan);
+void et_payload_scan_free (EtPayloadScan *scan);
+
+G_END_DECLS
+
+#endif /* !ET_PAYLOAD_INDEX_H_ */
@@ -26,6 +26,7 @@
 #include "easytag.h"
 #include "log.h"
 #include "misc.h"
+#include "picture_probe.h"
 #include "setting.h"
 #include "charset.h"
 
@@ -108,7 +109,6 @@ et_picture_type_from_filename (const gchar *filename_utf8)
     return picture_type;
 }
 
-/* FIXME: Possibly use gnome_vfs_get_mime_type_for_buffer. */
 Picture_Format
 Picture_Format_From_Data (const EtPicture *pic)
 {
@@ -119,31 +119,7 @@ Picture_Format_From_Data (const EtPicture *pic)
 
     data = g_bytes_get_data (pic->bytes, &size);
 
-    /* JPEG : "\xff\xd8\xff". */
-    if (size > 3 && (memcmp (data, "\xff\xd8\xff", 3) == 0))
-    {
-        return PICTURE_FORMAT_JPEG;
-    }
-
-    /* PNG : "\x89PNG\x0d\x0a\x1a\x0a". */
-    if (size > 8 && (memcmp (data, "\x89PNG\x0d\x0a\x1a\x0a", 8) == 0))
-    {
-        return PICTURE_FORMAT_PNG;
-    }
-    
-    /* GIF: "GIF87a" */
-    if (size > 6 && (memcmp (data, "GIF87a", 6) == 0))
-    {
-        return PICTURE_FORMAT_GIF;
-    }
-
-    /* GIF: "GIF89a" */
-    if (size > 6 && (memcmp (data, "GIF89a", 6) == 0))
-    {
-        return PICTURE_FORMAT_GIF;
-    }
-    
-    return PICTURE_FORMAT_UNKNOWN;
+    return et_picture_probe_format (data, size);
 }
 
 const gchar *
@@ -157,6 +133,10 @@ Picture_Mime_Type_String (Picture_Format format)
             return "image/png";
         case PICTURE_FORMAT_GIF:
             return "image/gif";
+        case PICTURE_FORMAT_BMP:
+            return "image/bmp";
+        case PICTURE_FORMAT_WEBP:
+            return "image/webp";
         case PICTURE_FORMAT_UNKNOWN:
         default:
             g_debug ("%s", "Unrecognised image MIME type");
@@ -176,6 +156,10 @@ Picture_Format_String (Picture_Format format)
             return _("PNG image");
         case PICTURE_FORMAT_GIF:
             return _("GIF image");
+        case PICTURE_FORMAT_BMP:
+            return _("BMP image");
+        case PICTURE_FORMAT_WEBP:
+            return _("WebP image");
         case PICTURE_FORMAT_UNKNOWN:
         default:
             return _("Unknown image");
@@ -314,12 +298,13 @@ et_picture_format_info (const EtPicture *pic,
  * et_picture_new:
  * @type: the image type
  * @description: a text description
- * @width: image width
- * @height image height
+ * @width: image width, or 0 if unknown
+ * @height image height, or 0 if unknown
  * @bytes: image data
  *
  * Create a new #EtPicture instance, copying the string and adding a reference
- * to the image data.
+ * to the image data. If the dimensions are unknown, they are read from the
+ * header of the image.
  *
  * Returns: a new #EtPicture, or %NULL on failure
  */
@@ -344,6 +329,21 @@ et_picture_new (EtPictureType type,
     pic->bytes = g_bytes_ref (bytes);
     pic->next = NULL;
 
+    if (width == 0 && height == 0)
+    {
+        EtPictureInfo info;
+        gconstpointer data;
+        gsize size;
+
+        data = g_bytes_get_data (bytes, &size);
+
+        if (et_picture_probe (data, size, &info))
+        {
+            pic->width = info.width;
+            pic->height = info.height;
+        }
+    }
+
     return pic;
 }
 
@@ -81,6 +81,8 @@ typedef enum
     PICTURE_FORMAT_JPEG,
     PICTURE_FORMAT_PNG,
     PICTURE_FORMAT_GIF,
+    PICTURE_FORMAT_BMP,
+    PICTURE_FORMAT_WEBP,
     PICTURE_FORMAT_UNKNOWN
 } Picture_Format;
 
@@ -0,0 +1,467 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "picture_probe.h"
+
+#include <string.h>
+
+/*
+ * Only the headers of the images are parsed, so that the properties of cover
+ * art can be found when reading tags without decoding any pixels.
+ */
+
+static guint
+read_be16 (const guchar *data)
+{
+    return (data[0] << 8) | data[1];
+}
+
+static guint32
+read_be32 (const guchar *data)
+{
+    return ((guint32)data[0] << 24) | ((guint32)data[1] << 16)
+           | ((guint32)data[2] << 8) | data[3];
+}
+
+static guint
+read_le16 (const guchar *data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+static guint32
+read_le24 (const guchar *data)
+{
+    return data[0] | (data[1] << 8) | ((guint32)data[2] << 16);
+}
+
+static guint32
+read_le32 (const guchar *data)
+{
+    return data[0] | (data[1] << 8) | ((guint32)data[2] << 16)
+           | ((guint32)data[3] << 24);
+}
+
+/*
+ * et_picture_probe_format:
+ * @data: image data
+ * @size: size of @data, in bytes
+ *
+ * Find the format of an image from its signature.
+ *
+ * Returns: the format of the image, or %PICTURE_FORMAT_UNKNOWN
+ */
+Picture_Format
+et_picture_probe_format (gconstpointer data,
+                         gsize size)
+{
+    const guchar *bytes = data;
+
+    g_return_val_if_fail (data != NULL || size == 0, PICTURE_FORMAT_UNKNOWN);
+
+    /* JPEG : "\xff\xd8\xff". */
+    if (size > 3 && (memcmp (bytes, "\xff\xd8\xff", 3) == 0))
+    {
+        return PICTURE_FORMAT_JPEG;
+    }
+
+    /* PNG : "\x89PNG\x0d\x0a\x1a\x0a". */
+    if (size > 8 && (memcmp (bytes, "\x89PNG\x0d\x0a\x1a\x0a", 8) == 0))
+    {
+        return PICTURE_FORMAT_PNG;
+    }
+
+    /* GIF: "GIF87a" or "GIF89a". */
+    if (size > 6 && (memcmp (bytes, "GIF87a", 6) == 0
+                     || memcmp (bytes, "GIF89a", 6) == 0))
+    {
+        return PICTURE_FORMAT_GIF;
+    }
+
+    /* BMP: "BM", followed by the file size. */
+    if (size > 14 && (memcmp (bytes, "BM", 2) == 0))
+    {
+        return PICTURE_FORMAT_BMP;
+    }
+
+    /* WebP: "RIFF", the file size, then "WEBP". */
+    if (size > 12 && (memcmp (bytes, "RIFF", 4) == 0)
+        && (memcmp (bytes + 8, "WEBP", 4) == 0))
+    {
+        return PICTURE_FORMAT_WEBP;
+    }
+
+    return PICTURE_FORMAT_UNKNOWN;
+}
+
+/*
+ * Walk the JPEG markers until a start of frame, which holds the sample
+ * precision, the dimensions and the number of components.
+ */
+static gboolean
+probe_jpeg (const guchar *data,
+            gsize size,
+            EtPictureInfo *info)
+{
+    gsize pos = 2;
+
+    while (pos + 4 <= size)
+    {
+        guchar marker;
+        gsize length;
+
+        if (data[pos] != 0xff)
+        {
+            return FALSE;
+        }
+
+        /* Any number of fill bytes may precede a marker. */
+        while (pos < size && data[pos] == 0xff)
+        {
+            pos++;
+        }
+
+        if (pos >= size)
+        {
+            return FALSE;
+        }
+
+        marker = data[pos++];
+
+        /* Standalone markers, without a length. */
+        if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd8))
+        {
+            continue;
+        }
+
+        /* End of image or start of scan before a frame header. */
+        if (marker == 0xd9 || marker == 0xda || pos + 2 > size)
+        {
+            return FALSE;
+        }
+
+        length = read_be16 (data + pos);
+
+        if (length < 2)
+        {
+            return FALSE;
+        }
+
+        /* SOF0 to SOF15, except DHT (0xc4), JPG (0xc8) and DAC (0xcc). */
+        if (marker >= 0xc0 && marker <= 0xcf && marker != 0xc4
+            && marker != 0xc8 && marker != 0xcc)
+        {
+            if (length < 8 || pos + 8 > size)
+            {
+                return FALSE;
+            }
+
+            info->height = read_be16 (data + pos + 3);
+            info->width = read_be16 (data + pos + 5);
+            info->depth = data[pos + 2] * data[pos + 7];
+            info->colors = 0;
+
+            return info->width > 0 && info->height > 0;
+        }
+
+        pos += length;
+    }
+
+    return FALSE;
+}
+
+/*
+ * The IHDR chunk always comes first, but the size of an indexed image's
+ * palette is only known from the PLTE chunk, which precedes the image data.
+ */
+static gboolean
+probe_png (const guchar *data,
+           gsize size,
+           EtPictureInfo *info)
+{
+    guint bit_depth;
+    guint channels;
+    gsize pos;
+
+    if (size < 8 + 8 + 13 || memcmp (data + 12, "IHDR", 4) != 0)
+    {
+        return FALSE;
+    }
+
+    info->width = read_be32 (data + 16);
+    info->height = read_be32 (data + 20);
+    bit_depth = data[24];
+    info->colors = 0;
+
+    switch (data[25])
+    {
+        case 0: /* Greyscale. */
+        case 3: /* Indexed. */
+            channels = 1;
+            break;
+        case 2: /* RGB. */
+            channels = 3;
+            break;
+        case 4: /* Greyscale and alpha. */
+            channels = 2;
+            break;
+        case 6: /* RGBA. */
+            channels = 4;
+            break;
+        default:
+            return FALSE;
+    }
+
+    info->depth = bit_depth * channels;
+
+    if (data[25] == 3)
+    {
+        pos = 8;
+
+        while (pos + 8 <= size)
+        {
+            guint32 length = read_be32 (data + pos);
+
+            if (memcmp (data + pos + 4, "PLTE", 4) == 0)
+            {
+                info->colors = length / 3;
+                break;
+            }
+            else if (memcmp (data + pos + 4, "IDAT", 4) == 0)
+            {
+                break;
+            }
+
+            /* Length, type, data and CRC. */
+            if (size - pos < 12 || length > size - pos - 12)
+            {
+                break;
+            }
+
+            pos += 12 + length;
+        }
+    }
+
+    return info->width > 0 && info->height > 0;
+}
+
+/*
+ * The logical screen descriptor follows the signature, and gives the size of
+ * the global colour table, if there is one.
+ */
+static gboolean
+probe_gif (const guchar *data,
+           gsize size,
+           EtPictureInfo *info)
+{
+    guchar flags;
+
+    if (size < 13)
+    {
+        return FALSE;
+    }
+
+    info->width = read_le16 (data + 6);
+    info->height = read_le16 (data + 8);
+    flags = data[10];
+    info->depth = (flags & 0x07) + 1;
+    info->colors = (flags & 0x80) ? 1 << info->depth : 0;
+
+    return info->width > 0 && info->height > 0;
+}
+
+/*
+ * After the file header comes a DIB header, which is either the old OS/2
+ * BITMAPCOREHEADER with 16-bit dimensions, or a BITMAPINFOHEADER (or one of
+ * its extensions) with signed 32-bit dimensions. A negative height means that
+ * the rows are stored top-down.
+ */
+static gboolean
+probe_bmp (const guchar *data,
+           gsize size,
+           EtPictureInfo *info)
+{
+    guint32 header_size;
+
+    if (size < 14 + 12)
+    {
+        return FALSE;
+    }
+
+    header_size = read_le32 (data + 14);
+
+    if (header_size == 12)
+    {
+        info->width = read_le16 (data + 18);
+        info->height = read_le16 (data + 20);
+        info->depth = read_le16 (data + 24);
+        info->colors = info->depth <= 8 ? 1 << info->depth : 0;
+    }
+    else if (header_size >= 40 && size >= 14 + 40)
+    {
+        gint32 height;
+        guint32 colors_used;
+
+        info->width = read_le32 (data + 18);
+        height = (gint32)read_le32 (data + 22);
+        info->height = height < 0 ? -(gint64)height : height;
+        info->depth = read_le16 (data + 28);
+        colors_used = read_le32 (data + 46);
+
+        if (info->depth <= 8)
+        {
+            info->colors = colors_used ? colors_used : 1U << info->depth;
+        }
+        else
+        {
+            info->colors = 0;
+        }
+    }
+    else
+    {
+        return FALSE;
+    }
+
+    return info->width > 0 && info->height > 0;
+}
+
+/*
+ * The first chunk of a WebP file is either a lossy VP8 key frame, a lossless
+ * VP8L bitstream, or the extended VP8X header with the canvas size.
+ */
+static gboolean
+probe_webp (const guchar *data,
+            gsize size,
+            EtPictureInfo *info)
+{
+    const guchar *chunk;
+
+    /* The header of the first chunk. */
+    if (size < 12 + 8)
+    {
+        return FALSE;
+    }
+
+    chunk = data + 12;
+    size -= 12;
+    info->colors = 0;
+
+    if (memcmp (chunk, "VP8 ", 4) == 0)
+    {
+        /* A 3 byte frame tag, then the key frame start code. */
+        if (size < 8 + 10 || memcmp (chunk + 11, "\x9d\x01\x2a", 3) != 0)
+        {
+            return FALSE;
+        }
+
+        info->width = read_le16 (chunk + 14) & 0x3fff;
+        info->height = read_le16 (chunk + 16) & 0x3fff;
+        info->depth = 24;
+    }
+    else if (memcmp (chunk, "VP8L", 4) == 0)
+    {
+        guint32 bits;
+
+        if (size < 8 + 5 || chunk[8] != 0x2f)
+        {
+            return FALSE;
+        }
+
+        bits = read_le32 (chunk + 9);
+        info->width = (bits & 0x3fff) + 1;
+        info->height = ((bits >> 14) & 0x3fff) + 1;
+        info->depth = (bits & (1 << 28)) ? 32 : 24;
+    }
+    else if (memcmp (chunk, "VP8X", 4) == 0)
+    {
+        if (size < 8 + 10)
+        {
+            return FALSE;
+        }
+
+        info->width = read_le24 (chunk + 12) + 1;
+        info->height = read_le24 (chunk + 15) + 1;
+        /* Alpha flag. */
+        info->depth = (chunk[8] & 0x10) ? 32 : 24;
+    }
+    else
+    {
+        return FALSE;
+    }
+
+    return info->width > 0 && info->height > 0;
+}
+
+/*
+ * et_picture_probe:
+ * @data: image data
+ * @size: size of @data, in bytes
+ * @info: return location for the properties of the image
+ *
+ * Find the format, dimensions and colour depth of an image by parsing its
+ * header. @info->format is set even if the header could not be parsed.
+ *
+ * Returns: %TRUE if the dimensions of the image were found, %FALSE otherwise
+ */
+gboolean
+et_picture_probe (gconstpointer data,
+                  gsize size,
+                  EtPictureInfo *info)
+{
+    gboolean result;
+
+    g_return_val_if_fail (data != NULL || size == 0, FALSE);
+    g_return_val_if_fail (info != NULL, FALSE);
+
+    info->format = et_picture_probe_format (data, size);
+
+    switch (info->format)
+    {
+        case PICTURE_FORMAT_JPEG:
+            result = probe_jpeg (data, size, info);
+            break;
+        case PICTURE_FORMAT_PNG:
+            result = probe_png (data, size, info);
+            break;
+        case PICTURE_FORMAT_GIF:
+            result = probe_gif (data, size, info);
+            break;
+        case PICTURE_FORMAT_BMP:
+            result = probe_bmp (data, size, info);
+            break;
+        case PICTURE_FORMAT_WEBP:
+            result = probe_webp (data, size, info);
+            break;
+        case PICTURE_FORMAT_UNKNOWN:
+        default:
+            result = FALSE;
+            break;
+    }
+
+    if (!result)
+    {
+        info->width = 0;
+        info->height = 0;
+        info->depth = 0;
+        info->colors = 0;
+    }
+
+    return result;
+}
@@ -0,0 +1,53 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ET_PICTURE_PROBE_H_
+#define ET_PICTURE_PROBE_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#include "picture.h"
+
+/*
+ * EtPictureInfo:
+ * @format: format of the image
+ * @width: width in pixels
+ * @height: height in pixels
+ * @depth: colour depth in bits per pixel
+ * @colors: number of colours in the palette, or 0 for non-indexed images
+ *
+ * Properties of an image which are stored in its header. The fields follow
+ * the FLAC PICTURE metadata block.
+ */
+typedef struct
+{
+    Picture_Format format;
+    guint width;
+    guint height;
+    guint depth;
+    guint colors;
+} EtPictureInfo;
+
+Picture_Format et_picture_probe_format (gconstpointer data, gsize size);
+gboolean et_picture_probe (gconstpointer data, gsize size, EtPictureInfo *info);
+
+G_END_DECLS
+
+#endif /* !ET_PICTURE_PROBE_H_ */
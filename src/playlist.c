@@ -0,0 +1,547 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "playlist.h"
+
+#include <string.h>
+
+/* Size of the buffer, above which the entries are written to the file. */
+#define ET_PLAYLIST_BUFFER_SIZE (64 * 1024)
+
+/*
+ * EtPlaylistWriter:
+ * @format: the format of the playlist
+ * @content: what is written for each entry
+ * @dos_separator: whether to write paths with backslashes
+ * @filename_is_utf8: whether filenames are encoded in UTF-8, so that they can
+ *                    be written to the UTF-8 formats without conversion
+ * @prefix: the directory of the files to write with a relative path, ending
+ *          with a separator, or %NULL to write full paths
+ * @prefix_len: the length of @prefix
+ * @stream: the playlist file
+ * @buffer: the entries which were not written to @stream yet
+ * @n_entries: the number of entries which were added
+ */
+struct _EtPlaylistWriter
+{
+    EtPlaylistFormat format;
+    EtPlaylistContent content;
+    gboolean dos_separator;
+    gboolean filename_is_utf8;
+    gchar *prefix;
+    gsize prefix_len;
+    GOutputStream *stream;
+    GString *buffer;
+    guint n_entries;
+};
+
+/*
+ * et_playlist_format_get_extension:
+ * @format: a playlist format
+ *
+ * Returns: the extension of playlist files in @format, with the leading dot
+ */
+const gchar *
+et_playlist_format_get_extension (EtPlaylistFormat format)
+{
+    switch (format)
+    {
+        case ET_PLAYLIST_FORMAT_M3U:
+            return ".m3u";
+        case ET_PLAYLIST_FORMAT_M3U8:
+            return ".m3u8";
+        case ET_PLAYLIST_FORMAT_PLS:
+            return ".pls";
+        case ET_PLAYLIST_FORMAT_XSPF:
+            return ".xspf";
+        default:
+            g_return_val_if_reached (".m3u");
+    }
+}
+
+static gboolean
+et_playlist_writer_flush (EtPlaylistWriter *writer,
+                          GError **error)
+{
+    gsize bytes_written;
+
+    if (!g_output_stream_write_all (writer->stream, writer->buffer->str,
+                                    writer->buffer->len, &bytes_written,
+                                    NULL, error))
+    {
+        g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %" G_GSIZE_FORMAT
+                 " bytes of data were written", bytes_written,
+                 writer->buffer->len);
+        g_assert (error == NULL || *error != NULL);
+        return FALSE;
+    }
+
+    g_string_truncate (writer->buffer, 0);
+
+    return TRUE;
+}
+
+/*
+ * Append a path, as it is in the file system encoding, replacing the
+ * separators if needed.
+ */
+static void
+append_path (EtPlaylistWriter *writer,
+             const gchar *path)
+{
+    if (writer->dos_separator)
+    {
+        const gchar *p;
+
+        for (p = path; *p != '\0'; p++)
+        {
+            g_string_append_c (writer->buffer, *p == '/' ? '\\' : *p);
+        }
+    }
+    else
+    {
+        g_string_append (writer->buffer, path);
+    }
+}
+
+/*
+ * Append a path or a file name for the UTF-8 formats, which is only
+ * converted if it is not already valid UTF-8.
+ */
+static void
+append_utf8_path (EtPlaylistWriter *writer,
+                  const gchar *path)
+{
+    gchar *path_utf8;
+
+    if (writer->filename_is_utf8 && g_utf8_validate (path, -1, NULL))
+    {
+        append_path (writer, path);
+        return;
+    }
+
+    path_utf8 = g_filename_display_name (path);
+    append_path (writer, path_utf8);
+    g_free (path_utf8);
+}
+
+/*
+ * Append the title of an entry of an M3U playlist, which is in the file
+ * system encoding, like the paths.
+ */
+static void
+append_locale_title (EtPlaylistWriter *writer,
+                     const gchar *title)
+{
+    gchar *title_locale;
+
+    if (writer->filename_is_utf8)
+    {
+        g_string_append (writer->buffer, title);
+        return;
+    }
+
+    title_locale = g_filename_from_utf8 (title, -1, NULL, NULL, NULL);
+
+    if (title_locale)
+    {
+        g_string_append (writer->buffer, title_locale);
+        g_free (title_locale);
+    }
+    else
+    {
+        g_string_append (writer->buffer, title);
+    }
+}
+
+static void
+append_markup_escaped (GString *buffer,
+                       const gchar *text)
+{
+    const gchar *p;
+
+    for (p = text; *p != '\0'; p++)
+    {
+        switch (*p)
+        {
+            case '&':
+                g_string_append (buffer, "&amp;");
+                break;
+            case '<':
+                g_string_append (buffer, "&lt;");
+                break;
+            case '>':
+                g_string_append (buffer, "&gt;");
+                break;
+            case '"':
+                g_string_append (buffer, "&quot;");
+                break;
+            default:
+                g_string_append_c (buffer, *p);
+                break;
+        }
+    }
+}
+
+/*
+ * Append a path as a URI reference, escaping the raw bytes of the path, so
+ * that it needs no conversion whatever its encoding.
+ */
+static void
+append_uri_escaped (GString *buffer,
+                    const gchar *path)
+{
+    static const gchar hex[] = "0123456789ABCDEF";
+    const guchar *p;
+
+    for (p = (const guchar *)path; *p != '\0'; p++)
+    {
+        if (g_ascii_isalnum (*p) || strchr ("-._~/", *p) != NULL)
+        {
+            g_string_append_c (buffer, *p);
+        }
+        else
+        {
+            g_string_append_c (buffer, '%');
+            g_string_append_c (buffer, hex[*p >> 4]);
+            g_string_append_c (buffer, hex[*p & 0xf]);
+        }
+    }
+}
+
+/*
+ * et_playlist_writer_new:
+ * @file: the playlist file to create, or replace
+ * @format: the format of the playlist
+ * @content: what to write for each entry, besides its path
+ * @basedir: (allow-none): the directory of the files to write with a path
+ *           relative to it, in the file system encoding, or %NULL to write
+ *           full paths
+ * @dos_separator: whether to use backslashes as directory separators
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Start writing a playlist. If @basedir is not %NULL, files which are not
+ * below it are skipped, as they cannot be given a relative path.
+ *
+ * Returns: a new writer, to free with et_playlist_writer_free(), or %NULL
+ * if @file could not be created
+ */
+EtPlaylistWriter *
+et_playlist_writer_new (GFile *file,
+                        EtPlaylistFormat format,
+                        EtPlaylistContent content,
+                        const gchar *basedir,
+                        gboolean dos_separator,
+                        GError **error)
+{
+    EtPlaylistWriter *writer;
+    GFileOutputStream *ostream;
+
+    g_return_val_if_fail (G_IS_FILE (file), NULL);
+    g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+    ostream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL,
+                              error);
+
+    if (!ostream)
+    {
+        g_assert (error == NULL || *error != NULL);
+        return NULL;
+    }
+
+    writer = g_slice_new0 (EtPlaylistWriter);
+    writer->format = format;
+    writer->content = content;
+    /* XSPF locations are URIs, which always use forward slashes. */
+    writer->dos_separator = dos_separator
+                            && format != ET_PLAYLIST_FORMAT_XSPF;
+    writer->filename_is_utf8 = g_get_filename_charsets (NULL);
+    writer->stream = G_OUTPUT_STREAM (ostream);
+    writer->buffer = g_string_sized_new (ET_PLAYLIST_BUFFER_SIZE);
+
+    /* The prefix to strip is computed once, rather than for each file. */
+    if (basedir)
+    {
+        writer->prefix = g_str_has_suffix (basedir, G_DIR_SEPARATOR_S)
+                         ? g_strdup (basedir)
+                         : g_strconcat (basedir, G_DIR_SEPARATOR_S, NULL);
+        writer->prefix_len = strlen (writer->prefix);
+    }
+
+    switch (format)
+    {
+        case ET_PLAYLIST_FORMAT_M3U:
+        case ET_PLAYLIST_FORMAT_M3U8:
+            if (content != ET_PLAYLIST_CONTENT_FILENAMES)
+            {
+                g_string_append (writer->buffer, "#EXTM3U\r\n");
+            }
+            break;
+        case ET_PLAYLIST_FORMAT_PLS:
+            g_string_append (writer->buffer, "[playlist]\r\n");
+            break;
+        case ET_PLAYLIST_FORMAT_XSPF:
+            g_string_append (writer->buffer,
+                             "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                             "<playlist version=\"1\" xmlns=\"http://xspf.org/ns/0/\">\n"
+                             "  <trackList>\n");
+            break;
+        default:
+            g_assert_not_reached ();
+            break;
+    }
+
+    return writer;
+}
+
+/*
+ * et_playlist_writer_add:
+ * @writer: the playlist writer
+ * @filename: the full path of the file, in the file system encoding
+ * @duration: the duration of the file, in seconds
+ * @title: (allow-none): the title of the entry, in UTF-8, or %NULL to use
+ *         the name of the file
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Add an entry to the playlist. Nothing is copied to add it, except into
+ * the buffer of @writer, and the file name is only converted if the format
+ * requires another encoding.
+ *
+ * Returns: %TRUE if the entry was added or skipped, %FALSE if the buffer
+ * could not be written to the playlist file
+ */
+gboolean
+et_playlist_writer_add (EtPlaylistWriter *writer,
+                        const gchar *filename,
+                        gint duration,
+                        const gchar *title,
+                        GError **error)
+{
+    GString *buffer;
+    const gchar *path;
+    const gchar *basename = NULL;
+    gboolean extended;
+
+    g_return_val_if_fail (writer != NULL, FALSE);
+    g_return_val_if_fail (filename != NULL, FALSE);
+    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+    buffer = writer->buffer;
+
+    if (writer->prefix)
+    {
+        /* Keep only files in this directory and sub-directories. */
+        if (strncmp (filename, writer->prefix, writer->prefix_len) != 0)
+        {
+            return TRUE;
+        }
+
+        path = filename + writer->prefix_len;
+    }
+    else
+    {
+        path = filename;
+    }
+
+    extended = writer->content != ET_PLAYLIST_CONTENT_FILENAMES;
+
+    if (extended && title == NULL)
+    {
+        basename = strrchr (filename, G_DIR_SEPARATOR);
+        basename = basename ? basename + 1 : filename;
+    }
+
+    writer->n_entries++;
+
+    switch (writer->format)
+    {
+        case ET_PLAYLIST_FORMAT_M3U:
+            if (extended)
+            {
+                g_string_append_printf (buffer, "#EXTINF:%d,", duration);
+
+                if (title)
+                {
+                    append_locale_title (writer, title);
+                }
+                else
+                {
+                    g_string_append (buffer, basename);
+                }
+
+                g_string_append (buffer, "\r\n");
+            }
+
+            append_path (writer, path);
+            g_string_append (buffer, "\r\n");
+            break;
+        case ET_PLAYLIST_FORMAT_M3U8:
+            if (extended)
+            {
+                g_string_append_printf (buffer, "#EXTINF:%d,", duration);
+
+                if (title)
+                {
+                    g_string_append (buffer, title);
+                }
+                else
+                {
+                    append_utf8_path (writer, basename);
+                }
+
+                g_string_append (buffer, "\r\n");
+            }
+
+            append_utf8_path (writer, path);
+            g_string_append (buffer, "\r\n");
+            break;
+        case ET_PLAYLIST_FORMAT_PLS:
+            g_string_append_printf (buffer, "File%u=", writer->n_entries);
+            append_utf8_path (writer, path);
+            g_string_append (buffer, "\r\n");
+
+            if (extended)
+            {
+                g_string_append_printf (buffer, "Title%u=",
+                                        writer->n_entries);
+
+                if (title)
+                {
+                    g_string_append (buffer, title);
+                }
+                else
+                {
+                    append_utf8_path (writer, basename);
+                }
+
+                g_string_append_printf (buffer, "\r\nLength%u=%d\r\n",
+                                        writer->n_entries, duration);
+            }
+            break;
+        case ET_PLAYLIST_FORMAT_XSPF:
+            g_string_append (buffer, "    <track>\n      <location>");
+
+            if (!writer->prefix)
+            {
+                g_string_append (buffer, "file://");
+            }
+
+            append_uri_escaped (buffer, path);
+            g_string_append (buffer, "</location>\n");
+
+            if (extended)
+            {
+                g_string_append (buffer, "      <title>");
+
+                if (title)
+                {
+                    append_markup_escaped (buffer, title);
+                }
+                else
+                {
+                    gchar *basename_utf8;
+
+                    basename_utf8 = g_filename_display_name (basename);
+                    append_markup_escaped (buffer, basename_utf8);
+                    g_free (basename_utf8);
+                }
+
+                g_string_append_printf (buffer,
+                                        "</title>\n"
+                                        "      <duration>%" G_GINT64_FORMAT
+                                        "</duration>\n",
+                                        (gint64)duration * 1000);
+            }
+
+            g_string_append (buffer, "    </track>\n");
+            break;
+        default:
+            g_assert_not_reached ();
+            break;
+    }
+
+    if (buffer->len >= ET_PLAYLIST_BUFFER_SIZE)
+    {
+        return et_playlist_writer_flush (writer, error);
+    }
+
+    return TRUE;
+}
+
+/*
+ * et_playlist_writer_close:
+ * @writer: the playlist writer
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Finish the playlist, and write what remains in the buffer to the playlist
+ * file, which is then closed. @writer must still be freed.
+ *
+ * Returns: %TRUE if the playlist was written, %FALSE otherwise
+ */
+gboolean
+et_playlist_writer_close (EtPlaylistWriter *writer,
+                          GError **error)
+{
+    g_return_val_if_fail (writer != NULL, FALSE);
+    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+    switch (writer->format)
+    {
+        case ET_PLAYLIST_FORMAT_M3U:
+        case ET_PLAYLIST_FORMAT_M3U8:
+            break;
+        case ET_PLAYLIST_FORMAT_PLS:
+            g_string_append_printf (writer->buffer,
+                                    "NumberOfEntries=%u\r\nVersion=2\r\n",
+                                    writer->n_entries);
+            break;
+        case ET_PLAYLIST_FORMAT_XSPF:
+            g_string_append (writer->buffer, "  </trackList>\n</playlist>\n");
+            break;
+        default:
+            g_assert_not_reached ();
+            break;
+    }
+
+    if (!et_playlist_writer_flush (writer, error))
+    {
+        return FALSE;
+    }
+
+    return g_output_stream_close (writer->stream, NULL, error);
+}
+
+/*
+ * et_playlist_writer_free:
+ * @writer: the playlist writer
+ *
+ * Free @writer. If et_playlist_writer_close() was not called, the playlist
+ * file is closed without finishing it.
+ */
+void
+et_playlist_writer_free (EtPlaylistWriter *writer)
+{
+    g_return_if_fail (writer != NULL);
+
+    g_object_unref (writer->stream);
+    g_string_free (writer->buffer, TRUE);
+    g_free (writer->prefix);
+    g_slice_free (EtPlaylistWriter, writer);
+}
@@ -0,0 +1,45 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ET_PLAYLIST_H_
+#define ET_PLAYLIST_H_
+
+#include <gio/gio.h>
+
+#include "setting.h"
+
+G_BEGIN_DECLS
+
+/*
+ * EtPlaylistWriter:
+ *
+ * Writes the entries of a playlist file in one of the #EtPlaylistFormat
+ * formats, collecting them in a buffer which is written out in large blocks.
+ */
+typedef struct _EtPlaylistWriter EtPlaylistWriter;
+
+EtPlaylistWriter * et_playlist_writer_new (GFile *file, EtPlaylistFormat format, EtPlaylistContent content, const gchar *basedir, gboolean dos_separator, GError **error);
+gboolean et_playlist_writer_add (EtPlaylistWriter *writer, const gchar *filename, gint duration, const gchar *title, GError **error);
+gboolean et_playlist_writer_close (EtPlaylistWriter *writer, GError **error);
+void et_playlist_writer_free (EtPlaylistWriter *writer);
+
+const gchar * et_playlist_format_get_extension (EtPlaylistFormat format);
+
+G_END_DECLS
+
+#endif /* !ET_PLAYLIST_H_ */
@@ -26,8 +26,10 @@
 #include "browser.h"
 #include "charset.h"
 #include "easytag.h"
+#include "enums.h"
 #include "misc.h"
 #include "picture.h"
+#include "playlist.h"
 #include "scan.h"
 #include "scan_dialog.h"
 #include "setting.h"
@@ -36,8 +38,10 @@ typedef struct
 {
     GtkWidget *name_mask_radio;
     GtkWidget *name_mask_entry;
+    GtkWidget *format_combo;
     GtkWidget *selected_files_check;
     GtkWidget *path_relative_radio;
+    GtkWidget *per_directory_check;
     GtkWidget *playlist_parent_check;
     GtkWidget *playlist_dos_check;
     GtkWidget *content_filenames_radio;
@@ -48,369 +52,104 @@ typedef struct
 
 G_DEFINE_TYPE_WITH_PRIVATE (EtPlaylistDialog, et_playlist_dialog, GTK_TYPE_DIALOG)
 
-/*
- * Function to replace UNIX ForwardSlash with a DOS BackSlash
- */
-static void
-convert_forwardslash_to_backslash (const gchar *string)
-{
-    gchar *tmp;
-
-    while ((tmp = strchr (string,'/')) != NULL)
-    {
-        *tmp = '\\';
-    }
-}
-
 /*
  * Write a playlist
- *  - 'playlist_name' in file system encoding (not UTF-8)
+ *  - 'file' is the playlist file, which is replaced
+ *  - 'mask' is the compiled content mask, shared by all the playlists written
+ *    at once, or NULL if the entries are not generated from a mask
  */
 static gboolean
-write_playlist (EtPlaylistDialog *self, GFile *file, GError **error)
+write_playlist (GFile *file,
+                GList *etfilelist,
+                const EtScanRenameMask *mask,
+                GError **error)
 {
-    EtPlaylistDialogPrivate *priv;
-    GFile *parent;
-    GFileOutputStream *ostream;
-    GString *to_write;
+    EtPlaylistWriter *writer;
+    gchar *basedir = NULL;
     GList *l;
-    GList *etfilelist = NULL;
-    gchar *basedir;
-    gchar *temp;
-    EtPlaylistContent playlist_content;
+    gboolean success;
 
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-    priv = et_playlist_dialog_get_instance_private (self);
-
-    ostream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, error);
-
-    if (!ostream)
-    {
-        g_assert (error == NULL || *error != NULL);
-        return FALSE;
-    }
-
     /* 'base directory' where is located the playlist. Used also to write file with a
      * relative path for file located in this directory and sub-directories
      */
-    parent = g_file_get_parent (file);
-    basedir = g_file_get_path (parent);
-    g_object_unref (parent);
-
-    playlist_content = g_settings_get_enum (MainSettings, "playlist-content");
-
-    /* 1) First line of the file (if playlist content is not set to "write only
-     * list of files") */
-    if (playlist_content != ET_PLAYLIST_CONTENT_FILENAMES)
+    if (g_settings_get_boolean (MainSettings, "playlist-relative"))
     {
-        gsize bytes_written;
-
-        to_write = g_string_new ("#EXTM3U\r\n");
+        GFile *parent = g_file_get_parent (file);
 
-        if (!g_output_stream_write_all (G_OUTPUT_STREAM (ostream),
-                                        to_write->str, to_write->len,
-                                        &bytes_written, NULL, error))
-        {
-            g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %" G_GSIZE_FORMAT
-                     "bytes of data were written", bytes_written,
-                     to_write->len);
-            g_assert (error == NULL || *error != NULL);
-            g_string_free (to_write, TRUE);
-            g_object_unref (ostream);
-            return FALSE;
-        }
-        g_string_free (to_write, TRUE);
+        basedir = g_file_get_path (parent);
+        g_object_unref (parent);
     }
 
-    if (g_settings_get_boolean (MainSettings, "playlist-selected-only"))
+    writer = et_playlist_writer_new (file,
+                                     g_settings_get_enum (MainSettings,
+                                                          "playlist-format"),
+                                     g_settings_get_enum (MainSettings,
+                                                          "playlist-content"),
+                                     basedir,
+                                     g_settings_get_boolean (MainSettings,
+                                                             "playlist-dos-separator"),
+                                     error);
+    g_free (basedir);
+
+    if (!writer)
     {
-        etfilelist = et_application_window_browser_get_selected_files (ET_APPLICATION_WINDOW (MainWindow));
-    }
-    else
-    {
-        etfilelist = ETCore->ETFileList;
+        g_assert (error == NULL || *error != NULL);
+        return FALSE;
     }
 
-    for (l = etfilelist; l != NULL; l = g_list_next (l))
+    success = TRUE;
+
+    for (l = etfilelist; l != NULL && success; l = g_list_next (l))
     {
         const ET_File *etfile;
-        const gchar *filename;
-        gint duration;
+        gchar *title = NULL;
 
         etfile = (ET_File *)l->data;
-        filename = ((File_Name *)etfile->FileNameCur->data)->value;
-        duration = ((ET_File_Info *)etfile->ETFileInfo)->duration;
 
-        if (g_settings_get_boolean (MainSettings, "playlist-relative"))
+        if (mask)
         {
-            // Keep only files in this directory and sub-dirs
-            if ( strncmp(filename,basedir,strlen(basedir))==0 )
-            {
-                gsize bytes_written;
-
-                /* 2) Write the header. */
-                switch (playlist_content)
-                {
-                    case ET_PLAYLIST_CONTENT_FILENAMES:
-                        /* No header written. */
-                        break;
-                    case ET_PLAYLIST_CONTENT_EXTENDED:
-                        /* Header has extended information. */
-                        temp = g_path_get_basename (filename);
-                        to_write = g_string_new ("#EXTINF:");
-                        /* Must be written in system encoding (not UTF-8). */
-                        g_string_append_printf (to_write, "%d,%s\r\n", duration,
-                                                temp);
-
-                        if (!g_output_stream_write_all (G_OUTPUT_STREAM (ostream),
-                                                        to_write->str,
-                                                        to_write->len,
-                                                        &bytes_written, NULL,
-                                                        error))
-                        {
-                            g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %"
-                                     G_GSIZE_FORMAT "bytes of data were written",
-                                     bytes_written, to_write->len);
-                            g_assert (error == NULL || *error != NULL);
-                            g_string_free (to_write, TRUE);
-                            g_object_unref (ostream);
-                            return FALSE;
-                        }
-                        g_string_free (to_write, TRUE);
-                        g_free (temp);
-                        break;
-                    case ET_PLAYLIST_CONTENT_EXTENDED_MASK:
-                    {
-                        /* Header uses information generated from a mask. */
-                        gchar *mask = filename_from_display (gtk_entry_get_text (GTK_ENTRY (priv->content_mask_entry)));
-                        /* Special case: do not replace illegal characters and
-                         * do not check if there is a directory separator in
-                         * the mask. */
-                        gchar *filename_generated_utf8 = et_scan_generate_new_filename_from_mask (etfile, mask, TRUE);
-                        gchar *filename_generated = filename_from_display (filename_generated_utf8);
-
-                        to_write = g_string_new ("#EXTINF:");
-                        /* Must be written in system encoding (not UTF-8). */
-                        g_string_append_printf (to_write, "%d,%s\r\n", duration,
-                                                filename_generated);
-
-                        if (!g_output_stream_write_all (G_OUTPUT_STREAM (ostream),
-                                                        to_write->str,
-                                                        to_write->len,
-                                                        &bytes_written, NULL,
-                                                        error))
-                        {
-                            g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %"
-                                     G_GSIZE_FORMAT "bytes of data were written",
-                                     bytes_written, to_write->len);
-                            g_assert (error == NULL || *error != NULL);
-                            g_string_free (to_write, TRUE);
-                            g_object_unref (ostream);
-                            return FALSE;
-                        }
-                        g_string_free (to_write, TRUE);
-                        g_free (mask);
-                        g_free (filename_generated_utf8);
-
-                        break;
-                    }
-                    default:
-                        g_assert_not_reached ();
-                        break;
-                }
-
-                /* 3) Write the file path. */
-                if (g_settings_get_boolean (MainSettings,
-                                            "playlist-dos-separator"))
-                {
-                    gchar *filename_conv = g_strdup(filename+strlen(basedir)+1);
-                    convert_forwardslash_to_backslash (filename_conv);
-
-                    to_write = g_string_new (filename_conv);
-                    /* Must be written in system encoding (not UTF-8)*/
-                    to_write = g_string_append (to_write, "\r\n");
-
-                    if (!g_output_stream_write_all (G_OUTPUT_STREAM (ostream),
-                                                    to_write->str,
-                                                    to_write->len,
-                                                    &bytes_written, NULL,
-                                                    error))
-                    {
-                        g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %"
-                                 G_GSIZE_FORMAT "bytes of data were written",
-                                 bytes_written, to_write->len);
-                        g_assert (error == NULL || *error != NULL);
-                        g_string_free (to_write, TRUE);
-                        g_object_unref (ostream);
-                        return FALSE;
-                    }
-                    g_string_free (to_write, TRUE);
-                    g_free(filename_conv);
-                }else
-                {
-                    to_write = g_string_new (filename+strlen(basedir)+1);
-                    /* Must be written in system encoding (not UTF-8)*/
-                    to_write = g_string_append (to_write, "\r\n");
-
-                    if (!g_output_stream_write_all (G_OUTPUT_STREAM (ostream),
-                                                    to_write->str,
-                                                    to_write->len,
-                                                    &bytes_written, NULL,
-                                                    error))
-                    {
-                        g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %"
-                                 G_GSIZE_FORMAT "bytes of data were written",
-                                 bytes_written, to_write->len);
-                        g_assert (error == NULL || *error != NULL);
-                        g_string_free (to_write, TRUE);
-                        g_object_unref (ostream);
-                        return FALSE;
-                    }
-                    g_string_free (to_write, TRUE);
-                }
-            }
+            /* Header uses information generated from a mask. */
+            title = et_scan_rename_mask_apply (mask, etfile);
         }
-        else /* !ETSettings:playlist-relative */
-        {
-            gsize bytes_written;
 
-            /* 2) Write the header. */
-            switch (playlist_content)
-            {
-                case ET_PLAYLIST_CONTENT_FILENAMES:
-                    /* No header written. */
-                    break;
-                case ET_PLAYLIST_CONTENT_EXTENDED:
-                    /* Header has extended information. */
-                    temp = g_path_get_basename (filename);
-                    to_write = g_string_new ("#EXTINF:");
-                    /* Must be written in system encoding (not UTF-8). */
-                    g_string_append_printf (to_write, "%d,%s\r\n", duration,
-                                            temp);
-                    g_free (temp);
-
-                    if (!g_output_stream_write_all (G_OUTPUT_STREAM (ostream),
-                                                    to_write->str, to_write->len,
-                                                    &bytes_written, NULL, error))
-                    {
-                        g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %"
-                                 G_GSIZE_FORMAT" bytes of data were written",
-                                 bytes_written, to_write->len);
-                        g_assert (error == NULL || *error != NULL);
-                        g_string_free (to_write, TRUE);
-                        g_object_unref (ostream);
-                        return FALSE;
-                    }
-                    g_string_free (to_write, TRUE);
-                    break;
-                case ET_PLAYLIST_CONTENT_EXTENDED_MASK:
-                {
-                    /* Header uses information generated from a mask. */
-                    gchar *mask = filename_from_display (gtk_entry_get_text (GTK_ENTRY (priv->content_mask_entry)));
-                    /* Special case: do not replace illegal characters and
-                     * do not check if there is a directory separator in
-                     * the mask. */
-                    gchar *filename_generated_utf8 = et_scan_generate_new_filename_from_mask (etfile, mask, TRUE);
-                    gchar *filename_generated = filename_from_display (filename_generated_utf8);
-
-                    to_write = g_string_new ("#EXTINF:");
-                    /* Must be written in system encoding (not UTF-8). */
-                    g_string_append_printf (to_write, "%d,%s\r\n", duration,
-                                            filename_generated);
-                    g_free (filename_generated);
-
-                    if (!g_output_stream_write_all (G_OUTPUT_STREAM (ostream),
-                                                    to_write->str, to_write->len,
-                                                    &bytes_written, NULL, error))
-                    {
-                        g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %"
-                                 G_GSIZE_FORMAT" bytes of data were written",
-                                 bytes_written, to_write->len);
-                        g_assert (error == NULL || *error != NULL);
-                        g_string_free (to_write, TRUE);
-                        g_object_unref (ostream);
-                        return FALSE;
-                    }
-                    g_string_free (to_write, TRUE);
-                    g_free (mask);
-                    g_free (filename_generated_utf8);
-                }
-                break;
-                default:
-                    g_assert_not_reached ();
-                    break;
-            }
-
-            /* 3) Write the file path. */
-            if (g_settings_get_boolean (MainSettings,
-                                        "playlist-dos-separator"))
-            {
-                gchar *filename_conv = g_strdup(filename);
-                convert_forwardslash_to_backslash(filename_conv);
-
-                to_write = g_string_new (filename_conv);
-                /* Must be written in system encoding (not UTF-8)*/
-                to_write = g_string_append (to_write, "\r\n");
-
-                if (!g_output_stream_write_all (G_OUTPUT_STREAM (ostream),
-                                                to_write->str, to_write->len,
-                                                &bytes_written, NULL, error))
-                {
-                    g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %"
-                             G_GSIZE_FORMAT" bytes of data were written",
-                             bytes_written, to_write->len);
-                    g_assert (error == NULL || *error != NULL);
-                    g_string_free (to_write, TRUE);
-                    g_object_unref (ostream);
-                    return FALSE;
-                }
-                g_string_free (to_write, TRUE);
-                g_free(filename_conv);
-            }else
-            {
-                to_write = g_string_new (filename);
-                /* Must be written in system encoding (not UTF-8)*/
-                to_write = g_string_append (to_write, "\r\n");
-
-                if (!g_output_stream_write_all (G_OUTPUT_STREAM (ostream),
-                                                to_write->str, to_write->len,
-                                                &bytes_written, NULL, error))
-                {
-                    g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %"
-                             G_GSIZE_FORMAT" bytes of data were written",
-                             bytes_written, to_write->len);
-                    g_assert (error == NULL || *error != NULL);
-                    g_string_free (to_write, TRUE);
-                    g_object_unref (ostream);
-                    return FALSE;
-                }
-                g_string_free (to_write, TRUE);
-            }
-        }
+        success = et_playlist_writer_add (writer,
+                                          ((File_Name *)etfile->FileNameCur->data)->value,
+                                          ((ET_File_Info *)etfile->ETFileInfo)->duration,
+                                          title, error);
+        g_free (title);
     }
 
-    if (g_settings_get_boolean (MainSettings, "playlist-selected-only"))
+    if (success)
     {
-        g_list_free (etfilelist);
+        success = et_playlist_writer_close (writer, error);
     }
 
-    g_assert (error == NULL || *error == NULL);
-    g_object_unref (ostream);
-    g_free(basedir);
-    return TRUE;
+    et_playlist_writer_free (writer);
+
+    g_assert (success || error == NULL || *error != NULL);
+    return success;
 }
 
-static void
-write_button_clicked (EtPlaylistDialog *self)
+/*
+ * Build the name of the playlist to write for the files of a directory
+ *  - 'dir_path' in file system encoding (not UTF-8)
+ *  - 'etfile' is the file, from the directory, used to fill the name mask
+ */
+static GFile *
+get_playlist_file (EtPlaylistDialog *self,
+                   const gchar *dir_path,
+                   const ET_File *etfile)
 {
     EtPlaylistDialogPrivate *priv;
     gchar *playlist_name = NULL;
     gchar *playlist_path_utf8;      // Path
     gchar *playlist_basename_utf8;  // Filename
     gchar *playlist_name_utf8;      // Path + filename
+    const gchar *extension;
     gchar *temp;
-    GtkWidget *msgdialog;
+    GFile *file;
 
     priv = et_playlist_dialog_get_instance_private (self);
 
@@ -423,25 +162,20 @@ write_button_clicked (EtPlaylistDialog *self)
     }
 
     // Path of the playlist file (may be truncated later if PLAYLIST_CREATE_IN_PARENT_DIR is TRUE)
-    temp = g_file_get_path (et_application_window_get_current_path (ET_APPLICATION_WINDOW (MainWindow)));
-    playlist_path_utf8 = g_filename_display_name (temp);
-    g_free (temp);
+    playlist_path_utf8 = g_filename_display_name (dir_path);
 
     /* Build the playlist filename. */
     if (g_settings_get_boolean (MainSettings, "playlist-use-mask"))
     {
         EtConvertSpaces convert_mode;
 
-        if (!ETCore->ETFileList)
-            return;
-
         playlist_name = g_settings_get_string (MainSettings,
                                                "playlist-filename-mask");
 
-        /* Generate filename from tag of the current selected file (FIXME). */
+        /* Generate filename from tag of the file. */
         temp = filename_from_display (playlist_name);
         g_free (playlist_name);
-        playlist_basename_utf8 = et_scan_generate_new_filename_from_mask (ETCore->ETFileDisplayed,
+        playlist_basename_utf8 = et_scan_generate_new_filename_from_mask (etfile,
                                                                           temp,
                                                                           FALSE);
         g_free (temp);
@@ -505,50 +239,217 @@ write_button_clicked (EtPlaylistDialog *self)
         }
     }
 
+    extension = et_playlist_format_get_extension (g_settings_get_enum (MainSettings,
+                                                                       "playlist-format"));
+
     // Generate path + filename of playlist
     if (playlist_path_utf8[strlen(playlist_path_utf8)-1]==G_DIR_SEPARATOR)
-        playlist_name_utf8 = g_strconcat(playlist_path_utf8,playlist_basename_utf8,".m3u",NULL);
+        playlist_name_utf8 = g_strconcat(playlist_path_utf8,playlist_basename_utf8,extension,NULL);
     else
-        playlist_name_utf8 = g_strconcat(playlist_path_utf8,G_DIR_SEPARATOR_S,playlist_basename_utf8,".m3u",NULL);
+        playlist_name_utf8 = g_strconcat(playlist_path_utf8,G_DIR_SEPARATOR_S,playlist_basename_utf8,extension,NULL);
 
     g_free(playlist_path_utf8);
     g_free(playlist_basename_utf8);
 
     playlist_name = filename_from_display(playlist_name_utf8);
+    file = g_file_new_for_path (playlist_name);
+
+    g_free(playlist_name_utf8);
+    g_free(playlist_name);
+
+    return file;
+}
+
+static void
+show_write_error (EtPlaylistDialog *self,
+                  GFile *file,
+                  const GError *error)
+{
+    GtkWidget *msgdialog;
+    gchar *playlist_name_utf8;
+
+    playlist_name_utf8 = g_file_get_parse_name (file);
+
+    // Writing fails...
+    msgdialog = gtk_message_dialog_new (GTK_WINDOW (self),
+                                       GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                                       GTK_MESSAGE_ERROR,
+                                       GTK_BUTTONS_CLOSE,
+                                       _("Cannot write playlist file ‘%s’"),
+                                       playlist_name_utf8);
+    gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (msgdialog),
+                                              "%s", error->message);
+    gtk_window_set_title(GTK_WINDOW(msgdialog),_("Playlist File Error"));
+
+    gtk_dialog_run(GTK_DIALOG(msgdialog));
+    gtk_widget_destroy(msgdialog);
+    g_free (playlist_name_utf8);
+}
 
+/*
+ * Group the files by the directory which contains them, keeping the order of
+ * the files, and of the directories as they first appear.
+ *  - 'dirs' is filled with the directories, in file system encoding, which
+ *    are owned by the table
+ * Returns: the table of the files (a GQueue of ET_File) of each directory
+ */
+static GHashTable *
+group_files_by_directory (GList *etfilelist,
+                          GPtrArray *dirs)
+{
+    GHashTable *groups;
+    GList *l;
+
+    groups = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                    (GDestroyNotify)g_queue_free);
+
+    for (l = etfilelist; l != NULL; l = g_list_next (l))
     {
-        GFile *file = g_file_new_for_path (playlist_name);
+        const ET_File *etfile = l->data;
+        gchar *dir;
+        GQueue *files;
+
+        dir = g_path_get_dirname (((File_Name *)etfile->FileNameCur->data)->value);
+        files = g_hash_table_lookup (groups, dir);
+
+        if (files)
+        {
+            g_free (dir);
+        }
+        else
+        {
+            files = g_queue_new ();
+            g_ptr_array_add (dirs, dir);
+            g_hash_table_insert (groups, dir, files);
+        }
+
+        g_queue_push_tail (files, l->data);
+    }
+
+    return groups;
+}
+
+static void
+write_button_clicked (EtPlaylistDialog *self)
+{
+    EtPlaylistDialogPrivate *priv;
+    GList *etfilelist;
+    EtScanRenameMask *mask = NULL;
+    guint n_written = 0;
+    gchar *msg;
+
+    priv = et_playlist_dialog_get_instance_private (self);
+
+    if (!ETCore->ETFileList)
+    {
+        return;
+    }
+
+    if (g_settings_get_boolean (MainSettings, "playlist-selected-only"))
+    {
+        etfilelist = et_application_window_browser_get_selected_files (ET_APPLICATION_WINDOW (MainWindow));
+    }
+    else
+    {
+        etfilelist = ETCore->ETFileList;
+    }
+
+    /* The content mask is compiled once, for all the files and playlists. */
+    if (g_settings_get_enum (MainSettings, "playlist-content")
+        == ET_PLAYLIST_CONTENT_EXTENDED_MASK)
+    {
+        gchar *mask_text;
+
+        mask_text = filename_from_display (gtk_entry_get_text (GTK_ENTRY (priv->content_mask_entry)));
+        /* Special case: do not replace illegal characters and do not check if
+         * there is a directory separator in the mask. */
+        mask = et_scan_rename_mask_new (mask_text, TRUE);
+        g_free (mask_text);
+    }
+
+    if (g_settings_get_boolean (MainSettings, "playlist-per-directory"))
+    {
+        /* Write a playlist for each directory, with the files which are in
+         * it. */
+        GPtrArray *dirs;
+        GHashTable *groups;
+        guint i;
+
+        dirs = g_ptr_array_new ();
+        groups = group_files_by_directory (etfilelist, dirs);
+
+        for (i = 0; i < dirs->len; i++)
+        {
+            GQueue *files;
+            GFile *file;
+            GError *error = NULL;
+
+            files = g_hash_table_lookup (groups, dirs->pdata[i]);
+            file = get_playlist_file (self, dirs->pdata[i], files->head->data);
+
+            if (write_playlist (file, files->head, mask, &error))
+            {
+                n_written++;
+            }
+            else
+            {
+                show_write_error (self, file, error);
+                g_error_free (error);
+                g_object_unref (file);
+                break;
+            }
+
+            g_object_unref (file);
+        }
+
+        /* The directories are owned by the table. */
+        g_ptr_array_free (dirs, TRUE);
+        g_hash_table_destroy (groups);
+    }
+    else
+    {
+        gchar *path;
+        GFile *file;
         GError *error = NULL;
 
-        if (!write_playlist (self, file, &error))
+        path = g_file_get_path (et_application_window_get_current_path (ET_APPLICATION_WINDOW (MainWindow)));
+        /* Generate filename from tag of the current selected file (FIXME). */
+        file = get_playlist_file (self, path, ETCore->ETFileDisplayed);
+        g_free (path);
+
+        if (write_playlist (file, etfilelist, mask, &error))
         {
-            // Writing fails...
-            msgdialog = gtk_message_dialog_new (GTK_WINDOW (self),
-                                               GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
-                                               GTK_MESSAGE_ERROR,
-                                               GTK_BUTTONS_CLOSE,
-                                               _("Cannot write playlist file ‘%s’"),
-                                               playlist_name_utf8);
-            gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (msgdialog),
-                                                      "%s", error->message);
-            gtk_window_set_title(GTK_WINDOW(msgdialog),_("Playlist File Error"));
-
-            gtk_dialog_run(GTK_DIALOG(msgdialog));
-            gtk_widget_destroy(msgdialog);
-            g_error_free (error);
-        }else
+            n_written++;
+        }
+        else
         {
-            gchar *msg;
-            msg = g_strdup_printf (_("Wrote playlist file ‘%s’"),
-                                   playlist_name_utf8);
-            et_application_window_status_bar_message (ET_APPLICATION_WINDOW (MainWindow),
-                                                      msg, TRUE);
-            g_free (msg);
+            show_write_error (self, file, error);
+            g_error_free (error);
         }
+
         g_object_unref (file);
     }
-    g_free(playlist_name_utf8);
-    g_free(playlist_name);
+
+    if (n_written > 0)
+    {
+        msg = g_strdup_printf (ngettext ("Wrote %u playlist file",
+                                         "Wrote %u playlist files",
+                                         n_written),
+                               n_written);
+        et_application_window_status_bar_message (ET_APPLICATION_WINDOW (MainWindow),
+                                                  msg, TRUE);
+        g_free (msg);
+    }
+
+    if (mask)
+    {
+        et_scan_rename_mask_free (mask);
+    }
+
+    if (g_settings_get_boolean (MainSettings, "playlist-selected-only"))
+    {
+        g_list_free (etfilelist);
+    }
 }
 
 /*
@@ -646,6 +547,13 @@ create_playlist_dialog (EtPlaylistDialog *self)
                      "active", G_SETTINGS_BIND_DEFAULT);
 
     /* Playlist options */
+    g_settings_bind_with_mapping (MainSettings, "playlist-format",
+                                  priv->format_combo, "active",
+                                  G_SETTINGS_BIND_DEFAULT,
+                                  et_settings_enum_get, et_settings_enum_set,
+                                  GSIZE_TO_POINTER (ET_TYPE_PLAYLIST_FORMAT),
+                                  NULL);
+
     g_settings_bind (MainSettings, "playlist-selected-only",
                      priv->selected_files_check, "active",
                      G_SETTINGS_BIND_DEFAULT);
@@ -654,6 +562,11 @@ create_playlist_dialog (EtPlaylistDialog *self)
                      priv->path_relative_radio, "active",
                      G_SETTINGS_BIND_DEFAULT);
 
+    /* Create a playlist in each directory. */
+    g_settings_bind (MainSettings, "playlist-per-directory",
+                     priv->per_directory_check, "active",
+                     G_SETTINGS_BIND_DEFAULT);
+
     /* Create playlist in parent directory. */
     g_settings_bind (MainSettings, "playlist-parent-directory",
                      priv->playlist_parent_check, "active",
@@ -718,12 +631,18 @@ et_playlist_dialog_class_init (EtPlaylistDialogClass *klass)
     gtk_widget_class_bind_template_child_private (widget_class,
                                                   EtPlaylistDialog,
                                                   name_mask_entry);
+    gtk_widget_class_bind_template_child_private (widget_class,
+                                                  EtPlaylistDialog,
+                                                  format_combo);
     gtk_widget_class_bind_template_child_private (widget_class,
                                                   EtPlaylistDialog,
                                                   selected_files_check);
     gtk_widget_class_bind_template_child_private (widget_class,
                                                   EtPlaylistDialog,
                                                   path_relative_radio);
+    gtk_widget_class_bind_template_child_private (widget_class,
+                                                  EtPlaylistDialog,
+                                                  per_directory_check);
     gtk_widget_class_bind_template_child_private (widget_class,
                                                   EtPlaylistDialog,
                                                   playlist_parent_check);
@@ -0,0 +1,257 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "prefetch.h"
+
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <stdio.h>
+
+#include "read_session.h"
+
+/*
+ * EtPrefetch:
+ * @paths: (array length=n_paths): local paths of the files to prefetch
+ * @n_paths: the number of paths
+ * @depth: the number of files to prefetch ahead of the current one
+ * @current: the index of the file which is being parsed
+ * @next: the index of the next file to prefetch
+ * @stop: whether the worker thread should exit
+ * @thread: (allow-none): the worker thread, or %NULL if @depth is 0
+ * @mutex: protects @current, @next and @stop
+ * @cond: signalled when @current or @stop change
+ */
+struct _EtPrefetch
+{
+    gchar **paths;
+    guint n_paths;
+    guint depth;
+    guint current;
+    guint next;
+    gboolean stop;
+    GThread *thread;
+    GMutex mutex;
+    GCond cond;
+};
+
+/*
+ * et_prefetch_file:
+ * @path: the file to prefetch
+ *
+ * Bring the regions of @path that the tag and header readers look at, which
+ * are the same as the regions cached by #EtReadSession, into the page cache.
+ * Errors are ignored, as the readers report them later anyway.
+ */
+static void
+et_prefetch_file (const gchar *path)
+{
+#ifdef HAVE_POSIX_FADVISE
+    int fd;
+    GStatBuf st;
+
+    fd = g_open (path, O_RDONLY, 0);
+
+    if (fd == -1)
+    {
+        return;
+    }
+
+    if (fstat (fd, &st) == 0)
+    {
+        /* Only a hint: the kernel starts the reads and returns at once. */
+        posix_fadvise (fd, 0, ET_READ_SESSION_HEAD_SIZE,
+                       POSIX_FADV_WILLNEED);
+
+        if (st.st_size > ET_READ_SESSION_HEAD_SIZE)
+        {
+            posix_fadvise (fd,
+                           MAX (ET_READ_SESSION_HEAD_SIZE,
+                                st.st_size - ET_READ_SESSION_TAIL_SIZE),
+                           ET_READ_SESSION_TAIL_SIZE, POSIX_FADV_WILLNEED);
+        }
+    }
+
+    g_close (fd, NULL);
+#else /* !HAVE_POSIX_FADVISE */
+    /* Without a way to hint the kernel, read the data on this thread
+     * instead, which fills the page cache just the same. */
+    FILE *fp;
+    guchar *buffer;
+    gsize len;
+
+    fp = g_fopen (path, "rb");
+
+    if (!fp)
+    {
+        return;
+    }
+
+    buffer = g_malloc (ET_READ_SESSION_HEAD_SIZE);
+    len = fread (buffer, 1, ET_READ_SESSION_HEAD_SIZE, fp);
+
+    if (len == ET_READ_SESSION_HEAD_SIZE
+        && fseek (fp, -ET_READ_SESSION_TAIL_SIZE, SEEK_END) == 0)
+    {
+        len = fread (buffer, 1, ET_READ_SESSION_TAIL_SIZE, fp);
+    }
+
+    g_free (buffer);
+    fclose (fp);
+#endif /* !HAVE_POSIX_FADVISE */
+}
+
+static gpointer
+et_prefetch_thread (gpointer user_data)
+{
+    EtPrefetch *prefetch = user_data;
+
+    g_mutex_lock (&prefetch->mutex);
+
+    while (!prefetch->stop && prefetch->next < prefetch->n_paths)
+    {
+        guint index;
+
+        /* Do not run too far ahead of the reader, or the early files could be
+         * evicted from the cache before they are parsed. */
+        if (prefetch->next > prefetch->current + prefetch->depth)
+        {
+            g_cond_wait (&prefetch->cond, &prefetch->mutex);
+            continue;
+        }
+
+        /* The current file is already being read by the loader. */
+        prefetch->next = MAX (prefetch->next, prefetch->current + 1);
+        index = prefetch->next++;
+
+        if (index >= prefetch->n_paths)
+        {
+            break;
+        }
+
+        g_mutex_unlock (&prefetch->mutex);
+        et_prefetch_file (prefetch->paths[index]);
+        g_mutex_lock (&prefetch->mutex);
+    }
+
+    g_mutex_unlock (&prefetch->mutex);
+
+    return NULL;
+}
+
+/*
+ * et_prefetch_new:
+ * @files: (element-type GFile): the files which will be loaded, in order
+ * @depth: the number of files to prefetch ahead of the current one, or 0 to
+ *         disable prefetching
+ *
+ * Start prefetching @files on a worker thread. The loader must call
+ * et_prefetch_advance() before it reads each file.
+ *
+ * Returns: a new #EtPrefetch, to be freed with et_prefetch_free()
+ */
+EtPrefetch *
+et_prefetch_new (GList *files,
+                 guint depth)
+{
+    EtPrefetch *prefetch;
+    GList *l;
+    guint i;
+
+    prefetch = g_slice_new0 (EtPrefetch);
+    prefetch->depth = depth;
+    g_mutex_init (&prefetch->mutex);
+    g_cond_init (&prefetch->cond);
+
+    if (depth == 0 || files == NULL)
+    {
+        return prefetch;
+    }
+
+    /* Take the paths now, so that the worker does not share the GFiles. */
+    prefetch->n_paths = g_list_length (files);
+    prefetch->paths = g_new0 (gchar *, prefetch->n_paths + 1);
+
+    for (l = files, i = 0; l != NULL; l = g_list_next (l))
+    {
+        gchar *path = g_file_get_path (G_FILE (l->data));
+
+        /* Keep the indices in step with the list, even for non-local files,
+         * which are not prefetched. */
+        prefetch->paths[i++] = path ? path : g_strdup ("");
+    }
+
+    prefetch->thread = g_thread_new ("prefetch", et_prefetch_thread,
+                                     prefetch);
+
+    return prefetch;
+}
+
+/*
+ * et_prefetch_advance:
+ * @prefetch: the prefetcher
+ * @index: the index in the list of the file which is about to be read
+ *
+ * Let the worker thread prefetch up to @depth files after @index.
+ */
+void
+et_prefetch_advance (EtPrefetch *prefetch,
+                     guint index)
+{
+    g_return_if_fail (prefetch != NULL);
+
+    if (!prefetch->thread)
+    {
+        return;
+    }
+
+    g_mutex_lock (&prefetch->mutex);
+    prefetch->current = index;
+    g_cond_signal (&prefetch->cond);
+    g_mutex_unlock (&prefetch->mutex);
+}
+
+/*
+ * et_prefetch_free:
+ * @prefetch: the prefetcher
+ *
+ * Stop the worker thread, waiting for the file which it is prefetching, and
+ * free @prefetch.
+ */
+void
+et_prefetch_free (EtPrefetch *prefetch)
+{
+    g_return_if_fail (prefetch != NULL);
+
+    if (prefetch->thread)
+    {
+        g_mutex_lock (&prefetch->mutex);
+        prefetch->stop = TRUE;
+        g_cond_signal (&prefetch->cond);
+        g_mutex_unlock (&prefetch->mutex);
+
+        g_thread_join (prefetch->thread);
+    }
+
+    g_strfreev (prefetch->paths);
+    g_mutex_clear (&prefetch->mutex);
+    g_cond_clear (&prefetch->cond);
+    g_slice_free (EtPrefetch, prefetch);
+}
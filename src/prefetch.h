@@ -0,0 +1,41 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ET_PREFETCH_H_
+#define ET_PREFETCH_H_
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/*
+ * EtPrefetch:
+ *
+ * Asks the operating system to read the start and the end of the next files
+ * of a list in the background, while the current file is parsed, so that the
+ * tag and header readers do not wait on the disk for each file in turn.
+ */
+typedef struct _EtPrefetch EtPrefetch;
+
+EtPrefetch * et_prefetch_new (GList *files, guint depth);
+void et_prefetch_advance (EtPrefetch *prefetch, guint index);
+void et_prefetch_free (EtPrefetch *prefetch);
+
+G_END_DECLS
+
+#endif /* !ET_PREFETCH_H_ */
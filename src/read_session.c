@@ -0,0 +1,576 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "read_session.h"
+
+#include <errno.h>
+#include <string.h>
+
+/*
+ * EtReadSession:
+ * @file: the file being read
+ * @istream: the only stream opened on @file
+ * @info: size and modification time of @file
+ * @size: the size of @file, in bytes
+ * @position: the current position of @istream, or -1 if unknown
+ * @head: (allow-none): cached data from the start of the file
+ * @head_len: the number of valid bytes in @head
+ * @tail: (allow-none): cached data from the end of the file
+ * @tail_offset: the offset of the first byte of @tail in the file
+ * @tail_len: the number of valid bytes in @tail
+ * @data: results of parsing the file, shared between readers
+ */
+struct _EtReadSession
+{
+    GFile *file;
+    GFileInputStream *istream;
+    GFileInfo *info;
+    goffset size;
+    goffset position;
+    guchar *head;
+    gsize head_len;
+    guchar *tail;
+    goffset tail_offset;
+    gsize tail_len;
+    GData *data;
+};
+
+/*
+ * EtReadSessionStream:
+ *
+ * A GFileInputStream with its own read position, which reads through the
+ * buffers of a shared EtReadSession. Closing the stream does not close the
+ * file, which stays open until the session is freed.
+ */
+typedef struct
+{
+    GFileInputStream parent_instance;
+    EtReadSession *session;
+    goffset offset;
+} EtReadSessionStream;
+
+typedef struct
+{
+    GFileInputStreamClass parent_class;
+} EtReadSessionStreamClass;
+
+G_DEFINE_TYPE (EtReadSessionStream, et_read_session_stream,
+               G_TYPE_FILE_INPUT_STREAM)
+
+/*
+ * et_read_session_read_file:
+ * @session: the read session
+ * @offset: the position in the file from which to read
+ * @buffer: the buffer to fill
+ * @count: the number of bytes to read
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Read directly from the file underlying @session, seeking only if the
+ * previous read finished somewhere else.
+ *
+ * Returns: the number of bytes read, 0 on end of file, or -1 on error
+ */
+static gssize
+et_read_session_read_file (EtReadSession *session,
+                           goffset offset,
+                           gpointer buffer,
+                           gsize count,
+                           GError **error)
+{
+    gssize bytes_read;
+
+    if (session->position != offset)
+    {
+        if (!g_seekable_seek (G_SEEKABLE (session->istream), offset,
+                              G_SEEK_SET, NULL, error))
+        {
+            session->position = -1;
+            return -1;
+        }
+
+        session->position = offset;
+    }
+
+    bytes_read = g_input_stream_read (G_INPUT_STREAM (session->istream),
+                                      buffer, count, NULL, error);
+
+    if (bytes_read == -1)
+    {
+        session->position = -1;
+        return -1;
+    }
+
+    session->position += bytes_read;
+
+    return bytes_read;
+}
+
+/*
+ * et_read_session_fill:
+ * @session: the read session
+ * @offset: the position in the file from which to fill @buffer
+ * @size: the number of bytes to read
+ * @buffer: (out): return location for the newly-allocated buffer
+ * @len: (out): return location for the number of bytes read into @buffer
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Read @size bytes of the file from @offset into a new buffer, stopping early
+ * if the end of the file is reached.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+static gboolean
+et_read_session_fill (EtReadSession *session,
+                      goffset offset,
+                      gsize size,
+                      guchar **buffer,
+                      gsize *len,
+                      GError **error)
+{
+    guchar *data;
+    gsize total = 0;
+
+    data = g_malloc (size);
+
+    while (total < size)
+    {
+        gssize bytes_read;
+
+        bytes_read = et_read_session_read_file (session, offset + total,
+                                                data + total, size - total,
+                                                error);
+
+        if (bytes_read == -1)
+        {
+            g_free (data);
+            return FALSE;
+        }
+        else if (bytes_read == 0)
+        {
+            break;
+        }
+
+        total += bytes_read;
+    }
+
+    *buffer = data;
+    *len = total;
+
+    return TRUE;
+}
+
+/*
+ * et_read_session_pread:
+ * @session: the read session
+ * @offset: the position in the file from which to read
+ * @buffer: the buffer to fill
+ * @count: the maximum number of bytes to read
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Read up to @count bytes from @offset, using the head and tail buffers where
+ * possible. The buffers are filled on first use, so that formats which only
+ * look at one end of the file do not pay for the other. Reads which start
+ * inside a buffer stop at its end.
+ *
+ * Returns: the number of bytes read, 0 on end of file, or -1 on error
+ */
+static gssize
+et_read_session_pread (EtReadSession *session,
+                       goffset offset,
+                       gpointer buffer,
+                       gsize count,
+                       GError **error)
+{
+    gsize available;
+
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    if (offset < ET_READ_SESSION_HEAD_SIZE)
+    {
+        if (session->head == NULL)
+        {
+            if (!et_read_session_fill (session, 0,
+                                       MIN (session->size,
+                                            ET_READ_SESSION_HEAD_SIZE),
+                                       &session->head, &session->head_len,
+                                       error))
+            {
+                return -1;
+            }
+        }
+
+        if (offset < (goffset)session->head_len)
+        {
+            available = MIN (count, session->head_len - offset);
+            memcpy (buffer, session->head + offset, available);
+            return available;
+        }
+    }
+
+    /* Only use the tail buffer if it does not overlap the head buffer. */
+    if (session->size > ET_READ_SESSION_HEAD_SIZE + ET_READ_SESSION_TAIL_SIZE
+        && offset >= session->size - ET_READ_SESSION_TAIL_SIZE
+        && offset < session->size)
+    {
+        if (session->tail == NULL)
+        {
+            session->tail_offset = session->size - ET_READ_SESSION_TAIL_SIZE;
+
+            if (!et_read_session_fill (session, session->tail_offset,
+                                       ET_READ_SESSION_TAIL_SIZE,
+                                       &session->tail, &session->tail_len,
+                                       error))
+            {
+                return -1;
+            }
+        }
+
+        if (offset - session->tail_offset < (goffset)session->tail_len)
+        {
+            available = MIN (count,
+                             session->tail_len
+                             - (offset - session->tail_offset));
+            memcpy (buffer, session->tail + (offset - session->tail_offset),
+                    available);
+            return available;
+        }
+    }
+
+    return et_read_session_read_file (session, offset, buffer, count, error);
+}
+
+static gssize
+et_read_session_stream_read (GInputStream *stream,
+                             void *buffer,
+                             gsize count,
+                             GCancellable *cancellable,
+                             GError **error)
+{
+    EtReadSessionStream *self = (EtReadSessionStream *)stream;
+    gsize total = 0;
+
+    /* Several of the tag libraries treat a short read as the end of the file,
+     * as with fread(), so keep reading across the end of the cached regions
+     * until the request is satisfied. */
+    while (total < count)
+    {
+        gssize bytes_read;
+        GError *tmp_error = NULL;
+
+        bytes_read = et_read_session_pread (self->session, self->offset,
+                                            (guchar *)buffer + total,
+                                            count - total, &tmp_error);
+
+        if (bytes_read == -1)
+        {
+            /* Report the data which was read, and let the next read fail. */
+            if (total > 0)
+            {
+                g_error_free (tmp_error);
+                break;
+            }
+
+            g_propagate_error (error, tmp_error);
+            return -1;
+        }
+        else if (bytes_read == 0)
+        {
+            break;
+        }
+
+        self->offset += bytes_read;
+        total += bytes_read;
+    }
+
+    return total;
+}
+
+static gssize
+et_read_session_stream_skip (GInputStream *stream,
+                             gsize count,
+                             GCancellable *cancellable,
+                             GError **error)
+{
+    EtReadSessionStream *self = (EtReadSessionStream *)stream;
+    goffset remaining;
+
+    remaining = MAX (0, self->session->size - self->offset);
+    count = MIN ((goffset)count, remaining);
+    self->offset += count;
+
+    return count;
+}
+
+static gboolean
+et_read_session_stream_close (GInputStream *stream,
+                              GCancellable *cancellable,
+                              GError **error)
+{
+    /* The file is closed when the session is freed. */
+    return TRUE;
+}
+
+static goffset
+et_read_session_stream_tell (GFileInputStream *stream)
+{
+    return ((EtReadSessionStream *)stream)->offset;
+}
+
+static gboolean
+et_read_session_stream_can_seek (GFileInputStream *stream)
+{
+    return TRUE;
+}
+
+static gboolean
+et_read_session_stream_seek (GFileInputStream *stream,
+                             goffset offset,
+                             GSeekType type,
+                             GCancellable *cancellable,
+                             GError **error)
+{
+    EtReadSessionStream *self = (EtReadSessionStream *)stream;
+    goffset new_offset;
+
+    switch (type)
+    {
+        case G_SEEK_SET:
+            new_offset = offset;
+            break;
+        case G_SEEK_CUR:
+            new_offset = self->offset + offset;
+            break;
+        case G_SEEK_END:
+            new_offset = self->session->size + offset;
+            break;
+        default:
+            g_assert_not_reached ();
+            return FALSE;
+    }
+
+    if (new_offset < 0)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "%s",
+                     g_strerror (EINVAL));
+        return FALSE;
+    }
+
+    self->offset = new_offset;
+
+    return TRUE;
+}
+
+static GFileInfo *
+et_read_session_stream_query_info (GFileInputStream *stream,
+                                   const char *attributes,
+                                   GCancellable *cancellable,
+                                   GError **error)
+{
+    EtReadSessionStream *self = (EtReadSessionStream *)stream;
+
+    /* Only the attributes which were queried when the session was created are
+     * available. */
+    return g_file_info_dup (self->session->info);
+}
+
+static void
+et_read_session_stream_class_init (EtReadSessionStreamClass *klass)
+{
+    GInputStreamClass *istream_class = G_INPUT_STREAM_CLASS (klass);
+    GFileInputStreamClass *file_istream_class = G_FILE_INPUT_STREAM_CLASS (klass);
+
+    istream_class->read_fn = et_read_session_stream_read;
+    istream_class->skip = et_read_session_stream_skip;
+    istream_class->close_fn = et_read_session_stream_close;
+
+    file_istream_class->tell = et_read_session_stream_tell;
+    file_istream_class->can_seek = et_read_session_stream_can_seek;
+    file_istream_class->seek = et_read_session_stream_seek;
+    file_istream_class->query_info = et_read_session_stream_query_info;
+}
+
+static void
+et_read_session_stream_init (EtReadSessionStream *self)
+{
+}
+
+/*
+ * et_read_session_new:
+ * @file: the file to read
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Open @file for reading, and query its size and modification time in a
+ * single call on the open stream.
+ *
+ * Returns: a new #EtReadSession, free with et_read_session_free(), or %NULL
+ * on error
+ */
+EtReadSession *
+et_read_session_new (GFile *file,
+                     GError **error)
+{
+    EtReadSession *session;
+    GFileInputStream *istream;
+    GFileInfo *info;
+
+    g_return_val_if_fail (file != NULL, NULL);
+    g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+    istream = g_file_read (file, NULL, error);
+
+    if (!istream)
+    {
+        g_assert (error == NULL || *error != NULL);
+        return NULL;
+    }
+
+    info = g_file_input_stream_query_info (istream,
+                                           G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                                           G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                           NULL, error);
+
+    if (!info)
+    {
+        g_assert (error == NULL || *error != NULL);
+        g_object_unref (istream);
+        return NULL;
+    }
+
+    session = g_slice_new0 (EtReadSession);
+    session->file = g_object_ref (file);
+    session->istream = istream;
+    session->info = info;
+    session->size = g_file_info_get_size (info);
+    session->position = 0;
+    g_datalist_init (&session->data);
+
+    return session;
+}
+
+/*
+ * et_read_session_free:
+ * @session: the read session to free
+ *
+ * Close the file and free the cached data. Any streams returned by
+ * et_read_session_open_stream() must already have been released.
+ */
+void
+et_read_session_free (EtReadSession *session)
+{
+    g_return_if_fail (session != NULL);
+
+    g_datalist_clear (&session->data);
+    g_object_unref (session->istream);
+    g_object_unref (session->info);
+    g_object_unref (session->file);
+    g_free (session->head);
+    g_free (session->tail);
+
+    g_slice_free (EtReadSession, session);
+}
+
+GFile *
+et_read_session_get_file (EtReadSession *session)
+{
+    g_return_val_if_fail (session != NULL, NULL);
+
+    return session->file;
+}
+
+goffset
+et_read_session_get_size (EtReadSession *session)
+{
+    g_return_val_if_fail (session != NULL, 0);
+
+    return session->size;
+}
+
+guint64
+et_read_session_get_modification_time (EtReadSession *session)
+{
+    g_return_val_if_fail (session != NULL, 0);
+
+    return g_file_info_get_attribute_uint64 (session->info,
+                                             G_FILE_ATTRIBUTE_TIME_MODIFIED);
+}
+
+/*
+ * et_read_session_open_stream:
+ * @session: the read session
+ *
+ * Get a new stream positioned at the start of the file, which can be used
+ * anywhere that the result of g_file_read() would be. Reads which fall within
+ * the cached head or tail of the file are served without further I/O.
+ *
+ * Returns: (transfer full): a new stream, which must not outlive @session
+ */
+GFileInputStream *
+et_read_session_open_stream (EtReadSession *session)
+{
+    EtReadSessionStream *stream;
+
+    g_return_val_if_fail (session != NULL, NULL);
+
+    stream = g_object_new (et_read_session_stream_get_type (), NULL);
+    stream->session = session;
+    stream->offset = 0;
+
+    return G_FILE_INPUT_STREAM (stream);
+}
+
+/*
+ * et_read_session_get_data:
+ * @session: the read session
+ * @key: the name of the data
+ *
+ * Get data which was stored by et_read_session_set_data().
+ *
+ * Returns: (transfer none): the data, or %NULL if it was not set
+ */
+gpointer
+et_read_session_get_data (EtReadSession *session,
+                          const gchar *key)
+{
+    g_return_val_if_fail (session != NULL && key != NULL, NULL);
+
+    return g_datalist_get_data (&session->data, key);
+}
+
+/*
+ * et_read_session_set_data:
+ * @session: the read session
+ * @key: the name of the data
+ * @data: (transfer full): the data to store
+ * @destroy: (allow-none): a function to free @data with the session
+ *
+ * Store the result of parsing the file, so that a reader which runs later in
+ * the same session can use it instead of parsing the file again.
+ */
+void
+et_read_session_set_data (EtReadSession *session,
+                          const gchar *key,
+                          gpointer data,
+                          GDestroyNotify destroy)
+{
+    g_return_if_fail (session != NULL && key != NULL);
+
+    g_datalist_set_data_full (&session->data, key, data, destroy);
+}
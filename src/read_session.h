@@ -0,0 +1,56 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ET_READ_SESSION_H_
+#define ET_READ_SESSION_H_
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* Number of bytes cached from the start of the file. Large enough for the
+ * usual ID3v2, FLAC and Ogg header blocks, not counting big embedded images. */
+#define ET_READ_SESSION_HEAD_SIZE (64 * 1024)
+/* Number of bytes cached from the end of the file, for ID3v1, APE and Lyrics3
+ * tags. */
+#define ET_READ_SESSION_TAIL_SIZE (8 * 1024)
+
+/*
+ * EtReadSession:
+ *
+ * Shared state for reading a single file while it is loaded: the file is
+ * opened and queried once, and the start and the end of the file are cached,
+ * so that the tag reader and the header reader do not each read them again.
+ */
+typedef struct _EtReadSession EtReadSession;
+
+EtReadSession * et_read_session_new (GFile *file, GError **error);
+void et_read_session_free (EtReadSession *session);
+
+GFile * et_read_session_get_file (EtReadSession *session);
+goffset et_read_session_get_size (EtReadSession *session);
+guint64 et_read_session_get_modification_time (EtReadSession *session);
+
+GFileInputStream * et_read_session_open_stream (EtReadSession *session);
+
+gpointer et_read_session_get_data (EtReadSession *session, const gchar *key);
+void et_read_session_set_data (EtReadSession *session, const gchar *key, gpointer data, GDestroyNotify destroy);
+
+G_END_DECLS
+
+#endif /* !ET_READ_SESSION_H_ */
@@ -0,0 +1,703 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "rename_plan.h"
+
+#include <errno.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#ifndef G_OS_WIN32
+#include <unistd.h>
+#endif
+
+typedef enum
+{
+    ENTRY_PENDING,
+    /* Waiting for the file which occupies the new path to be renamed. */
+    ENTRY_VISITING,
+    ENTRY_DONE
+} EtRenameEntryState;
+
+typedef struct
+{
+    gchar *old_path;
+    gchar *new_path;
+    gpointer data;
+    /* Set while the file is moved aside to break a cycle. */
+    gchar *tmp_path;
+    EtRenameEntryState state;
+    GError *error;
+} EtRenameEntry;
+
+struct _EtRenamePlan
+{
+    /* Array of EtRenameEntry, in the order that they were added. */
+    GPtrArray *entries;
+    /* Old path to EtRenameEntry. */
+    GHashTable *sources;
+    gboolean checked;
+    guint n_conflicts;
+    /* Only for the tests: a new path which renaming to fails. */
+    gchar *fail_path;
+};
+
+static void
+et_rename_entry_free (EtRenameEntry *entry)
+{
+    g_free (entry->old_path);
+    g_free (entry->new_path);
+    g_free (entry->tmp_path);
+    g_clear_error (&entry->error);
+    g_slice_free (EtRenameEntry, entry);
+}
+
+EtRenamePlan *
+et_rename_plan_new (void)
+{
+    EtRenamePlan *plan;
+
+    plan = g_slice_new (EtRenamePlan);
+    plan->entries = g_ptr_array_new_with_free_func ((GDestroyNotify)et_rename_entry_free);
+    plan->sources = g_hash_table_new (g_str_hash, g_str_equal);
+    plan->checked = FALSE;
+    plan->n_conflicts = 0;
+    plan->fail_path = NULL;
+
+    return plan;
+}
+
+void
+et_rename_plan_free (EtRenamePlan *plan)
+{
+    g_return_if_fail (plan != NULL);
+
+    g_hash_table_destroy (plan->sources);
+    g_ptr_array_unref (plan->entries);
+    g_free (plan->fail_path);
+    g_slice_free (EtRenamePlan, plan);
+}
+
+/*
+ * et_rename_plan_add:
+ * @plan: the plan
+ * @old_path: the current path of a file, in the GLib filename encoding
+ * @new_path: the path to rename the file to
+ * @data: data to pass to the result function
+ *
+ * Add a file to be renamed. Missing directories in @new_path are created.
+ */
+void
+et_rename_plan_add (EtRenamePlan *plan,
+                    const gchar *old_path,
+                    const gchar *new_path,
+                    gpointer data)
+{
+    EtRenameEntry *entry;
+
+    g_return_if_fail (plan != NULL);
+    g_return_if_fail (old_path != NULL && new_path != NULL);
+
+    entry = g_slice_new (EtRenameEntry);
+    entry->old_path = g_strdup (old_path);
+    entry->new_path = g_strdup (new_path);
+    entry->data = data;
+    entry->tmp_path = NULL;
+    entry->state = ENTRY_PENDING;
+    entry->error = NULL;
+
+    g_ptr_array_add (plan->entries, entry);
+    plan->checked = FALSE;
+}
+
+guint
+et_rename_plan_get_length (const EtRenamePlan *plan)
+{
+    g_return_val_if_fail (plan != NULL, 0);
+
+    return plan->entries->len;
+}
+
+/*
+ * Whether two paths which both exist are the same file, such as when the
+ * paths only differ by case on a case-insensitive filesystem.
+ */
+static gboolean
+is_same_file (const gchar *path_a,
+              const GStatBuf *stat_a,
+              const gchar *path_b,
+              const GStatBuf *stat_b)
+{
+#ifdef G_OS_WIN32
+    /* The inode number is not available. */
+    gchar *folded_a;
+    gchar *folded_b;
+    gboolean result;
+
+    folded_a = g_utf8_casefold (path_a, -1);
+    folded_b = g_utf8_casefold (path_b, -1);
+    result = strcmp (folded_a, folded_b) == 0;
+    g_free (folded_a);
+    g_free (folded_b);
+
+    return result;
+#else
+    return stat_a->st_dev == stat_b->st_dev && stat_a->st_ino == stat_b->st_ino;
+#endif
+}
+
+static void
+set_conflict (EtRenamePlan *plan,
+              EtRenameEntry *entry,
+              gint code,
+              const gchar *message)
+{
+    g_set_error_literal (&entry->error, G_IO_ERROR, code, message);
+    entry->state = ENTRY_DONE;
+    plan->n_conflicts++;
+}
+
+/*
+ * et_rename_plan_check:
+ * @plan: the plan
+ *
+ * Find the renames which cannot be done, because several files would have the
+ * same name, or because a file which is not part of the plan already has the
+ * new name. The conflicting renames are marked as failed, and are not done by
+ * et_rename_plan_execute(). No files are touched.
+ *
+ * Returns: the number of conflicting renames
+ */
+guint
+et_rename_plan_check (EtRenamePlan *plan)
+{
+    GHashTable *targets;
+    GPtrArray *occupied;
+    gboolean changed;
+    guint i;
+
+    g_return_val_if_fail (plan != NULL, 0);
+
+    if (plan->checked)
+    {
+        return plan->n_conflicts;
+    }
+
+    g_hash_table_remove_all (plan->sources);
+    targets = g_hash_table_new (g_str_hash, g_str_equal);
+
+    for (i = 0; i < plan->entries->len; i++)
+    {
+        EtRenameEntry *entry = g_ptr_array_index (plan->entries, i);
+
+        if (entry->state != ENTRY_PENDING)
+        {
+            continue;
+        }
+
+        if (g_hash_table_contains (plan->sources, entry->old_path))
+        {
+            set_conflict (plan, entry, G_IO_ERROR_FAILED,
+                          _("The file is renamed more than once"));
+            continue;
+        }
+
+        g_hash_table_insert (plan->sources, entry->old_path, entry);
+
+        if (strcmp (entry->old_path, entry->new_path) == 0)
+        {
+            /* Nothing to do. */
+            entry->state = ENTRY_DONE;
+        }
+        else if (g_hash_table_contains (targets, entry->new_path))
+        {
+            set_conflict (plan, entry, G_IO_ERROR_EXISTS,
+                          _("Another file is renamed to the same name"));
+        }
+        else
+        {
+            g_hash_table_insert (targets, entry->new_path, entry);
+        }
+    }
+
+    g_hash_table_destroy (targets);
+
+    /* A file may only be renamed over a file which is itself renamed out of
+     * the way. */
+    occupied = g_ptr_array_new ();
+
+    for (i = 0; i < plan->entries->len; i++)
+    {
+        EtRenameEntry *entry = g_ptr_array_index (plan->entries, i);
+        GStatBuf new_stat;
+        GStatBuf old_stat;
+
+        if (entry->state != ENTRY_PENDING
+            || g_lstat (entry->new_path, &new_stat) != 0)
+        {
+            continue;
+        }
+
+        /* Only the case differs, on a case-insensitive filesystem. */
+        if (g_lstat (entry->old_path, &old_stat) == 0
+            && is_same_file (entry->old_path, &old_stat, entry->new_path,
+                             &new_stat))
+        {
+            continue;
+        }
+
+        g_ptr_array_add (occupied, entry);
+    }
+
+    /* Conflicts can cascade along chains of renames, so repeat until nothing
+     * changes. */
+    do
+    {
+        changed = FALSE;
+
+        for (i = 0; i < occupied->len; i++)
+        {
+            EtRenameEntry *entry = g_ptr_array_index (occupied, i);
+            const EtRenameEntry *occupant;
+
+            if (entry->state != ENTRY_PENDING)
+            {
+                continue;
+            }
+
+            occupant = g_hash_table_lookup (plan->sources, entry->new_path);
+
+            if (occupant && occupant->state == ENTRY_PENDING)
+            {
+                continue;
+            }
+
+            set_conflict (plan, entry, G_IO_ERROR_EXISTS,
+                          _("A file with the new name already exists"));
+            changed = TRUE;
+        }
+    } while (changed);
+
+    g_ptr_array_free (occupied, TRUE);
+
+    plan->checked = TRUE;
+
+    return plan->n_conflicts;
+}
+
+static gboolean
+move_file (const gchar *old_path,
+           const gchar *new_path,
+           GError **error)
+{
+    gint saved_errno;
+
+    if (g_rename (old_path, new_path) == 0)
+    {
+        return TRUE;
+    }
+
+    saved_errno = errno;
+
+    if (saved_errno == EXDEV)
+    {
+        /* Across filesystems, the file must be copied. */
+        GFile *old_file;
+        GFile *new_file;
+        gboolean result;
+
+        old_file = g_file_new_for_path (old_path);
+        new_file = g_file_new_for_path (new_path);
+        result = g_file_move (old_file, new_file, G_FILE_COPY_NONE, NULL,
+                              NULL, NULL, error);
+        g_object_unref (old_file);
+        g_object_unref (new_file);
+
+        return result;
+    }
+    else
+    {
+        g_set_error_literal (error, G_IO_ERROR,
+                             g_io_error_from_errno (saved_errno),
+                             g_strerror (saved_errno));
+
+        return FALSE;
+    }
+}
+
+/*
+ * Find a name next to @path which is not used, without creating a file.
+ */
+static gchar *
+get_temporary_path (const gchar *path)
+{
+    GStatBuf buf;
+
+    for (;;)
+    {
+        gchar *tmp_path;
+
+        tmp_path = g_strdup_printf ("%s.%08x", path, g_random_int ());
+
+        /* On other errors, renaming to the path fails anyway. */
+        if (g_lstat (tmp_path, &buf) != 0)
+        {
+            return tmp_path;
+        }
+
+        g_free (tmp_path);
+    }
+}
+
+/*
+ * Move a file back from @tmp_path to @path, without replacing a file which
+ * is at @path by now, such as the other file of a swap which was already
+ * renamed. A hard link refuses to replace a file, without a window between
+ * checking and renaming. Where there are no hard links, the path is checked
+ * first.
+ */
+static gboolean
+restore_file (const gchar *tmp_path,
+              const gchar *path)
+{
+    GStatBuf buf;
+
+#ifndef G_OS_WIN32
+    if (link (tmp_path, path) == 0)
+    {
+        g_unlink (tmp_path);
+        return TRUE;
+    }
+
+    if (errno == EEXIST || errno == ENOENT)
+    {
+        return FALSE;
+    }
+#endif
+
+    if (g_lstat (path, &buf) == 0)
+    {
+        return FALSE;
+    }
+
+    return g_rename (tmp_path, path) == 0;
+}
+
+/*
+ * Put a file which was moved aside back at @path. If that is not possible,
+ * the file is left at @tmp_path, which is added to @error so that the user
+ * can find it.
+ */
+static void
+restore_or_report (const gchar *tmp_path,
+                   const gchar *path,
+                   GError **error)
+{
+    gchar *display_path;
+
+    if (restore_file (tmp_path, path))
+    {
+        return;
+    }
+
+    display_path = g_filename_display_name (tmp_path);
+
+    if (error && *error)
+    {
+        g_prefix_error (error, _("The file was left at ‘%s’: "),
+                        display_path);
+    }
+    else
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_EXISTS,
+                     _("The file was left at ‘%s’"), display_path);
+    }
+
+    g_free (display_path);
+}
+
+static void
+rename_entry (const EtRenamePlan *plan,
+              EtRenameEntry *entry)
+{
+    const gchar *path;
+    GStatBuf new_stat;
+    gboolean result;
+
+    path = entry->tmp_path ? entry->tmp_path : entry->old_path;
+
+    if (g_lstat (entry->new_path, &new_stat) == 0)
+    {
+        GStatBuf old_stat;
+
+        if (g_lstat (path, &old_stat) == 0
+            && is_same_file (path, &old_stat, entry->new_path, &new_stat))
+        {
+            /* Renaming a file to a name which only differs by case does
+             * nothing on a case-insensitive filesystem, so go by way of a
+             * temporary name. */
+            gchar *tmp_path = get_temporary_path (entry->old_path);
+
+            result = move_file (path, tmp_path, &entry->error);
+
+            if (result)
+            {
+                result = move_file (tmp_path, entry->new_path,
+                                    &entry->error);
+
+                if (!result)
+                {
+                    restore_or_report (tmp_path, path, &entry->error);
+                }
+            }
+
+            g_free (tmp_path);
+        }
+        else
+        {
+            g_set_error_literal (&entry->error, G_IO_ERROR, G_IO_ERROR_EXISTS,
+                                 _("A file with the new name already exists"));
+            result = FALSE;
+        }
+    }
+    else if (plan->fail_path && strcmp (entry->new_path, plan->fail_path) == 0)
+    {
+        g_set_error_literal (&entry->error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                             "Failure requested by the tests");
+        result = FALSE;
+    }
+    else
+    {
+        result = move_file (path, entry->new_path, &entry->error);
+    }
+
+    if (!result && entry->tmp_path)
+    {
+        /* Put the file back where it was, unless the file of the cycle which
+         * had the new name has already taken its place. */
+        restore_or_report (entry->tmp_path, entry->old_path, &entry->error);
+    }
+
+    entry->state = ENTRY_DONE;
+}
+
+/*
+ * Create each of the directories that the files are renamed into, once.
+ */
+static void
+create_directories (EtRenamePlan *plan)
+{
+    GHashTable *directories;
+    guint i;
+
+    /* Directory to errno, or 0 on success. */
+    directories = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                         NULL);
+
+    for (i = 0; i < plan->entries->len; i++)
+    {
+        EtRenameEntry *entry = g_ptr_array_index (plan->entries, i);
+        gchar *directory;
+        gpointer value;
+        gint saved_errno;
+
+        if (entry->state != ENTRY_PENDING)
+        {
+            continue;
+        }
+
+        directory = g_path_get_dirname (entry->new_path);
+
+        if (g_hash_table_lookup_extended (directories, directory, NULL,
+                                          &value))
+        {
+            saved_errno = GPOINTER_TO_INT (value);
+            g_free (directory);
+        }
+        else
+        {
+            saved_errno = g_mkdir_with_parents (directory, 0777) == 0 ? 0
+                                                                       : errno;
+            g_hash_table_insert (directories, directory,
+                                 GINT_TO_POINTER (saved_errno));
+        }
+
+        if (saved_errno != 0)
+        {
+            gchar *display_name;
+
+            display_name = g_filename_display_name (directory);
+            g_set_error (&entry->error, G_IO_ERROR,
+                         g_io_error_from_errno (saved_errno),
+                         _("Cannot create directory ‘%s’: %s"),
+                         display_name, g_strerror (saved_errno));
+            g_free (display_name);
+            entry->state = ENTRY_DONE;
+        }
+    }
+
+    g_hash_table_destroy (directories);
+}
+
+/*
+ * et_rename_plan_execute:
+ * @plan: the plan
+ *
+ * Check the plan for conflicts, create the directories which are needed, and
+ * rename the files. A file is only renamed once the file which has its new
+ * name, if any, has been renamed. Files which swap names, or which form a
+ * longer cycle, are resolved by moving one file of the cycle to a temporary
+ * name.
+ *
+ * Returns: %TRUE if all the files were renamed, %FALSE otherwise
+ */
+gboolean
+et_rename_plan_execute (EtRenamePlan *plan)
+{
+    GPtrArray *stack;
+    gboolean result = TRUE;
+    guint i;
+
+    g_return_val_if_fail (plan != NULL, FALSE);
+
+    et_rename_plan_check (plan);
+    create_directories (plan);
+
+    stack = g_ptr_array_new ();
+
+    for (i = 0; i < plan->entries->len; i++)
+    {
+        EtRenameEntry *start = g_ptr_array_index (plan->entries, i);
+
+        if (start->state != ENTRY_PENDING)
+        {
+            continue;
+        }
+
+        /* Follow the chain of files which occupy the new names, without
+         * recursion, as the chains can be long when renumbering tracks. */
+        g_ptr_array_add (stack, start);
+
+        while (stack->len > 0)
+        {
+            EtRenameEntry *entry = g_ptr_array_index (stack, stack->len - 1);
+            EtRenameEntry *occupant;
+
+            if (entry->state == ENTRY_DONE)
+            {
+                g_ptr_array_set_size (stack, stack->len - 1);
+                continue;
+            }
+
+            entry->state = ENTRY_VISITING;
+            occupant = g_hash_table_lookup (plan->sources, entry->new_path);
+
+            if (occupant && occupant != entry)
+            {
+                if (occupant->state == ENTRY_PENDING)
+                {
+                    g_ptr_array_add (stack, occupant);
+                    continue;
+                }
+                else if (occupant->state == ENTRY_VISITING
+                         && occupant->tmp_path == NULL)
+                {
+                    /* A cycle: move the occupant aside. If that fails, the
+                     * rename fails as the new name is still in use. */
+                    gchar *tmp_path;
+
+                    tmp_path = get_temporary_path (occupant->old_path);
+
+                    if (move_file (occupant->old_path, tmp_path, NULL))
+                    {
+                        occupant->tmp_path = tmp_path;
+                    }
+                    else
+                    {
+                        g_free (tmp_path);
+                    }
+                }
+            }
+
+            rename_entry (plan, entry);
+            g_ptr_array_set_size (stack, stack->len - 1);
+        }
+    }
+
+    g_ptr_array_free (stack, TRUE);
+
+    for (i = 0; i < plan->entries->len; i++)
+    {
+        const EtRenameEntry *entry = g_ptr_array_index (plan->entries, i);
+
+        if (entry->error)
+        {
+            result = FALSE;
+            break;
+        }
+    }
+
+    return result;
+}
+
+/*
+ * et_rename_plan_foreach_result:
+ * @plan: the plan
+ * @func: the function to call for each rename
+ * @user_data: data to pass to @func
+ *
+ * Call @func for each rename which was added to the plan, in the same order.
+ */
+void
+et_rename_plan_foreach_result (const EtRenamePlan *plan,
+                               EtRenamePlanResultFunc func,
+                               gpointer user_data)
+{
+    guint i;
+
+    g_return_if_fail (plan != NULL);
+    g_return_if_fail (func != NULL);
+
+    for (i = 0; i < plan->entries->len; i++)
+    {
+        const EtRenameEntry *entry = g_ptr_array_index (plan->entries, i);
+
+        func (entry->old_path, entry->new_path, entry->error, entry->data,
+              user_data);
+    }
+}
+
+/*
+ * _et_rename_plan_set_fail_path:
+ * @plan: the plan
+ * @path: a new path of the plan
+ *
+ * Make the rename to @path fail, after any file of its cycle has been moved
+ * aside, to test the recovery. Only for the tests.
+ */
+void
+_et_rename_plan_set_fail_path (EtRenamePlan *plan,
+                               const gchar *path)
+{
+    g_return_if_fail (plan != NULL);
+
+    g_free (plan->fail_path);
+    plan->fail_path = g_strdup (path);
+}
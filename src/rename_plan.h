@@ -0,0 +1,58 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ET_RENAME_PLAN_H_
+#define ET_RENAME_PLAN_H_
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/*
+ * EtRenamePlan:
+ *
+ * A batch of file renames, which are checked for conflicts before any file is
+ * touched, and then done in an order which allows files to swap names.
+ */
+typedef struct _EtRenamePlan EtRenamePlan;
+
+/*
+ * EtRenamePlanResultFunc:
+ * @old_path: the original path of the file
+ * @new_path: the path which the file was to be renamed to
+ * @error: the reason that the rename failed, or %NULL on success
+ * @data: the data passed to et_rename_plan_add()
+ * @user_data: the data passed to et_rename_plan_foreach_result()
+ */
+typedef void (*EtRenamePlanResultFunc) (const gchar *old_path, const gchar *new_path, const GError *error, gpointer data, gpointer user_data);
+
+EtRenamePlan * et_rename_plan_new (void);
+void et_rename_plan_free (EtRenamePlan *plan);
+
+void et_rename_plan_add (EtRenamePlan *plan, const gchar *old_path, const gchar *new_path, gpointer data);
+guint et_rename_plan_get_length (const EtRenamePlan *plan);
+guint et_rename_plan_check (EtRenamePlan *plan);
+gboolean et_rename_plan_execute (EtRenamePlan *plan);
+void et_rename_plan_foreach_result (const EtRenamePlan *plan, EtRenamePlanResultFunc func, gpointer user_data);
+
+/* Only for the tests. */
+void _et_rename_plan_set_fail_path (EtRenamePlan *plan, const gchar *path);
+
+G_END_DECLS
+
+#endif /* !ET_RENAME_PLAN_H_ */
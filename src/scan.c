@@ -297,13 +297,13 @@ Scan_Word_Is_Roman_Numeral (const gchar *text)
 }
 
 /*
- * Function to set the first letter of each word to uppercase, according the "Chicago Manual of Style" (http://www.docstyles.com/cmscrib.htm#Note2)
- * No needed to reallocate
+ * Uppercase the first letter of each word of the lowercase, valid UTF-8
+ * @string, in place. Trailing whitespace is removed.
  */
-void
-Scan_Process_Fields_First_Letters_Uppercase (gchar **str,
-                                             gboolean uppercase_preps,
-                                             gboolean handle_roman)
+static void
+first_letters_uppercase (gchar *string,
+                         gboolean uppercase_preps,
+                         gboolean handle_roman)
 {
 /**** DANIEL TEST *****
     gchar *iter;
@@ -326,7 +326,6 @@ Scan_Process_Fields_First_Letters_Uppercase (gchar **str,
     }
 ****/
 /**** Barış Çiçek version ****/
-    gchar *string = *str;
     gchar *word, *word1, *word2, *temp;
     gint i, len;
     gchar utf8_character[6];
@@ -360,17 +359,6 @@ Scan_Process_Fields_First_Letters_Uppercase (gchar **str,
         NULL
     };
 
-    temp = Scan_Process_Fields_All_Downcase (string);
-    g_free (*str);
-    *str = string = temp;
-
-    if (!g_utf8_validate(string,-1,NULL))
-    {
-        /* FIXME: Translatable string. */
-        g_warning ("%s",
-                   "Scan_Process_Fields_First_Letters_Uppercase: Not valid UTF-8!");
-        return;
-    }
     /* Removes trailing whitespace. */
     string = g_strchomp(string);
 
@@ -473,3 +461,421 @@ increment:
         set_to_upper_case = set_to_upper_case_tmp;
     }
 }
+
+/*
+ * Function to set the first letter of each word to uppercase, according the "Chicago Manual of Style" (http://www.docstyles.com/cmscrib.htm#Note2)
+ * No needed to reallocate
+ */
+void
+Scan_Process_Fields_First_Letters_Uppercase (gchar **str,
+                                             gboolean uppercase_preps,
+                                             gboolean handle_roman)
+{
+    gchar *temp;
+
+    temp = Scan_Process_Fields_All_Downcase (*str);
+    g_free (*str);
+    *str = temp;
+
+    if (!g_utf8_validate (temp, -1, NULL))
+    {
+        /* FIXME: Translatable string. */
+        g_warning ("%s",
+                   "Scan_Process_Fields_First_Letters_Uppercase: Not valid UTF-8!");
+        return;
+    }
+
+    first_letters_uppercase (temp, uppercase_preps, handle_roman);
+}
+
+/*
+ * EtScanPipeline:
+ * @flags: the options to apply
+ * @regex: the regular expression for %ET_SCAN_PIPELINE_CONVERT_CHARACTERS,
+ *         or %NULL
+ * @replacement: the replacement for the matches of @regex
+ * @ascii_casing: whether the case of ASCII letters can be changed with the
+ *                ASCII functions, which is not so in every locale
+ */
+struct _EtScanPipeline
+{
+    EtScanPipelineFlags flags;
+    GRegex *regex;
+    gchar *replacement;
+    gboolean ascii_casing;
+};
+
+/* The options which change the case of letters. */
+#define ET_SCAN_PIPELINE_CASING (ET_SCAN_PIPELINE_UPPERCASE_ALL \
+                                 | ET_SCAN_PIPELINE_LOWERCASE_ALL \
+                                 | ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTER \
+                                 | ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTERS)
+
+/*
+ * et_scan_pipeline_new:
+ * @flags: the options to apply
+ * @convert_from: the regular expression to replace, with
+ *                %ET_SCAN_PIPELINE_CONVERT_CHARACTERS
+ * @convert_to: the replacement, with %ET_SCAN_PIPELINE_CONVERT_CHARACTERS
+ * @error: a #GError, or %NULL
+ *
+ * Compile the process-fields options into a pipeline, so that the settings
+ * and the regular expression are read once for a whole run.
+ *
+ * Returns: a new #EtScanPipeline, free with et_scan_pipeline_free(), or
+ * %NULL if the regular expression or the replacement is invalid
+ */
+EtScanPipeline *
+et_scan_pipeline_new (EtScanPipelineFlags flags,
+                      const gchar *convert_from,
+                      const gchar *convert_to,
+                      GError **error)
+{
+    static const gchar lowercase[] = "abcdefghijklmnopqrstuvwxyz";
+    static const gchar uppercase[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    EtScanPipeline *pipeline;
+    gchar *upper;
+    gchar *lower;
+
+    g_return_val_if_fail (!(flags & ET_SCAN_PIPELINE_CONVERT_CHARACTERS)
+                          || (convert_from != NULL && convert_to != NULL),
+                          NULL);
+    g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+    pipeline = g_slice_new0 (EtScanPipeline);
+    pipeline->flags = flags;
+
+    if (flags & ET_SCAN_PIPELINE_CONVERT_CHARACTERS)
+    {
+        pipeline->regex = g_regex_new (convert_from, 0, 0, error);
+
+        if (pipeline->regex == NULL
+            || !g_regex_check_replacement (convert_to, NULL, error))
+        {
+            et_scan_pipeline_free (pipeline);
+            return NULL;
+        }
+
+        pipeline->replacement = g_strdup (convert_to);
+    }
+
+    /* In a Turkish locale, for example, 'i' is not uppercased to 'I'. */
+    upper = g_utf8_strup (lowercase, -1);
+    lower = g_utf8_strdown (uppercase, -1);
+    pipeline->ascii_casing = strcmp (upper, uppercase) == 0
+                             && strcmp (lower, lowercase) == 0;
+    g_free (upper);
+    g_free (lower);
+
+    return pipeline;
+}
+
+/*
+ * Apply the options one after the other, with the functions above. Used when
+ * the string is not ASCII.
+ */
+static void
+et_scan_pipeline_apply_utf8 (const EtScanPipeline *pipeline,
+                             const gchar *string,
+                             GString *buffer)
+{
+    const EtScanPipelineFlags flags = pipeline->flags;
+    gchar *str;
+    gchar *res;
+
+    str = g_strdup (string);
+
+    if (flags & ET_SCAN_PIPELINE_CONVERT_SPACES)
+    {
+        Scan_Convert_Underscore_Into_Space (str);
+        Scan_Convert_P20_Into_Space (str);
+    }
+    else if (flags & ET_SCAN_PIPELINE_CONVERT_UNDERSCORES)
+    {
+        Scan_Convert_Space_Into_Underscore (str);
+    }
+
+    if (flags & ET_SCAN_PIPELINE_INSERT_SPACES)
+    {
+        res = Scan_Process_Fields_Insert_Space (str);
+        g_free (str);
+        str = res;
+    }
+
+    if (flags & ET_SCAN_PIPELINE_KEEP_ONE_SPACE)
+    {
+        Scan_Process_Fields_Keep_One_Space (str);
+    }
+
+    if (flags & ET_SCAN_PIPELINE_UPPERCASE_ALL)
+    {
+        res = Scan_Process_Fields_All_Uppercase (str);
+        g_free (str);
+        str = res;
+    }
+
+    if (flags & ET_SCAN_PIPELINE_LOWERCASE_ALL)
+    {
+        res = Scan_Process_Fields_All_Downcase (str);
+        g_free (str);
+        str = res;
+    }
+
+    if (flags & ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTER)
+    {
+        res = Scan_Process_Fields_Letter_Uppercase (str);
+        g_free (str);
+        str = res;
+    }
+
+    if (flags & ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTERS)
+    {
+        Scan_Process_Fields_First_Letters_Uppercase (&str,
+                                                     flags & ET_SCAN_PIPELINE_UPPERCASE_PREPOSITIONS,
+                                                     flags & ET_SCAN_PIPELINE_DETECT_ROMAN_NUMERALS);
+    }
+
+    if (flags & ET_SCAN_PIPELINE_REMOVE_SPACES)
+    {
+        Scan_Process_Fields_Remove_Space (str);
+    }
+
+    g_string_assign (buffer, str);
+    g_free (str);
+}
+
+/*
+ * The ASCII version of Scan_Process_Fields_Letter_Uppercase(), in place.
+ */
+static void
+letter_uppercase_ascii (gchar *string)
+{
+    gchar *p;
+
+    if (*string == '\0')
+    {
+        return;
+    }
+
+    string[0] = g_ascii_toupper (string[0]);
+
+    for (p = string + 1; *p; p++)
+    {
+        *p = g_ascii_tolower (*p);
+
+        /* Uppercase the word 'I' in english */
+        if ((p[-1] == ' ' || p[-1] == '_') && *p == 'i'
+            && (p[1] == ' ' || p[1] == '_'))
+        {
+            *p = 'I';
+        }
+    }
+}
+
+/*
+ * Apply the options to the ASCII @string. The conversions, the insertion and
+ * removal of spaces and the changes of case of all the letters are done in a
+ * single pass, as each of them only depends on the characters before. The
+ * options which look at whole words are then applied in place.
+ */
+static void
+et_scan_pipeline_apply_ascii (const EtScanPipeline *pipeline,
+                              const gchar *string,
+                              GString *buffer)
+{
+    const EtScanPipelineFlags flags = pipeline->flags;
+    const gboolean words = (flags & (ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTER
+                                     | ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTERS)) != 0;
+    gboolean first = TRUE;
+    gboolean in_run = FALSE;
+    const gchar *p;
+
+    for (p = string; *p; p++)
+    {
+        gchar chars[2];
+        gsize n_chars = 0;
+        gsize i;
+        gchar c = *p;
+
+        if (flags & ET_SCAN_PIPELINE_CONVERT_SPACES)
+        {
+            if (c == '_')
+            {
+                c = ' ';
+            }
+            else if (c == '%' && p[1] == '2' && p[2] == '0')
+            {
+                c = ' ';
+                p += 2;
+            }
+        }
+        else if ((flags & ET_SCAN_PIPELINE_CONVERT_UNDERSCORES) && c == ' ')
+        {
+            c = '_';
+        }
+
+        if ((flags & ET_SCAN_PIPELINE_INSERT_SPACES) && !first
+            && g_ascii_isupper (c))
+        {
+            chars[n_chars++] = ' ';
+        }
+
+        chars[n_chars++] = c;
+        first = FALSE;
+
+        for (i = 0; i < n_chars; i++)
+        {
+            c = chars[i];
+
+            if (flags & ET_SCAN_PIPELINE_KEEP_ONE_SPACE)
+            {
+                const gboolean separator = (c == ' ' || c == '_');
+
+                /* Keep the first of consecutive separators. */
+                if (separator && in_run)
+                {
+                    continue;
+                }
+
+                in_run = separator;
+            }
+
+            if (flags & ET_SCAN_PIPELINE_UPPERCASE_ALL)
+            {
+                c = g_ascii_toupper (c);
+            }
+
+            if (flags & ET_SCAN_PIPELINE_LOWERCASE_ALL)
+            {
+                c = g_ascii_tolower (c);
+            }
+
+            /* Spaces are only removed last, as words are separated by them. */
+            if ((flags & ET_SCAN_PIPELINE_REMOVE_SPACES) && !words && c == ' ')
+            {
+                continue;
+            }
+
+            g_string_append_c (buffer, c);
+        }
+    }
+
+    if (flags & ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTER)
+    {
+        letter_uppercase_ascii (buffer->str);
+    }
+
+    if (flags & ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTERS)
+    {
+        gsize i;
+
+        for (i = 0; i < buffer->len; i++)
+        {
+            buffer->str[i] = g_ascii_tolower (buffer->str[i]);
+        }
+
+        first_letters_uppercase (buffer->str,
+                                 flags & ET_SCAN_PIPELINE_UPPERCASE_PREPOSITIONS,
+                                 flags & ET_SCAN_PIPELINE_DETECT_ROMAN_NUMERALS);
+        g_string_truncate (buffer, strlen (buffer->str));
+    }
+
+    if ((flags & ET_SCAN_PIPELINE_REMOVE_SPACES) && words)
+    {
+        Scan_Process_Fields_Remove_Space (buffer->str);
+        g_string_truncate (buffer, strlen (buffer->str));
+    }
+}
+
+/*
+ * et_scan_pipeline_apply:
+ * @pipeline: the pipeline
+ * @string: the UTF-8 string to process
+ * @buffer: the buffer to store the result in, which can be reused from one
+ *          call to the next
+ *
+ * Apply the options of @pipeline to @string, with the same result as applying
+ * the Scan_Process_Fields_*() functions one after the other. @pipeline is not
+ * modified, so it can be shared between threads, each with its own @buffer.
+ */
+void
+et_scan_pipeline_apply (const EtScanPipeline *pipeline,
+                        const gchar *string,
+                        GString *buffer)
+{
+    gchar *replaced = NULL;
+    const gchar *p;
+
+    g_return_if_fail (pipeline != NULL);
+    g_return_if_fail (string != NULL);
+    g_return_if_fail (buffer != NULL);
+
+    g_string_truncate (buffer, 0);
+
+    if (pipeline->regex)
+    {
+        GError *error = NULL;
+
+        replaced = g_regex_replace (pipeline->regex, string, -1, 0,
+                                    pipeline->replacement, 0, &error);
+
+        if (error != NULL)
+        {
+            /* Leave the string as it is, as before. */
+            g_debug ("Error while converting characters: %s", error->message);
+            g_error_free (error);
+            g_free (replaced);
+            replaced = NULL;
+        }
+        else
+        {
+            string = replaced;
+        }
+    }
+
+    if (*string == '\0')
+    {
+        g_free (replaced);
+        return;
+    }
+
+    for (p = string; *p; p++)
+    {
+        if ((guchar)*p >= 0x80)
+        {
+            break;
+        }
+    }
+
+    if (*p == '\0' && (pipeline->ascii_casing
+                       || !(pipeline->flags & ET_SCAN_PIPELINE_CASING)))
+    {
+        et_scan_pipeline_apply_ascii (pipeline, string, buffer);
+    }
+    else
+    {
+        et_scan_pipeline_apply_utf8 (pipeline, string, buffer);
+    }
+
+    g_free (replaced);
+}
+
+/*
+ * et_scan_pipeline_free:
+ * @pipeline: the pipeline to free
+ *
+ * Free the pipeline.
+ */
+void
+et_scan_pipeline_free (EtScanPipeline *pipeline)
+{
+    g_return_if_fail (pipeline != NULL);
+
+    if (pipeline->regex)
+    {
+        g_regex_unref (pipeline->regex);
+    }
+
+    g_free (pipeline->replacement);
+    g_slice_free (EtScanPipeline, pipeline);
+}
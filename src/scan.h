@@ -35,6 +35,56 @@ gchar* Scan_Process_Fields_All_Downcase (const gchar *string);
 gchar* Scan_Process_Fields_Letter_Uppercase (const gchar *string);
 void Scan_Process_Fields_First_Letters_Uppercase (gchar **str, gboolean uppercase_preps, gboolean handle_roman);
 
+/*
+ * EtScanPipelineFlags:
+ * @ET_SCAN_PIPELINE_CONVERT_SPACES: convert underscores and '%20' to spaces
+ * @ET_SCAN_PIPELINE_CONVERT_UNDERSCORES: convert spaces to underscores
+ * @ET_SCAN_PIPELINE_CONVERT_CHARACTERS: replace the matches of a regular
+ *                                       expression
+ * @ET_SCAN_PIPELINE_INSERT_SPACES: insert a space before uppercase letters
+ * @ET_SCAN_PIPELINE_KEEP_ONE_SPACE: remove duplicate spaces and underscores
+ * @ET_SCAN_PIPELINE_UPPERCASE_ALL: convert to uppercase
+ * @ET_SCAN_PIPELINE_LOWERCASE_ALL: convert to lowercase
+ * @ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTER: uppercase the first letter only
+ * @ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTERS: uppercase the first letter of
+ *                                           each word
+ * @ET_SCAN_PIPELINE_UPPERCASE_PREPOSITIONS: also uppercase prepositions, with
+ *                                          %ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTERS
+ * @ET_SCAN_PIPELINE_DETECT_ROMAN_NUMERALS: uppercase Roman numerals, with
+ *                                         %ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTERS
+ * @ET_SCAN_PIPELINE_REMOVE_SPACES: remove all spaces
+ *
+ * The process-fields options, which are applied in this order. At most one
+ * of the conversions may be set.
+ */
+typedef enum
+{
+    ET_SCAN_PIPELINE_CONVERT_SPACES = 1 << 0,
+    ET_SCAN_PIPELINE_CONVERT_UNDERSCORES = 1 << 1,
+    ET_SCAN_PIPELINE_CONVERT_CHARACTERS = 1 << 2,
+    ET_SCAN_PIPELINE_INSERT_SPACES = 1 << 3,
+    ET_SCAN_PIPELINE_KEEP_ONE_SPACE = 1 << 4,
+    ET_SCAN_PIPELINE_UPPERCASE_ALL = 1 << 5,
+    ET_SCAN_PIPELINE_LOWERCASE_ALL = 1 << 6,
+    ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTER = 1 << 7,
+    ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTERS = 1 << 8,
+    ET_SCAN_PIPELINE_UPPERCASE_PREPOSITIONS = 1 << 9,
+    ET_SCAN_PIPELINE_DETECT_ROMAN_NUMERALS = 1 << 10,
+    ET_SCAN_PIPELINE_REMOVE_SPACES = 1 << 11
+} EtScanPipelineFlags;
+
+/*
+ * EtScanPipeline:
+ *
+ * A set of process-fields options, compiled once to be applied to many
+ * strings, possibly from several threads at once.
+ */
+typedef struct _EtScanPipeline EtScanPipeline;
+
+EtScanPipeline * et_scan_pipeline_new (EtScanPipelineFlags flags, const gchar *convert_from, const gchar *convert_to, GError **error);
+void et_scan_pipeline_apply (const EtScanPipeline *pipeline, const gchar *string, GString *buffer);
+void et_scan_pipeline_free (EtScanPipeline *pipeline);
+
 G_END_DECLS
 
 #endif /* !ET_SCAN_H_ */
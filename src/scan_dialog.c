@@ -212,7 +212,6 @@ struct _Scan_Mask_Item
 static void Scan_Option_Button (void);
 static void entry_check_scan_tag_mask (GtkEntry *entry, gpointer user_data);
 
-static GList *Scan_Generate_New_Tag_From_Mask (ET_File *ETFile, gchar *mask);
 static void Scan_Free_File_Rename_List (GList *list);
 static void Scan_Free_File_Fill_Tag_List (GList *list);
 
@@ -354,398 +353,641 @@ et_scan_dialog_set_file_tag_for_mask_item (File_Tag *file_tag,
 }
 
 /*
- * Uses the filename and path to fill tag information
- * Note: mask and source are read from the right to the left
+ * EtScanFillCode:
+ * @code: the code of the mask, without the '%'
+ * @leading: (allow-none): the text before the code, which is only set for the
+ *           first code of a directory level
+ * @separator: (allow-none): the text between the code and the next one, or
+ *             %NULL if the code is the last of its directory level
  */
-static void
-Scan_Tag_With_Mask (EtScanDialog *self, ET_File *ETFile)
+typedef struct
 {
-    EtScanDialogPrivate *priv;
-    GList *fill_tag_list = NULL;
-    GList *l;
-    gchar *mask; // The 'mask' in the entry
-    gchar *filename_utf8;
-    File_Tag *FileTag;
+    gchar code;
+    gchar *leading;
+    gchar *separator;
+} EtScanFillCode;
 
-    g_return_if_fail (ETFile != NULL);
+/*
+ * EtScanFillMask:
+ * @segments: (element-type GArray): one #GArray of #EtScanFillCode for each
+ *            directory level of the mask
+ * @convert_mode: the conversion of the spaces in the filename
+ * @overwrite: whether to overwrite the fields which are already filled
+ * @default_comment: (allow-none): the comment to set, if any
+ * @crc32_comment: whether to set the CRC-32 of the file as comment
+ *
+ * A fill tag mask, compiled once with the settings resolved, so that it can
+ * be applied to many files without parsing the mask again.
+ */
+typedef struct
+{
+    GPtrArray *segments;
+    EtConvertSpaces convert_mode;
+    gboolean overwrite;
+    gchar *default_comment;
+    gboolean crc32_comment;
+    /* ET_File to its CRC32 comment, calculated beforehand for a selection. */
+    GHashTable *crc32_comments;
+} EtScanFillMask;
 
-    priv = et_scan_dialog_get_instance_private (self);
+static void
+et_scan_fill_code_clear (gpointer data)
+{
+    EtScanFillCode *code = data;
 
-    mask = g_strdup (gtk_entry_get_text (GTK_ENTRY (gtk_bin_get_child (GTK_BIN (priv->fill_combo)))));
-    if (!mask) return;
+    g_free (code->leading);
+    g_free (code->separator);
+}
 
-    // Create a new File_Tag item
-    FileTag = et_file_tag_new ();
-    et_file_tag_copy_into (FileTag, ETFile->FileTag->data);
+/*
+ * et_scan_fill_mask_new:
+ * @mask_text: the mask, as entered by the user
+ *
+ * Compile @mask_text with the current settings of the scanner.
+ *
+ * Returns: a new mask, to be freed with et_scan_fill_mask_free()
+ */
+static EtScanFillMask *
+et_scan_fill_mask_new (const gchar *mask_text)
+{
+    EtScanFillMask *mask;
+    gchar *text;
+    gchar **segments;
+    gsize i;
 
-    // Process this mask with file
-    fill_tag_list = Scan_Generate_New_Tag_From_Mask(ETFile,mask);
+    mask = g_slice_new0 (EtScanFillMask);
+    mask->segments = g_ptr_array_new_with_free_func ((GDestroyNotify)g_array_unref);
+    mask->convert_mode = g_settings_get_enum (MainSettings,
+                                              "fill-convert-spaces");
+    mask->overwrite = g_settings_get_boolean (MainSettings,
+                                              "fill-overwrite-tag-fields");
+    mask->crc32_comment = g_settings_get_boolean (MainSettings,
+                                                  "fill-crc32-comment");
 
-    for (l = fill_tag_list; l != NULL; l = g_list_next (l))
+    if (g_settings_get_boolean (MainSettings, "fill-set-default-comment"))
     {
-        const Scan_Mask_Item *mask_item = l->data;
-
-        /* We display the text affected to the code. */
-        et_scan_dialog_set_file_tag_for_mask_item (FileTag, mask_item,
-                                                   g_settings_get_boolean (MainSettings,
-                                                                           "fill-overwrite-tag-fields"));
-
+        mask->default_comment = g_settings_get_string (MainSettings,
+                                                       "fill-default-comment");
     }
 
-    Scan_Free_File_Fill_Tag_List(fill_tag_list);
+    /* Replace characters into mask before parsing. */
+    text = g_strdup (mask_text);
 
-    /* Set the default text to comment. */
-    if (g_settings_get_boolean (MainSettings, "fill-set-default-comment")
-        && (g_settings_get_boolean (MainSettings, "fill-overwrite-tag-fields")
-            || et_str_empty (FileTag->comment)))
+    switch (mask->convert_mode)
     {
-        gchar *default_comment = g_settings_get_string (MainSettings,
-                                                        "fill-default-comment");
-        et_file_tag_set_comment  (FileTag, default_comment);
-        g_free (default_comment);
+        case ET_CONVERT_SPACES_SPACES:
+            Scan_Convert_Underscore_Into_Space (text);
+            Scan_Convert_P20_Into_Space (text);
+            break;
+        case ET_CONVERT_SPACES_UNDERSCORES:
+            Scan_Convert_Space_Into_Underscore (text);
+            break;
+        case ET_CONVERT_SPACES_NO_CHANGE:
+            break;
+        /* FIXME: Check if this is intentional. */
+        case ET_CONVERT_SPACES_REMOVE:
+        default:
+            g_assert_not_reached ();
     }
 
-    /* Set CRC-32 value as default comment (for files with ID3 tag only). */
-    if (g_settings_get_boolean (MainSettings, "fill-crc32-comment")
-        && (g_settings_get_boolean (MainSettings, "fill-overwrite-tag-fields")
-            || et_str_empty (FileTag->comment)))
+    /* Each directory level of the mask is matched against the same level of
+     * the filename, so keep the empty levels too. */
+    segments = g_strsplit (text, G_DIR_SEPARATOR_S, 0);
+
+    for (i = 0; segments[i] != NULL; i++)
     {
-        GFile *file;
-        GError *error = NULL;
-        guint32 crc32_value;
-        gchar *buffer;
+        GArray *codes;
+        const gchar *mask_seq = segments[i];
 
-        if (ETFile->ETFileDescription == ID3_TAG)
+        codes = g_array_new (FALSE, FALSE, sizeof (EtScanFillCode));
+        g_array_set_clear_func (codes, et_scan_fill_code_clear);
+
+        while (!et_str_empty (mask_seq))
         {
-            file = g_file_new_for_path (((File_Name *)((GList *)ETFile->FileNameNew)->data)->value);
+            EtScanFillCode code;
+            const gchar *tmp;
 
-            if (crc32_file_with_ID3_tag (file, &crc32_value, &error))
+            /* Determine (first) code and destination. */
+            if ((tmp = strchr (mask_seq, '%')) == NULL || strlen (tmp) < 2)
             {
-                buffer = g_strdup_printf ("%.8" G_GUINT32_FORMAT,
-                                          crc32_value);
-                et_file_tag_set_comment (FileTag, buffer);
-                g_free(buffer);
+                break;
+            }
+
+            code.code = tmp[1];
+            code.leading = tmp > mask_seq ? g_strndup (mask_seq,
+                                                       tmp - mask_seq)
+                                          : NULL;
+            mask_seq = tmp + 2;
+
+            /* Determine separator between two code or trailing text (after
+             * code). */
+            if (!et_str_empty (mask_seq))
+            {
+                gsize len;
+
+                if ((tmp = strchr (mask_seq, '%')) == NULL
+                    || strlen (tmp) < 2)
+                {
+                    /* No more code found. */
+                    len = strlen (mask_seq);
+                }
+                else
+                {
+                    len = tmp - mask_seq;
+                }
+
+                code.separator = g_strndup (mask_seq, len);
+                mask_seq += len;
             }
             else
             {
-                Log_Print (LOG_ERROR,
-                           _("Cannot calculate CRC value of file ‘%s’"),
-                           error->message);
-                g_error_free (error);
+                code.separator = NULL;
             }
 
-            g_object_unref (file);
+            g_array_append_val (codes, code);
         }
+
+        g_ptr_array_add (mask->segments, codes);
     }
 
+    g_strfreev (segments);
+    g_free (text);
 
-    // Save changes of the 'File_Tag' item
-    ET_Manage_Changes_Of_File_Data(ETFile,NULL,FileTag);
+    return mask;
+}
 
-    g_free(mask);
-    et_application_window_status_bar_message (ET_APPLICATION_WINDOW (MainWindow),
-                                              _("Tag successfully scanned"),
-                                              TRUE);
-    filename_utf8 = g_path_get_basename( ((File_Name *)ETFile->FileNameNew->data)->value_utf8 );
-    Log_Print (LOG_OK, _("Tag successfully scanned ‘%s’"), filename_utf8);
-    g_free(filename_utf8);
+static void
+et_scan_fill_mask_free (EtScanFillMask *mask)
+{
+    g_ptr_array_unref (mask->segments);
+    g_free (mask->default_comment);
+
+    if (mask->crc32_comments)
+    {
+        g_hash_table_destroy (mask->crc32_comments);
+    }
+
+    g_slice_free (EtScanFillMask, mask);
 }
 
+/*
+ * et_scan_fill_mask_apply:
+ * @mask: the compiled mask
+ * @ETFile: the file to scan
+ *
+ * Match @mask against the new filename of @ETFile, from the right to the left
+ * for the directory levels.
+ *
+ * Returns: (element-type Scan_Mask_Item): the list of fields which were found,
+ *          to be freed with Scan_Free_File_Fill_Tag_List()
+ */
 static GList *
-Scan_Generate_New_Tag_From_Mask (ET_File *ETFile, gchar *mask)
+et_scan_fill_mask_apply (const EtScanFillMask *mask,
+                         const ET_File *ETFile)
 {
     GList *fill_tag_list = NULL;
     gchar *filename_utf8;
     gchar *tmp;
-    gchar *buf;
-    gchar *separator;
-    gchar *string;
-    gsize len, i, loop=0;
-    gchar **mask_splitted;
     gchar **file_splitted;
-    guint mask_splitted_number;
     guint file_splitted_number;
     guint mask_splitted_index;
     guint file_splitted_index;
-    Scan_Mask_Item *mask_item;
-    EtConvertSpaces convert_mode;
+    gsize i;
 
-    g_return_val_if_fail (ETFile != NULL && mask != NULL, NULL);
-
-    filename_utf8 = g_strdup(((File_Name *)((GList *)ETFile->FileNameNew)->data)->value_utf8);
+    filename_utf8 = g_strdup (((File_Name *)((GList *)ETFile->FileNameNew)->data)->value_utf8);
     if (!filename_utf8) return NULL;
 
-    // Remove extension of file (if found)
-    tmp = strrchr(filename_utf8,'.');
-    for (i = 0; i <= ET_FILE_DESCRIPTION_SIZE; i++)
+    /* Remove extension of file (if found). */
+    tmp = strrchr (filename_utf8, '.');
+
+    for (i = 0; tmp != NULL && i < ET_FILE_DESCRIPTION_SIZE; i++)
     {
-        if ( strcasecmp(tmp,ETFileDescription[i].Extension)==0 )
+        if (strcasecmp (tmp, ETFileDescription[i].Extension) == 0)
         {
-            *tmp = 0; //strrchr(source,'.') = 0;
+            *tmp = 0;
             break;
         }
     }
 
-    if (i==ET_FILE_DESCRIPTION_SIZE)
+    if (i == ET_FILE_DESCRIPTION_SIZE)
     {
-        gchar *tmp1 = g_path_get_basename(filename_utf8);
+        gchar *tmp1 = g_path_get_basename (filename_utf8);
         Log_Print (LOG_ERROR,
                    _("The extension ‘%s’ was not found in filename ‘%s’"), tmp,
                    tmp1);
-        g_free(tmp1);
+        g_free (tmp1);
     }
 
-    /* Replace characters into mask and filename before parsing. */
-    convert_mode = g_settings_get_enum (MainSettings, "fill-convert-spaces");
-
-    switch (convert_mode)
+    /* Replace characters into filename before parsing, as was done for the
+     * mask. */
+    switch (mask->convert_mode)
     {
         case ET_CONVERT_SPACES_SPACES:
-            Scan_Convert_Underscore_Into_Space (mask);
             Scan_Convert_Underscore_Into_Space (filename_utf8);
-            Scan_Convert_P20_Into_Space (mask);
             Scan_Convert_P20_Into_Space (filename_utf8);
             break;
         case ET_CONVERT_SPACES_UNDERSCORES:
-            Scan_Convert_Space_Into_Underscore (mask);
             Scan_Convert_Space_Into_Underscore (filename_utf8);
             break;
         case ET_CONVERT_SPACES_NO_CHANGE:
-            break;
-        /* FIXME: Check if this is intentional. */
         case ET_CONVERT_SPACES_REMOVE:
         default:
-            g_assert_not_reached ();
+            break;
     }
 
-    // Split the Scanner mask
-    mask_splitted = g_strsplit(mask,G_DIR_SEPARATOR_S,0);
-    // Get number of arguments into 'mask_splitted'
-    for (mask_splitted_number=0;mask_splitted[mask_splitted_number];mask_splitted_number++);
+    /* Split the File Path. */
+    file_splitted = g_strsplit (filename_utf8, G_DIR_SEPARATOR_S, 0);
+    file_splitted_number = g_strv_length (file_splitted);
 
-    // Split the File Path
-    file_splitted = g_strsplit(filename_utf8,G_DIR_SEPARATOR_S,0);
-    // Get number of arguments into 'file_splitted'
-    for (file_splitted_number=0;file_splitted[file_splitted_number];file_splitted_number++);
-
-    // Set the starting position for each tab
-    if (mask_splitted_number <= file_splitted_number)
+    /* Set the starting position for each tab. */
+    if (mask->segments->len <= file_splitted_number)
     {
         mask_splitted_index = 0;
-        file_splitted_index = file_splitted_number - mask_splitted_number;
-    }else
+        file_splitted_index = file_splitted_number - mask->segments->len;
+    }
+    else
     {
-        mask_splitted_index = mask_splitted_number - file_splitted_number;
+        mask_splitted_index = mask->segments->len - file_splitted_number;
         file_splitted_index = 0;
     }
 
-    loop = 0;
-    while ( mask_splitted[mask_splitted_index]!= NULL && file_splitted[file_splitted_index]!=NULL )
+    for (; mask_splitted_index < mask->segments->len
+           && file_splitted[file_splitted_index] != NULL;
+         mask_splitted_index++, file_splitted_index++)
     {
-        gchar *mask_seq = mask_splitted[mask_splitted_index];
-        gchar *file_seq = file_splitted[file_splitted_index];
-        gchar *file_seq_utf8 = g_filename_display_name (file_seq);
+        const GArray *codes = g_ptr_array_index (mask->segments,
+                                                 mask_splitted_index);
+        const gchar *file_seq = file_splitted[file_splitted_index];
 
-        //g_print(">%d> seq '%s' '%s'\n",loop,mask_seq,file_seq);
-        while (!et_str_empty (mask_seq))
+        for (i = 0; i < codes->len; i++)
         {
+            const EtScanFillCode *code = &g_array_index (codes,
+                                                         EtScanFillCode, i);
+            Scan_Mask_Item *mask_item;
 
-            /*
-             * Determine (first) code and destination
-             */
-            if ( (tmp=strchr(mask_seq,'%')) == NULL || strlen(tmp) < 2 )
-            {
-                break;
-            }
-
-            /*
-             * Allocate a new iten for the fill_tag_list
-             */
             mask_item = g_slice_new0 (Scan_Mask_Item);
+            mask_item->code = code->code;
 
-            // Get the code (used to determine the corresponding target entry)
-            mask_item->code = tmp[1];
-
-            /*
-             * Delete text before the code
-             */
-            if ( (len = strlen(mask_seq) - strlen(tmp)) > 0 )
+            /* Delete text before the code. */
+            if (code->leading)
             {
-                // Get this text in 'mask_seq'
-                buf = g_strndup(mask_seq,len);
-                // We remove it in 'mask_seq'
-                mask_seq = mask_seq + len;
-                // Find the same text at the begining of 'file_seq' ?
-                if ( (strstr(file_seq,buf)) == file_seq )
+                /* Find the same text at the begining of 'file_seq'? */
+                if (g_str_has_prefix (file_seq, code->leading))
                 {
-                    file_seq = file_seq + len; // We remove it
-                }else
+                    file_seq += strlen (code->leading);
+                }
+                else
                 {
                     Log_Print (LOG_ERROR,
                                _("Cannot find separator ‘%s’ within ‘%s’"),
-                               buf, file_seq_utf8);
+                               code->leading,
+                               file_splitted[file_splitted_index]);
                 }
-                g_free(buf);
             }
 
-            // Remove the current code into 'mask_seq'
-            mask_seq = mask_seq + 2;
-
-            /*
-             * Determine separator between two code or trailing text (after code)
-             */
-            if (!et_str_empty (mask_seq))
+            if (code->separator)
             {
-                if ( (tmp=strchr(mask_seq,'%')) == NULL || strlen(tmp) < 2 )
-                {
-                    // No more code found
-                    len = strlen(mask_seq);
-                }else
-                {
-                    len = strlen(mask_seq) - strlen(tmp);
-                }
-                separator = g_strndup(mask_seq,len);
-
-                // Remove the current separator in 'mask_seq'
-                mask_seq = mask_seq + len;
-
-                // Try to find the separator in 'file_seq'
-                if ( (tmp=strstr(file_seq,separator)) == NULL )
+                /* Try to find the separator in 'file_seq'. */
+                if ((tmp = strstr (file_seq, code->separator)) == NULL)
                 {
                     Log_Print (LOG_ERROR,
                                _("Cannot find separator ‘%s’ within ‘%s’"),
-                               separator, file_seq_utf8);
-                    separator[0] = 0; // Needed to avoid error when calculting 'len' below
-                }
+                               code->separator,
+                               file_splitted[file_splitted_index]);
 
-                // Get the string affected to the code (or the corresponding entry field)
-                len = strlen(file_seq) - (tmp!=NULL?strlen(tmp):0);
-                string = g_strndup(file_seq,len);
-
-                // Remove the current separator in 'file_seq'
-                file_seq = file_seq + strlen(string) + strlen(separator);
-                g_free(separator);
-
-                // We get the text affected to the code
-                mask_item->string = string;
-            }else
+                    /* Use the remaining text. */
+                    mask_item->string = g_strdup (file_seq);
+                    file_seq += strlen (file_seq);
+                }
+                else
+                {
+                    /* Get the string affected to the code. */
+                    mask_item->string = g_strndup (file_seq, tmp - file_seq);
+                    file_seq = tmp + strlen (code->separator);
+                }
+            }
+            else
             {
-                // We display the remaining text, affected to the code (no more data in 'mask_seq')
-                mask_item->string = g_strdup(file_seq);
+                /* We display the remaining text, affected to the code (no
+                 * more data in the mask). */
+                mask_item->string = g_strdup (file_seq);
             }
 
-            // Add the filled mask_iten to the list
-            fill_tag_list = g_list_append(fill_tag_list,mask_item);
+            fill_tag_list = g_list_prepend (fill_tag_list, mask_item);
         }
-
-        g_free(file_seq_utf8);
-
-        // Next sequences
-        mask_splitted_index++;
-        file_splitted_index++;
-        loop++;
     }
 
-    g_free(filename_utf8);
-    g_strfreev(mask_splitted);
-    g_strfreev(file_splitted);
+    g_free (filename_utf8);
+    g_strfreev (file_splitted);
 
-    // The 'fill_tag_list' must be freed after use
-    return fill_tag_list;
+    /* The 'fill_tag_list' must be freed after use. */
+    return g_list_reverse (fill_tag_list);
 }
 
+/*
+ * et_scan_fill_mask_apply_to_file:
+ * @mask: the compiled mask
+ * @ETFile: the file to scan
+ *
+ * Uses the filename and path to fill tag information.
+ */
 static void
-Scan_Fill_Tag_Generate_Preview (EtScanDialog *self)
+et_scan_fill_mask_apply_to_file (const EtScanFillMask *mask,
+                                 ET_File *ETFile)
 {
-    EtScanDialogPrivate *priv;
-    gchar *mask = NULL;
-    gchar *preview_text = NULL;
-    GList *fill_tag_list = NULL;
+    GList *fill_tag_list;
     GList *l;
+    File_Tag *FileTag;
 
-    priv = et_scan_dialog_get_instance_private (self);
-
-    if (!ETCore->ETFileDisplayedList
-        || gtk_notebook_get_current_page (GTK_NOTEBOOK (priv->notebook)) != ET_SCAN_MODE_FILL_TAG)
-        return;
+    // Create a new File_Tag item
+    FileTag = et_file_tag_new ();
+    et_file_tag_copy_into (FileTag, ETFile->FileTag->data);
 
-    mask = g_strdup (gtk_entry_get_text (GTK_ENTRY (gtk_bin_get_child (GTK_BIN (priv->fill_combo)))));
-    if (!mask)
-        return;
+    // Process this mask with file
+    fill_tag_list = et_scan_fill_mask_apply (mask, ETFile);
 
-    preview_text = g_strdup("");
-    fill_tag_list = Scan_Generate_New_Tag_From_Mask(ETCore->ETFileDisplayed,mask);
     for (l = fill_tag_list; l != NULL; l = g_list_next (l))
     {
-        Scan_Mask_Item *mask_item = l->data;
-        gchar *tmp_code   = g_strdup_printf("%c",mask_item->code);
-        gchar *tmp_string = g_markup_printf_escaped("%s",mask_item->string); // To avoid problem with strings containing characters like '&'
-        gchar *tmp_preview_text = preview_text;
-
-        preview_text = g_strconcat(tmp_preview_text,"<b>","%",tmp_code," = ",
-                                   "</b>","<i>",tmp_string,"</i>",NULL);
-        g_free(tmp_code);
-        g_free(tmp_string);
-        g_free(tmp_preview_text);
+        const Scan_Mask_Item *mask_item = l->data;
 
-        tmp_preview_text = preview_text;
-        preview_text = g_strconcat(tmp_preview_text,"  ||  ",NULL);
-        g_free(tmp_preview_text);
+        /* We display the text affected to the code. */
+        et_scan_dialog_set_file_tag_for_mask_item (FileTag, mask_item,
+                                                   mask->overwrite);
     }
 
     Scan_Free_File_Fill_Tag_List(fill_tag_list);
 
-    if (GTK_IS_LABEL (priv->fill_preview_label))
+    /* Set the default text to comment. */
+    if (mask->default_comment
+        && (mask->overwrite || et_str_empty (FileTag->comment)))
     {
-        if (preview_text)
-        {
-            //gtk_label_set_text(GTK_LABEL(priv->fill_preview_label),preview_text);
-            gtk_label_set_markup (GTK_LABEL (priv->fill_preview_label),
-                                  preview_text);
-        } else
+        et_file_tag_set_comment (FileTag, mask->default_comment);
+    }
+
+    /* Set CRC-32 value as default comment (for files with ID3 tag only). */
+    if (mask->crc32_comment
+        && (mask->overwrite || et_str_empty (FileTag->comment))
+        && ETFile->ETFileDescription == ID3_TAG)
+    {
+        if (mask->crc32_comments)
         {
-            gtk_label_set_text (GTK_LABEL (priv->fill_preview_label), "");
+            const gchar *comment;
+
+            /* Files which could not be read were already logged. */
+            comment = g_hash_table_lookup (mask->crc32_comments, ETFile);
+
+            if (comment)
+            {
+                et_file_tag_set_comment (FileTag, comment);
+            }
         }
+        else
+        {
+            GFile *file;
+            GError *error = NULL;
+            guint32 crc32_value;
 
-        /* Force the window to be redrawn. */
-        gtk_widget_queue_resize (GTK_WIDGET (self));
+            file = g_file_new_for_path (((File_Name *)ETFile->FileNameCur->data)->value);
+
+            if (et_crc32_file_cached (file, &crc32_value, &error))
+            {
+                gchar *buffer;
+
+                buffer = g_strdup_printf ("%.8" G_GUINT32_FORMAT,
+                                          crc32_value);
+                et_file_tag_set_comment (FileTag, buffer);
+                g_free (buffer);
+            }
+            else
+            {
+                Log_Print (LOG_ERROR,
+                           _("Cannot calculate CRC value of file ‘%s’: %s"),
+                           ((File_Name *)ETFile->FileNameCur->data)->value_utf8,
+                           error->message);
+                g_error_free (error);
+            }
+
+            g_object_unref (file);
+        }
     }
 
-    g_free(mask);
-    g_free(preview_text);
+    // Save changes of the 'File_Tag' item
+    ET_Manage_Changes_Of_File_Data(ETFile,NULL,FileTag);
 }
 
+/*
+ * et_scan_fill_mask_compute_crc32:
+ * @mask: the compiled mask
+ * @files: (element-type ET_File): the files which will be scanned
+ *
+ * Calculate the CRC32 comments of @files beforehand, on a few worker threads,
+ * so that et_scan_fill_mask_apply_to_file() does not read the files one by
+ * one. The main loop keeps running to show the progress, and the stop action
+ * skips the files which have not been read yet.
+ */
 static void
-Scan_Rename_File_Generate_Preview (EtScanDialog *self)
+et_scan_fill_mask_compute_crc32 (EtScanFillMask *mask,
+                                 GList *files)
 {
-    EtScanDialogPrivate *priv;
-    gchar *preview_text = NULL;
-    gchar *mask = NULL;
+    EtApplicationWindow *window;
+    EtCrc32Job *job;
+    GList *etfiles = NULL;
+    GList *gfiles = NULL;
+    GList *l;
+    guint n_files = 0;
+    guint i;
 
-    priv = et_scan_dialog_get_instance_private (self);
+    mask->crc32_comments = g_hash_table_new_full (NULL, NULL, NULL, g_free);
 
-    if (!ETCore->ETFileDisplayed || !priv->rename_combo
-        || !priv->rename_preview_label)
+    for (l = files; l != NULL; l = g_list_next (l))
     {
-        return;
+        ET_File *ETFile = l->data;
+        const File_Tag *FileTag = ETFile->FileTag->data;
+
+        /* Filling the mask never empties a comment, so a file with a comment
+         * only gets the CRC32 if the fields are overwritten. */
+        if (ETFile->ETFileDescription != ID3_TAG
+            || !(mask->overwrite || et_str_empty (FileTag->comment)))
+        {
+            continue;
+        }
+
+        etfiles = g_list_prepend (etfiles, ETFile);
+        gfiles = g_list_prepend (gfiles,
+                                 g_file_new_for_path (((File_Name *)ETFile->FileNameCur->data)->value));
+        n_files++;
     }
 
-    if (gtk_notebook_get_current_page (GTK_NOTEBOOK (priv->notebook)) != ET_SCAN_MODE_RENAME_FILE)
+    if (n_files == 0)
+    {
         return;
+    }
 
-    mask = g_strdup (gtk_entry_get_text (GTK_ENTRY (gtk_bin_get_child (GTK_BIN (priv->rename_combo)))));
-    if (!mask)
-        return;
+    etfiles = g_list_reverse (etfiles);
+    gfiles = g_list_reverse (gfiles);
 
-    preview_text = et_scan_generate_new_filename_from_mask (ETCore->ETFileDisplayed,
-                                                            mask, FALSE);
+    window = ET_APPLICATION_WINDOW (MainWindow);
+    et_application_window_status_bar_message (window,
+                                              _("Calculating CRC values…"),
+                                              FALSE);
 
-    if (GTK_IS_LABEL (priv->rename_preview_label))
+    job = et_crc32_job_new (gfiles, ET_WORKER_JOB_MAX_FILE_THREADS);
+    g_list_free_full (gfiles, g_object_unref);
+
+    if (!et_application_window_run_job (window,
+                                        et_crc32_job_get_worker_job (job)))
     {
-        if (preview_text)
+        Log_Print (LOG_WARNING,
+                   _("CRC values were not calculated for all files"));
+    }
+
+    for (l = etfiles, i = 0; l != NULL; l = g_list_next (l), i++)
+    {
+        const ET_File *ETFile = l->data;
+        GError *error = NULL;
+        guint32 crc32_value;
+
+        if (et_crc32_job_get_result (job, i, &crc32_value, &error))
         {
-            //gtk_label_set_text(GTK_LABEL(priv->rename_preview_label),preview_text);
-            gchar *tmp_string = g_markup_printf_escaped("%s",preview_text); // To avoid problem with strings containing characters like '&'
+            g_hash_table_insert (mask->crc32_comments, l->data,
+                                 g_strdup_printf ("%.8" G_GUINT32_FORMAT,
+                                                  crc32_value));
+        }
+        else
+        {
+            if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            {
+                Log_Print (LOG_ERROR,
+                           _("Cannot calculate CRC value of file ‘%s’: %s"),
+                           ((File_Name *)ETFile->FileNameCur->data)->value_utf8,
+                           error->message);
+            }
+
+            g_error_free (error);
+        }
+    }
+
+    et_crc32_job_free (job);
+    g_list_free (etfiles);
+}
+
+/*
+ * Uses the filename and path to fill tag information
+ * Note: mask and source are read from the right to the left
+ */
+static void
+Scan_Tag_With_Mask (EtScanDialog *self, ET_File *ETFile)
+{
+    EtScanDialogPrivate *priv;
+    EtScanFillMask *mask;
+    gchar *filename_utf8;
+
+    g_return_if_fail (ETFile != NULL);
+
+    priv = et_scan_dialog_get_instance_private (self);
+
+    mask = et_scan_fill_mask_new (gtk_entry_get_text (GTK_ENTRY (gtk_bin_get_child (GTK_BIN (priv->fill_combo)))));
+    et_scan_fill_mask_apply_to_file (mask, ETFile);
+    et_scan_fill_mask_free (mask);
+
+    et_application_window_status_bar_message (ET_APPLICATION_WINDOW (MainWindow),
+                                              _("Tag successfully scanned"),
+                                              TRUE);
+    filename_utf8 = g_path_get_basename( ((File_Name *)ETFile->FileNameNew->data)->value_utf8 );
+    Log_Print (LOG_OK, _("Tag successfully scanned ‘%s’"), filename_utf8);
+    g_free(filename_utf8);
+}
+
+static void
+Scan_Fill_Tag_Generate_Preview (EtScanDialog *self)
+{
+    EtScanDialogPrivate *priv;
+    EtScanFillMask *mask;
+    gchar *preview_text = NULL;
+    GList *fill_tag_list = NULL;
+    GList *l;
+
+    priv = et_scan_dialog_get_instance_private (self);
+
+    if (!ETCore->ETFileDisplayedList
+        || gtk_notebook_get_current_page (GTK_NOTEBOOK (priv->notebook)) != ET_SCAN_MODE_FILL_TAG)
+        return;
+
+    mask = et_scan_fill_mask_new (gtk_entry_get_text (GTK_ENTRY (gtk_bin_get_child (GTK_BIN (priv->fill_combo)))));
+
+    preview_text = g_strdup("");
+    fill_tag_list = et_scan_fill_mask_apply (mask, ETCore->ETFileDisplayed);
+    et_scan_fill_mask_free (mask);
+    for (l = fill_tag_list; l != NULL; l = g_list_next (l))
+    {
+        Scan_Mask_Item *mask_item = l->data;
+        gchar *tmp_code   = g_strdup_printf("%c",mask_item->code);
+        gchar *tmp_string = g_markup_printf_escaped("%s",mask_item->string); // To avoid problem with strings containing characters like '&'
+        gchar *tmp_preview_text = preview_text;
+
+        preview_text = g_strconcat(tmp_preview_text,"<b>","%",tmp_code," = ",
+                                   "</b>","<i>",tmp_string,"</i>",NULL);
+        g_free(tmp_code);
+        g_free(tmp_string);
+        g_free(tmp_preview_text);
+
+        tmp_preview_text = preview_text;
+        preview_text = g_strconcat(tmp_preview_text,"  ||  ",NULL);
+        g_free(tmp_preview_text);
+    }
+
+    Scan_Free_File_Fill_Tag_List(fill_tag_list);
+
+    if (GTK_IS_LABEL (priv->fill_preview_label))
+    {
+        if (preview_text)
+        {
+            //gtk_label_set_text(GTK_LABEL(priv->fill_preview_label),preview_text);
+            gtk_label_set_markup (GTK_LABEL (priv->fill_preview_label),
+                                  preview_text);
+        } else
+        {
+            gtk_label_set_text (GTK_LABEL (priv->fill_preview_label), "");
+        }
+
+        /* Force the window to be redrawn. */
+        gtk_widget_queue_resize (GTK_WIDGET (self));
+    }
+
+    g_free(preview_text);
+}
+
+static void
+Scan_Rename_File_Generate_Preview (EtScanDialog *self)
+{
+    EtScanDialogPrivate *priv;
+    gchar *preview_text = NULL;
+    gchar *mask = NULL;
+
+    priv = et_scan_dialog_get_instance_private (self);
+
+    if (!ETCore->ETFileDisplayed || !priv->rename_combo
+        || !priv->rename_preview_label)
+    {
+        return;
+    }
+
+    if (gtk_notebook_get_current_page (GTK_NOTEBOOK (priv->notebook)) != ET_SCAN_MODE_RENAME_FILE)
+        return;
+
+    mask = g_strdup (gtk_entry_get_text (GTK_ENTRY (gtk_bin_get_child (GTK_BIN (priv->rename_combo)))));
+    if (!mask)
+        return;
+
+    preview_text = et_scan_generate_new_filename_from_mask (ETCore->ETFileDisplayed,
+                                                            mask, FALSE);
+
+    if (GTK_IS_LABEL (priv->rename_preview_label))
+    {
+        if (preview_text)
+        {
+            //gtk_label_set_text(GTK_LABEL(priv->rename_preview_label),preview_text);
+            gchar *tmp_string = g_markup_printf_escaped("%s",preview_text); // To avoid problem with strings containing characters like '&'
             gchar *str = g_strdup_printf("<i>%s</i>",tmp_string);
             gtk_label_set_markup (GTK_LABEL (priv->rename_preview_label), str);
             g_free(tmp_string);
@@ -798,240 +1040,270 @@ Scan_Free_File_Fill_Tag_List (GList *list)
  * Scanner To Rename File *
  **************************/
 /*
- * Uses tag information (displayed into tag entries) to rename file
- * Note: mask and source are read from the right to the left.
- * Note1: a mask code may be used severals times...
+ * EtScanRenameItem:
+ * @type: the type of the item, where %FIELD is resolved for each file
+ * @code: the code of a %FIELD item, without the '%'
+ * @string: (allow-none): the text of a separator item
  */
-static void
-Scan_Rename_File_With_Mask (EtScanDialog *self, ET_File *ETFile)
+typedef struct
 {
-    EtScanDialogPrivate *priv;
-    gchar *filename_generated_utf8 = NULL;
-    gchar *filename_generated = NULL;
-    gchar *filename_new_utf8 = NULL;
-    gchar *mask = NULL;
-    File_Name *FileName;
-
-    g_return_if_fail (ETFile != NULL);
-
-    priv = et_scan_dialog_get_instance_private (self);
-
-    mask = g_strdup (gtk_entry_get_text (GTK_ENTRY (gtk_bin_get_child (GTK_BIN (priv->rename_combo)))));
-    if (!mask) return;
-
-    // Note : if the first character is '/', we have a path with the filename,
-    // else we have only the filename. The both are in UTF-8.
-    filename_generated_utf8 = et_scan_generate_new_filename_from_mask (ETFile,
-                                                                       mask,
-                                                                       FALSE);
-    g_free(mask);
-
-    if (et_str_empty (filename_generated_utf8))
-    {
-        g_free (filename_generated_utf8);
-        return;
-    }
-
-    // Convert filename to file-system encoding
-    filename_generated = filename_from_display(filename_generated_utf8);
-    if (!filename_generated)
-    {
-        GtkWidget *msgdialog;
-        msgdialog = gtk_message_dialog_new (GTK_WINDOW (self),
-                             GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
-                             GTK_MESSAGE_ERROR,
-                             GTK_BUTTONS_CLOSE,
-                             _("Could not convert filename ‘%s’ into system filename encoding"),
-                             filename_generated_utf8);
-        gtk_window_set_title(GTK_WINDOW(msgdialog),_("Filename translation"));
-
-        gtk_dialog_run(GTK_DIALOG(msgdialog));
-        gtk_widget_destroy(msgdialog);
-        g_free(filename_generated_utf8);
-        return;
-    }
-
-    /* Build the filename with the full path or relative to old path */
-    filename_new_utf8 = et_file_generate_name (ETFile,
-                                               filename_generated_utf8);
-    g_free(filename_generated);
-    g_free(filename_generated_utf8);
-
-    /* Set the new filename */
-    /* Create a new 'File_Name' item. */
-    FileName = et_file_name_new ();
-    // Save changes of the 'File_Name' item
-    ET_Set_Filename_File_Name_Item(FileName,filename_new_utf8,NULL);
-
-    ET_Manage_Changes_Of_File_Data(ETFile,FileName,NULL);
-    g_free(filename_new_utf8);
-
-    et_application_window_status_bar_message (ET_APPLICATION_WINDOW (MainWindow),
-                                              _("New filename successfully scanned"),
-                                              TRUE);
+    Mask_Item_Type type;
+    gchar code;
+    gchar *string;
+} EtScanRenameItem;
 
-    filename_new_utf8 = g_path_get_basename(((File_Name *)ETFile->FileNameNew->data)->value_utf8);
-    Log_Print (LOG_OK, _("New filename successfully scanned ‘%s’"),
-               filename_new_utf8);
-    g_free(filename_new_utf8);
+/*
+ * EtScanRenameMask:
+ * @items: (element-type EtScanRenameItem): the items of the mask, in order
+ * @relative_path: whether the generated name is relative to the directory of
+ *                 the file
+ * @convert: whether to convert the characters of the fields
+ * @convert_mode: the conversion of the spaces in the fields
+ * @replace_illegal: whether to replace the characters which are illegal in
+ *                   filenames
+ *
+ * A rename mask, compiled once with the settings resolved, so that it can be
+ * applied to many files without parsing the mask again.
+ */
+struct _EtScanRenameMask
+{
+    GArray *items;
+    gboolean relative_path;
+    gboolean convert;
+    EtConvertSpaces convert_mode;
+    gboolean replace_illegal;
+};
 
-    return;
+static void
+et_scan_rename_item_clear (gpointer data)
+{
+    g_free (((EtScanRenameItem *)data)->string);
 }
 
 /*
- * Build the new filename using tag + mask
- * Used also to rename the directory (from the browser)
- * @param ETFile                     : the etfile to process
- * @param mask                       : the pattern to parse
- * @param no_dir_check_or_conversion : if FALSE, disable checking of a directory
- *      in the mask, and don't convert "illegal" characters. This is used in the
- *      function "Write_Playlist" for the content of the playlist.
- * Returns filename in UTF-8
+ * et_scan_rename_mask_new:
+ * @mask_text: the mask to parse
+ * @no_dir_check_or_conversion: if %TRUE, do not check for a directory in the
+ *                              mask, and do not convert "illegal" characters,
+ *                              as for the content of a playlist
+ *
+ * Compile @mask_text with the current settings of the scanner.
+ *
+ * Returns: a new mask, to be freed with et_scan_rename_mask_free()
  */
-gchar *
-et_scan_generate_new_filename_from_mask (const ET_File *ETFile,
-                                         const gchar *mask,
-                                         gboolean no_dir_check_or_conversion)
+EtScanRenameMask *
+et_scan_rename_mask_new (const gchar *mask_text,
+                         gboolean no_dir_check_or_conversion)
 {
+    EtScanRenameMask *mask;
+    EtScanRenameItem item;
+    gchar *text;
     gchar *tmp;
-    gchar **source = NULL;
-    gchar *path_utf8_cur = NULL;
-    gchar *filename_new_utf8 = NULL;
-    gchar *filename_tmp = NULL;
-    GList *rename_file_list = NULL;
-    GList *l;
-    File_Mask_Item *mask_item;
-    File_Mask_Item *mask_item_prev;
-    File_Mask_Item *mask_item_next;
     gint counter = 0;
 
-    g_return_val_if_fail (ETFile != NULL && mask != NULL, NULL);
+    g_return_val_if_fail (mask_text != NULL, NULL);
+
+    mask = g_slice_new0 (EtScanRenameMask);
+    mask->items = g_array_new (FALSE, FALSE, sizeof (EtScanRenameItem));
+    g_array_set_clear_func (mask->items, et_scan_rename_item_clear);
+    mask->convert = !no_dir_check_or_conversion;
 
     /*
      * Check for a directory in the mask
      */
-    if (!no_dir_check_or_conversion)
+    if (mask->convert)
     {
-        if (g_path_is_absolute(mask))
-        {
-            // Absolute directory
-        }else if (strrchr(mask,G_DIR_SEPARATOR)!=NULL) // This is '/' on UNIX machines and '\' under Windows
-        {
-            // Relative path => set beginning of the path
-            path_utf8_cur = g_path_get_dirname( ((File_Name *)ETFile->FileNameCur->data)->value_utf8 );
-        }
+        mask->convert_mode = g_settings_get_enum (MainSettings,
+                                                  "rename-convert-spaces");
+        mask->replace_illegal = g_settings_get_boolean (MainSettings,
+                                                        "rename-replace-illegal-chars");
+
+        // This is '/' on UNIX machines and '\' under Windows
+        mask->relative_path = !g_path_is_absolute (mask_text)
+                              && strrchr (mask_text, G_DIR_SEPARATOR) != NULL;
     }
 
+    text = g_strdup (mask_text);
 
     /*
      * Parse the codes to generate a list (1rst item = 1rst code)
      */
-    while ( mask!=NULL && (tmp=strrchr(mask,'%'))!=NULL && strlen(tmp)>1 )
+    while ((tmp = strrchr (text, '%')) != NULL && strlen (tmp) > 1)
     {
         // Mask contains some characters after the code ('%b__')
-        if (strlen(tmp)>2)
+        if (strlen (tmp) > 2)
         {
-            mask_item = g_slice_new0 (File_Mask_Item);
             if (counter)
             {
-                if (strchr(tmp+2,G_DIR_SEPARATOR))
-                    mask_item->type = DIRECTORY_SEPARATOR;
+                if (strchr (tmp + 2, G_DIR_SEPARATOR))
+                    item.type = DIRECTORY_SEPARATOR;
                 else
-                    mask_item->type = SEPARATOR;
-            } else
+                    item.type = SEPARATOR;
+            }
+            else
             {
-                mask_item->type = TRAILING_SEPARATOR;
+                item.type = TRAILING_SEPARATOR;
             }
-            mask_item->string = g_strdup(tmp+2);
-            rename_file_list = g_list_prepend(rename_file_list,mask_item);
+
+            item.code = 0;
+            item.string = g_strdup (tmp + 2);
+            g_array_prepend_val (mask->items, item);
         }
 
-        // Now, parses the code to get the corresponding string (from tag)
-        source = Scan_Return_File_Tag_Field_From_Mask_Code((File_Tag *)ETFile->FileTag->data,tmp[1]);
-        mask_item = g_slice_new0 (File_Mask_Item);
+        /* The codes without a field are always empty, so check for them once,
+         * rather than for each file. */
+        item.code = tmp[1];
+        item.string = NULL;
 
-        if (source && !et_str_empty (*source))
+        if (item.code == 'i')
         {
-            mask_item->type = FIELD;
-            mask_item->string = g_strdup(*source);
-
-            // Replace invalid characters for this field
-            /* Do not replace characters in a playlist information field. */
-            if (!no_dir_check_or_conversion)
-            {
-                EtConvertSpaces convert_mode;
-
-                convert_mode = g_settings_get_enum (MainSettings,
-                                                    "rename-convert-spaces");
-
-                switch (convert_mode)
-                {
-                    case ET_CONVERT_SPACES_SPACES:
-                        Scan_Convert_Underscore_Into_Space (mask_item->string);
-                        Scan_Convert_P20_Into_Space (mask_item->string);
-                        break;
-                    case ET_CONVERT_SPACES_UNDERSCORES:
-                        Scan_Convert_Space_Into_Underscore (mask_item->string);
-                        break;
-                    case ET_CONVERT_SPACES_REMOVE:
-                        Scan_Remove_Spaces (mask_item->string);
-                        break;
-                    /* FIXME: Check that this is intended. */
-                    case ET_CONVERT_SPACES_NO_CHANGE:
-                    default:
-                        g_assert_not_reached ();
-                }
-
-                /* This must occur after the space processing, to ensure that a
-                 * trailing space cannot be present (if illegal characters are to be
-                 * replaced). */
-                et_filename_prepare (mask_item->string,
-                                     g_settings_get_boolean (MainSettings,
-                                                             "rename-replace-illegal-chars"));
-            }
-        }else
+            item.type = EMPTY_FIELD;
+        }
+        else if (strchr (allowed_specifiers, item.code) == NULL)
+        {
+            Log_Print (LOG_ERROR, "Scanner: Invalid code '%%%c' found!",
+                       item.code);
+            item.type = EMPTY_FIELD;
+        }
+        else
         {
-            mask_item->type = EMPTY_FIELD;
-            mask_item->string = NULL;
+            item.type = FIELD;
         }
-        rename_file_list = g_list_prepend(rename_file_list,mask_item);
+
+        g_array_prepend_val (mask->items, item);
         *tmp = '\0'; // Cut parsed data of mask
         counter++; // To indicate that we made at least one loop to identifiate 'separator' or 'trailing_separator'
     }
 
     // It may have some characters before the last remaining code ('__%a')
-    if (!et_str_empty (mask))
+    if (!et_str_empty (text))
     {
-        mask_item = g_slice_new0 (File_Mask_Item);
-        mask_item->type = LEADING_SEPARATOR;
-        mask_item->string = g_strdup(mask);
-        rename_file_list = g_list_prepend(rename_file_list,mask_item);
+        item.type = LEADING_SEPARATOR;
+        item.code = 0;
+        item.string = g_strdup (text);
+        g_array_prepend_val (mask->items, item);
     }
 
-    if (!rename_file_list) return NULL;
+    g_free (text);
 
-    /*
-     * For Debugging : display the "rename_file_list" list
-     */
-    /***{
-        GList *list = g_list_first(rename_file_list);
-        gint i = 0;
-        g_print("## rename_file_list - start\n");
-        while (list)
+    return mask;
+}
+
+void
+et_scan_rename_mask_free (EtScanRenameMask *mask)
+{
+    g_return_if_fail (mask != NULL);
+
+    g_array_unref (mask->items);
+    g_slice_free (EtScanRenameMask, mask);
+}
+
+/*
+ * et_scan_rename_mask_get_field:
+ * @mask: the compiled mask
+ * @FileTag: the tag to read the field from
+ * @code: the code of the field
+ *
+ * Returns: the value of the field, converted as set in @mask, or %NULL if the
+ *          field is empty
+ */
+static gchar *
+et_scan_rename_mask_get_field (const EtScanRenameMask *mask,
+                               File_Tag *FileTag,
+                               gchar code)
+{
+    gchar **source;
+    gchar *string;
+
+    source = Scan_Return_File_Tag_Field_From_Mask_Code (FileTag, code);
+
+    if (!source || et_str_empty (*source))
+    {
+        return NULL;
+    }
+
+    string = g_strdup (*source);
+
+    // Replace invalid characters for this field
+    /* Do not replace characters in a playlist information field. */
+    if (mask->convert)
+    {
+        switch (mask->convert_mode)
         {
-            File_Mask_Item *mask_item = (File_Mask_Item *)list->data;
-            Mask_Item_Type  type      = mask_item->type;
-            gchar          *string    = mask_item->string;
+            case ET_CONVERT_SPACES_SPACES:
+                Scan_Convert_Underscore_Into_Space (string);
+                Scan_Convert_P20_Into_Space (string);
+                break;
+            case ET_CONVERT_SPACES_UNDERSCORES:
+                Scan_Convert_Space_Into_Underscore (string);
+                break;
+            case ET_CONVERT_SPACES_REMOVE:
+                Scan_Remove_Spaces (string);
+                break;
+            /* FIXME: Check that this is intended. */
+            case ET_CONVERT_SPACES_NO_CHANGE:
+            default:
+                g_assert_not_reached ();
+        }
+
+        /* This must occur after the space processing, to ensure that a
+         * trailing space cannot be present (if illegal characters are to be
+         * replaced). */
+        et_filename_prepare (string, mask->replace_illegal);
+    }
 
-            //g_print("item %d : \n",i++);
-            //g_print("  - type   : '%s'\n",type==UNKNOWN?"UNKNOWN":type==LEADING_SEPARATOR?"LEADING_SEPARATOR":type==TRAILING_SEPARATOR?"TRAILING_SEPARATOR":type==SEPARATOR?"SEPARATOR":type==DIRECTORY_SEPARATOR?"DIRECTORY_SEPARATOR":type==FIELD?"FIELD":type==EMPTY_FIELD?"EMPTY_FIELD":"???");
-            //g_print("  - string : '%s'\n",string);
-            g_print("%d -> %s (%s) | ",i++,type==UNKNOWN?"UNKNOWN":type==LEADING_SEPARATOR?"LEADING_SEPARATOR":type==TRAILING_SEPARATOR?"TRAILING_SEPARATOR":type==SEPARATOR?"SEPARATOR":type==DIRECTORY_SEPARATOR?"DIRECTORY_SEPARATOR":type==FIELD?"FIELD":type==EMPTY_FIELD?"EMPTY_FIELD":"???",string);
+    return string;
+}
 
-            list = list->next;
+/*
+ * et_scan_rename_mask_apply:
+ * @mask: the compiled mask
+ * @ETFile: the file to generate the name for
+ *
+ * Build the new filename using tag + mask.
+ *
+ * Returns: the filename in UTF-8, or %NULL if the mask is empty
+ */
+gchar *
+et_scan_rename_mask_apply (const EtScanRenameMask *mask,
+                           const ET_File *ETFile)
+{
+    gchar *filename_new_utf8 = NULL;
+    gchar *filename_tmp = NULL;
+    GList *rename_file_list = NULL;
+    GList *l;
+    File_Mask_Item *mask_item_prev;
+    File_Mask_Item *mask_item_next;
+    guint i;
+
+    g_return_val_if_fail (mask != NULL && ETFile != NULL, NULL);
+
+    if (mask->items->len == 0) return NULL;
+
+    /* Resolve the fields for this file. The separators are shared with the
+     * mask, rather than copied. */
+    for (i = mask->items->len; i > 0; i--)
+    {
+        const EtScanRenameItem *item = &g_array_index (mask->items,
+                                                       EtScanRenameItem,
+                                                       i - 1);
+        File_Mask_Item *mask_item = g_slice_new0 (File_Mask_Item);
+
+        if (item->type == FIELD)
+        {
+            mask_item->string = et_scan_rename_mask_get_field (mask,
+                                                               (File_Tag *)ETFile->FileTag->data,
+                                                               item->code);
+            mask_item->type = mask_item->string ? FIELD : EMPTY_FIELD;
+        }
+        else
+        {
+            mask_item->type = item->type;
+            mask_item->string = item->string;
         }
-        g_print("\n## rename_file_list - end\n\n");
-    }***/
+
+        rename_file_list = g_list_prepend (rename_file_list, mask_item);
+    }
 
     /*
      * Build the new filename with items placed into the list
@@ -1105,34 +1377,176 @@ et_scan_generate_new_filename_from_mask (const ET_File *ETFile,
     Scan_Free_File_Rename_List(rename_file_list);
 
 
-    // Add current path if relative path entered
-    if (path_utf8_cur)
-    {
-        filename_tmp = filename_new_utf8; // in UTF-8!
-        filename_new_utf8 = g_build_filename (path_utf8_cur, filename_new_utf8,
-                                              NULL);
-        g_free(filename_tmp);
-        g_free(path_utf8_cur);
-    }
+    // Add current path if relative path entered
+    if (mask->relative_path)
+    {
+        // Relative path => set beginning of the path
+        gchar *path_utf8_cur = g_path_get_dirname (((File_Name *)ETFile->FileNameCur->data)->value_utf8);
+
+        filename_tmp = filename_new_utf8; // in UTF-8!
+        filename_new_utf8 = g_build_filename (path_utf8_cur, filename_new_utf8,
+                                              NULL);
+        g_free(filename_tmp);
+        g_free(path_utf8_cur);
+    }
+
+    return filename_new_utf8; // in UTF-8!
+}
+
+/*
+ * Build the new filename using tag + mask
+ * Used also to rename the directory (from the browser)
+ * @param ETFile                     : the etfile to process
+ * @param mask                       : the pattern to parse
+ * @param no_dir_check_or_conversion : if FALSE, disable checking of a directory
+ *      in the mask, and don't convert "illegal" characters. This is used in the
+ *      function "Write_Playlist" for the content of the playlist.
+ * Returns filename in UTF-8
+ */
+gchar *
+et_scan_generate_new_filename_from_mask (const ET_File *ETFile,
+                                         const gchar *mask,
+                                         gboolean no_dir_check_or_conversion)
+{
+    EtScanRenameMask *rename_mask;
+    gchar *filename_new_utf8;
+
+    g_return_val_if_fail (ETFile != NULL && mask != NULL, NULL);
+
+    rename_mask = et_scan_rename_mask_new (mask, no_dir_check_or_conversion);
+    filename_new_utf8 = et_scan_rename_mask_apply (rename_mask, ETFile);
+    et_scan_rename_mask_free (rename_mask);
+
+    return filename_new_utf8;
+}
+
+/*
+ * Only the fields are owned by the list, the separators belong to the
+ * compiled mask.
+ */
+static void
+Scan_Free_File_Rename_List (GList *list)
+{
+    GList *l;
+
+    for (l = list; l != NULL; l = g_list_next (l))
+    {
+        if (l->data)
+        {
+            if (((File_Mask_Item *)l->data)->type == FIELD)
+            {
+                g_free (((File_Mask_Item *)l->data)->string);
+            }
+
+            g_slice_free (File_Mask_Item, l->data);
+        }
+    }
+
+    g_list_free (list);
+}
+
+/*
+ * et_scan_rename_mask_apply_to_file:
+ * @self: the scanner window
+ * @mask: the compiled mask
+ * @ETFile: the file to rename
+ *
+ * Uses tag information (displayed into tag entries) to rename file.
+ *
+ * Returns: %TRUE if a new filename was set, %FALSE otherwise
+ */
+static gboolean
+et_scan_rename_mask_apply_to_file (EtScanDialog *self,
+                                   const EtScanRenameMask *mask,
+                                   ET_File *ETFile)
+{
+    gchar *filename_generated_utf8 = NULL;
+    gchar *filename_generated = NULL;
+    gchar *filename_new_utf8 = NULL;
+    File_Name *FileName;
+
+    // Note : if the first character is '/', we have a path with the filename,
+    // else we have only the filename. The both are in UTF-8.
+    filename_generated_utf8 = et_scan_rename_mask_apply (mask, ETFile);
+
+    if (et_str_empty (filename_generated_utf8))
+    {
+        g_free (filename_generated_utf8);
+        return FALSE;
+    }
+
+    // Convert filename to file-system encoding
+    filename_generated = filename_from_display(filename_generated_utf8);
+    if (!filename_generated)
+    {
+        GtkWidget *msgdialog;
+        msgdialog = gtk_message_dialog_new (GTK_WINDOW (self),
+                             GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                             GTK_MESSAGE_ERROR,
+                             GTK_BUTTONS_CLOSE,
+                             _("Could not convert filename ‘%s’ into system filename encoding"),
+                             filename_generated_utf8);
+        gtk_window_set_title(GTK_WINDOW(msgdialog),_("Filename translation"));
+
+        gtk_dialog_run(GTK_DIALOG(msgdialog));
+        gtk_widget_destroy(msgdialog);
+        g_free(filename_generated_utf8);
+        return FALSE;
+    }
+
+    /* Build the filename with the full path or relative to old path */
+    filename_new_utf8 = et_file_generate_name (ETFile,
+                                               filename_generated_utf8);
+    g_free(filename_generated);
+    g_free(filename_generated_utf8);
+
+    /* Set the new filename */
+    /* Create a new 'File_Name' item. */
+    FileName = et_file_name_new ();
+    // Save changes of the 'File_Name' item
+    ET_Set_Filename_File_Name_Item(FileName,filename_new_utf8,NULL);
+
+    ET_Manage_Changes_Of_File_Data(ETFile,FileName,NULL);
+    g_free(filename_new_utf8);
 
-    return filename_new_utf8; // in UTF-8!
+    return TRUE;
 }
 
+/*
+ * Uses tag information (displayed into tag entries) to rename file
+ * Note: mask and source are read from the right to the left.
+ * Note1: a mask code may be used severals times...
+ */
 static void
-Scan_Free_File_Rename_List (GList *list)
+Scan_Rename_File_With_Mask (EtScanDialog *self, ET_File *ETFile)
 {
-    GList *l;
+    EtScanDialogPrivate *priv;
+    EtScanRenameMask *mask;
+    gchar *filename_new_utf8;
+    gboolean renamed;
 
-    for (l = list; l != NULL; l = g_list_next (l))
+    g_return_if_fail (ETFile != NULL);
+
+    priv = et_scan_dialog_get_instance_private (self);
+
+    mask = et_scan_rename_mask_new (gtk_entry_get_text (GTK_ENTRY (gtk_bin_get_child (GTK_BIN (priv->rename_combo)))),
+                                    FALSE);
+    renamed = et_scan_rename_mask_apply_to_file (self, mask, ETFile);
+    et_scan_rename_mask_free (mask);
+
+    if (!renamed)
     {
-        if (l->data)
-        {
-            g_free (((File_Mask_Item *)l->data)->string);
-            g_slice_free (File_Mask_Item, l->data);
-        }
+        return;
     }
 
-    g_list_free (list);
+    et_application_window_status_bar_message (ET_APPLICATION_WINDOW (MainWindow),
+                                              _("New filename successfully scanned"),
+                                              TRUE);
+
+    filename_new_utf8 = g_path_get_basename(((File_Name *)ETFile->FileNameNew->data)->value_utf8);
+    Log_Print (LOG_OK, _("New filename successfully scanned ‘%s’"),
+               filename_new_utf8);
+    g_free(filename_new_utf8);
 }
 
 /*
@@ -1196,76 +1610,39 @@ et_scan_generate_new_directory_name_from_mask (const ET_File *ETFile,
 
 
 /*
- * Replace something with something else ;)
- * Here use Regular Expression, to search and replace.
+ * Compile the process-fields options from the settings into a pipeline, so
+ * that they are read once for the whole selection.
  */
-static void
-Scan_Convert_Character (EtScanDialog *self, gchar **string)
+static EtScanPipeline *
+create_process_fields_pipeline (EtScanDialog *self)
 {
     EtScanDialogPrivate *priv;
-    gchar *from;
-    gchar *to;
-    GRegex *regex;
-    GError *regex_error = NULL;
-    gchar *new_string;
-
-    priv = et_scan_dialog_get_instance_private (self);
-
-    from = gtk_editable_get_chars (GTK_EDITABLE (priv->convert_from_entry), 0,
-                                 -1);
-    to = gtk_editable_get_chars (GTK_EDITABLE (priv->convert_to_entry), 0, -1);
-
-    regex = g_regex_new (from, 0, 0, &regex_error);
-    if (regex_error != NULL)
-    {
-        goto handle_error;
-    }
-
-    new_string = g_regex_replace (regex, *string, -1, 0, to, 0, &regex_error);
-    if (regex_error != NULL)
-    {
-        g_free (new_string);
-        g_regex_unref (regex);
-        goto handle_error;
-    }
-
-    /* Success. */
-    g_regex_unref (regex);
-    g_free (*string);
-    *string = new_string;
-
-out:
-    g_free (from);
-    g_free (to);
-    return;
-
-handle_error:
-    Log_Print (LOG_ERROR, _("Error while processing fields ‘%s’"),
-               regex_error->message);
-
-    g_error_free (regex_error);
-
-    goto out;
-}
-
-static void
-Scan_Process_Fields_Functions (EtScanDialog *self,
-                               gchar **string)
-{
+    EtScanPipelineFlags flags = 0;
+    EtScanPipeline *pipeline;
+    gchar *from = NULL;
+    gchar *to = NULL;
+    GError *error = NULL;
     const EtProcessFieldsConvert process = g_settings_get_enum (MainSettings,
                                                                 "process-convert");
 
+    priv = et_scan_dialog_get_instance_private (self);
+
     switch (process)
     {
         case ET_PROCESS_FIELDS_CONVERT_SPACES:
-            Scan_Convert_Underscore_Into_Space (*string);
-            Scan_Convert_P20_Into_Space (*string);
+            flags |= ET_SCAN_PIPELINE_CONVERT_SPACES;
             break;
         case ET_PROCESS_FIELDS_CONVERT_UNDERSCORES:
-            Scan_Convert_Space_Into_Underscore (*string);
+            flags |= ET_SCAN_PIPELINE_CONVERT_UNDERSCORES;
             break;
         case ET_PROCESS_FIELDS_CONVERT_CHARACTERS:
-            Scan_Convert_Character (self, string);
+            /* Replace something with something else, with a regular
+             * expression. */
+            flags |= ET_SCAN_PIPELINE_CONVERT_CHARACTERS;
+            from = gtk_editable_get_chars (GTK_EDITABLE (priv->convert_from_entry),
+                                           0, -1);
+            to = gtk_editable_get_chars (GTK_EDITABLE (priv->convert_to_entry),
+                                         0, -1);
             break;
         case ET_PROCESS_FIELDS_CONVERT_NO_CHANGE:
             break;
@@ -1276,62 +1653,72 @@ Scan_Process_Fields_Functions (EtScanDialog *self,
 
     if (g_settings_get_boolean (MainSettings, "process-insert-capital-spaces"))
     {
-        gchar *res;
-        res = Scan_Process_Fields_Insert_Space (*string);
-        g_free (*string);
-        *string = res;
+        flags |= ET_SCAN_PIPELINE_INSERT_SPACES;
     }
 
     if (g_settings_get_boolean (MainSettings,
-        "process-remove-duplicate-spaces"))
+                                "process-remove-duplicate-spaces"))
     {
-        Scan_Process_Fields_Keep_One_Space (*string);
+        flags |= ET_SCAN_PIPELINE_KEEP_ONE_SPACE;
     }
 
     if (g_settings_get_boolean (MainSettings, "process-uppercase-all"))
     {
-        gchar *res;
-        res = Scan_Process_Fields_All_Uppercase (*string);
-        g_free (*string);
-        *string = res;
+        flags |= ET_SCAN_PIPELINE_UPPERCASE_ALL;
     }
 
     if (g_settings_get_boolean (MainSettings, "process-lowercase-all"))
     {
-        gchar *res;
-        res = Scan_Process_Fields_All_Downcase (*string);
-        g_free (*string);
-        *string = res;
+        flags |= ET_SCAN_PIPELINE_LOWERCASE_ALL;
     }
 
     if (g_settings_get_boolean (MainSettings,
                                 "process-uppercase-first-letter"))
     {
-        gchar *res;
-        res = Scan_Process_Fields_Letter_Uppercase (*string);
-        g_free (*string);
-        *string = res;
+        flags |= ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTER;
     }
 
     if (g_settings_get_boolean (MainSettings,
                                 "process-uppercase-first-letters"))
     {
-        gboolean uppercase_preps;
-        gboolean handle_roman;
+        flags |= ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTERS;
+
+        if (g_settings_get_boolean (MainSettings,
+                                    "process-uppercase-prepositions"))
+        {
+            flags |= ET_SCAN_PIPELINE_UPPERCASE_PREPOSITIONS;
+        }
 
-        uppercase_preps = g_settings_get_boolean (MainSettings,
-                                                  "process-uppercase-prepositions");
-        handle_roman = g_settings_get_boolean (MainSettings,
-                                               "process-detect-roman-numerals");
-        Scan_Process_Fields_First_Letters_Uppercase (string, uppercase_preps,
-                                                     handle_roman);
+        if (g_settings_get_boolean (MainSettings,
+                                    "process-detect-roman-numerals"))
+        {
+            flags |= ET_SCAN_PIPELINE_DETECT_ROMAN_NUMERALS;
+        }
     }
 
     if (g_settings_get_boolean (MainSettings, "process-remove-spaces"))
     {
-        Scan_Process_Fields_Remove_Space (*string);
+        flags |= ET_SCAN_PIPELINE_REMOVE_SPACES;
+    }
+
+    pipeline = et_scan_pipeline_new (flags, from, to, &error);
+
+    if (pipeline == NULL)
+    {
+        Log_Print (LOG_ERROR, _("Error while processing fields ‘%s’"),
+                   error->message);
+        g_error_free (error);
+
+        /* Apply the other options anyway. */
+        pipeline = et_scan_pipeline_new (flags
+                                         & ~ET_SCAN_PIPELINE_CONVERT_CHARACTERS,
+                                         NULL, NULL, NULL);
     }
 
+    g_free (from);
+    g_free (to);
+
+    return pipeline;
 }
 
 
@@ -1339,261 +1726,256 @@ Scan_Process_Fields_Functions (EtScanDialog *self,
  * Scanner To Process Fields *
  *****************************/
 /* See also functions : Convert_P20_And_Undescore_Into_Spaces, ... in easytag.c */
-static void
-Scan_Process_Fields (EtScanDialog *self, ET_File *ETFile)
+
+/* The tag fields which can be processed, with the flag which selects them. */
+static const struct
 {
-    File_Name *FileName = NULL;
-    File_Tag  *FileTag  = NULL;
-    File_Name *st_filename;
-    File_Tag  *st_filetag;
-    guint process_fields;
-    gchar     *filename_utf8;
-    gchar     *string;
+    EtProcessField field;
+    gsize offset;
+    void (*set) (File_Tag *file_tag, const gchar *value);
+} process_tag_fields[] =
+{
+    { ET_PROCESS_FIELD_TITLE, G_STRUCT_OFFSET (File_Tag, title),
+      et_file_tag_set_title },
+    { ET_PROCESS_FIELD_ARTIST, G_STRUCT_OFFSET (File_Tag, artist),
+      et_file_tag_set_artist },
+    { ET_PROCESS_FIELD_ALBUM_ARTIST, G_STRUCT_OFFSET (File_Tag, album_artist),
+      et_file_tag_set_album_artist },
+    { ET_PROCESS_FIELD_ALBUM, G_STRUCT_OFFSET (File_Tag, album),
+      et_file_tag_set_album },
+    { ET_PROCESS_FIELD_GENRE, G_STRUCT_OFFSET (File_Tag, genre),
+      et_file_tag_set_genre },
+    { ET_PROCESS_FIELD_COMMENT, G_STRUCT_OFFSET (File_Tag, comment),
+      et_file_tag_set_comment },
+    { ET_PROCESS_FIELD_COMPOSER, G_STRUCT_OFFSET (File_Tag, composer),
+      et_file_tag_set_composer },
+    { ET_PROCESS_FIELD_ORIGINAL_ARTIST, G_STRUCT_OFFSET (File_Tag, orig_artist),
+      et_file_tag_set_orig_artist },
+    { ET_PROCESS_FIELD_COPYRIGHT, G_STRUCT_OFFSET (File_Tag, copyright),
+      et_file_tag_set_copyright },
+    { ET_PROCESS_FIELD_URL, G_STRUCT_OFFSET (File_Tag, url),
+      et_file_tag_set_url },
+    { ET_PROCESS_FIELD_ENCODED_BY, G_STRUCT_OFFSET (File_Tag, encoded_by),
+      et_file_tag_set_encoded_by }
+};
 
-    g_return_if_fail (ETFile != NULL);
+/* Below this number of files for each thread, starting a thread to process
+ * the fields is not worth it. */
+#define PROCESS_FIELDS_FILES_PER_THREAD 64
 
-    st_filename = (File_Name *)ETFile->FileNameNew->data;
-    st_filetag  = (File_Tag  *)ETFile->FileTag->data;
-    process_fields = g_settings_get_flags (MainSettings, "process-fields");
+/*
+ * EtProcessFieldsFile:
+ * @ETFile: the file to process
+ * @filename: the processed filename, without directory nor extension, or
+ *            %NULL if the filename is not processed
+ * @values: the processed values of the tag fields, in the order of
+ *          process_tag_fields, or %NULL for the fields which are not
+ *          processed
+ */
+typedef struct
+{
+    ET_File *ETFile;
+    gchar *filename;
+    gchar *values[G_N_ELEMENTS (process_tag_fields)];
+} EtProcessFieldsFile;
 
-    /* Process the filename */
-    if (st_filename != NULL)
-    {
-        if (st_filename->value_utf8 
-            && (process_fields & ET_PROCESS_FIELD_FILENAME))
-        {
-            gchar *string_utf8;
-            gchar *pos;
+/*
+ * EtProcessFieldsChunk:
+ * @pipeline: the options to apply
+ * @process_fields: the #EtProcessField flags of the fields to process
+ * @files: the files to process
+ * @n_files: the number of @files
+ *
+ * A part of the selection, processed by a single thread.
+ */
+typedef struct
+{
+    const EtScanPipeline *pipeline;
+    guint process_fields;
+    EtProcessFieldsFile *files;
+    guint n_files;
+} EtProcessFieldsChunk;
 
-            filename_utf8 = st_filename->value_utf8;
+/*
+ * Compute the processed values of the fields of @file. The file is only
+ * read, so that this can be called from any thread.
+ */
+static void
+process_fields_compute (const EtScanPipeline *pipeline,
+                        guint process_fields,
+                        EtProcessFieldsFile *file,
+                        GString *buffer)
+{
+    const File_Name *st_filename;
+    File_Tag *st_filetag;
+    gsize i;
 
-            if (!FileName)
-                FileName = et_file_name_new ();
+    st_filename = (File_Name *)file->ETFile->FileNameNew->data;
+    st_filetag = (File_Tag *)file->ETFile->FileTag->data;
 
-            string = g_path_get_basename(filename_utf8);
-            // Remove the extension to set it to lower case (to avoid problem with undo)
-            if ((pos=strrchr(string,'.'))!=NULL) *pos = 0;
+    /* Process the filename */
+    if (st_filename != NULL && st_filename->value_utf8
+        && (process_fields & ET_PROCESS_FIELD_FILENAME))
+    {
+        gchar *string;
+        gchar *pos;
 
-            Scan_Process_Fields_Functions (self, &string);
+        string = g_path_get_basename (st_filename->value_utf8);
+        // Remove the extension to set it to lower case (to avoid problem with undo)
+        if ((pos = strrchr (string, '.')) != NULL) *pos = 0;
 
-            string_utf8 = et_file_generate_name (ETFile, string);
-            ET_Set_Filename_File_Name_Item(FileName,string_utf8,NULL);
-            g_free(string_utf8);
-            g_free(string);
-        }
+        et_scan_pipeline_apply (pipeline, string, buffer);
+        file->filename = g_strndup (buffer->str, buffer->len);
+        g_free (string);
     }
 
     /* Process data of the tag */
-    if (st_filetag != NULL)
+    if (st_filetag == NULL)
     {
-        /* Title field. */
-        if (st_filetag->title
-            && (process_fields & ET_PROCESS_FIELD_TITLE))
-        {
-            if (!FileTag)
-            {
-                FileTag = et_file_tag_new ();
-                et_file_tag_copy_into (FileTag, ETFile->FileTag->data);
-            }
-
-            string = g_strdup(st_filetag->title);
-
-            Scan_Process_Fields_Functions (self, &string);
+        return;
+    }
 
-            et_file_tag_set_title (FileTag, string);
+    for (i = 0; i < G_N_ELEMENTS (process_tag_fields); i++)
+    {
+        const gchar *value;
 
-            g_free(string);
-        }
+        value = G_STRUCT_MEMBER (const gchar *, st_filetag,
+                                 process_tag_fields[i].offset);
 
-        /* Artist field. */
-        if (st_filetag->artist
-            && (process_fields & ET_PROCESS_FIELD_ARTIST))
+        if (value && (process_fields & process_tag_fields[i].field))
         {
-            if (!FileTag)
-            {
-                FileTag = et_file_tag_new ();
-                et_file_tag_copy_into (FileTag, ETFile->FileTag->data);
-            }
-
-            string = g_strdup(st_filetag->artist);
-
-            Scan_Process_Fields_Functions (self, &string);
-
-            et_file_tag_set_artist (FileTag, string);
-
-            g_free(string);
+            et_scan_pipeline_apply (pipeline, value, buffer);
+            file->values[i] = g_strndup (buffer->str, buffer->len);
         }
+    }
+}
 
-        /* Album Artist field. */
-        if (st_filetag->album_artist
-            && (process_fields & ET_PROCESS_FIELD_ALBUM_ARTIST))
-        {
-            if (!FileTag)
-            {
-                FileTag = et_file_tag_new ();
-                et_file_tag_copy_into (FileTag, ETFile->FileTag->data);
-            }
+static gpointer
+process_fields_compute_chunk (gpointer data)
+{
+    EtProcessFieldsChunk *chunk = data;
+    GString *buffer;
+    guint i;
 
-            string = g_strdup(st_filetag->album_artist);
+    buffer = g_string_sized_new (256);
 
-            Scan_Process_Fields_Functions (self, &string);
+    for (i = 0; i < chunk->n_files; i++)
+    {
+        process_fields_compute (chunk->pipeline, chunk->process_fields,
+                                &chunk->files[i], buffer);
+    }
 
-            et_file_tag_set_album_artist (FileTag, string);
+    g_string_free (buffer, TRUE);
 
-            g_free(string);
-        }
+    return NULL;
+}
 
-        /* Album field. */
-        if (st_filetag->album
-            && (process_fields & ET_PROCESS_FIELD_ALBUM))
+/*
+ * process_fields_compute_files:
+ * @pipeline: the options to apply
+ * @process_fields: the #EtProcessField flags of the fields to process
+ * @files: (array length=n_files): the files to process
+ * @n_files: the number of @files
+ *
+ * Compute the processed values of the fields of @files, split between several
+ * threads if there are enough files. The changes are applied afterwards, from
+ * the main thread, with process_fields_apply(), as the undo history is shared
+ * between all the files.
+ */
+static void
+process_fields_compute_files (const EtScanPipeline *pipeline,
+                              guint process_fields,
+                              EtProcessFieldsFile *files,
+                              guint n_files)
+{
+    EtProcessFieldsChunk *chunks;
+    GThread **threads;
+    guint n_threads;
+    guint start = 0;
+    guint i;
+
+    n_threads = CLAMP (n_files / PROCESS_FIELDS_FILES_PER_THREAD, 1,
+                       g_get_num_processors ());
+    chunks = g_new (EtProcessFieldsChunk, n_threads);
+    threads = g_new0 (GThread *, n_threads);
+
+    for (i = 0; i < n_threads; i++)
+    {
+        chunks[i].pipeline = pipeline;
+        chunks[i].process_fields = process_fields;
+        chunks[i].files = files + start;
+        chunks[i].n_files = n_files / n_threads
+                            + (i < n_files % n_threads ? 1 : 0);
+        start += chunks[i].n_files;
+
+        /* The first chunk is processed by this thread. */
+        if (i > 0)
         {
-            if (!FileTag)
-            {
-                FileTag = et_file_tag_new ();
-                et_file_tag_copy_into (FileTag, ETFile->FileTag->data);
-            }
-
-            string = g_strdup(st_filetag->album);
-
-            Scan_Process_Fields_Functions (self, &string);
-
-            et_file_tag_set_album (FileTag, string);
-
-            g_free(string);
+            threads[i] = g_thread_try_new ("process-fields",
+                                           process_fields_compute_chunk,
+                                           &chunks[i], NULL);
         }
+    }
 
-        /* Genre field. */
-        if (st_filetag->genre
-            && (process_fields & ET_PROCESS_FIELD_GENRE))
-        {
-            if (!FileTag)
-            {
-                FileTag = et_file_tag_new ();
-                et_file_tag_copy_into (FileTag, ETFile->FileTag->data);
-            }
-
-            string = g_strdup(st_filetag->genre);
-
-            Scan_Process_Fields_Functions (self, &string);
-
-            et_file_tag_set_genre (FileTag, string);
-
-            g_free(string);
-        }
+    process_fields_compute_chunk (&chunks[0]);
 
-        /* Comment field. */
-        if (st_filetag->comment
-            && (process_fields & ET_PROCESS_FIELD_COMMENT))
+    for (i = 1; i < n_threads; i++)
+    {
+        if (threads[i])
         {
-            if (!FileTag)
-            {
-                FileTag = et_file_tag_new ();
-                et_file_tag_copy_into (FileTag, ETFile->FileTag->data);
-            }
-
-            string = g_strdup(st_filetag->comment);
-
-            Scan_Process_Fields_Functions (self, &string);
-
-            et_file_tag_set_comment (FileTag, string);
-
-            g_free(string);
+            g_thread_join (threads[i]);
         }
-
-        /* Composer field. */
-        if (st_filetag->composer
-            && (process_fields & ET_PROCESS_FIELD_COMPOSER))
+        else
         {
-            if (!FileTag)
-            {
-                FileTag = et_file_tag_new ();
-                et_file_tag_copy_into (FileTag, ETFile->FileTag->data);
-            }
-
-            string = g_strdup(st_filetag->composer);
-
-            Scan_Process_Fields_Functions (self, &string);
-
-            et_file_tag_set_composer (FileTag, string);
-
-            g_free(string);
+            /* The thread could not be started. */
+            process_fields_compute_chunk (&chunks[i]);
         }
+    }
 
-        /* Original artist field. */
-        if (st_filetag->orig_artist
-            && (process_fields & ET_PROCESS_FIELD_ORIGINAL_ARTIST))
-        {
-            if (!FileTag)
-            {
-                FileTag = et_file_tag_new ();
-                et_file_tag_copy_into (FileTag, ETFile->FileTag->data);
-            }
-
-            string = g_strdup(st_filetag->orig_artist);
+    g_free (threads);
+    g_free (chunks);
+}
 
-            Scan_Process_Fields_Functions (self, &string);
+/*
+ * Set the processed values of the fields of @file, as a change which can be
+ * undone, and free them.
+ */
+static void
+process_fields_apply (EtProcessFieldsFile *file)
+{
+    ET_File *ETFile = file->ETFile;
+    File_Name *FileName = NULL;
+    File_Tag  *FileTag  = NULL;
+    gsize i;
 
-            et_file_tag_set_orig_artist (FileTag, string);
+    if (file->filename)
+    {
+        gchar *string_utf8;
 
-            g_free(string);
-        }
+        FileName = et_file_name_new ();
+        string_utf8 = et_file_generate_name (ETFile, file->filename);
+        ET_Set_Filename_File_Name_Item (FileName, string_utf8, NULL);
+        g_free (string_utf8);
+        g_free (file->filename);
+        file->filename = NULL;
+    }
 
-        /* Copyright field. */
-        if (st_filetag->copyright
-            && (process_fields & ET_PROCESS_FIELD_COPYRIGHT))
+    for (i = 0; i < G_N_ELEMENTS (process_tag_fields); i++)
+    {
+        if (file->values[i] == NULL)
         {
-            if (!FileTag)
-            {
-                FileTag = et_file_tag_new ();
-                et_file_tag_copy_into (FileTag, ETFile->FileTag->data);
-            }
-
-            string = g_strdup(st_filetag->copyright);
-
-            Scan_Process_Fields_Functions (self, &string);
-
-            et_file_tag_set_copyright (FileTag, string);
-
-            g_free(string);
+            continue;
         }
 
-        /* URL field. */
-        if (st_filetag->url
-            && (process_fields & ET_PROCESS_FIELD_URL))
+        if (!FileTag)
         {
-            if (!FileTag)
-            {
-                FileTag = et_file_tag_new ();
-                et_file_tag_copy_into (FileTag, ETFile->FileTag->data);
-            }
-
-            string = g_strdup(st_filetag->url);
-
-            Scan_Process_Fields_Functions (self, &string);
-
-            et_file_tag_set_url (FileTag, string);
-
-            g_free(string);
+            FileTag = et_file_tag_new ();
+            et_file_tag_copy_into (FileTag, ETFile->FileTag->data);
         }
 
-        /* 'Encoded by' field. */
-        if (st_filetag->encoded_by
-            && (process_fields & ET_PROCESS_FIELD_ENCODED_BY))
-        {
-            if (!FileTag)
-            {
-                FileTag = et_file_tag_new ();
-                et_file_tag_copy_into (FileTag, ETFile->FileTag->data);
-            }
-
-            string = g_strdup(st_filetag->encoded_by);
-
-            Scan_Process_Fields_Functions (self, &string);
-
-            et_file_tag_set_encoded_by (FileTag, string);
-
-            g_free(string);
-        }
+        process_tag_fields[i].set (FileTag, file->values[i]);
+        g_free (file->values[i]);
+        file->values[i] = NULL;
     }
 
     if (FileName && FileTag)
@@ -1602,8 +1984,27 @@ Scan_Process_Fields (EtScanDialog *self, ET_File *ETFile)
         // undo functions, as they are generated as the same time)
         FileName->key = FileTag->key;
     }
+
     ET_Manage_Changes_Of_File_Data(ETFile,FileName,FileTag);
+}
+
+static void
+Scan_Process_Fields (EtScanDialog *self, ET_File *ETFile)
+{
+    EtScanPipeline *pipeline;
+    EtProcessFieldsFile file = { NULL, };
 
+    g_return_if_fail (ETFile != NULL);
+
+    pipeline = create_process_fields_pipeline (self);
+    file.ETFile = ETFile;
+    process_fields_compute_files (pipeline,
+                                  g_settings_get_flags (MainSettings,
+                                                        "process-fields"),
+                                  &file, 1);
+    et_scan_pipeline_free (pipeline);
+
+    process_fields_apply (&file);
 }
 
 /******************
@@ -2711,9 +3112,16 @@ entry_check_rename_file_mask (GtkEntry *entry, gpointer user_data)
 void
 et_scan_dialog_scan_selected_files (EtScanDialog *self)
 {
+    EtScanDialogPrivate *priv;
     EtApplicationWindow *window;
+    EtScanMode mode;
+    EtScanFillMask *fill_mask = NULL;
+    EtScanRenameMask *rename_mask = NULL;
+    EtProcessFieldsFile *process_files = NULL;
     guint progress_bar_index = 0;
+    guint progress_step;
     guint selectcount;
+    guint scancount = 0;
     gchar progress_bar_text[30];
     double fraction;
     GList *selfilelist = NULL;
@@ -2721,6 +3129,7 @@ et_scan_dialog_scan_selected_files (EtScanDialog *self)
 
     g_return_if_fail (ETCore->ETFileDisplayedList != NULL);
 
+    priv = et_scan_dialog_get_instance_private (self);
     window = ET_APPLICATION_WINDOW (MainWindow);
     et_application_window_update_et_file_from_ui (window);
 
@@ -2732,17 +3141,88 @@ et_scan_dialog_scan_selected_files (EtScanDialog *self)
                 selectcount);
     et_application_window_progress_set_text (window, progress_bar_text);
 
+    /* Only refresh the progress bar about a hundred times, whatever the
+     * number of files. */
+    progress_step = MAX (1, selectcount / 100);
+
     /* Set to unsensitive all command buttons (except Quit button) */
     et_application_window_disable_command_actions (window);
 
+    /* Parse the mask and read the settings once for the whole selection. */
+    mode = gtk_notebook_get_current_page (GTK_NOTEBOOK (priv->notebook));
+
+    switch (mode)
+    {
+        case ET_SCAN_MODE_FILL_TAG:
+            fill_mask = et_scan_fill_mask_new (gtk_entry_get_text (GTK_ENTRY (gtk_bin_get_child (GTK_BIN (priv->fill_combo)))));
+
+            if (fill_mask->crc32_comment)
+            {
+                et_scan_fill_mask_compute_crc32 (fill_mask, selfilelist);
+            }
+            break;
+        case ET_SCAN_MODE_RENAME_FILE:
+            rename_mask = et_scan_rename_mask_new (gtk_entry_get_text (GTK_ENTRY (gtk_bin_get_child (GTK_BIN (priv->rename_combo)))),
+                                                   FALSE);
+            break;
+        case ET_SCAN_MODE_PROCESS_FIELDS:
+        {
+            EtScanPipeline *pipeline;
+            guint i;
+
+            /* Compute all the new values first, possibly in several
+             * threads, so that only applying them is left for the loop. */
+            pipeline = create_process_fields_pipeline (self);
+            process_files = g_new0 (EtProcessFieldsFile, selectcount);
+
+            for (l = selfilelist, i = 0; l != NULL; l = g_list_next (l), i++)
+            {
+                process_files[i].ETFile = l->data;
+            }
+
+            process_fields_compute_files (pipeline,
+                                          g_settings_get_flags (MainSettings,
+                                                                "process-fields"),
+                                          process_files, selectcount);
+            et_scan_pipeline_free (pipeline);
+            break;
+        }
+        default:
+            g_assert_not_reached ();
+    }
+
     for (l = selfilelist; l != NULL; l = g_list_next (l))
     {
         ET_File *etfile = l->data;
 
         /* Run the current scanner. */
-        Scan_Select_Mode_And_Run_Scanner (self, etfile);
+        switch (mode)
+        {
+            case ET_SCAN_MODE_FILL_TAG:
+                et_scan_fill_mask_apply_to_file (fill_mask, etfile);
+                scancount++;
+                break;
+            case ET_SCAN_MODE_RENAME_FILE:
+                if (et_scan_rename_mask_apply_to_file (self, rename_mask,
+                                                       etfile))
+                {
+                    scancount++;
+                }
+                break;
+            case ET_SCAN_MODE_PROCESS_FIELDS:
+                process_fields_apply (&process_files[progress_bar_index]);
+                break;
+            default:
+                g_assert_not_reached ();
+        }
+
+        if (++progress_bar_index % progress_step != 0
+            && progress_bar_index != selectcount)
+        {
+            continue;
+        }
 
-        fraction = (++progress_bar_index) / (double) selectcount;
+        fraction = progress_bar_index / (double) selectcount;
         et_application_window_progress_set_fraction (window, fraction);
         g_snprintf(progress_bar_text, 30, "%d/%d", progress_bar_index, selectcount);
         et_application_window_progress_set_text (window, progress_bar_text);
@@ -2753,6 +3233,26 @@ et_scan_dialog_scan_selected_files (EtScanDialog *self)
     }
 
     g_list_free (selfilelist);
+    g_free (process_files);
+
+    /* A single entry for the whole selection, rather than one per file. */
+    if (fill_mask)
+    {
+        Log_Print (LOG_OK, ngettext ("Tag successfully scanned for one file",
+                                     "Tags successfully scanned for %u files",
+                                     scancount),
+                   scancount);
+        et_scan_fill_mask_free (fill_mask);
+    }
+
+    if (rename_mask)
+    {
+        Log_Print (LOG_OK, ngettext ("New filename successfully scanned for one file",
+                                     "New filenames successfully scanned for %u files",
+                                     scancount),
+                   scancount);
+        et_scan_rename_mask_free (rename_mask);
+    }
 
     /* Refresh the whole list (faster than file by file) to show changes. */
     et_application_window_browser_refresh_list (window);
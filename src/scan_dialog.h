@@ -53,6 +53,18 @@ void et_scan_dialog_scan_selected_files (EtScanDialog *self);
 void et_scan_dialog_update_previews (EtScanDialog *self);
 
 void Scan_Select_Mode_And_Run_Scanner (EtScanDialog *self, ET_File *ETFile);
+
+/*
+ * EtScanRenameMask:
+ *
+ * A rename mask which was parsed once, to generate the names of many files.
+ */
+typedef struct _EtScanRenameMask EtScanRenameMask;
+
+EtScanRenameMask * et_scan_rename_mask_new (const gchar *mask, gboolean no_dir_check_or_conversion);
+gchar * et_scan_rename_mask_apply (const EtScanRenameMask *mask, const ET_File *ETFile);
+void et_scan_rename_mask_free (EtScanRenameMask *mask);
+
 gchar * et_scan_generate_new_filename_from_mask (const ET_File *ETFile, const gchar *mask, gboolean no_dir_check_or_conversion);
 gchar * et_scan_generate_new_directory_name_from_mask (const ET_File *ETFile, const gchar *mask, gboolean no_dir_check_or_conversion);
 
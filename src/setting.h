@@ -168,6 +168,15 @@ typedef enum
     ET_PLAYLIST_CONTENT_EXTENDED_MASK
 } EtPlaylistContent;
 
+/* File format of generated playlists. */
+typedef enum
+{
+    ET_PLAYLIST_FORMAT_M3U,
+    ET_PLAYLIST_FORMAT_M3U8,
+    ET_PLAYLIST_FORMAT_PLS,
+    ET_PLAYLIST_FORMAT_XSPF
+} EtPlaylistFormat;
+
 /* Encoding options when renaming files. */
 typedef enum
 {
@@ -32,6 +32,7 @@
 #include "picture.h"
 #include "scan.h"
 #include "scan_dialog.h"
+#include "thumbnail_cache.h"
 
 typedef struct
 {
@@ -86,6 +87,9 @@ typedef struct
 
     /* Image treeview model. */
     GtkListStore *images_model;
+    /* Thumbnails of the images, and cancellable for loading them. */
+    EtThumbnailCache *thumbnails;
+    GCancellable *thumbnails_cancellable;
 
     /* Mini buttons. */
     GtkWidget *track_sequence_button;
@@ -1238,145 +1242,244 @@ PictureEntry_Clear (EtTagArea *self)
 
     priv = et_tag_area_get_instance_private (self);
 
+    /* Thumbnails which are still loading belong to the old rows, so they are
+     * not shown, but they are still added to the cache. */
+    g_cancellable_cancel (priv->thumbnails_cancellable);
+    g_object_unref (priv->thumbnails_cancellable);
+    priv->thumbnails_cancellable = g_cancellable_new ();
+
     gtk_list_store_clear (priv->images_model);
 }
 
+typedef struct
+{
+    EtTagArea *self;
+    GtkTreeRowReference *row;
+    GBytes *bytes;
+    ET_Tag_Type tag_type;
+    gint scale_factor;
+} EtThumbnailLoad;
+
 static void
-PictureEntry_Update (EtTagArea *self,
-                     EtPicture *pic,
-                     gboolean select_it)
+et_thumbnail_load_free (EtThumbnailLoad *load)
 {
-    EtTagAreaPrivate *priv;
-    GdkPixbufLoader *loader = 0;
-    GError *error = NULL;
-    
-    g_return_if_fail (pic != NULL);
+    g_object_unref (load->self);
+    gtk_tree_row_reference_free (load->row);
+    g_bytes_unref (load->bytes);
+    g_slice_free (EtThumbnailLoad, load);
+}
 
-    priv = et_tag_area_get_instance_private (self);
+/*
+ * Set the size of the pictures of the displayed tag which have the data of a
+ * thumbnail which was decoded in a worker thread, as is done for the
+ * thumbnails found in the cache. The rows of the model share the data of the
+ * pictures of the tag.
+ */
+static void
+set_displayed_picture_size (GBytes *bytes,
+                            gint width,
+                            gint height)
+{
+    const File_Tag *FileTag;
+    EtPicture *pic;
 
-    if (g_bytes_get_size (pic->bytes) == 0)
+    if (!ETCore->ETFileDisplayed)
     {
-        goto next;
+        return;
     }
 
-    loader = gdk_pixbuf_loader_new ();
+    FileTag = (File_Tag *)ETCore->ETFileDisplayed->FileTag->data;
 
-    if (loader)
+    for (pic = FileTag->picture; pic != NULL; pic = pic->next)
     {
-        if (gdk_pixbuf_loader_write_bytes (loader, pic->bytes, &error))
+        if (pic->bytes == bytes)
         {
-            GtkTreeSelection *selection;
-            GdkPixbuf *pixbuf;
+            pic->width = width;
+            pic->height = height;
+        }
+    }
+}
 
-            if (!gdk_pixbuf_loader_close(loader, &error))
-            {
-                Log_Print (LOG_ERROR, _("Error parsing image data ‘%s’"),
-                           error->message);
-                g_error_free (error);
-            }
+/*
+ * Show the thumbnail of the picture in the row, and the size of the original
+ * picture in its description.
+ */
+static void
+PictureEntry_Set_Thumbnail (EtTagArea *self,
+                            GtkTreeIter *iter,
+                            GdkPixbuf *pixbuf,
+                            gint width,
+                            gint height,
+                            ET_Tag_Type tag_type,
+                            gint scale_factor)
+{
+    EtTagAreaPrivate *priv;
+    EtPicture *pic;
+    GdkWindow *view_window;
+    cairo_surface_t *surface;
+    gchar *pic_info;
 
-            selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->images_view));
+    priv = et_tag_area_get_instance_private (self);
 
-            pixbuf = gdk_pixbuf_loader_get_pixbuf(loader);
-            if (pixbuf)
-            {
-                GtkTreeIter iter1;
-                gint scale_factor;
-                GdkPixbuf *scaled_pixbuf;
-                cairo_surface_t *surface;
-                GdkWindow *view_window;
-                gint scaled_pixbuf_width;
-                gint scaled_pixbuf_height;
-                gchar *pic_info;
-
-                g_object_ref(pixbuf);
-                g_object_unref(loader);
-                
-                // Keep aspect ratio of the picture
-                pic->width  = gdk_pixbuf_get_width(pixbuf);
-                pic->height = gdk_pixbuf_get_height(pixbuf);
-                /* TODO: Connect to notify:scale-factor and update when the
-                 * scale changes. */
-                scale_factor = gtk_widget_get_scale_factor (priv->images_view);
-
-                if (pic->width > pic->height)
-                {
-                    scaled_pixbuf_width = 96 * scale_factor;
-                    scaled_pixbuf_height = 96 * scale_factor * pic->height
-                                           / pic->width;
-                }else
-                {
-                    scaled_pixbuf_width = 96 * scale_factor * pic->width
-                                          / pic->height;
-                    scaled_pixbuf_height = 96 * scale_factor;
-                }
+    gtk_tree_model_get (GTK_TREE_MODEL (priv->images_model), iter,
+                        PICTURE_COLUMN_DATA, &pic, -1);
+    pic->width = width;
+    pic->height = height;
+
+    /* This ties the model to the view, so if the model is to be shared in the
+     * future, the surface should be per-view. */
+    view_window = gtk_widget_get_window (priv->images_view);
+    surface = gdk_cairo_surface_create_from_pixbuf (pixbuf, scale_factor,
+                                                    view_window);
+    pic_info = et_picture_format_info (pic, tag_type);
+    gtk_list_store_set (priv->images_model, iter,
+                        PICTURE_COLUMN_SURFACE, surface,
+                        PICTURE_COLUMN_TEXT, pic_info,
+                        PICTURE_COLUMN_DATA, pic, -1);
+
+    g_free (pic_info);
+    cairo_surface_destroy (surface);
+    et_picture_free (pic);
+}
 
-                scaled_pixbuf = gdk_pixbuf_scale_simple (pixbuf,
-                                                         scaled_pixbuf_width,
-                                                         scaled_pixbuf_height,
-                                                         GDK_INTERP_BILINEAR);
-                g_object_unref (pixbuf);
-
-                /* This ties the model to the view, so if the model is to be
-                 * shared in the future, the surface should be per-view. */
-                view_window = gtk_widget_get_window (priv->images_view);
-                surface = gdk_cairo_surface_create_from_pixbuf (scaled_pixbuf,
-                                                                scale_factor,
-                                                                view_window);
-                pic_info = et_picture_format_info (pic,
-                                                   ETCore->ETFileDisplayed->ETFileDescription->TagType);
-                gtk_list_store_insert_with_values (priv->images_model, &iter1,
-                                                   G_MAXINT,
-                                                   PICTURE_COLUMN_SURFACE,
-                                                   surface,
-                                                   PICTURE_COLUMN_TEXT,
-                                                   pic_info,
-                                                   PICTURE_COLUMN_DATA,
-                                                   pic, -1);
-                g_free(pic_info);
-
-                if (select_it)
-                    gtk_tree_selection_select_iter(selection, &iter1);
-                g_object_unref(scaled_pixbuf);
-            }else
-            {
-                GtkWidget *msgdialog;
-                
-                g_object_unref(loader);
-                
-                Log_Print (LOG_ERROR, "%s",
-                           _("Cannot display the image because not enough data has been read to determine how to create the image buffer"));
-
-                msgdialog = gtk_message_dialog_new(GTK_WINDOW(MainWindow),
-                                                   GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
-                                                   GTK_MESSAGE_ERROR,
-                                                   GTK_BUTTONS_CLOSE,
-                                                   "%s",
-                                                   _("Cannot display the image"));
-                gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (msgdialog),
-                                                          _("Not enough data has been read to determine how to create the image buffer."));
-                gtk_window_set_title (GTK_WINDOW (msgdialog),
-                                      _("Load Image File"));
-                gtk_dialog_run(GTK_DIALOG(msgdialog));
-                gtk_widget_destroy(msgdialog);
-            }
-        }
-        else
+static void
+on_thumbnail_loaded (GObject *source_object,
+                     GAsyncResult *result,
+                     gpointer user_data)
+{
+    EtThumbnailLoad *load = user_data;
+    EtTagAreaPrivate *priv;
+    GdkPixbuf *pixbuf;
+    gint width;
+    gint height;
+    GError *error = NULL;
+
+    priv = et_tag_area_get_instance_private (load->self);
+
+    pixbuf = et_thumbnail_cache_load_finish (priv->thumbnails, result, &width,
+                                             &height, &error);
+
+    if (!pixbuf)
+    {
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
         {
             Log_Print (LOG_ERROR, _("Error parsing image data ‘%s’"),
                        error->message);
-            g_error_free (error);
         }
+
+        g_error_free (error);
+        et_thumbnail_load_free (load);
+        return;
     }
 
-next:
-    /* Do also for next picture. */
-    if (pic->next)
+    if (gtk_tree_row_reference_valid (load->row))
     {
-        PictureEntry_Update (self, pic->next, select_it);
+        GtkTreePath *path;
+        GtkTreeIter iter;
+
+        path = gtk_tree_row_reference_get_path (load->row);
+
+        if (gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->images_model),
+                                     &iter, path))
+        {
+            PictureEntry_Set_Thumbnail (load->self, &iter, pixbuf, width,
+                                        height, load->tag_type,
+                                        load->scale_factor);
+            set_displayed_picture_size (load->bytes, width, height);
+        }
+
+        gtk_tree_path_free (path);
     }
 
-    return;
+    g_object_unref (pixbuf);
+    et_thumbnail_load_free (load);
+}
+
+/*
+ * Add the pictures to the view. Thumbnails which are not in the cache are
+ * decoded in a worker thread, and shown once they are ready.
+ */
+static void
+PictureEntry_Update (EtTagArea *self,
+                     EtPicture *pic,
+                     gboolean select_it)
+{
+    EtTagAreaPrivate *priv;
+    GtkTreeSelection *selection;
+    ET_Tag_Type tag_type;
+    gint scale_factor;
+    gint size;
+
+    g_return_if_fail (pic != NULL);
+
+    priv = et_tag_area_get_instance_private (self);
+
+    selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->images_view));
+    tag_type = ETCore->ETFileDisplayed->ETFileDescription->TagType;
+    /* TODO: Connect to notify:scale-factor and update when the scale
+     * changes. */
+    scale_factor = gtk_widget_get_scale_factor (priv->images_view);
+    size = 96 * scale_factor;
+
+    for (; pic != NULL; pic = pic->next)
+    {
+        GtkTreeIter iter;
+        GdkPixbuf *pixbuf;
+        gint width;
+        gint height;
+        gchar *pic_info;
+
+        if (g_bytes_get_size (pic->bytes) == 0)
+        {
+            continue;
+        }
+
+        pic_info = et_picture_format_info (pic, tag_type);
+        gtk_list_store_insert_with_values (priv->images_model, &iter,
+                                           G_MAXINT,
+                                           PICTURE_COLUMN_TEXT, pic_info,
+                                           PICTURE_COLUMN_DATA, pic, -1);
+        g_free (pic_info);
+
+        pixbuf = et_thumbnail_cache_lookup (priv->thumbnails, pic->bytes,
+                                            size, &width, &height);
+
+        if (pixbuf)
+        {
+            pic->width = width;
+            pic->height = height;
+            PictureEntry_Set_Thumbnail (self, &iter, pixbuf, width, height,
+                                        tag_type, scale_factor);
+            g_object_unref (pixbuf);
+        }
+        else
+        {
+            EtThumbnailLoad *load;
+            GtkTreePath *path;
+
+            path = gtk_tree_model_get_path (GTK_TREE_MODEL (priv->images_model),
+                                            &iter);
+
+            load = g_slice_new (EtThumbnailLoad);
+            load->self = g_object_ref (self);
+            load->row = gtk_tree_row_reference_new (GTK_TREE_MODEL (priv->images_model),
+                                                    path);
+            load->bytes = g_bytes_ref (pic->bytes);
+            load->tag_type = tag_type;
+            load->scale_factor = scale_factor;
+
+            et_thumbnail_cache_load_async (priv->thumbnails, pic->bytes, size,
+                                           priv->thumbnails_cancellable,
+                                           on_thumbnail_loaded, load);
+
+            gtk_tree_path_free (path);
+        }
+
+        if (select_it)
+        {
+            gtk_tree_selection_select_iter (selection, &iter);
+        }
+    }
 }
 
 
@@ -1892,6 +1995,12 @@ on_picture_save_button_clicked (GObject *object,
                 case PICTURE_FORMAT_GIF:
                     image_name = g_strdup ("image_name.gif");
                     break;
+                case PICTURE_FORMAT_BMP:
+                    image_name = g_strdup ("image_name.bmp");
+                    break;
+                case PICTURE_FORMAT_WEBP:
+                    image_name = g_strdup ("image_name.webp");
+                    break;
                 case PICTURE_FORMAT_UNKNOWN:
                 default:
                     image_name = g_strdup("image_name.ext");
@@ -2123,6 +2232,9 @@ create_tag_area (EtTagArea *self)
 
     priv = et_tag_area_get_instance_private (self);
 
+    priv->thumbnails = et_thumbnail_cache_new (64);
+    priv->thumbnails_cancellable = g_cancellable_new ();
+
     /* Page for common tag fields. */
     et_tag_field_connect_signals (GTK_ENTRY (priv->title_entry), self);
     et_tag_field_connect_signals (GTK_ENTRY (priv->artist_entry), self);
@@ -2223,11 +2335,46 @@ et_tag_area_init (EtTagArea *self)
     create_tag_area (self);
 }
 
+static void
+et_tag_area_dispose (GObject *object)
+{
+    EtTagArea *self;
+    EtTagAreaPrivate *priv;
+
+    self = ET_TAG_AREA (object);
+    priv = et_tag_area_get_instance_private (self);
+
+    if (priv->thumbnails_cancellable)
+    {
+        g_cancellable_cancel (priv->thumbnails_cancellable);
+        g_clear_object (&priv->thumbnails_cancellable);
+    }
+
+    G_OBJECT_CLASS (et_tag_area_parent_class)->dispose (object);
+}
+
+static void
+et_tag_area_finalize (GObject *object)
+{
+    EtTagArea *self;
+    EtTagAreaPrivate *priv;
+
+    self = ET_TAG_AREA (object);
+    priv = et_tag_area_get_instance_private (self);
+
+    et_thumbnail_cache_free (priv->thumbnails);
+
+    G_OBJECT_CLASS (et_tag_area_parent_class)->finalize (object);
+}
+
 static void
 et_tag_area_class_init (EtTagAreaClass *klass)
 {
     GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
+    G_OBJECT_CLASS (klass)->dispose = et_tag_area_dispose;
+    G_OBJECT_CLASS (klass)->finalize = et_tag_area_finalize;
+
     gtk_widget_class_set_template_from_resource (widget_class,
                                                  "/org/gnome/EasyTAG/tag_area.ui");
     gtk_widget_class_bind_template_child_private (widget_class, EtTagArea,
@@ -0,0 +1,553 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016 David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "ape_private.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include "genres.h"
+
+/* Size of the APE header and footer. */
+#define ET_APE_FOOTER_SIZE 32
+/* Size of the ID3v1 tag. */
+#define ET_APE_ID3V1_SIZE 128
+
+/* Flags of the APE header and footer. */
+#define ET_APE_HAS_HEADER 0x80000000
+#define ET_APE_IS_HEADER 0x20000000
+
+static guint32
+et_ape_read_le32 (const guchar *data)
+{
+    return ((guint32)data[3] << 24) | ((guint32)data[2] << 16)
+           | ((guint32)data[1] << 8) | data[0];
+}
+
+static void
+et_ape_write_le32 (guchar *data,
+                   guint32 value)
+{
+    data[0] = value & 0xff;
+    data[1] = (value >> 8) & 0xff;
+    data[2] = (value >> 16) & 0xff;
+    data[3] = (value >> 24) & 0xff;
+}
+
+/*
+ * et_ape_read_at:
+ * @istream: the stream to read from
+ * @offset: the offset to read from
+ * @buffer: the buffer to fill
+ * @count: the number of bytes to read
+ * @error: a #GError, or %NULL
+ *
+ * Returns: %TRUE if @count bytes were read, %FALSE otherwise
+ */
+static gboolean
+et_ape_read_at (GInputStream *istream,
+                goffset offset,
+                guchar *buffer,
+                gsize count,
+                GError **error)
+{
+    gsize bytes_read;
+
+    if (!g_seekable_seek (G_SEEKABLE (istream), offset, G_SEEK_SET, NULL,
+                          error))
+    {
+        return FALSE;
+    }
+
+    if (!g_input_stream_read_all (istream, buffer, count, &bytes_read, NULL,
+                                  error))
+    {
+        return FALSE;
+    }
+
+    if (bytes_read != count)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "%s",
+                     g_strerror (EIO));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * et_ape_tag_parse_items:
+ * @tag: the tag, with @data filled
+ * @data_len: the length of the data of @tag
+ * @count: the number of items given in the footer
+ *
+ * Index the items of @tag in place. Parsing stops at the first item which
+ * does not fit inside the data, so that a damaged tag still gives the items
+ * before the damage.
+ */
+static void
+et_ape_tag_parse_items (EtApeTag *tag,
+                        gsize data_len,
+                        guint32 count)
+{
+    const guchar *p = tag->data;
+    const guchar *end = tag->data + data_len;
+
+    while (count-- > 0 && end - p >= 8)
+    {
+        EtApeItem item;
+        const guchar *key_end;
+
+        item.value_len = et_ape_read_le32 (p);
+        item.flags = et_ape_read_le32 (p + 4);
+        item.key = (const gchar *)p + 8;
+
+        key_end = memchr (item.key, '\0', end - (const guchar *)item.key);
+
+        if (key_end == NULL || key_end == (const guchar *)item.key
+            || item.value_len > (gsize)(end - key_end - 1))
+        {
+            break;
+        }
+
+        item.value = (const gchar *)key_end + 1;
+        p = (const guchar *)item.value + item.value_len;
+
+        /* APEv1 values may include the terminating nul. */
+        if (tag->version == 1000 && item.value_len > 0
+            && item.value[item.value_len - 1] == '\0')
+        {
+            item.value_len--;
+        }
+
+        g_array_append_val (tag->items, item);
+    }
+}
+
+/*
+ * et_ape_tag_add_id3v1_field:
+ * @tag: the tag
+ * @key: the key of the APE item
+ * @value: the value of the field, which need not be nul-terminated
+ * @len: the maximum length of @value
+ *
+ * Add an item for a field of the ID3v1 tag, if @tag has no item for @key,
+ * stripping the padding from the end of the field.
+ */
+static void
+et_ape_tag_add_id3v1_field (EtApeTag *tag,
+                            const gchar *key,
+                            const gchar *value,
+                            gsize len)
+{
+    EtApeItem item;
+
+    if (et_ape_tag_lookup (tag, key) != NULL)
+    {
+        return;
+    }
+
+    item.value_len = 0;
+
+    while (item.value_len < len && value[item.value_len] != '\0')
+    {
+        item.value_len++;
+    }
+
+    while (item.value_len > 0 && value[item.value_len - 1] == ' ')
+    {
+        item.value_len--;
+    }
+
+    if (item.value_len == 0)
+    {
+        return;
+    }
+
+    item.key = key;
+    item.value = value;
+    item.flags = ET_APE_ITEM_TYPE_TEXT;
+
+    g_array_append_val (tag->items, item);
+}
+
+static void
+et_ape_tag_add_id3v1 (EtApeTag *tag)
+{
+    const gchar *v1 = (const gchar *)tag->id3v1;
+    guchar genre;
+
+    et_ape_tag_add_id3v1_field (tag, "Title", v1 + 3, 30);
+    et_ape_tag_add_id3v1_field (tag, "Artist", v1 + 33, 30);
+    et_ape_tag_add_id3v1_field (tag, "Album", v1 + 63, 30);
+    et_ape_tag_add_id3v1_field (tag, "Year", v1 + 93, 4);
+
+    /* ID3v1.1 stores the track number at the end of the comment. */
+    if (v1[125] == '\0' && v1[126] != '\0')
+    {
+        g_snprintf (tag->id3v1_track, sizeof (tag->id3v1_track), "%u",
+                    (guchar)v1[126]);
+        et_ape_tag_add_id3v1_field (tag, "Track", tag->id3v1_track,
+                                    sizeof (tag->id3v1_track));
+        et_ape_tag_add_id3v1_field (tag, "Comment", v1 + 97, 28);
+    }
+    else
+    {
+        et_ape_tag_add_id3v1_field (tag, "Comment", v1 + 97, 30);
+    }
+
+    genre = tag->id3v1[127];
+
+    if (genre < G_N_ELEMENTS (id3_genres))
+    {
+        et_ape_tag_add_id3v1_field (tag, "Genre", id3_genres[genre],
+                                    strlen (id3_genres[genre]));
+    }
+}
+
+/*
+ * et_ape_tag_read:
+ * @session: the read session of the file
+ * @error: a #GError, or %NULL
+ *
+ * Read the APEv1 or APEv2 tag, and the ID3v1 tag, from the end of the file of
+ * @session. The items region of the APE tag is read in one block, which is
+ * usually served from the cached tail of the session, and the items are
+ * indexed in place rather than copied. The fields of an ID3v1 tag are
+ * available as items for the keys which are missing from the APE tag.
+ *
+ * Returns: the tag, to be freed with et_ape_tag_free(), or %NULL on error
+ */
+EtApeTag *
+et_ape_tag_read (EtReadSession *session,
+                 GError **error)
+{
+    EtApeTag *tag;
+    GFileInputStream *file_istream;
+    GInputStream *istream;
+    goffset end;
+    guchar footer[ET_APE_FOOTER_SIZE];
+
+    g_return_val_if_fail (session != NULL, NULL);
+    g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+    file_istream = et_read_session_open_stream (session);
+    istream = G_INPUT_STREAM (file_istream);
+
+    tag = g_slice_new0 (EtApeTag);
+    tag->items = g_array_new (FALSE, FALSE, sizeof (EtApeItem));
+    tag->strings = g_ptr_array_new_with_free_func (g_free);
+
+    end = et_read_session_get_size (session);
+
+    if (end >= ET_APE_ID3V1_SIZE)
+    {
+        if (!et_ape_read_at (istream, end - ET_APE_ID3V1_SIZE, tag->id3v1,
+                             ET_APE_ID3V1_SIZE, error))
+        {
+            goto err;
+        }
+
+        if (memcmp (tag->id3v1, "TAG", 3) == 0)
+        {
+            tag->has_id3v1 = TRUE;
+            end -= ET_APE_ID3V1_SIZE;
+        }
+    }
+
+    tag->offset = end;
+
+    if (end >= ET_APE_FOOTER_SIZE)
+    {
+        guint32 length;
+        guint32 count;
+        guint32 flags;
+
+        if (!et_ape_read_at (istream, end - ET_APE_FOOTER_SIZE, footer,
+                             ET_APE_FOOTER_SIZE, error))
+        {
+            goto err;
+        }
+
+        length = et_ape_read_le32 (footer + 12);
+        count = et_ape_read_le32 (footer + 16);
+        flags = et_ape_read_le32 (footer + 20);
+
+        /* The length includes the footer and the items, but not the
+         * header. A tag which claims to be larger than the file is ignored,
+         * as libapetag would fail to read it. */
+        if (memcmp (footer, "APETAGEX", 8) == 0
+            && length >= ET_APE_FOOTER_SIZE && length <= end)
+        {
+            gsize data_len = length - ET_APE_FOOTER_SIZE;
+
+            tag->version = et_ape_read_le32 (footer + 8);
+            tag->offset = end - length;
+
+            if (tag->version >= 2000 && (flags & ET_APE_HAS_HEADER)
+                && tag->offset >= ET_APE_FOOTER_SIZE)
+            {
+                tag->offset -= ET_APE_FOOTER_SIZE;
+            }
+
+            tag->data = g_malloc (data_len);
+
+            if (!et_ape_read_at (istream, end - length, tag->data, data_len,
+                                 error))
+            {
+                goto err;
+            }
+
+            et_ape_tag_parse_items (tag, data_len, count);
+        }
+    }
+
+    if (tag->has_id3v1)
+    {
+        et_ape_tag_add_id3v1 (tag);
+    }
+
+    g_object_unref (file_istream);
+
+    return tag;
+
+err:
+    g_object_unref (file_istream);
+    et_ape_tag_free (tag);
+
+    return NULL;
+}
+
+void
+et_ape_tag_free (EtApeTag *tag)
+{
+    g_return_if_fail (tag != NULL);
+
+    g_free (tag->data);
+    g_array_unref (tag->items);
+    g_ptr_array_unref (tag->strings);
+    g_slice_free (EtApeTag, tag);
+}
+
+/*
+ * et_ape_tag_lookup:
+ * @tag: the tag
+ * @key: the key to look up, which is case-insensitive as for APE items
+ *
+ * Returns: (transfer none): the first item with @key, or %NULL if there is
+ *          none
+ */
+const EtApeItem *
+et_ape_tag_lookup (const EtApeTag *tag,
+                   const gchar *key)
+{
+    guint i;
+
+    g_return_val_if_fail (tag != NULL && key != NULL, NULL);
+
+    for (i = 0; i < tag->items->len; i++)
+    {
+        const EtApeItem *item = &g_array_index (tag->items, EtApeItem, i);
+
+        if (g_ascii_strcasecmp (item->key, key) == 0)
+        {
+            return item;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * et_ape_tag_set:
+ * @tag: the tag
+ * @key: the key of the item
+ * @value: (allow-none): the new text value of the item, or %NULL or an empty
+ *         string to remove the item
+ *
+ * Replace all the items with @key by a single text item. Other items,
+ * including binary ones, are kept, so that they are written back unchanged.
+ */
+void
+et_ape_tag_set (EtApeTag *tag,
+                const gchar *key,
+                const gchar *value)
+{
+    EtApeItem item;
+    guint i;
+
+    g_return_if_fail (tag != NULL && key != NULL);
+
+    for (i = tag->items->len; i > 0; i--)
+    {
+        if (g_ascii_strcasecmp (g_array_index (tag->items, EtApeItem,
+                                               i - 1).key, key) == 0)
+        {
+            g_array_remove_index (tag->items, i - 1);
+        }
+    }
+
+    if (value == NULL || *value == '\0')
+    {
+        return;
+    }
+
+    item.key = g_strdup (key);
+    item.value = g_strdup (value);
+    item.value_len = strlen (value);
+    item.flags = ET_APE_ITEM_TYPE_TEXT;
+
+    g_ptr_array_add (tag->strings, (gpointer)item.key);
+    g_ptr_array_add (tag->strings, (gpointer)item.value);
+    g_array_append_val (tag->items, item);
+}
+
+/*
+ * et_ape_tag_serialize:
+ * @tag: the tag
+ * @len: (out): return location for the length of the data
+ *
+ * Build an APEv2 tag, with both a header and a footer, from the items of
+ * @tag.
+ *
+ * Returns: the data of the tag, to be freed with g_free()
+ */
+static guchar *
+et_ape_tag_serialize (const EtApeTag *tag,
+                      gsize *len)
+{
+    guchar *data;
+    guchar *p;
+    gsize items_len = 0;
+    guint i;
+
+    for (i = 0; i < tag->items->len; i++)
+    {
+        const EtApeItem *item = &g_array_index (tag->items, EtApeItem, i);
+
+        items_len += 8 + strlen (item->key) + 1 + item->value_len;
+    }
+
+    *len = ET_APE_FOOTER_SIZE + items_len + ET_APE_FOOTER_SIZE;
+    data = g_malloc (*len);
+
+    /* Header. */
+    memcpy (data, "APETAGEX", 8);
+    et_ape_write_le32 (data + 8, 2000);
+    et_ape_write_le32 (data + 12, items_len + ET_APE_FOOTER_SIZE);
+    et_ape_write_le32 (data + 16, tag->items->len);
+    et_ape_write_le32 (data + 20, ET_APE_HAS_HEADER | ET_APE_IS_HEADER);
+    memset (data + 24, 0, 8);
+
+    p = data + ET_APE_FOOTER_SIZE;
+
+    for (i = 0; i < tag->items->len; i++)
+    {
+        const EtApeItem *item = &g_array_index (tag->items, EtApeItem, i);
+        gsize key_len = strlen (item->key);
+
+        et_ape_write_le32 (p, item->value_len);
+        et_ape_write_le32 (p + 4, item->flags);
+        memcpy (p + 8, item->key, key_len + 1);
+        memcpy (p + 8 + key_len + 1, item->value, item->value_len);
+        p += 8 + key_len + 1 + item->value_len;
+    }
+
+    /* The footer is the same as the header, but for one flag. */
+    memcpy (p, data, ET_APE_FOOTER_SIZE);
+    et_ape_write_le32 (p + 20, ET_APE_HAS_HEADER);
+
+    return data;
+}
+
+/*
+ * et_ape_tag_write:
+ * @tag: the tag, as read from @file and changed by et_ape_tag_set()
+ * @file: the file to write to
+ * @error: a #GError, or %NULL
+ *
+ * Replace the APE and ID3v1 tags at the end of @file by an APEv2 tag with the
+ * items of @tag, which include the fields of the old ID3v1 tag. If @tag has no
+ * items, both tags are stripped.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+gboolean
+et_ape_tag_write (const EtApeTag *tag,
+                  GFile *file,
+                  GError **error)
+{
+    GFileIOStream *iostream;
+    GSeekable *seekable;
+    guchar *data = NULL;
+    gsize len = 0;
+    gboolean success = FALSE;
+
+    g_return_val_if_fail (tag != NULL && G_IS_FILE (file), FALSE);
+    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+    iostream = g_file_open_readwrite (file, NULL, error);
+
+    if (iostream == NULL)
+    {
+        return FALSE;
+    }
+
+    seekable = G_SEEKABLE (iostream);
+
+    if (!g_seekable_can_truncate (seekable))
+    {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_BADF, "%s",
+                     g_strerror (EBADF));
+        goto out;
+    }
+
+    if (!g_seekable_seek (seekable, tag->offset, G_SEEK_SET, NULL, error))
+    {
+        goto out;
+    }
+
+    if (tag->items->len > 0)
+    {
+        GOutputStream *ostream;
+
+        data = et_ape_tag_serialize (tag, &len);
+        ostream = g_io_stream_get_output_stream (G_IO_STREAM (iostream));
+
+        if (!g_output_stream_write_all (ostream, data, len, NULL, NULL,
+                                        error))
+        {
+            goto out;
+        }
+    }
+
+    if (!g_seekable_truncate (seekable, tag->offset + len, NULL, error))
+    {
+        goto out;
+    }
+
+    success = g_io_stream_close (G_IO_STREAM (iostream), NULL, error);
+
+out:
+    g_free (data);
+    g_object_unref (iostream);
+
+    return success;
+}
@@ -0,0 +1,89 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016 David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef ET_APE_PRIVATE_H_
+#define ET_APE_PRIVATE_H_
+
+#include <gio/gio.h>
+
+#include "read_session.h"
+
+G_BEGIN_DECLS
+
+/* Mask and values of the item type in the flags of an APE item. */
+#define ET_APE_ITEM_TYPE_MASK 0x00000006
+#define ET_APE_ITEM_TYPE_TEXT 0x00000000
+#define ET_APE_ITEM_TYPE_BINARY 0x00000002
+
+/*
+ * EtApeItem:
+ * @key: the nul-terminated key of the item
+ * @value: the value of the item, which is not nul-terminated
+ * @value_len: the length of @value
+ * @flags: the flags of the item
+ *
+ * An item of an APE tag. The strings point into the data of the #EtApeTag,
+ * and are not copied.
+ */
+typedef struct
+{
+    const gchar *key;
+    const gchar *value;
+    gsize value_len;
+    guint32 flags;
+} EtApeItem;
+
+/*
+ * EtApeTag:
+ * @version: the version of the APE tag in the file (1000 or 2000), or 0 if
+ *           the file has no APE tag
+ * @offset: the offset in the file of the APE tag, or of the ID3v1 tag if
+ *          there is no APE tag, or the size of the file if there is neither
+ * @has_id3v1: whether the file ends with an ID3v1 tag
+ * @data: the items region of the APE tag, read in a single block
+ * @items: (element-type EtApeItem): the items, in order
+ * @strings: the keys and values which were added by et_ape_tag_set()
+ * @id3v1: the ID3v1 tag, the fields of which are used for the keys which are
+ *         missing from the APE tag
+ * @id3v1_track: the track number from @id3v1, as a string
+ *
+ * The APE and ID3v1 tags at the end of a file, as read by et_ape_tag_read().
+ */
+typedef struct
+{
+    guint32 version;
+    goffset offset;
+    gboolean has_id3v1;
+    guchar *data;
+    GArray *items;
+    GPtrArray *strings;
+    guchar id3v1[128];
+    gchar id3v1_track[4];
+} EtApeTag;
+
+EtApeTag * et_ape_tag_read (EtReadSession *session, GError **error);
+void et_ape_tag_free (EtApeTag *tag);
+
+const EtApeItem * et_ape_tag_lookup (const EtApeTag *tag, const gchar *key);
+void et_ape_tag_set (EtApeTag *tag, const gchar *key, const gchar *value);
+
+gboolean et_ape_tag_write (const EtApeTag *tag, GFile *file, GError **error);
+
+G_END_DECLS
+
+#endif /* !ET_APE_PRIVATE_H_ */
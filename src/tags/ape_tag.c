@@ -20,13 +20,11 @@
 
 #include "config.h"
 
-#include <glib/gi18n.h>
-#include <glib/gstdio.h>
-#include <stdio.h>
 #include <stdlib.h>
-#include <errno.h>
+#include <string.h>
 
 #include "ape_tag.h"
+#include "ape_private.h"
 #include "et_core.h"
 #include "misc.h"
 #include "setting.h"
@@ -40,28 +38,77 @@
 /*
  * set_string_field:
  * @field: (inout): pointer to a location in which to store the field value
- * @string: (transfer none): the string to copy and store in @field
+ * @item: (allow-none): the item to copy the value from
  *
- * Copy @string and store it in @field, first validating that the string is
- * valid UTF-8.
+ * Copy the value of @item and store it in @field, first validating that the
+ * string is valid UTF-8. Items which are empty or not text are ignored.
  */
 static void
 set_string_field (gchar **field,
-                  gchar *string)
+                  const EtApeItem *item)
 {
+    gchar *string;
+
+    if (item == NULL || item->value_len == 0
+        || (item->flags & ET_APE_ITEM_TYPE_MASK) != ET_APE_ITEM_TYPE_TEXT)
+    {
+        return;
+    }
+
+    /* Fails for embedded nuls too, which are then handled below. */
+    if (g_utf8_validate (item->value, item->value_len, NULL))
+    {
+        *field = g_strndup (item->value, item->value_len);
+        return;
+    }
+
+    /* Unnecessarily copies the field twice, but this should not be the
+     * common case. */
+    string = g_strndup (item->value, item->value_len);
+
     if (!et_str_empty (string))
     {
-        if (g_utf8_validate (string, -1, NULL))
-        {
-            *field = g_strdup (string);
-        }
-        else
-        {
-            /* Unnecessarily validates the field again, but this should not be
-             * the common case. */
-            *field = Try_To_Validate_Utf8_String (string);
-        }
+        *field = Try_To_Validate_Utf8_String (string);
+    }
+
+    g_free (string);
+}
+
+/*
+ * set_number_fields:
+ * @number: (out): pointer to a location in which to store the number
+ * @total: (out): pointer to a location in which to store the total
+ * @item: (allow-none): the item with a value of the form "number/total"
+ * @to_string: the function to format the numbers with
+ */
+static void
+set_number_fields (gchar **number,
+                   gchar **total,
+                   const EtApeItem *item,
+                   gchar * (*to_string) (const guint))
+{
+    gchar *string;
+    gchar *separator;
+
+    *number = *total = NULL;
+
+    if (item == NULL)
+    {
+        return;
     }
+
+    string = g_strndup (item->value, item->value_len);
+    separator = strchr (string, '/');
+
+    if (separator)
+    {
+        *total = to_string (atoi (separator + 1));
+        *separator = '\0';
+    }
+
+    *number = to_string (atoi (string));
+
+    g_free (string);
 }
 
 /*
@@ -69,147 +116,132 @@ set_string_field (gchar **field,
  *  - if field is found but contains no info (strlen(str)==0), we don't read it
  */
 gboolean
-ape_tag_read_file_tag (GFile *file,
+ape_tag_read_file_tag (EtReadSession *session,
                        File_Tag *FileTag,
                        GError **error)
 {
-    FILE *fp;
-    gchar *filename;
-    gchar *string = NULL;
-    gchar *string1 = NULL;
-    apetag *ape_cnt;
+    EtApeTag *tag;
 
-    g_return_val_if_fail (file != NULL && FileTag != NULL, FALSE);
+    g_return_val_if_fail (session != NULL && FileTag != NULL, FALSE);
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-    filename = g_file_get_path (file);
+    /* Reads the APE and ID3v1 tags. */
+    tag = et_ape_tag_read (session, error);
 
-    if ((fp = g_fopen (filename, "rb")) == NULL)
+    if (tag == NULL)
     {
-        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
-                     _("Error while opening file: %s"),
-                     g_strerror (errno));
-        g_free (filename);
         return FALSE;
     }
 
-    ape_cnt = apetag_init();
-    apetag_read_fp (ape_cnt, fp, filename, 0); /* read all tags ape,id3v[12]*/
-
-    g_free (filename);
-
     /* Title */
-    string = apefrm_getstr (ape_cnt, APE_TAG_FIELD_TITLE);
-    set_string_field (&FileTag->title, string);
+    set_string_field (&FileTag->title,
+                      et_ape_tag_lookup (tag, APE_TAG_FIELD_TITLE));
 
     /* Artist */
-    string = apefrm_getstr (ape_cnt, APE_TAG_FIELD_ARTIST);
-    set_string_field (&FileTag->artist, string);
+    set_string_field (&FileTag->artist,
+                      et_ape_tag_lookup (tag, APE_TAG_FIELD_ARTIST));
 
     /* Album artist. */
-    string = apefrm_getstr (ape_cnt, APE_TAG_FIELD_ALBUMARTIST);
-    set_string_field (&FileTag->album_artist, string);
+    set_string_field (&FileTag->album_artist,
+                      et_ape_tag_lookup (tag, APE_TAG_FIELD_ALBUMARTIST));
 
     /* Album */
-    string = apefrm_getstr (ape_cnt, APE_TAG_FIELD_ALBUM);
-    set_string_field (&FileTag->album, string);
+    set_string_field (&FileTag->album,
+                      et_ape_tag_lookup (tag, APE_TAG_FIELD_ALBUM));
 
     /* Disc Number and Disc Total */
-    string = apefrm_getstr (ape_cnt, APE_TAG_FIELD_PART);
-
-    if (string)
-    {
-        string = Try_To_Validate_Utf8_String (string);
-
-        string1 = strchr (string, '/');
-
-        if (string1)
-        {
-            FileTag->disc_total = et_disc_number_to_string (atoi (string1
-                                                                  + 1));
-            *string1 = '\0';
-        }
-
-        FileTag->disc_number = et_disc_number_to_string (atoi (string));
-
-        g_free (string);
-    }
-    else
-    {
-        FileTag->disc_number = FileTag->disc_total = NULL;
-    }
+    set_number_fields (&FileTag->disc_number, &FileTag->disc_total,
+                       et_ape_tag_lookup (tag, APE_TAG_FIELD_PART),
+                       et_disc_number_to_string);
 
     /* Year */
-    string = apefrm_getstr (ape_cnt, APE_TAG_FIELD_YEAR);
-    set_string_field (&FileTag->year, string);
+    set_string_field (&FileTag->year,
+                      et_ape_tag_lookup (tag, APE_TAG_FIELD_YEAR));
 
     /* Track and Total Track */
-    string = apefrm_getstr (ape_cnt, APE_TAG_FIELD_TRACK);
-
-    if (string)
-    {
-        string = Try_To_Validate_Utf8_String(string);
-
-        string1 = strchr (string, '/');
-
-        if (string1)
-        {
-            FileTag->track_total = et_track_number_to_string (atoi (string1
-                                                                    + 1));
-            *string1 = '\0';
-        }
-        FileTag->track = et_track_number_to_string (atoi (string));
-
-        g_free(string);
-    } else
-    {
-        FileTag->track = FileTag->track_total = NULL;
-    }
+    set_number_fields (&FileTag->track, &FileTag->track_total,
+                       et_ape_tag_lookup (tag, APE_TAG_FIELD_TRACK),
+                       et_track_number_to_string);
 
     /* Genre */
-    string = apefrm_getstr (ape_cnt, APE_TAG_FIELD_GENRE);
-    set_string_field (&FileTag->genre, string);
+    set_string_field (&FileTag->genre,
+                      et_ape_tag_lookup (tag, APE_TAG_FIELD_GENRE));
 
     /* Comment */
-    string = apefrm_getstr (ape_cnt, APE_TAG_FIELD_COMMENT);
-    set_string_field (&FileTag->comment, string);
+    set_string_field (&FileTag->comment,
+                      et_ape_tag_lookup (tag, APE_TAG_FIELD_COMMENT));
 
     /* Composer */
-    string = apefrm_getstr (ape_cnt, APE_TAG_FIELD_COMPOSER);
-    set_string_field (&FileTag->composer, string);
+    set_string_field (&FileTag->composer,
+                      et_ape_tag_lookup (tag, APE_TAG_FIELD_COMPOSER));
 
     /* Original artist */
-    string = apefrm_getstr (ape_cnt, "Original Artist");
-    set_string_field (&FileTag->orig_artist, string);
+    set_string_field (&FileTag->orig_artist,
+                      et_ape_tag_lookup (tag, "Original Artist"));
 
     /* Copyright */
-    string = apefrm_getstr (ape_cnt, APE_TAG_FIELD_COPYRIGHT);
-    set_string_field (&FileTag->copyright, string);
+    set_string_field (&FileTag->copyright,
+                      et_ape_tag_lookup (tag, APE_TAG_FIELD_COPYRIGHT));
 
     /* URL */
-    string = apefrm_getstr (ape_cnt, APE_TAG_FIELD_RELATED_URL);
-    set_string_field (&FileTag->url, string);
+    set_string_field (&FileTag->url,
+                      et_ape_tag_lookup (tag, APE_TAG_FIELD_RELATED_URL));
 
     /* Encoded by */
-    string = apefrm_getstr (ape_cnt, "Encoded By");
-    set_string_field (&FileTag->encoded_by, string);
+    set_string_field (&FileTag->encoded_by,
+                      et_ape_tag_lookup (tag, "Encoded By"));
 
-    apetag_free (ape_cnt);
-    fclose (fp);
+    et_ape_tag_free (tag);
 
     return TRUE;
 }
 
+/*
+ * set_number_item:
+ * @tag: the tag
+ * @key: the key of the item
+ * @number: (allow-none): the number
+ * @total: (allow-none): the total
+ *
+ * Set the item @key to "number/total", or to just the number if there is no
+ * total, or remove it if there is no number.
+ */
+static void
+set_number_item (EtApeTag *tag,
+                 const gchar *key,
+                 const gchar *number,
+                 const gchar *total)
+{
+    gchar *string;
+
+    if (et_str_empty (number))
+    {
+        et_ape_tag_set (tag, key, NULL);
+        return;
+    }
+
+    if (!et_str_empty (total))
+    {
+        string = g_strconcat (number, "/", total, NULL);
+        et_ape_tag_set (tag, key, string);
+        g_free (string);
+    }
+    else
+    {
+        et_ape_tag_set (tag, key, number);
+    }
+}
+
 gboolean
 ape_tag_write_file_tag (const ET_File *ETFile,
                         GError **error)
 {
     const File_Tag *FileTag;
     const gchar *filename_in;
-    //FILE     *file_in;
-    gchar    *string;
-    //GList    *list;
-    apetag   *ape_mem;
+    GFile *file;
+    EtReadSession *session;
+    EtApeTag *tag;
+    gboolean success;
 
     g_return_val_if_fail (ETFile != NULL && ETFile->FileTag != NULL, FALSE);
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
@@ -217,164 +249,48 @@ ape_tag_write_file_tag (const ET_File *ETFile,
     FileTag     = (File_Tag *)ETFile->FileTag->data;
     filename_in = ((File_Name *)ETFile->FileNameCur->data)->value;
 
-    ape_mem = apetag_init ();
+    file = g_file_new_for_path (filename_in);
+    session = et_read_session_new (file, error);
 
-    /* TODO: Pointless, as g_set_error() will try to malloc. */
-    if (!ape_mem)
+    if (session == NULL)
     {
-        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOMEM, "%s",
-                     g_strerror (ENOMEM));
+        g_object_unref (file);
         return FALSE;
     }
 
-    /*********
-     * Title *
-     *********/
-    if (!et_str_empty (FileTag->title))
-        apefrm_add(ape_mem, 0, APE_TAG_FIELD_TITLE, FileTag->title);
-    else
-        apefrm_remove(ape_mem,APE_TAG_FIELD_TITLE);
-
-
-    /**********
-     * Artist *
-     **********/
-    if (!et_str_empty (FileTag->artist))
-        apefrm_add(ape_mem, 0, APE_TAG_FIELD_ARTIST, FileTag->artist);
-    else
-        apefrm_remove(ape_mem,APE_TAG_FIELD_ARTIST);
-
-    /* Album artist. */
-    if (!et_str_empty (FileTag->album_artist))
-    {
-        apefrm_add (ape_mem, 0, APE_TAG_FIELD_ALBUMARTIST,
-                    FileTag->album_artist);
-    }
-    else
-    {
-        apefrm_remove (ape_mem, APE_TAG_FIELD_ALBUMARTIST);
-    }
-
-    /*********
-     * Album *
-     *********/
-    if (!et_str_empty (FileTag->album))
-        apefrm_add(ape_mem, 0, APE_TAG_FIELD_ALBUM, FileTag->album);
-    else
-        apefrm_remove(ape_mem,APE_TAG_FIELD_ALBUM);
-
-    /******************************
-     * Disc Number and Disc Total *
-     ******************************/
-    if (!et_str_empty (FileTag->disc_number))
-    {
-        if (!et_str_empty (FileTag->disc_total))
-        {
-            string = g_strconcat (FileTag->disc_number, "/",
-                                  FileTag->disc_total, NULL);
-        }
-        else
-        {
-            string = g_strconcat (FileTag->disc_number, NULL);
-        }
-
-        apefrm_add (ape_mem, 0, APE_TAG_FIELD_PART, string);
-        g_free (string);
-    }
-    else
-    {
-        apefrm_remove (ape_mem, APE_TAG_FIELD_PART);
-    }
-
-    /********
-     * Year *
-     ********/
-    if (!et_str_empty (FileTag->year))
-        apefrm_add(ape_mem, 0, APE_TAG_FIELD_YEAR, FileTag->year);
-    else
-        apefrm_remove(ape_mem,APE_TAG_FIELD_YEAR);
+    /* Read the existing tags, so that the items which are not edited (and the
+     * fields of an ID3v1 tag) are kept. */
+    tag = et_ape_tag_read (session, error);
+    et_read_session_free (session);
 
-    /*************************
-     * Track and Total Track *
-     *************************/
-    if (!et_str_empty (FileTag->track))
+    if (tag == NULL)
     {
-        if (!et_str_empty (FileTag->track_total))
-            string = g_strconcat(FileTag->track,"/",FileTag->track_total,NULL);
-        else
-            string = g_strconcat(FileTag->track,NULL);
-        apefrm_add(ape_mem, 0, APE_TAG_FIELD_TRACK, string);
-        g_free(string);
-    } else
-        apefrm_remove(ape_mem,APE_TAG_FIELD_TRACK);
-
-    /*********
-     * Genre *
-     *********/
-    if (!et_str_empty (FileTag->genre))
-        apefrm_add(ape_mem, 0, APE_TAG_FIELD_GENRE, FileTag->genre);
-    else
-        apefrm_remove(ape_mem,APE_TAG_FIELD_GENRE);
-
-    /***********
-     * Comment *
-     ***********/
-    if (!et_str_empty (FileTag->comment))
-        apefrm_add (ape_mem, 0, APE_TAG_FIELD_COMMENT, FileTag->comment);
-    else
-        apefrm_remove(ape_mem,APE_TAG_FIELD_COMMENT);
-
-    /************
-     * Composer *
-     ************/
-    if (!et_str_empty (FileTag->composer))
-        apefrm_add(ape_mem, 0, APE_TAG_FIELD_COMPOSER, FileTag->composer);
-    else
-        apefrm_remove(ape_mem,APE_TAG_FIELD_COMPOSER);
-
-    /*******************
-     * Original artist *
-     *******************/
-    if (!et_str_empty (FileTag->orig_artist))
-        apefrm_add(ape_mem, 0, "Original Artist", FileTag->orig_artist);
-    else
-        apefrm_remove(ape_mem,"Original Artist");
-
-    /*************
-     * Copyright *
-     *************/
-    if (!et_str_empty (FileTag->copyright))
-        apefrm_add(ape_mem, 0, APE_TAG_FIELD_COPYRIGHT, FileTag->copyright);
-    else
-        apefrm_remove(ape_mem,APE_TAG_FIELD_COPYRIGHT);
-
-    /*******
-     * URL *
-     *******/
-    if (!et_str_empty (FileTag->url))
-        apefrm_add(ape_mem, 0, APE_TAG_FIELD_RELATED_URL, FileTag->url);
-    else
-        apefrm_remove(ape_mem,APE_TAG_FIELD_RELATED_URL);
-
-    /**************
-     * Encoded by *
-     **************/
-    if (!et_str_empty (FileTag->encoded_by))
-        apefrm_add(ape_mem, 0, "Encoded By", FileTag->encoded_by);
-    else
-        apefrm_remove(ape_mem,"Encoded By");
-
-    /* reread all tag-type again  excl. changed frames by apefrm_remove() */
-    if (apetag_save (filename_in, ape_mem, APE_TAG_V2 + SAVE_NEW_OLD_APE_TAG)
-        != 0)
-    {
-        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED, "%s",
-                     _("Failed to write APE tag"));
-        apetag_free (ape_mem);
+        g_object_unref (file);
         return FALSE;
     }
 
-    apetag_free(ape_mem);
-
-    return TRUE;
+    et_ape_tag_set (tag, APE_TAG_FIELD_TITLE, FileTag->title);
+    et_ape_tag_set (tag, APE_TAG_FIELD_ARTIST, FileTag->artist);
+    et_ape_tag_set (tag, APE_TAG_FIELD_ALBUMARTIST, FileTag->album_artist);
+    et_ape_tag_set (tag, APE_TAG_FIELD_ALBUM, FileTag->album);
+    set_number_item (tag, APE_TAG_FIELD_PART, FileTag->disc_number,
+                     FileTag->disc_total);
+    et_ape_tag_set (tag, APE_TAG_FIELD_YEAR, FileTag->year);
+    set_number_item (tag, APE_TAG_FIELD_TRACK, FileTag->track,
+                     FileTag->track_total);
+    et_ape_tag_set (tag, APE_TAG_FIELD_GENRE, FileTag->genre);
+    et_ape_tag_set (tag, APE_TAG_FIELD_COMMENT, FileTag->comment);
+    et_ape_tag_set (tag, APE_TAG_FIELD_COMPOSER, FileTag->composer);
+    et_ape_tag_set (tag, "Original Artist", FileTag->orig_artist);
+    et_ape_tag_set (tag, APE_TAG_FIELD_COPYRIGHT, FileTag->copyright);
+    et_ape_tag_set (tag, APE_TAG_FIELD_RELATED_URL, FileTag->url);
+    et_ape_tag_set (tag, "Encoded By", FileTag->encoded_by);
+
+    /* Writes an APEv2 tag in place of the old APE and ID3v1 tags. */
+    success = et_ape_tag_write (tag, file, error);
+
+    et_ape_tag_free (tag);
+    g_object_unref (file);
+
+    return success;
 }
@@ -22,7 +22,6 @@
 #ifdef ENABLE_FLAC
 
 #include <glib/gi18n.h>
-#include <errno.h>
 
 #include "et_core.h"
 #include "flac_header.h"
@@ -31,135 +30,52 @@
 
 /* Header info of FLAC file */
 gboolean
-et_flac_header_read_file_info (GFile *file,
+et_flac_header_read_file_info (EtReadSession *session,
                                ET_File_Info *ETFileInfo,
                                GError **error)
 {
-    GFileInfo *info;
-    FLAC__Metadata_Chain *chain;
-    EtFlacReadState state;
-    GFileInputStream *istream;
-    FLAC__IOCallbacks callbacks = { et_flac_read_func,
-                                    NULL, /* Do not set a write callback. */
-                                    et_flac_seek_func, et_flac_tell_func,
-                                    et_flac_eof_func,
-                                    et_flac_read_close_func };
-    FLAC__Metadata_Iterator *iter;
-    gsize metadata_len;
-
-    g_return_val_if_fail (file != NULL && ETFileInfo != NULL, FALSE);
-    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-
-    /* Decoding FLAC file */
-    chain = FLAC__metadata_chain_new ();
+    const EtFlacMetadata *metadata;
 
-    if (chain == NULL)
-    {
-        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOMEM, "%s",
-                     g_strerror (ENOMEM));
-        return FALSE;
-    }
+    g_return_val_if_fail (session != NULL && ETFileInfo != NULL, FALSE);
+    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-    istream = g_file_read (file, NULL, error);
+    /* Usually already parsed by the tag reader. */
+    metadata = et_flac_metadata_get (session, error);
 
-    if (istream == NULL)
+    if (!metadata)
     {
-        FLAC__metadata_chain_delete (chain);
+        g_assert (error == NULL || *error != NULL);
         return FALSE;
     }
 
-    state.eof = FALSE;
-    state.error = NULL;
-    state.istream = istream;
-    state.seekable = G_SEEKABLE (istream);
-
-    if (!FLAC__metadata_chain_read_with_callbacks (chain, &state, callbacks))
+    if (metadata->sample_rate == 0)
     {
-        const FLAC__Metadata_ChainStatus status = FLAC__metadata_chain_status (chain);
-
-        g_debug ("Error reading FLAC metadata chain: %s:",
-                 FLAC__Metadata_ChainStatusString[status]);
-        FLAC__metadata_chain_delete (chain);
-        /* TODO: Provide a dedicated error enum corresponding to status. */
-        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED, "%s",
-                     _("Error opening FLAC file"));
-        et_flac_read_close_func (&state);
-        return FALSE;
-    }
+        gchar *filename;
 
-    iter = FLAC__metadata_iterator_new ();
+        /* This is invalid according to the FLAC specification, but such files
+         * have been observed in the wild. */
+        ETFileInfo->duration = 0;
 
-    if (iter == NULL)
-    {
-        et_flac_read_close_func (&state);
-        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOMEM, "%s",
-                     g_strerror (ENOMEM));
-        return FALSE;
+        filename = g_file_get_path (et_read_session_get_file (session));
+        g_debug ("Invalid FLAC sample rate of 0: %s", filename);
+        g_free (filename);
     }
-
-    FLAC__metadata_iterator_init (iter, chain);
-    metadata_len = 0;
-
-    do
+    else
     {
-        const FLAC__StreamMetadata *block;
-
-        block = FLAC__metadata_iterator_get_block (iter);
-
-        metadata_len += block->length;
-
-        if (FLAC__metadata_iterator_get_block_type (iter)
-            == FLAC__METADATA_TYPE_STREAMINFO)
-        {
-            const FLAC__StreamMetadata_StreamInfo *stream_info = &block->data.stream_info;
-            if (stream_info->sample_rate == 0)
-            {
-                gchar *filename;
-
-                /* This is invalid according to the FLAC specification, but
-                 * such files have been observed in the wild. */
-                ETFileInfo->duration = 0;
-
-                filename = g_file_get_path (file);
-                g_debug ("Invalid FLAC sample rate of 0: %s", filename);
-                g_free (filename);
-            }
-            else
-            {
-                ETFileInfo->duration = stream_info->total_samples
-                                       / stream_info->sample_rate;
-            }
-
-            ETFileInfo->mode = stream_info->channels;
-            ETFileInfo->samplerate = stream_info->sample_rate;
-            ETFileInfo->version = 0; /* Not defined in FLAC file. */
-        }
+        ETFileInfo->duration = metadata->total_samples / metadata->sample_rate;
     }
-    while (FLAC__metadata_iterator_next (iter));
-
-    FLAC__metadata_iterator_delete (iter);
-    FLAC__metadata_chain_delete (chain);
-    et_flac_read_close_func (&state);
-    /* End of decoding FLAC file */
 
-    info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE,
-                              G_FILE_QUERY_INFO_NONE, NULL, NULL);
+    ETFileInfo->mode = metadata->channels;
+    ETFileInfo->samplerate = metadata->sample_rate;
+    ETFileInfo->version = 0; /* Not defined in FLAC file. */
 
-    if (info)
-    {
-        ETFileInfo->size = g_file_info_get_size (info);
-        g_object_unref (info);
-    }
-    else
-    {
-        ETFileInfo->size = 0;
-    }
+    ETFileInfo->size = et_read_session_get_size (session);
 
     if (ETFileInfo->duration > 0 && ETFileInfo->size > 0)
     {
         /* Ignore metadata blocks, and use the remainder to calculate the
          * average bitrate (including format overhead). */
-        ETFileInfo->bitrate = (ETFileInfo->size - metadata_len) * 8 /
+        ETFileInfo->bitrate = (ETFileInfo->size - metadata->metadata_len) * 8 /
                               ETFileInfo->duration / 1000;
     }
 
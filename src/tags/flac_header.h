@@ -21,10 +21,11 @@
 #define ET_FLAC_HEADER_H_
 
 #include "et_core.h"
+#include "read_session.h"
 
 G_BEGIN_DECLS
 
-gboolean et_flac_header_read_file_info (GFile *file, ET_File_Info *ETFileInfo, GError **error);
+gboolean et_flac_header_read_file_info (EtReadSession *session, ET_File_Info *ETFileInfo, GError **error);
 EtFileHeaderFields * et_flac_header_display_file_info_to_ui (const ET_File *ETFile);
 void et_flac_file_header_fields_free (EtFileHeaderFields *fields);
 
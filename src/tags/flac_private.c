@@ -20,9 +20,556 @@
 
 #ifdef ENABLE_FLAC
 
+#include <glib/gi18n.h>
 #include <errno.h>
+#include <string.h>
 #include <unistd.h>
 
+/* The key under which the parsed metadata is stored in the read session. */
+#define ET_FLAC_METADATA_KEY "et-flac-metadata"
+
+/* Length of the fixed part of a STREAMINFO block. */
+#define ET_FLAC_STREAMINFO_LENGTH 34
+
+/* The metadata block types which are read. */
+enum
+{
+    ET_FLAC_BLOCK_STREAMINFO = 0,
+    ET_FLAC_BLOCK_VORBIS_COMMENT = 4,
+    ET_FLAC_BLOCK_PICTURE = 6,
+    ET_FLAC_BLOCK_INVALID = 127
+};
+
+static guint32
+et_flac_read_be32 (const guchar *data)
+{
+    return ((guint32)data[0] << 24) | ((guint32)data[1] << 16)
+           | ((guint32)data[2] << 8) | data[3];
+}
+
+static guint32
+et_flac_read_le32 (const guchar *data)
+{
+    return ((guint32)data[3] << 24) | ((guint32)data[2] << 16)
+           | ((guint32)data[1] << 8) | data[0];
+}
+
+/*
+ * et_flac_set_invalid_error:
+ * @error: a #GError, or %NULL
+ *
+ * Set the error for a file which is not a valid FLAC file.
+ */
+static void
+et_flac_set_invalid_error (GError **error)
+{
+    /* TODO: Provide a dedicated error enum. */
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED, "%s",
+                 _("Error opening FLAC file"));
+}
+
+/*
+ * et_flac_read_exactly:
+ * @istream: the stream to read from
+ * @buffer: the buffer to fill
+ * @count: the number of bytes to read
+ * @error: a #GError, or %NULL
+ *
+ * Read exactly @count bytes, treating a truncated file as invalid.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+static gboolean
+et_flac_read_exactly (GInputStream *istream,
+                      void *buffer,
+                      gsize count,
+                      GError **error)
+{
+    gsize bytes_read;
+
+    if (!g_input_stream_read_all (istream, buffer, count, &bytes_read, NULL,
+                                  error))
+    {
+        return FALSE;
+    }
+
+    if (bytes_read != count)
+    {
+        et_flac_set_invalid_error (error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+et_flac_skip (GInputStream *istream,
+              goffset count,
+              GError **error)
+{
+    return g_seekable_seek (G_SEEKABLE (istream), count, G_SEEK_CUR, NULL,
+                            error);
+}
+
+/*
+ * et_flac_skip_to_stream_marker:
+ * @istream: a stream at the start of the file
+ * @error: a #GError, or %NULL
+ *
+ * Skip an ID3v2 tag at the start of the file, as libFLAC does, and check for
+ * the "fLaC" stream marker.
+ *
+ * Returns: %TRUE if the stream is now at the first metadata block, %FALSE
+ *          otherwise
+ */
+static gboolean
+et_flac_skip_to_stream_marker (GInputStream *istream,
+                               GError **error)
+{
+    guchar marker[4];
+
+    if (!et_flac_read_exactly (istream, marker, sizeof (marker), error))
+    {
+        return FALSE;
+    }
+
+    if (memcmp (marker, "ID3", 3) == 0)
+    {
+        guchar header[6];
+        goffset tag_size;
+
+        /* The rest of the version, the flags and the syncsafe size of the
+         * ID3v2 header. */
+        if (!et_flac_read_exactly (istream, header, sizeof (header), error))
+        {
+            return FALSE;
+        }
+
+        tag_size = ((header[2] & 0x7f) << 21) | ((header[3] & 0x7f) << 14)
+                   | ((header[4] & 0x7f) << 7) | (header[5] & 0x7f);
+
+        /* Footer present. */
+        if (header[1] & 0x10)
+        {
+            tag_size += 10;
+        }
+
+        if (!et_flac_skip (istream, tag_size, error)
+            || !et_flac_read_exactly (istream, marker, sizeof (marker),
+                                      error))
+        {
+            return FALSE;
+        }
+    }
+
+    if (memcmp (marker, "fLaC", 4) != 0)
+    {
+        et_flac_set_invalid_error (error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * et_flac_metadata_parse_vorbis_comment:
+ * @block: the block to fill
+ * @data: (transfer full): the block data, with one spare byte at the end
+ * @length: the length of the block data, not counting the spare byte
+ *
+ * Point the comments of @block into @data, which is kept. Each string in
+ * the block is followed by the length of the next one, or by the spare byte,
+ * so the strings can be nul-terminated in place once all the lengths have
+ * been read.
+ *
+ * Returns: %TRUE if the block is valid, %FALSE otherwise
+ */
+static gboolean
+et_flac_metadata_parse_vorbis_comment (EtFlacVorbisComment *block,
+                                       guchar *data,
+                                       guint32 length)
+{
+    FLAC__StreamMetadata_VorbisComment *vc = &block->comment;
+    const guchar *end = data + length;
+    guchar *p = data;
+    guint32 i;
+
+    block->data = data;
+
+    if (end - p < 4)
+    {
+        return FALSE;
+    }
+
+    vc->vendor_string.length = et_flac_read_le32 (p);
+    p += 4;
+
+    if (vc->vendor_string.length > (gsize)(end - p))
+    {
+        return FALSE;
+    }
+
+    vc->vendor_string.entry = p;
+    p += vc->vendor_string.length;
+
+    if (end - p < 4)
+    {
+        return FALSE;
+    }
+
+    vc->num_comments = et_flac_read_le32 (p);
+    p += 4;
+
+    /* Each comment needs at least its length. */
+    if (vc->num_comments > (gsize)(end - p) / 4)
+    {
+        return FALSE;
+    }
+
+    vc->comments = g_new (FLAC__StreamMetadata_VorbisComment_Entry,
+                          vc->num_comments);
+
+    for (i = 0; i < vc->num_comments; i++)
+    {
+        FLAC__StreamMetadata_VorbisComment_Entry *comment = &vc->comments[i];
+
+        if (end - p < 4)
+        {
+            return FALSE;
+        }
+
+        comment->length = et_flac_read_le32 (p);
+        p += 4;
+
+        if (comment->length > (gsize)(end - p))
+        {
+            return FALSE;
+        }
+
+        comment->entry = p;
+        p += comment->length;
+    }
+
+    vc->vendor_string.entry[vc->vendor_string.length] = '\0';
+
+    for (i = 0; i < vc->num_comments; i++)
+    {
+        vc->comments[i].entry[vc->comments[i].length] = '\0';
+    }
+
+    return TRUE;
+}
+
+static void
+et_flac_vorbis_comment_clear (EtFlacVorbisComment *block)
+{
+    g_free (block->comment.comments);
+    g_free (block->data);
+}
+
+static void
+et_flac_metadata_free (EtFlacMetadata *metadata)
+{
+    g_array_free (metadata->vorbis_comments, TRUE);
+    g_array_free (metadata->pictures, TRUE);
+    g_slice_free (EtFlacMetadata, metadata);
+}
+
+/*
+ * et_flac_metadata_read:
+ * @istream: a stream at the start of the file
+ * @error: a #GError, or %NULL
+ *
+ * Read the metadata blocks in order, stopping before the first audio frame.
+ * Only STREAMINFO and the VORBIS_COMMENT blocks are decoded. PICTURE blocks
+ * are recorded by offset, and the other blocks are skipped without reading
+ * them.
+ *
+ * Returns: the metadata, or %NULL on error
+ */
+static EtFlacMetadata *
+et_flac_metadata_read (GInputStream *istream,
+                       GError **error)
+{
+    EtFlacMetadata *metadata;
+    gboolean is_last = FALSE;
+    gboolean is_first = TRUE;
+
+    if (!et_flac_skip_to_stream_marker (istream, error))
+    {
+        return NULL;
+    }
+
+    metadata = g_slice_new0 (EtFlacMetadata);
+    metadata->vorbis_comments = g_array_new (FALSE, FALSE,
+                                             sizeof (EtFlacVorbisComment));
+    g_array_set_clear_func (metadata->vorbis_comments,
+                            (GDestroyNotify)et_flac_vorbis_comment_clear);
+    metadata->pictures = g_array_new (FALSE, FALSE,
+                                      sizeof (EtFlacPictureBlock));
+
+    while (!is_last)
+    {
+        guchar header[4];
+        guint type;
+        guint32 length;
+
+        if (!et_flac_read_exactly (istream, header, sizeof (header), error))
+        {
+            goto err;
+        }
+
+        is_last = (header[0] & 0x80) != 0;
+        type = header[0] & 0x7f;
+        length = (header[1] << 16) | (header[2] << 8) | header[3];
+        metadata->metadata_len += length;
+
+        /* The first block must be STREAMINFO. */
+        if (is_first != (type == ET_FLAC_BLOCK_STREAMINFO))
+        {
+            et_flac_set_invalid_error (error);
+            goto err;
+        }
+
+        is_first = FALSE;
+
+        switch (type)
+        {
+            case ET_FLAC_BLOCK_STREAMINFO:
+            {
+                guchar info[ET_FLAC_STREAMINFO_LENGTH];
+
+                if (length < ET_FLAC_STREAMINFO_LENGTH)
+                {
+                    et_flac_set_invalid_error (error);
+                    goto err;
+                }
+
+                if (!et_flac_read_exactly (istream, info, sizeof (info),
+                                           error)
+                    || !et_flac_skip (istream,
+                                      length - ET_FLAC_STREAMINFO_LENGTH,
+                                      error))
+                {
+                    goto err;
+                }
+
+                /* After the block and frame sizes: 20 bits of sample rate, 3
+                 * bits of channels - 1, 5 bits of bits per sample - 1 and 36
+                 * bits of total samples. */
+                metadata->sample_rate = (info[10] << 12) | (info[11] << 4)
+                                        | (info[12] >> 4);
+                metadata->channels = ((info[12] >> 1) & 0x07) + 1;
+                metadata->total_samples = ((guint64)(info[13] & 0x0f) << 32)
+                                          | et_flac_read_be32 (&info[14]);
+                break;
+            }
+            case ET_FLAC_BLOCK_VORBIS_COMMENT:
+            {
+                /* There should only be one, but the fields of all of them
+                 * are read, as libFLAC returns them all. */
+                EtFlacVorbisComment block;
+                guchar *data;
+
+                data = g_malloc (length + 1);
+
+                if (!et_flac_read_exactly (istream, data, length, error))
+                {
+                    g_free (data);
+                    goto err;
+                }
+
+                memset (&block, 0, sizeof (block));
+
+                if (!et_flac_metadata_parse_vorbis_comment (&block, data,
+                                                            length))
+                {
+                    et_flac_vorbis_comment_clear (&block);
+                    et_flac_set_invalid_error (error);
+                    goto err;
+                }
+
+                g_array_append_val (metadata->vorbis_comments, block);
+                break;
+            }
+            case ET_FLAC_BLOCK_PICTURE:
+            {
+                EtFlacPictureBlock block;
+
+                block.offset = g_seekable_tell (G_SEEKABLE (istream));
+                block.length = length;
+                g_array_append_val (metadata->pictures, block);
+
+                if (!et_flac_skip (istream, length, error))
+                {
+                    goto err;
+                }
+                break;
+            }
+            case ET_FLAC_BLOCK_INVALID:
+                et_flac_set_invalid_error (error);
+                goto err;
+            default:
+                /* PADDING, APPLICATION, SEEKTABLE, CUESHEET and reserved
+                 * block types. */
+                if (!et_flac_skip (istream, length, error))
+                {
+                    goto err;
+                }
+                break;
+        }
+    }
+
+    return metadata;
+
+err:
+    g_assert (error == NULL || *error != NULL);
+    et_flac_metadata_free (metadata);
+    return NULL;
+}
+
+/*
+ * et_flac_metadata_get:
+ * @session: the read session of a FLAC file
+ * @error: a #GError, or %NULL
+ *
+ * Get the metadata of the file, reading it on the first call in the session,
+ * so that the tag and the header readers share a single pass over the file.
+ *
+ * Returns: (transfer none): the metadata, owned by @session, or %NULL on
+ *          error
+ */
+EtFlacMetadata *
+et_flac_metadata_get (EtReadSession *session,
+                      GError **error)
+{
+    EtFlacMetadata *metadata;
+    GFileInputStream *istream;
+
+    g_return_val_if_fail (session != NULL, NULL);
+    g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+    metadata = et_read_session_get_data (session, ET_FLAC_METADATA_KEY);
+
+    if (metadata)
+    {
+        return metadata;
+    }
+
+    istream = et_read_session_open_stream (session);
+    metadata = et_flac_metadata_read (G_INPUT_STREAM (istream), error);
+    g_object_unref (istream);
+
+    if (metadata)
+    {
+        et_read_session_set_data (session, ET_FLAC_METADATA_KEY, metadata,
+                                  (GDestroyNotify)et_flac_metadata_free);
+    }
+
+    return metadata;
+}
+
+/*
+ * et_flac_metadata_read_picture:
+ * @session: the read session of a FLAC file
+ * @block: a PICTURE block from et_flac_metadata_get()
+ * @type: (out): the picture type
+ * @description: (out) (transfer full): the description of the picture
+ * @data: (out) (transfer full): the image data
+ * @error: a #GError, or %NULL
+ *
+ * Read and decode a PICTURE block. The image data is not copied out of the
+ * block.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+gboolean
+et_flac_metadata_read_picture (EtReadSession *session,
+                               const EtFlacPictureBlock *block,
+                               guint32 *type,
+                               gchar **description,
+                               GBytes **data,
+                               GError **error)
+{
+    GFileInputStream *istream;
+    guchar *buffer;
+    const guchar *p;
+    const guchar *end;
+    guint32 length;
+    gboolean success;
+
+    g_return_val_if_fail (session != NULL && block != NULL, FALSE);
+    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+    buffer = g_malloc (block->length);
+    istream = et_read_session_open_stream (session);
+
+    success = g_seekable_seek (G_SEEKABLE (istream), block->offset,
+                               G_SEEK_SET, NULL, error)
+              && et_flac_read_exactly (G_INPUT_STREAM (istream), buffer,
+                                       block->length, error);
+    g_object_unref (istream);
+
+    if (!success)
+    {
+        g_free (buffer);
+        return FALSE;
+    }
+
+    p = buffer;
+    end = buffer + block->length;
+
+    /* Type, then the MIME type, which is not needed. */
+    if (end - p < 8)
+    {
+        goto invalid;
+    }
+
+    *type = et_flac_read_be32 (p);
+    length = et_flac_read_be32 (p + 4);
+    p += 8;
+
+    if (length > (gsize)(end - p) || end - p - length < 4)
+    {
+        goto invalid;
+    }
+
+    p += length;
+
+    /* Description. */
+    length = et_flac_read_be32 (p);
+    p += 4;
+
+    /* Also the width, height, depth and number of colors, and the data
+     * length. */
+    if (length > (gsize)(end - p) || end - p - length < 20)
+    {
+        goto invalid;
+    }
+
+    *description = g_strndup ((const gchar *)p, length);
+    p += length + 16;
+
+    length = et_flac_read_be32 (p);
+    p += 4;
+
+    if (length > (gsize)(end - p))
+    {
+        g_free (*description);
+        goto invalid;
+    }
+
+    *data = g_bytes_new_with_free_func (p, length, g_free, buffer);
+
+    return TRUE;
+
+invalid:
+    g_free (buffer);
+    et_flac_set_invalid_error (error);
+    return FALSE;
+}
+
+
 size_t
 et_flac_read_func (void *ptr,
                    size_t size,
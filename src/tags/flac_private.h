@@ -26,6 +26,8 @@
 #include <gio/gio.h>
 #include <FLAC/metadata.h>
 
+#include "read_session.h"
+
 G_BEGIN_DECLS
 
 /*
@@ -60,6 +62,56 @@ typedef struct
     GFileIOStream *iostream;
 } EtFlacWriteState;
 
+/*
+ * EtFlacPictureBlock:
+ * @offset: the offset in the file of the data of the PICTURE block
+ * @length: the length of the data of the block
+ *
+ * The location of a PICTURE block, which is only read when it is needed.
+ */
+typedef struct
+{
+    goffset offset;
+    guint32 length;
+} EtFlacPictureBlock;
+
+/*
+ * EtFlacVorbisComment:
+ * @comment: the comments of a VORBIS_COMMENT block, pointing into @data
+ * @data: the data of the block
+ */
+typedef struct
+{
+    FLAC__StreamMetadata_VorbisComment comment;
+    guchar *data;
+} EtFlacVorbisComment;
+
+/*
+ * EtFlacMetadata:
+ * @sample_rate: the sample rate from the STREAMINFO block
+ * @channels: the number of channels from the STREAMINFO block
+ * @total_samples: the number of samples from the STREAMINFO block, or 0 if
+ *                 unknown
+ * @metadata_len: the total length of the data of all the metadata blocks
+ * @vorbis_comments: (element-type EtFlacVorbisComment): the VORBIS_COMMENT
+ *                   blocks, in order
+ * @pictures: (element-type EtFlacPictureBlock): the PICTURE blocks, in order
+ *
+ * The metadata of a FLAC file, as read by et_flac_metadata_get().
+ */
+typedef struct
+{
+    guint32 sample_rate;
+    guint channels;
+    guint64 total_samples;
+    gsize metadata_len;
+    GArray *vorbis_comments;
+    GArray *pictures;
+} EtFlacMetadata;
+
+EtFlacMetadata * et_flac_metadata_get (EtReadSession *session, GError **error);
+gboolean et_flac_metadata_read_picture (EtReadSession *session, const EtFlacPictureBlock *block, guint32 *type, gchar **description, GBytes **data, GError **error);
+
 /* Used with both EtFlacReadState and EtFlacWriteState. */
 size_t et_flac_read_func (void *ptr, size_t size, size_t nmemb, FLAC__IOHandle handle);
 int et_flac_seek_func (FLAC__IOHandle handle, FLAC__int64 offset, int whence);
@@ -30,9 +30,11 @@
 #include "vcedit.h"
 #include "et_core.h"
 #include "id3_tag.h"
+#include "log.h"
 #include "misc.h"
 #include "setting.h"
 #include "picture.h"
+#include "picture_probe.h"
 #include "charset.h"
 
 #define MULTIFIELD_SEPARATOR " - "
@@ -182,374 +184,357 @@ values_list_foreach (gpointer data,
 }
 
 /*
- * Read tag data from a FLAC file using the level 2 flac interface,
- * Note:
- *  - if field is found but contains no info (strlen(str)==0), we don't read it
+ * flac_tag_read_vorbis_comment:
+ * @vc: the Vorbis comment block of the file
+ * @FileTag: the tag to fill
+ *
+ * Fill @FileTag from the fields of @vc, keeping unsupported fields in
+ * @FileTag->other.
  */
-gboolean
-flac_tag_read_file_tag (GFile *file,
-                        File_Tag *FileTag,
-                        GError **error)
+static void
+flac_tag_read_vorbis_comment (const FLAC__StreamMetadata_VorbisComment *vc,
+                              File_Tag *FileTag)
 {
-    FLAC__Metadata_Chain *chain;
-    EtFlacReadState state;
-    FLAC__IOCallbacks callbacks = { et_flac_read_func,
-                                    NULL, /* Do not set a write callback. */
-                                    et_flac_seek_func, et_flac_tell_func,
-                                    et_flac_eof_func,
-                                    et_flac_read_close_func };
-    FLAC__Metadata_Iterator *iter;
-
-    EtPicture *prev_pic = NULL;
-
-    g_return_val_if_fail (file != NULL && FileTag != NULL, FALSE);
-    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+    GHashTable *tags;
+    GSList *strings;
+    GHashTableIter tags_iter;
+    gchar *key;
 
-    chain = FLAC__metadata_chain_new ();
+    tags = populate_tag_hash_table (vc);
 
-    if (chain == NULL)
+    /* Title */
+    if ((strings = g_hash_table_lookup (tags,
+                                        ET_VORBIS_COMMENT_FIELD_TITLE)))
     {
-        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOMEM, "%s",
-                     g_strerror (ENOMEM));
-        return FALSE;
+        g_slist_foreach (strings, values_list_foreach,
+                         &FileTag->title);
+        g_slist_free (strings);
+        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_TITLE);
     }
 
-    state.error = NULL;
-    state.istream = g_file_read (file, NULL, &state.error);
-    state.seekable = G_SEEKABLE (state.istream);
-
-    if (!FLAC__metadata_chain_read_with_callbacks (chain, &state, callbacks))
+    /* Artist */
+    if ((strings = g_hash_table_lookup (tags,
+                                        ET_VORBIS_COMMENT_FIELD_ARTIST)))
     {
-        /* TODO: Provide a dedicated error enum corresponding to status. */
-        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED, "%s",
-                     _("Error opening FLAC file"));
-        et_flac_read_close_func (&state);
-
-        return FALSE;
+        g_slist_foreach (strings, values_list_foreach,
+                         &FileTag->artist);
+        g_slist_free (strings);
+        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_ARTIST);
     }
 
-    iter = FLAC__metadata_iterator_new ();
-
-    if (iter == NULL)
+    /* Album artist. */
+    if ((strings = g_hash_table_lookup (tags,
+                                        ET_VORBIS_COMMENT_FIELD_ALBUM_ARTIST)))
     {
-        et_flac_read_close_func (&state);
-        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOMEM, "%s",
-                     g_strerror (ENOMEM));
-        return FALSE;
+        g_slist_foreach (strings, values_list_foreach,
+                         &FileTag->album_artist);
+        g_slist_free (strings);
+        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_ALBUM_ARTIST);
     }
 
-    FLAC__metadata_iterator_init (iter, chain);
+    /* Album. */
+    if ((strings = g_hash_table_lookup (tags,
+                                        ET_VORBIS_COMMENT_FIELD_ALBUM)))
+    {
+        g_slist_foreach (strings, values_list_foreach,
+                         &FileTag->album);
+        g_slist_free (strings);
+        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_ALBUM);
+    }
 
-    while (FLAC__metadata_iterator_next (iter))
+    /* Disc number and total discs. */
+    if ((strings = g_hash_table_lookup (tags,
+                                        ET_VORBIS_COMMENT_FIELD_DISC_TOTAL)))
     {
-        FLAC__StreamMetadata *block;
+        /* Only take values from the first total discs field. */
+        if (!et_str_empty (strings->data))
+        {
+            FileTag->disc_total = et_disc_number_to_string (atoi (strings->data));
+        }
 
-        block = FLAC__metadata_iterator_get_block (iter);
+        g_slist_free_full (strings, g_free);
+        g_hash_table_remove (tags,
+                             ET_VORBIS_COMMENT_FIELD_DISC_TOTAL);
+    }
 
-        if (block->type == FLAC__METADATA_TYPE_VORBIS_COMMENT)
+    if ((strings = g_hash_table_lookup (tags,
+                                        ET_VORBIS_COMMENT_FIELD_DISC_NUMBER)))
+    {
+        /* Only take values from the first disc number field. */
+        if (!et_str_empty (strings->data))
         {
-            const FLAC__StreamMetadata_VorbisComment *vc;
-            GHashTable *tags;
-            GSList *strings;
-            GHashTableIter tags_iter;
-            gchar *key;
-
-            /* Get comments from block. */
-            vc = &block->data.vorbis_comment;
-            tags = populate_tag_hash_table (vc);
-
-            /* Title */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_TITLE)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->title);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_TITLE);
-            }
+            gchar *separator;
 
-            /* Artist */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_ARTIST)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->artist);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_ARTIST);
-            }
+            separator = strchr (strings->data, '/');
 
-            /* Album artist. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_ALBUM_ARTIST)))
+            if (separator && !FileTag->disc_total)
             {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->album_artist);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_ALBUM_ARTIST);
+                FileTag->disc_total = et_disc_number_to_string (atoi (separator + 1));
+                *separator = '\0';
             }
 
-            /* Album. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_ALBUM)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->album);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_ALBUM);
-            }
+            FileTag->disc_number = et_disc_number_to_string (atoi (strings->data));
+        }
 
-            /* Disc number and total discs. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_DISC_TOTAL)))
-            {
-                /* Only take values from the first total discs field. */
-                if (!et_str_empty (strings->data))
-                {
-                    FileTag->disc_total = et_disc_number_to_string (atoi (strings->data));
-                }
+        g_slist_free_full (strings, g_free);
+        g_hash_table_remove (tags,
+                             ET_VORBIS_COMMENT_FIELD_DISC_NUMBER);
+    }
 
-                g_slist_free_full (strings, g_free);
-                g_hash_table_remove (tags,
-                                     ET_VORBIS_COMMENT_FIELD_DISC_TOTAL);
-            }
+    /* Track number and total tracks. */
+    if ((strings = g_hash_table_lookup (tags,
+                                        ET_VORBIS_COMMENT_FIELD_TRACK_TOTAL)))
+    {
+        /* Only take values from the first total tracks field. */
+        if (!et_str_empty (strings->data))
+        {
+            FileTag->track_total = et_track_number_to_string (atoi (strings->data));
+        }
+
+        g_slist_free_full (strings, g_free);
+        g_hash_table_remove (tags,
+                             ET_VORBIS_COMMENT_FIELD_TRACK_TOTAL);
+    }
 
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_DISC_NUMBER)))
+    if ((strings = g_hash_table_lookup (tags,
+                                        ET_VORBIS_COMMENT_FIELD_TRACK_NUMBER)))
+    {
+        /* Only take values from the first track number field. */
+        if (!et_str_empty (strings->data))
+        {
+            gchar *separator;
+
+            separator = strchr (strings->data, '/');
+
+            if (separator && !FileTag->track_total)
             {
-                /* Only take values from the first disc number field. */
-                if (!et_str_empty (strings->data))
-                {
-                    gchar *separator;
+                FileTag->track_total = et_track_number_to_string (atoi (separator + 1));
+                *separator = '\0';
+            }
 
-                    separator = strchr (strings->data, '/');
+            FileTag->track = et_track_number_to_string (atoi (strings->data));
+        }
 
-                    if (separator && !FileTag->disc_total)
-                    {
-                        FileTag->disc_total = et_disc_number_to_string (atoi (separator + 1));
-                        *separator = '\0';
-                    }
+        g_slist_free_full (strings, g_free);
+        g_hash_table_remove (tags,
+                             ET_VORBIS_COMMENT_FIELD_TRACK_NUMBER);
+    }
 
-                    FileTag->disc_number = et_disc_number_to_string (atoi (strings->data));
-                }
+    /* Year. */
+    if ((strings = g_hash_table_lookup (tags,
+                                        ET_VORBIS_COMMENT_FIELD_DATE)))
+    {
+        g_slist_foreach (strings, values_list_foreach,
+                         &FileTag->year);
+        g_slist_free (strings);
+        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_DATE);
+    }
 
-                g_slist_free_full (strings, g_free);
-                g_hash_table_remove (tags,
-                                     ET_VORBIS_COMMENT_FIELD_DISC_NUMBER);
-            }
+    /* Genre. */
+    if ((strings = g_hash_table_lookup (tags,
+                                        ET_VORBIS_COMMENT_FIELD_GENRE)))
+    {
+        g_slist_foreach (strings, values_list_foreach,
+                         &FileTag->genre);
+        g_slist_free (strings);
+        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_GENRE);
+    }
 
-            /* Track number and total tracks. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_TRACK_TOTAL)))
-            {
-                /* Only take values from the first total tracks field. */
-                if (!et_str_empty (strings->data))
-                {
-                    FileTag->track_total = et_track_number_to_string (atoi (strings->data));
-                }
+    /* Comment. */
+    {
+        GSList *descs;
+        GSList *comments;
 
-                g_slist_free_full (strings, g_free);
-                g_hash_table_remove (tags,
-                                     ET_VORBIS_COMMENT_FIELD_TRACK_TOTAL);
-            }
+        descs = g_hash_table_lookup (tags,
+                                     ET_VORBIS_COMMENT_FIELD_DESCRIPTION);
+        comments = g_hash_table_lookup (tags,
+                                        ET_VORBIS_COMMENT_FIELD_COMMENT);
 
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_TRACK_NUMBER)))
-            {
-                /* Only take values from the first track number field. */
-                if (!et_str_empty (strings->data))
-                {
-                    gchar *separator;
+        /* Prefer DESCRIPTION, as it is part of the spec. */
+        if (descs && !comments)
+        {
+            g_slist_foreach (descs, values_list_foreach,
+                             &FileTag->comment);
+        }
+        else if (descs && comments)
+        {
+            /* Mark the file as modified, so that comments are written
+             * to the DESCRIPTION field on saving. */
+            FileTag->saved = FALSE;
 
-                    separator = strchr (strings->data, '/');
+            g_slist_foreach (descs, values_list_foreach,
+                             &FileTag->comment);
+            g_slist_foreach (comments, values_list_foreach,
+                             &FileTag->comment);
+        }
+        else if (comments)
+        {
+            FileTag->saved = FALSE;
 
-                    if (separator && !FileTag->track_total)
-                    {
-                        FileTag->track_total = et_track_number_to_string (atoi (separator + 1));
-                        *separator = '\0';
-                    }
+            g_slist_foreach (comments, values_list_foreach,
+                             &FileTag->comment);
+        }
 
-                    FileTag->track = et_track_number_to_string (atoi (strings->data));
-                }
+        g_slist_free (descs);
+        g_slist_free (comments);
+        g_hash_table_remove (tags,
+                             ET_VORBIS_COMMENT_FIELD_DESCRIPTION);
+        g_hash_table_remove (tags,
+                             ET_VORBIS_COMMENT_FIELD_COMMENT);
+    }
 
-                g_slist_free_full (strings, g_free);
-                g_hash_table_remove (tags,
-                                     ET_VORBIS_COMMENT_FIELD_TRACK_NUMBER);
-            }
+    /* Composer. */
+    if ((strings = g_hash_table_lookup (tags,
+                                        ET_VORBIS_COMMENT_FIELD_COMPOSER)))
+    {
+        g_slist_foreach (strings, values_list_foreach,
+                         &FileTag->composer);
+        g_slist_free (strings);
+        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_COMPOSER);
+    }
 
-            /* Year. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_DATE)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->year);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_DATE);
-            }
+    /* Original artist. */
+    if ((strings = g_hash_table_lookup (tags,
+                                        ET_VORBIS_COMMENT_FIELD_PERFORMER)))
+    {
+        g_slist_foreach (strings, values_list_foreach,
+                         &FileTag->orig_artist);
+        g_slist_free (strings);
+        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_PERFORMER);
+    }
 
-            /* Genre. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_GENRE)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->genre);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_GENRE);
-            }
+    /* Copyright. */
+    if ((strings = g_hash_table_lookup (tags,
+                                        ET_VORBIS_COMMENT_FIELD_COPYRIGHT)))
+    {
+        g_slist_foreach (strings, values_list_foreach,
+                         &FileTag->copyright);
+        g_slist_free (strings);
+        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_COPYRIGHT);
+    }
 
-            /* Comment. */
-            {
-                GSList *descs;
-                GSList *comments;
+    /* URL. */
+    if ((strings = g_hash_table_lookup (tags,
+                                        ET_VORBIS_COMMENT_FIELD_CONTACT)))
+    {
+        g_slist_foreach (strings, values_list_foreach,
+                         &FileTag->url);
+        g_slist_free (strings);
+        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_CONTACT);
+    }
 
-                descs = g_hash_table_lookup (tags,
-                                             ET_VORBIS_COMMENT_FIELD_DESCRIPTION);
-                comments = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_COMMENT);
+    /* Encoded by. */
+    if ((strings = g_hash_table_lookup (tags,
+                                        ET_VORBIS_COMMENT_FIELD_ENCODED_BY)))
+    {
+        g_slist_foreach (strings, values_list_foreach,
+                         &FileTag->encoded_by);
+        g_slist_free (strings);
+        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_ENCODED_BY);
+    }
 
-                /* Prefer DESCRIPTION, as it is part of the spec. */
-                if (descs && !comments)
-                {
-                    g_slist_foreach (descs, values_list_foreach,
-                                     &FileTag->comment);
-                }
-                else if (descs && comments)
-                {
-                    /* Mark the file as modified, so that comments are written
-                     * to the DESCRIPTION field on saving. */
-                    FileTag->saved = FALSE;
-
-                    g_slist_foreach (descs, values_list_foreach,
-                                     &FileTag->comment);
-                    g_slist_foreach (comments, values_list_foreach,
-                                     &FileTag->comment);
-                }
-                else if (comments)
-                {
-                    FileTag->saved = FALSE;
+    /* Save unsupported fields. */
+    g_hash_table_iter_init (&tags_iter, tags);
 
-                    g_slist_foreach (comments, values_list_foreach,
-                                     &FileTag->comment);
-                }
+    while (g_hash_table_iter_next (&tags_iter, (gpointer *)&key,
+                                   (gpointer *)&strings))
+    {
+        GSList *l;
 
-                g_slist_free (descs);
-                g_slist_free (comments);
-                g_hash_table_remove (tags,
-                                     ET_VORBIS_COMMENT_FIELD_DESCRIPTION);
-                g_hash_table_remove (tags,
-                                     ET_VORBIS_COMMENT_FIELD_COMMENT);
-            }
+        for (l = strings; l != NULL; l = g_slist_next (l))
+        {
+            FileTag->other = g_list_prepend (FileTag->other,
+                                             g_strconcat (key,
+                                                          "=",
+                                                          l->data,
+                                                          NULL));
+        }
 
-            /* Composer. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_COMPOSER)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->composer);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_COMPOSER);
-            }
+        g_slist_free_full (strings, g_free);
+        g_hash_table_iter_remove (&tags_iter);
+    }
 
-            /* Original artist. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_PERFORMER)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->orig_artist);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_PERFORMER);
-            }
+    if (FileTag->other)
+    {
+        FileTag->other = g_list_reverse (FileTag->other);
+    }
 
-            /* Copyright. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_COPYRIGHT)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->copyright);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_COPYRIGHT);
-            }
+    /* The hash table should now only contain keys. */
+    g_hash_table_unref (tags);
+}
 
-            /* URL. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_CONTACT)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->url);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_CONTACT);
-            }
+/*
+ * Read tag data from a FLAC file, sharing the parsed metadata with the header
+ * reader.
+ * Note:
+ *  - if field is found but contains no info (strlen(str)==0), we don't read it
+ */
+gboolean
+flac_tag_read_file_tag (EtReadSession *session,
+                        File_Tag *FileTag,
+                        GError **error)
+{
+    EtFlacMetadata *metadata;
+    guint i;
+    EtPicture *prev_pic = NULL;
 
-            /* Encoded by. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_ENCODED_BY)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->encoded_by);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_ENCODED_BY);
-            }
+    g_return_val_if_fail (session != NULL && FileTag != NULL, FALSE);
+    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-            /* Save unsupported fields. */
-            g_hash_table_iter_init (&tags_iter, tags);
+    metadata = et_flac_metadata_get (session, error);
 
-            while (g_hash_table_iter_next (&tags_iter, (gpointer *)&key,
-                                           (gpointer *)&strings))
-            {
-                GSList *l;
+    if (!metadata)
+    {
+        g_assert (error == NULL || *error != NULL);
+        return FALSE;
+    }
 
-                for (l = strings; l != NULL; l = g_slist_next (l))
-                {
-                    FileTag->other = g_list_prepend (FileTag->other,
-                                                     g_strconcat (key,
-                                                                  "=",
-                                                                  l->data,
-                                                                  NULL));
-                }
+    for (i = 0; i < metadata->vorbis_comments->len; i++)
+    {
+        const EtFlacVorbisComment *block;
 
-                g_slist_free_full (strings, g_free);
-                g_hash_table_iter_remove (&tags_iter);
-            }
+        block = &g_array_index (metadata->vorbis_comments,
+                                EtFlacVorbisComment, i);
+        flac_tag_read_vorbis_comment (&block->comment, FileTag);
+    }
 
-            if (FileTag->other)
-            {
-                FileTag->other = g_list_reverse (FileTag->other);
-            }
+    /* Only the PICTURE blocks are read again, as the rest of the metadata was
+     * skipped when parsing. */
+    for (i = 0; i < metadata->pictures->len; i++)
+    {
+        const EtFlacPictureBlock *block;
+        guint32 type;
+        gchar *description;
+        GBytes *bytes;
+        EtPicture *pic;
+        GError *tmp_error = NULL;
 
-            /* The hash table should now only contain keys. */
-            g_hash_table_unref (tags);
-        }
-        else if (block->type == FLAC__METADATA_TYPE_PICTURE)
+        block = &g_array_index (metadata->pictures, EtFlacPictureBlock, i);
+
+        if (!et_flac_metadata_read_picture (session, block, &type,
+                                            &description, &bytes, &tmp_error))
         {
-            /* Picture. */
-            const FLAC__StreamMetadata_Picture *p;
-            GBytes *bytes;
-            EtPicture *pic;
-        
-            /* Get picture data from block. */
-            p = &block->data.picture;
+            g_debug ("Error reading FLAC picture block: %s",
+                     tmp_error->message);
+            g_error_free (tmp_error);
+            continue;
+        }
 
-            bytes = g_bytes_new (p->data, p->data_length);
-        
-            pic = et_picture_new (p->type, (const gchar *)p->description,
-                                  0, 0, bytes);
-            g_bytes_unref (bytes);
+        pic = et_picture_new (type, description, 0, 0, bytes);
+        g_bytes_unref (bytes);
+        g_free (description);
 
-            if (!prev_pic)
-            {
-                FileTag->picture = pic;
-            }
-            else
-            {
-                prev_pic->next = pic;
-            }
-
-            prev_pic = pic;
+        if (!prev_pic)
+        {
+            FileTag->picture = pic;
+        }
+        else
+        {
+            prev_pic->next = pic;
         }
-    }
 
-    FLAC__metadata_iterator_delete (iter);
-    FLAC__metadata_chain_delete (chain);
-    et_flac_read_close_func (&state);
+        prev_pic = pic;
+    }
 
 #ifdef ENABLE_MP3
     /* If no FLAC vorbis tag found : we try to get the ID3 tag if it exists
@@ -572,7 +557,7 @@ flac_tag_read_file_tag (GFile *file,
       && FileTag->encoded_by  == NULL
       && FileTag->picture     == NULL)
     {
-        id3tag_read_file_tag (file, FileTag, NULL);
+        id3tag_read_file_tag (session, FileTag, NULL);
 
         // If an ID3 tag has been found (and no FLAC tag), we mark the file as
         // unsaved to rewrite a flac tag.
@@ -719,7 +704,81 @@ vc_block_append_tag (FLAC__StreamMetadata *vc_block,
 }
 
 /*
- * Write Flac tag, using the level 2 flac interface
+ * flac_tag_set_padding:
+ * @chain: a chain with any padding sorted into a single block at the end
+ * @padding: the number of bytes of padding to leave
+ *
+ * Set the trailing PADDING block of @chain to @padding bytes, adding the block
+ * if there is none, or removing it if @padding is 0.
+ *
+ * Returns: %TRUE on success, %FALSE if a block could not be allocated
+ */
+static gboolean
+flac_tag_set_padding (FLAC__Metadata_Chain *chain,
+                      guint padding)
+{
+    FLAC__Metadata_Iterator *iter;
+    gboolean success = TRUE;
+
+    iter = FLAC__metadata_iterator_new ();
+
+    if (iter == NULL)
+    {
+        return FALSE;
+    }
+
+    FLAC__metadata_iterator_init (iter, chain);
+
+    while (FLAC__metadata_iterator_next (iter))
+    {
+        /* Move to the last block. */
+    }
+
+    if (FLAC__metadata_iterator_get_block_type (iter)
+        == FLAC__METADATA_TYPE_PADDING)
+    {
+        if (padding == 0)
+        {
+            FLAC__metadata_iterator_delete_block (iter, false);
+        }
+        else
+        {
+            FLAC__metadata_iterator_get_block (iter)->length = padding;
+        }
+    }
+    else if (padding > 0)
+    {
+        FLAC__StreamMetadata *padding_block;
+
+        padding_block = FLAC__metadata_object_new (FLAC__METADATA_TYPE_PADDING);
+
+        if (padding_block == NULL)
+        {
+            success = FALSE;
+        }
+        else
+        {
+            padding_block->length = padding;
+
+            if (!FLAC__metadata_iterator_insert_block_after (iter,
+                                                             padding_block))
+            {
+                FLAC__metadata_object_delete (padding_block);
+                success = FALSE;
+            }
+        }
+    }
+
+    FLAC__metadata_iterator_delete (iter);
+
+    return success;
+}
+
+/*
+ * Write Flac tag, using the level 2 flac interface. The tag is written in
+ * place, in the existing metadata and padding, whenever it fits. Otherwise the
+ * whole file is rewritten, with the configured amount of padding after the
+ * new tag so that later edits fit.
  */
 gboolean
 flac_tag_write_file_tag (const ET_File *ETFile,
@@ -740,6 +799,7 @@ flac_tag_write_file_tag (const ET_File *ETFile,
     FLAC__Metadata_Iterator *iter;
     FLAC__StreamMetadata_VorbisComment_Entry vce_field_vendor_string; // To save vendor string
     gboolean vce_field_vendor_string_found = FALSE;
+    gboolean needs_rewrite;
 
     g_return_val_if_fail (ETFile != NULL && ETFile->FileTag != NULL, FALSE);
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
@@ -1003,6 +1063,7 @@ flac_tag_write_file_tag (const ET_File *ETFile,
                 const gchar *violation;
                 FLAC__StreamMetadata *picture_block; // For picture data
                 Picture_Format format;
+                EtPictureInfo info;
                 gconstpointer data;
                 gsize data_size;
                 
@@ -1024,13 +1085,23 @@ flac_tag_write_file_tag (const ET_File *ETFile,
                     FLAC__metadata_object_picture_set_description(picture_block, (FLAC__byte *)pic->description, TRUE);
                 }
                 
+                /* Picture data. */
+                data = g_bytes_get_data (pic->bytes, &data_size);
+
                 // Resolution
                 picture_block->data.picture.width  = pic->width;
                 picture_block->data.picture.height = pic->height;
-                picture_block->data.picture.depth  = 0;
 
-                /* Picture data. */
-                data = g_bytes_get_data (pic->bytes, &data_size);
+                if (et_picture_probe (data, data_size, &info))
+                {
+                    picture_block->data.picture.depth = info.depth;
+                    picture_block->data.picture.colors = info.colors;
+                }
+                else
+                {
+                    picture_block->data.picture.depth = 0;
+                    picture_block->data.picture.colors = 0;
+                }
                 /* Safe to pass const data, if the last argument (copy) is
                  * TRUE, according the the FLAC API reference. */
                 FLAC__metadata_object_picture_set_data (picture_block,
@@ -1063,9 +1134,37 @@ flac_tag_write_file_tag (const ET_File *ETFile,
     //
     
     FLAC__metadata_chain_sort_padding (chain);
- 
+
+    /* With padding allowed, libFLAC grows or shrinks the trailing padding to
+     * keep the metadata the same length, so that the audio data is left
+     * alone. */
+    needs_rewrite = FLAC__metadata_chain_check_if_tempfile_needed (chain,
+                                                                   true);
+
+    if (needs_rewrite)
+    {
+        /* The audio data has to be moved anyway, so reserve room for the tag
+         * to grow in later edits. */
+        if (!flac_tag_set_padding (chain,
+                                   g_settings_get_uint (MainSettings,
+                                                        "flac-padding-size")))
+        {
+            flac_error_msg = FLAC__Metadata_ChainStatusString[FLAC__METADATA_CHAIN_STATUS_MEMORY_ALLOCATION_ERROR];
+            FLAC__metadata_chain_delete (chain);
+            et_flac_write_close_func (&state);
+
+            g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                         _("Failed to write comments to file ‘%s’: %s"),
+                         filename_utf8, flac_error_msg);
+            return FALSE;
+        }
+
+        needs_rewrite = FLAC__metadata_chain_check_if_tempfile_needed (chain,
+                                                                       true);
+    }
+
     /* Write tag. */
-    if (FLAC__metadata_chain_check_if_tempfile_needed (chain, true))
+    if (needs_rewrite)
     {
         EtFlacWriteState temp_state;
         GFile *temp_file;
@@ -1146,6 +1245,18 @@ flac_tag_write_file_tag (const ET_File *ETFile,
     FLAC__metadata_chain_delete (chain);
     et_flac_write_close_func (&state);
 
+    if (needs_rewrite)
+    {
+        Log_Print (LOG_INFO,
+                   _("The whole of file ‘%s’ was rewritten to fit the tag"),
+                   filename_utf8);
+    }
+    else
+    {
+        Log_Print (LOG_OK, _("The tag of file ‘%s’ was written in place"),
+                   filename_utf8);
+    }
+
 #ifdef ENABLE_MP3
     {
         // Delete the ID3 tags (create a dummy ETFile for the Id3tag_... function)
@@ -1153,8 +1264,8 @@ flac_tag_write_file_tag (const ET_File *ETFile,
         File_Name *FileName_tmp = et_file_name_new ();
         File_Tag  *FileTag_tmp = et_file_tag_new ();
         // Same file...
-        FileName_tmp->value      = g_strdup(filename);
-        FileName_tmp->value_utf8 = g_strdup(filename_utf8); // Not necessary to fill 'value_ck'
+        ET_Set_Filename_File_Name_Item (FileName_tmp, filename_utf8,
+                                        filename);
         ETFile_tmp->FileNameList = g_list_append(NULL,FileName_tmp);
         ETFile_tmp->FileNameCur  = ETFile_tmp->FileNameList;
         // With empty tag...
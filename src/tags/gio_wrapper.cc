@@ -23,12 +23,14 @@
 
 #include "gio_wrapper.h"
 
-GIO_InputStream::GIO_InputStream (GFile * file_) :
-    file ((GFile *)g_object_ref (gpointer (file_))),
+/* The stream reads through the shared session, so that TagLib does not open
+ * the file again. */
+GIO_InputStream::GIO_InputStream (EtReadSession *session) :
+    file ((GFile *)g_object_ref (gpointer (et_read_session_get_file (session)))),
+    stream (et_read_session_open_stream (session)),
     filename (g_file_get_uri (file)),
     error (NULL)
 {
-    stream = g_file_read (file, NULL, &error);
 }
 
 GIO_InputStream::~GIO_InputStream ()
@@ -27,10 +27,12 @@
 #include <tiostream.h>
 #include <gio/gio.h>
 
+#include "read_session.h"
+
 class GIO_InputStream : public TagLib::IOStream
 {
 public:
-    GIO_InputStream (GFile *file_);
+    GIO_InputStream (EtReadSession *session);
     virtual ~GIO_InputStream ();
     virtual TagLib::FileName name () const;
     virtual TagLib::ByteVector readBlock (TagLib::ulong length);
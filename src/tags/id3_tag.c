@@ -547,6 +547,23 @@ id3tag_write_file_v23tag (const ET_File *ETFile,
                     ID3Field_SetASCII (id3_field, "GIF");
                 }
                 break;
+            case PICTURE_FORMAT_BMP:
+            case PICTURE_FORMAT_WEBP:
+                if ((id3_field = ID3Frame_GetField (id3_frame,
+                                                    ID3FN_MIMETYPE)))
+                {
+                    ID3Field_SetASCII (id3_field,
+                                       Picture_Mime_Type_String (format));
+                }
+
+                if ((id3_field = ID3Frame_GetField (id3_frame,
+                                                    ID3FN_IMAGEFORMAT)))
+                {
+                    ID3Field_SetASCII (id3_field,
+                                       format == PICTURE_FORMAT_BMP ? "BMP"
+                                                                    : "WEBP");
+                }
+                break;
             case PICTURE_FORMAT_UNKNOWN:
             default:
                 break;
@@ -600,8 +617,8 @@ id3tag_write_file_v23tag (const ET_File *ETFile,
         File_Name *FileName_tmp = et_file_name_new ();
         File_Tag  *FileTag_tmp = et_file_tag_new();
         // Same file...
-        FileName_tmp->value      = g_strdup(filename);
-        FileName_tmp->value_utf8 = g_strdup(filename_utf8);  // Not necessary to fill 'value_ck'
+        ET_Set_Filename_File_Name_Item (FileName_tmp, filename_utf8,
+                                        filename);
         ETFile_tmp->FileNameList = g_list_append(NULL,FileName_tmp);
         ETFile_tmp->FileNameCur  = ETFile_tmp->FileNameList;
         // With empty tag...
@@ -748,8 +765,10 @@ id3tag_write_file_v23tag (const ET_File *ETFile,
                                        "id3v2-enable-unicode"))
         {
             File_Tag  *FileTag_tmp = et_file_tag_new ();
+            EtReadSession *session = et_read_session_new (file, NULL);
 
-            if (id3tag_read_file_tag (file, FileTag_tmp, NULL) == TRUE
+            if (session
+                && id3tag_read_file_tag (session, FileTag_tmp, NULL) == TRUE
                 && et_file_tag_detect_difference (FileTag,
                                                   FileTag_tmp) == TRUE)
             {
@@ -760,6 +779,11 @@ id3tag_write_file_v23tag (const ET_File *ETFile,
                              _("Buggy id3lib"));
             }
 
+            if (session)
+            {
+                et_read_session_free (session);
+            }
+
             et_file_tag_free (FileTag_tmp);
         }
     }
@@ -1077,7 +1101,7 @@ gchar *Id3tag_Get_Field (const ID3Frame *id3_frame, ID3_FieldID id3_fieldid)
                 string = g_malloc0 (ID3V2_MAX_STRING_LEN+1);
                 num_chars = ID3Field_GetASCII_1(id3_field,string,ID3V2_MAX_STRING_LEN,0);
                 //string1 = convert_string(string,"UTF-8","UTF-8",FALSE); // Nothing to do
-                if (g_utf8_validate(string,-1,NULL))
+                if (et_charset_utf8_validate (string, -1, NULL))
                     string1 = g_strdup(string);
                 break;
 
@@ -1096,7 +1120,7 @@ gchar *Id3tag_Get_Field (const ID3Frame *id3_frame, ID3_FieldID id3_fieldid)
                 string = g_malloc0 (4 * ID3V2_MAX_STRING_LEN + 1);
                 num_chars = ID3Field_GetASCII_1(id3_field,string,ID3V2_MAX_STRING_LEN,0);
 
-                if (g_utf8_validate (string, -1, NULL))
+                if (et_charset_utf8_validate (string, -1, NULL))
                 {
                     string1 = g_strdup (string);
                 }
@@ -1189,8 +1213,9 @@ Id3tag_Set_Field (const ID3Frame *id3_frame,
         if (g_settings_get_boolean (MainSettings, "id3v2-enable-unicode"))
         {
             // Check if we can write the tag using ISO-8859-1 instead of UTF-16...
-            if ( (string_converted = g_convert(string, strlen(string), "ISO-8859-1",
-                                               "UTF-8", NULL, NULL ,NULL)) )
+            if ( (string_converted = et_charset_convert (string, strlen (string),
+                                                         "ISO-8859-1", "UTF-8",
+                                                         NULL, NULL, NULL)) )
             {
                 enc = ID3TE_ISO8859_1;
                 g_free(string_converted);
@@ -1467,10 +1492,7 @@ Id3tag_Rules_For_ISO_Fields (const gchar *string,
 gboolean
 et_id3tag_check_if_file_is_valid (GFile *file, GError **error)
 {
-    unsigned char tmp[256];
-    unsigned char tmp0[256];
-    gssize bytes_read;
-    gboolean valid = FALSE;
+    gboolean valid;
     GFileInputStream *file_istream;
 
     g_return_val_if_fail (file != NULL, FALSE);
@@ -1480,20 +1502,46 @@ et_id3tag_check_if_file_is_valid (GFile *file, GError **error)
     if (!file_istream)
     {
         g_assert (error == NULL || *error != NULL);
-        return valid;
+        return FALSE;
     }
 
+    valid = et_id3tag_check_if_stream_is_valid (G_INPUT_STREAM (file_istream),
+                                                error);
+    g_object_unref (file_istream);
+
+    return valid;
+}
+
+/*
+ * et_id3tag_check_if_stream_is_valid:
+ * @istream: a stream positioned at the start of the file
+ * @error: a #GError, or %NULL
+ *
+ * Check that the stream contains at least one non-zero byte, the same as
+ * et_id3tag_check_if_file_is_valid().
+ *
+ * Returns: %TRUE if the file is valid, %FALSE otherwise
+ */
+gboolean
+et_id3tag_check_if_stream_is_valid (GInputStream *istream, GError **error)
+{
+    unsigned char tmp[256];
+    unsigned char tmp0[256];
+    gssize bytes_read;
+    gboolean valid = FALSE;
+
+    g_return_val_if_fail (istream != NULL, FALSE);
+
     memset (&tmp0, 0, 256);
 
     /* Keep reading until EOF. */
-    while ((bytes_read = g_input_stream_read (G_INPUT_STREAM (file_istream),
-                                              tmp, 256, NULL, error)) != 0)
+    while ((bytes_read = g_input_stream_read (istream, tmp, 256, NULL,
+                                              error)) != 0)
     {
         if (bytes_read == -1)
         {
             /* Error in reading file. */
             g_assert (error == NULL || *error != NULL);
-            g_object_unref (file_istream);
             return valid;
         }
 
@@ -1505,8 +1553,6 @@ et_id3tag_check_if_file_is_valid (GFile *file, GError **error)
         }
     }
 
-    g_object_unref (file_istream);
-
     /* The error was not set by g_input_stream_read(), so the file must be
      * empty. */
     if (!valid)
@@ -1662,14 +1708,13 @@ id3tag_write_file_tag (const ET_File *ETFile,
 guchar
 Id3tag_String_To_Genre (const gchar *genre)
 {
-    guint i;
+    gint number;
 
-    if (genre != NULL)
+    if (genre != NULL && (number = et_genre_lookup (genre)) != -1)
     {
-        for (i=0; i<=GENRE_MAX; i++)
-            if (strcasecmp(genre,id3_genres[i])==0)
-                return (guchar)i;
+        return (guchar)number;
     }
+
     return (guchar)0xFF;
 }
 
@@ -22,6 +22,7 @@
 
 #include <glib.h>
 #include "et_core.h"
+#include "read_session.h"
 
 G_BEGIN_DECLS
 
@@ -46,7 +47,7 @@ typedef enum
     ET_ID3_ERROR_BUGGY_ID3LIB
 } EtID3Error;
 
-gboolean id3tag_read_file_tag (GFile *file, File_Tag *FileTag, GError **error);
+gboolean id3tag_read_file_tag (EtReadSession *session, File_Tag *FileTag, GError **error);
 gboolean id3tag_write_file_v24tag (const ET_File *ETFile, GError **error);
 gboolean id3tag_write_file_tag (const ET_File *ETFile, GError **error);
 
@@ -55,6 +56,7 @@ guchar Id3tag_String_To_Genre (const gchar *genre);
 
 gchar *et_id3tag_get_tpos_from_file_tag (const File_Tag *file_tag);
 gboolean et_id3tag_check_if_file_is_valid (GFile *file, GError **error);
+gboolean et_id3tag_check_if_stream_is_valid (GInputStream *istream, GError **error);
 
 G_END_DECLS
 
@@ -87,7 +87,7 @@ static gboolean etag_write_tags (const gchar *filename, struct id3_tag const *v1
  * If a tag entry exists (ex: title), we allocate memory, else value stays to NULL
  */
 gboolean
-id3tag_read_file_tag (GFile *gfile,
+id3tag_read_file_tag (EtReadSession *session,
                       File_Tag *FileTag,
                       GError **error)
 {
@@ -106,15 +106,10 @@ id3tag_read_file_tag (GFile *gfile,
     unsigned tmpupdate, update = 0;
     long tagsize;
 
-    g_return_val_if_fail (gfile != NULL && FileTag != NULL, FALSE);
+    g_return_val_if_fail (session != NULL && FileTag != NULL, FALSE);
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-    istream = G_INPUT_STREAM (g_file_read (gfile, NULL, error));
-
-    if (!istream)
-    {
-        return FALSE;
-    }
+    istream = G_INPUT_STREAM (et_read_session_open_stream (session));
 
     string1 = g_malloc0 (ID3_TAG_QUERYSIZE);
 
@@ -219,7 +214,8 @@ id3tag_read_file_tag (GFile *gfile,
     g_free (string1);
     g_object_unref (istream);
 
-    filename = g_file_get_path (gfile);
+    /* libid3tag can only read from a file descriptor. */
+    filename = g_file_get_path (et_read_session_get_file (session));
 
     if ((fd = g_open (filename, O_RDONLY, 0)) == -1)
     {
@@ -346,49 +342,10 @@ id3tag_read_file_tag (GFile *gfile,
              *    - "<genre_name>"              -> "Dance"
              *    - "(<genre_id>)<refinement>"  -> "(3)EuroDance"
              */
-            gchar *tmp;
-            unsigned genre = 0;
-            FileTag->genre = NULL;
-
-            if ((string1[0] == '(') && g_ascii_isdigit (string1[1])
-                && (tmp = strchr (string1 + 1, ')')) && *(tmp+1))
-                /* Convert a genre written as '(3)EuroDance' into 'EuroDance' */
-            {
-                FileTag->genre = g_strdup (tmp + 1);
-            }
-            else if ((string1[0] == '(') && g_ascii_isdigit (string1[1])
-                     && strchr (string1, ')'))
-            {
-                /* Convert a genre written as '(3)' into 'Dance' */
-                genre = strtol (string1 +1 , &tmp, 10);
-                if (*tmp != ')')
-                {
-                    FileTag->genre = g_strdup (string1);
-                }
-            }
-            else
-            {
-                genre = strtol (string1, &tmp, 10);
-                if (tmp == string1)
-                {
-                    FileTag->genre = g_strdup (string1);
-                }
-            }
+            const gchar *genre;
 
-            if (!FileTag->genre)
-            {
-                if (id3_genre_index (genre))
-                {
-                    FileTag->genre = (gchar *)id3_ucs4_utf8duplicate (id3_genre_index (genre));
-                }
-                else if (strcmp (genre_no (genre),
-                                 genre_no (ID3_INVALID_GENRE)) != 0)
-                {
-                    /* If the integer genre is not found in the (outdated)
-                     * libid3tag index, try the EasyTAG index instead. */
-                    FileTag->genre = g_strdup (genre_no (genre));
-                }
-            }
+            genre = et_genre_parse_reference (string1);
+            FileTag->genre = g_strdup (genre);
 
             g_free(string1);
         }
@@ -647,7 +604,7 @@ etag_guess_byteorder(const id3_ucs4_t *ustr, gchar **ret) /* XXX */
     }
 
     tmp = (gchar *)id3_ucs4_utf8duplicate(ustr);
-    str = g_convert(tmp, -1, charset, "UTF-8", NULL, NULL, NULL);
+    str = et_charset_convert (tmp, -1, charset, "UTF-8", NULL, NULL, NULL);
     if (str)
     {
         g_free(str);
@@ -687,7 +644,7 @@ etag_guess_byteorder(const id3_ucs4_t *ustr, gchar **ret) /* XXX */
         return 0;
     }
 
-    str2 = g_convert(str, -1, charset, "UTF-8", NULL, NULL, NULL);
+    str2 = et_charset_convert (str, -1, charset, "UTF-8", NULL, NULL, NULL);
 
     if (str2 && *str2)
     {
@@ -877,7 +834,7 @@ libid3tag_Get_Frame_Str (const struct id3_frame *frame,
                     retval |= etag_ucs42gchar (id3_field_getstrings (field, j),
                                                is_latin, is_utf16, &tmpstr2);
 
-                    if (tmpstr2 && *tmpstr2 && g_utf8_validate(tmpstr2, -1, NULL))
+                    if (tmpstr2 && *tmpstr2 && et_charset_utf8_validate (tmpstr2, -1, NULL))
                     {
                         if (tmpstr)
                         {
@@ -902,7 +859,7 @@ libid3tag_Get_Frame_Str (const struct id3_frame *frame,
                 break;
         }
 
-        if (!et_str_empty (tmpstr) && g_utf8_validate (tmpstr, -1, NULL))
+        if (!et_str_empty (tmpstr) && et_charset_utf8_validate (tmpstr, -1, NULL))
         {
             if (ret)
             {
@@ -85,7 +85,7 @@ monkey_samples_per_frame(unsigned int versionid, unsigned int compressionlevel)
     
 /*
  * info_mac_read:
- * @file: file from which to read a header
+ * @session: the read session of the file from which to read a header
  * @stream_info: stream information to fill
  * @error: a #GError, or NULL
  *
@@ -94,11 +94,10 @@ monkey_samples_per_frame(unsigned int versionid, unsigned int compressionlevel)
  * Returns: %TRUE on success, or %FALSE and with @error set on failure
 */
 gboolean
-info_mac_read (GFile *file,
+info_mac_read (EtReadSession *session,
                StreamInfoMac *stream_info,
                GError **error)
 {
-    GFileInfo *info;
     GFileInputStream *istream;
     guint8 header_buffer[MAC_FORMAT_HEADER_LENGTH];
     gsize bytes_read;
@@ -107,49 +106,15 @@ info_mac_read (GFile *file,
     
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-    info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE,
-                              G_FILE_QUERY_INFO_NONE, NULL, error);
+    stream_info->FileSize = et_read_session_get_size (session);
 
-    if (!info)
-    {
-        return FALSE;
-    }
-
-    stream_info->FileSize = g_file_info_get_size (info);
-    g_object_unref (info);
-
-    istream = g_file_read (file, NULL, error);
-
-    if (!istream)
-    {
-        return FALSE;
-    }
-
-    /* FIXME: is_id3v2() should accept an istream or a GFile. */
-    {
-        gchar *path;
-        FILE *fp;
-
-        path = g_file_get_path (file);
-        fp = g_fopen (path, "rb");
-
-        if (!fp)
-        {
-            /* TODO: Add specific error domain and message. */
-            g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s",
-                         g_strerror (EINVAL));
-            g_free (path);
-            return FALSE;
-        }
-
-        size_id3 = is_id3v2 (fp);
-        fclose (fp);
-        g_free (path);
-    }
+    istream = et_read_session_open_stream (session);
+    size_id3 = is_id3v2_stream (G_INPUT_STREAM (istream));
 
     if (!g_seekable_seek (G_SEEKABLE (istream), size_id3, G_SEEK_SET, NULL,
                           error))
     {
+        g_object_unref (istream);
         return FALSE;
     }
 
@@ -159,9 +124,12 @@ info_mac_read (GFile *file,
     {
         g_debug ("Only %" G_GSIZE_FORMAT " bytes out of 16 bytes of data were "
                  "read", bytes_read);
+        g_object_unref (istream);
         return FALSE;
     }
 
+    g_object_unref (istream);
+
     if (memcmp (header_buffer, "MAC", 3) != 0)
     {
         /* TODO: Add specific error domain and message. */
@@ -22,6 +22,8 @@
 
 #include <gio/gio.h>
 
+#include "read_session.h"
+
 /** \file info_mac.h 
     \brief Get information from MonkeyAudio file.
 
@@ -79,6 +81,6 @@ typedef struct
     unsigned int EncoderVersion;    /**< version of encoder used */
 } StreamInfoMac;
 
-gboolean info_mac_read (GFile *file, StreamInfoMac *stream_info, GError **error);
+gboolean info_mac_read (EtReadSession *session, StreamInfoMac *stream_info, GError **error);
 
 #endif /* INFO_MAC_H */
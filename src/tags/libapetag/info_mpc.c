@@ -57,7 +57,7 @@ profile_stringify (unsigned int profile)
 
 /*
 * info_mpc_read:
-* @file: file from which to read a header
+* @session: the read session of the file from which to read a header
 * @stream_info: stream information to fill
 * @error: a #Gerror, or %NULL
 *
@@ -66,68 +66,32 @@ profile_stringify (unsigned int profile)
 * Returns: %TRUE on success, %FALSE and with @error set on failure
 */
 gboolean
-info_mpc_read (GFile *file,
+info_mpc_read (EtReadSession *session,
                StreamInfoMpc *stream_info,
                GError **error)
 {
-    GFileInfo *info;
     GFileInputStream *istream;
     guint32 header_buffer[MPC_HEADER_LENGTH];
     gsize bytes_read;
     gsize id3_size;
-    
-    info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE,
-                              G_FILE_QUERY_INFO_NONE, NULL, error);
-
-    if (!info)
-    {
-        return FALSE;
-    }
 
-    stream_info->FileSize = g_file_info_get_size (info);
-    g_object_unref (info);
+    stream_info->FileSize = et_read_session_get_size (session);
 
-    {
-        gchar *path;
-        FILE *fp;
-
-        path = g_file_get_path (file);
-        fp = g_fopen (path, "rb");
-        g_free (path);
-
-        if (!fp)
-        {
-            /* TODO: Add specific error domain and message. */
-            g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s",
-                         g_strerror (EINVAL));
-            return FALSE;
-        }
+    istream = et_read_session_open_stream (session);
 
-        /* Skip id3v2. */
-        /* FIXME: is_id3v2 (and is_id3v1 and is_ape) should accept an istream
-         * or GFile. */
-        id3_size = is_id3v2 (fp);
+    /* Skip id3v2. */
+    id3_size = is_id3v2_stream (G_INPUT_STREAM (istream));
 
-        fseek (fp, 0, SEEK_END);
-        stream_info->FileSize = ftell (fp);
-
-        /* Stream size. */
-        stream_info->ByteLength = stream_info->FileSize - is_id3v1 (fp)
-                                  - is_ape (fp) - id3_size;
-
-        fclose (fp);
-    }
-        
-    istream = g_file_read (file, NULL, error);
-
-    if (!istream)
-    {
-        return FALSE;
-    }
+    /* Stream size. */
+    stream_info->ByteLength = stream_info->FileSize
+                              - is_id3v1_stream (G_INPUT_STREAM (istream))
+                              - is_ape_stream (G_INPUT_STREAM (istream))
+                              - id3_size;
 
     if (!g_seekable_seek (G_SEEKABLE (istream), id3_size, G_SEEK_SET, NULL,
                           error))
     {
+        g_object_unref (istream);
         return FALSE;
     }
 
@@ -138,9 +102,12 @@ info_mpc_read (GFile *file,
     {
         g_debug ("Only %" G_GSIZE_FORMAT "bytes out of 16 bytes of data were "
                  "read", bytes_read);
+        g_object_unref (istream);
         return FALSE;
     }
 
+    g_object_unref (istream);
+
     /* FIXME: Read 4 bytes, take as a uint32, then byteswap if necessary. (The
      * official Musepack decoder expects the user(!) to request the
      * byteswap.) */
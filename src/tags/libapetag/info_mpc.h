@@ -22,6 +22,8 @@
 
 #include <gio/gio.h>
 
+#include "read_session.h"
+
 /** \file info_mpc.h 
     \brief Get information from MusePack file.
 
@@ -88,6 +90,6 @@ typedef struct
     \retval 1 file not found or write protected
     \retval 2 not musepack audio file
 */
-gboolean info_mpc_read (GFile *file, StreamInfoMpc *Info, GError **error);
+gboolean info_mpc_read (EtReadSession *session, StreamInfoMpc *Info, GError **error);
 
 #endif /* INFO_MPC_H */
@@ -183,3 +183,136 @@ is_ape (FILE * fp)
         ) /* footer size = 32 */
         );
 }
+
+/*
+    The *_stream variants below are equivalent to the functions above, but read
+    from a seekable GInputStream, so that the callers can share the stream (and
+    its buffers) which was already opened for the file.
+*/
+
+/*
+ * is_tag_stream_read_at:
+ * @istream: a seekable input stream
+ * @offset: the offset to seek to, relative to @type
+ * @type: the type of seek
+ * @buf: the buffer to fill
+ * @count: the number of bytes to read
+ *
+ * Returns: %TRUE if exactly @count bytes were read, %FALSE otherwise
+ */
+static gboolean
+is_tag_stream_read_at (GInputStream *istream,
+                       goffset offset,
+                       GSeekType type,
+                       void *buf,
+                       gsize count)
+{
+    gsize bytes_read;
+
+    if (!g_seekable_seek (G_SEEKABLE (istream), offset, type, NULL, NULL))
+    {
+        return FALSE;
+    }
+
+    return g_input_stream_read_all (istream, buf, count, &bytes_read, NULL,
+                                    NULL)
+           && bytes_read == count;
+}
+
+int
+is_id3v1_stream (GInputStream *istream)
+{
+    int n = 0;
+    char buf[16];
+    goffset saved_position;
+
+    saved_position = g_seekable_tell (G_SEEKABLE (istream));
+
+    do {
+        n++;
+        memset (buf, 0, sizeof (buf));
+
+        if (!is_tag_stream_read_at (istream, ((-ID3V1_TAG_SIZE) * n) - 3,
+                                    G_SEEK_END, buf, sizeof (buf)))
+        {
+            g_seekable_seek (G_SEEKABLE (istream), saved_position, G_SEEK_SET,
+                             NULL, NULL);
+            return 0;
+        }
+
+        if (memcmp (buf, "APETAGEX", 8) == 0) /*APE.TAG.EX*/
+            break;
+    } while (memcmp (buf + 3, "TAG", 3) == 0);
+
+    g_seekable_seek (G_SEEKABLE (istream), saved_position, G_SEEK_SET, NULL,
+                     NULL);
+    return (n - 1) * ID3V1_TAG_SIZE;
+}
+
+int
+is_id3v2_stream (GInputStream *istream)
+{
+    unsigned char buf[16];
+    goffset saved_position;
+    long id3v2size = 0;
+
+    saved_position = g_seekable_tell (G_SEEKABLE (istream));
+
+    do {
+        memset (buf, 0, sizeof (buf));
+
+        if (!is_tag_stream_read_at (istream, id3v2size, G_SEEK_SET, buf,
+                                    sizeof (buf)))
+        {
+            g_seekable_seek (G_SEEKABLE (istream), saved_position, G_SEEK_SET,
+                             NULL, NULL);
+            return 0;
+        }
+
+        if (memcmp (buf, "ID3", 3) != 0) {
+            break;
+        }
+
+        /* ID3v2 tag skipeer $49 44 33 yy yy xx zz zz zz zz [zz size + this 10 bytes] */
+        id3v2size += 10 + (((long) (buf[9])) | ((long) (buf[8]) << 7) |
+        ((long) (buf[7]) << 14) | ((long) (buf[6]) << 21));
+    } while (memcmp (buf, "ID3", 3) == 0);
+
+    g_seekable_seek (G_SEEKABLE (istream), saved_position, G_SEEK_SET, NULL,
+                     NULL);
+    return (int) id3v2size;
+}
+
+int
+is_ape_stream (GInputStream *istream)
+{
+    unsigned char buf[32];
+    goffset saved_position;
+    gboolean found;
+
+    saved_position = g_seekable_tell (G_SEEKABLE (istream));
+    memset (buf, 0, sizeof (buf));
+
+    found = is_tag_stream_read_at (istream,
+                                   is_id3v1_stream (istream)
+                                   ? -32 - ID3V1_TAG_SIZE : -32,
+                                   G_SEEK_END, buf, sizeof (buf))
+            && memcmp (buf, "APETAGEX", 8) == 0;
+
+    g_seekable_seek (G_SEEKABLE (istream), saved_position, G_SEEK_SET, NULL,
+                     NULL);
+
+    if (!found)
+    {
+        return 0;
+    }
+
+    /* See is_ape() for the footer size calculation. */
+    return (int) (is_tag_ape2long (buf + 8 + 4) +
+        (
+            ( (is_tag_ape2long (buf + 8) == 2000) &&
+            !(is_tag_ape2long (buf + 8 + 4 + 8) & IS_TAG_FOOTER_NOT)
+            ) ? 32 : 0
+        ) /* footer size = 32 */
+        );
+}
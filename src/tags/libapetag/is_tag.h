@@ -20,6 +20,9 @@
 #ifndef _IS_TAG_H
 #define _IS_TAG_H
 
+#include <stdio.h>
+#include <gio/gio.h>
+
 /** \file is_tag.h 
     \brief Function for check if tag is avilable 
 
@@ -34,4 +37,10 @@ int is_ape (FILE * fp);
 
 int is_ape_ver (FILE * fp);
 
+int is_id3v1_stream (GInputStream *istream);
+
+int is_id3v2_stream (GInputStream *istream);
+
+int is_ape_stream (GInputStream *istream);
+
 #endif /* _IS_TAG_H */
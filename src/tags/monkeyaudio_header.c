@@ -28,16 +28,16 @@
 #include "libapetag/info_mac.h"
 
 gboolean
-et_mac_header_read_file_info (GFile *file,
+et_mac_header_read_file_info (EtReadSession *session,
                               ET_File_Info *ETFileInfo,
                               GError **error)
 {
     StreamInfoMac Info;
 
-    g_return_val_if_fail (file != NULL && ETFileInfo != NULL, FALSE);
+    g_return_val_if_fail (session != NULL && ETFileInfo != NULL, FALSE);
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-    if (!info_mac_read (file, &Info, error))
+    if (!info_mac_read (session, &Info, error))
     {
         return FALSE;
     }
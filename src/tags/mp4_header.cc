@@ -27,28 +27,18 @@
  * Get header info into the ETFileInfo structure
  */
 gboolean
-et_mp4_header_read_file_info (GFile *file,
+et_mp4_header_read_file_info (EtReadSession *session,
                               ET_File_Info *ETFileInfo,
                               GError **error)
 {
-    GFileInfo *info;
     const TagLib::MP4::Properties *properties;
 
-    g_return_val_if_fail (file != NULL && ETFileInfo != NULL, FALSE);
+    g_return_val_if_fail (session != NULL && ETFileInfo != NULL, FALSE);
 
     /* Get size of file */
-    info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE,
-                              G_FILE_QUERY_INFO_NONE, NULL, error);
+    ETFileInfo->size = et_read_session_get_size (session);
 
-    if (!info)
-    {
-        return FALSE;
-    }
-
-    ETFileInfo->size = g_file_info_get_size (info);
-    g_object_unref (info);
-
-    GIO_InputStream stream (file);
+    GIO_InputStream stream (session);
 
     if (!stream.isOpen ())
     {
@@ -53,7 +53,7 @@
  * Read tag data into an Mp4 file.
  */
 gboolean
-mp4tag_read_file_tag (GFile *file,
+mp4tag_read_file_tag (EtReadSession *session,
                       File_Tag *FileTag,
                       GError **error)
 {
@@ -61,10 +61,10 @@ mp4tag_read_file_tag (GFile *file,
     guint year;
     TagLib::String str;
 
-    g_return_val_if_fail (file != NULL && FileTag != NULL, FALSE);
+    g_return_val_if_fail (session != NULL && FileTag != NULL, FALSE);
 
     /* Get data from tag. */
-    GIO_InputStream stream (file);
+    GIO_InputStream stream (session);
 
     if (!stream.isOpen ())
     {
@@ -480,6 +480,10 @@ mp4tag_write_file_tag (const ET_File *ETFile,
             case PICTURE_FORMAT_GIF:
                 f = TagLib::MP4::CoverArt::GIF;
                 break;
+            case PICTURE_FORMAT_BMP:
+                f = TagLib::MP4::CoverArt::BMP;
+                break;
+            case PICTURE_FORMAT_WEBP:
             case PICTURE_FORMAT_UNKNOWN:
             default:
                 g_critical ("Unknown format");
@@ -66,11 +66,12 @@ channel_mode_name (int mode)
  * Read infos into header of first frame
  */
 gboolean
-et_mpeg_header_read_file_info (GFile *file,
+et_mpeg_header_read_file_info (EtReadSession *session,
                                ET_File_Info *ETFileInfo,
                                GError **error)
 {
-    GFileInfo *info;
+    GFileInputStream *istream;
+    gboolean valid;
     gchar *filename;
     /*
      * With id3lib, the header frame couldn't be read if the file contains an ID3v2 tag with an APIC frame
@@ -78,38 +79,32 @@ et_mpeg_header_read_file_info (GFile *file,
     ID3Tag *id3_tag = NULL;    /* Tag defined by the id3lib */
     const Mp3_Headerinfo* headerInfo = NULL;
 
-    g_return_val_if_fail (file != NULL || ETFileInfo != NULL, FALSE);
+    g_return_val_if_fail (session != NULL && ETFileInfo != NULL, FALSE);
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
     /* Check if the file is corrupt. */
-    if (!et_id3tag_check_if_file_is_valid (file, error))
-    {
-        return FALSE;
-    }
-
-    /* Get size of file */
-    info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE,
-                              G_FILE_QUERY_INFO_NONE, NULL, error);
+    istream = et_read_session_open_stream (session);
+    valid = et_id3tag_check_if_stream_is_valid (G_INPUT_STREAM (istream),
+                                                error);
+    g_object_unref (istream);
 
-    if (!info)
+    if (!valid)
     {
         return FALSE;
     }
 
-    ETFileInfo->size = g_file_info_get_size (info);
-    g_object_unref (info);
+    ETFileInfo->size = et_read_session_get_size (session);
 
     /* Get data from tag */
     if ((id3_tag = ID3Tag_New()) == NULL)
     {
         g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOMEM, "%s",
                      g_strerror (ENOMEM));
-        g_object_unref (info);
         return FALSE;
     }
 
     /* Link the file to the tag (uses ID3TT_ID3V2 to get header if APIC is present in Tag) */
-    filename = g_file_get_path (file);
+    filename = g_file_get_path (et_read_session_get_file (session));
 #ifdef G_OS_WIN32
     /* On Windows, id3lib expects filenames to be in the system codepage. */
     {
@@ -28,16 +28,16 @@
 #include "libapetag/info_mpc.h"
 
 gboolean
-et_mpc_header_read_file_info (GFile *file,
+et_mpc_header_read_file_info (EtReadSession *session,
                               ET_File_Info *ETFileInfo,
                               GError **error)
 {
     StreamInfoMpc Info;
 
-    g_return_val_if_fail (file != NULL && ETFileInfo != NULL, FALSE);
+    g_return_val_if_fail (session != NULL && ETFileInfo != NULL, FALSE);
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-    if (!info_mpc_read (file, &Info, error))
+    if (!info_mpc_read (session, &Info, error))
     {
         return FALSE;
     }
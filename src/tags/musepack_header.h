@@ -22,10 +22,11 @@
 #define ET_MUSEPACK_HEADER_H_
 
 #include "et_core.h"
+#include "read_session.h"
 
 G_BEGIN_DECLS
 
-gboolean et_mpc_header_read_file_info (GFile *file, ET_File_Info *ETFileInfo, GError **error);
+gboolean et_mpc_header_read_file_info (EtReadSession *session, ET_File_Info *ETFileInfo, GError **error);
 EtFileHeaderFields * et_mpc_header_display_file_info_to_ui (const ET_File *ETFile);
 void et_mpc_file_header_fields_free (EtFileHeaderFields *fields);
 
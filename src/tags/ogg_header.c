@@ -50,7 +50,6 @@ et_ogg_error_quark (void)
 
 /*
  * EtOggHeaderState:
- * @file: the Ogg file which is currently being parsed
  * @istream: an input stream for the current Ogg file
  * @error: either the most recent error, or %NULL
  *
@@ -59,7 +58,6 @@ et_ogg_error_quark (void)
  */
 typedef struct
 {
-    GFile *file;
     GInputStream *istream;
     GError *error;
 } EtOggHeaderState;
@@ -185,7 +183,7 @@ et_ogg_tell_func (void *datasource)
 }
 
 gboolean
-et_ogg_header_read_file_info (GFile *file,
+et_ogg_header_read_file_info (EtReadSession *session,
                               ET_File_Info *ETFileInfo,
                               GError **error)
 {
@@ -200,33 +198,14 @@ et_ogg_header_read_file_info (GFile *file,
     ov_callbacks callbacks = { et_ogg_read_func, et_ogg_seek_func,
                                et_ogg_close_func, et_ogg_tell_func };
     EtOggHeaderState state;
-    GFileInfo *info;
 
-    g_return_val_if_fail (file != NULL && ETFileInfo != NULL, FALSE);
+    g_return_val_if_fail (session != NULL && ETFileInfo != NULL, FALSE);
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-    info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE,
-                              G_FILE_QUERY_INFO_NONE, NULL, error);
+    ETFileInfo->size = et_read_session_get_size (session);
 
-    if (!info)
-    {
-        return FALSE;
-    }
-
-    ETFileInfo->size = g_file_info_get_size (info);
-    g_object_unref (info);
-
-    state.file = file;
     state.error = NULL;
-    state.istream = G_INPUT_STREAM (g_file_read (state.file, NULL,
-                                                 &state.error));
-
-    if (!state.istream)
-    {
-        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                     _("Error while opening file: %s"), state.error->message);
-        return FALSE;
-    }
+    state.istream = G_INPUT_STREAM (et_read_session_open_stream (session));
 
     if ((res = ov_open_callbacks (&state, &vf, NULL, 0, callbacks)) == 0)
     {
@@ -300,45 +279,40 @@ et_ogg_header_read_file_info (GFile *file,
 #ifdef ENABLE_SPEEX
 
 gboolean
-et_speex_header_read_file_info (GFile *file,
+et_speex_header_read_file_info (EtReadSession *session,
                                 ET_File_Info *ETFileInfo,
                                 GError **error)
 {
     EtOggState *state;
+    GFileInputStream *istream;
     const SpeexHeader *si;
     const gchar *encoder_version = NULL;
     gint channels = 0;
     glong rate = 0;
     glong bitrate = 0;
     gdouble duration = 0;
-    GFileInfo *info;
     GError *tmp_error = NULL;
 
-    g_return_val_if_fail (file != NULL && ETFileInfo != NULL, FALSE);
+    g_return_val_if_fail (session != NULL && ETFileInfo != NULL, FALSE);
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
     state = vcedit_new_state();    // Allocate memory for 'state'
+    istream = et_read_session_open_stream (session);
 
-    if (!vcedit_open (state, file, &tmp_error))
+    if (!vcedit_open (state, istream, &tmp_error))
     {
         g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
                      _("Failed to open file as Vorbis: %s"),
                      tmp_error->message);
         g_error_free (tmp_error);
+        g_object_unref (istream);
         vcedit_clear (state);
         return FALSE;
     }
 
-    info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE,
-                              G_FILE_QUERY_INFO_NONE, NULL, error);
-
-    if (!info)
-    {
-        return FALSE;
-    }
+    g_object_unref (istream);
 
-    ETFileInfo->size = g_file_info_get_size (info);
-    g_object_unref (info);
+    ETFileInfo->size = et_read_session_get_size (session);
 
     /* Get Speex information. */
     if ((si = vcedit_speex_header (state)) != NULL)
@@ -31,6 +31,7 @@
 #include "et_core.h"
 #include "misc.h"
 #include "picture.h"
+#include "picture_probe.h"
 #include "setting.h"
 #include "charset.h"
 
@@ -735,23 +736,17 @@ invalid_picture:
  *  - if field is found but contains no info (strlen(str)==0), we don't read it
  */
 gboolean
-ogg_tag_read_file_tag (GFile *file,
+ogg_tag_read_file_tag (EtReadSession *session,
                        File_Tag *FileTag,
                        GError **error)
 {
     GFileInputStream *istream;
     EtOggState *state;
 
-    g_return_val_if_fail (file != NULL && FileTag != NULL, FALSE);
+    g_return_val_if_fail (session != NULL && FileTag != NULL, FALSE);
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-    istream = g_file_read (file, NULL, error);
-
-    if (!istream)
-    {
-        g_assert (error == NULL || *error != NULL);
-        return FALSE;
-    }
+    istream = et_read_session_open_stream (session);
 
     {
     /* Check for an unsupported ID3v2 tag. */
@@ -777,7 +772,7 @@ ogg_tag_read_file_tag (GFile *file,
             {
                 gchar *path;
 
-                path = g_file_get_path (file);
+                path = g_file_get_path (et_read_session_get_file (session));
                 g_debug ("Ogg file '%s' contains an ID3v2 tag", path);
                 g_free (path);
 
@@ -797,17 +792,25 @@ ogg_tag_read_file_tag (GFile *file,
 
     g_assert (error == NULL || *error == NULL);
 
-    g_object_unref (istream);
+    /* Parse the headers from the start of the file, through the same
+     * buffers. */
+    if (!g_seekable_seek (G_SEEKABLE (istream), 0, G_SEEK_SET, NULL, error))
+    {
+        goto err;
+    }
 
     state = vcedit_new_state();    // Allocate memory for 'state'
 
-    if (!vcedit_open (state, file, error))
+    if (!vcedit_open (state, istream, error))
     {
         g_assert (error == NULL || *error != NULL);
+        g_object_unref (istream);
         vcedit_clear(state);
         return FALSE;
     }
 
+    g_object_unref (istream);
+
     g_assert (error == NULL || *error == NULL);
 
     /* Get data from tag */
@@ -878,6 +881,7 @@ ogg_tag_write_file_tag (const ET_File *ETFile,
     const File_Tag *FileTag;
     const gchar *filename;
     GFile           *file;
+    GFileInputStream *istream;
     EtOggState *state;
     vorbis_comment *vc;
     GList *l;
@@ -891,16 +895,28 @@ ogg_tag_write_file_tag (const ET_File *ETFile,
 
     file = g_file_new_for_path (filename);
 
+    istream = g_file_read (file, NULL, error);
+
+    if (!istream)
+    {
+        g_assert (error == NULL || *error != NULL);
+        g_object_unref (file);
+        return FALSE;
+    }
+
     state = vcedit_new_state();    // Allocate memory for 'state'
 
-    if (!vcedit_open (state, file, error))
+    if (!vcedit_open (state, istream, error))
     {
         g_assert (error == NULL || *error != NULL);
+        g_object_unref (istream);
         g_object_unref (file);
         vcedit_clear(state);
         return FALSE;
     }
 
+    g_object_unref (istream);
+
     g_assert (error == NULL || *error == NULL);
 
     /* Get data from tag */
@@ -1013,6 +1029,7 @@ ogg_tag_write_file_tag (const ET_File *ETFile,
         gsize desclen;
         gconstpointer data;
         gsize data_size;
+        EtPictureInfo info;
         Picture_Format format = Picture_Format_From_Data (pic);
 
         /* According to the specification, only PNG and JPEG images should
@@ -1113,13 +1130,17 @@ ogg_tag_write_file_tag (const ET_File *ETFile,
         convert_to_byte_array (pic->height, array);
         add_to_guchar_str (ustring, &ustring_len, array, 4);
 
-        /* TODO: Determine the depth per pixel by querying the pixbuf to see
-         * whether an alpha channel is present. */
-        convert_to_byte_array (0, array);
+        if (!et_picture_probe (data, data_size, &info))
+        {
+            info.depth = 0;
+            info.colors = 0;
+        }
+
+        convert_to_byte_array (info.depth, array);
         add_to_guchar_str (ustring, &ustring_len, array, 4);
 
         /* Non-indexed images should set this to zero. */
-        convert_to_byte_array (0, array);
+        convert_to_byte_array (info.colors, array);
         add_to_guchar_str (ustring, &ustring_len, array, 4);
 
         /* Adding picture data and its size. */
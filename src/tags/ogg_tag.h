@@ -28,10 +28,11 @@
 
 #include "vcedit.h"
 #include "et_core.h"
+#include "read_session.h"
 
 G_BEGIN_DECLS
 
-gboolean ogg_tag_read_file_tag (GFile *file, File_Tag *FileTag, GError **error);
+gboolean ogg_tag_read_file_tag (EtReadSession *session, File_Tag *FileTag, GError **error);
 gboolean ogg_tag_write_file_tag (const ET_File *ETFile, GError **error);
 
 void et_add_file_tags_from_vorbis_comments (vorbis_comment *vc, File_Tag *FileTag);
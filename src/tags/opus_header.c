@@ -21,6 +21,8 @@
 #ifdef ENABLE_OPUS
 
 #include <glib/gi18n.h>
+/* For SEEK_SET. */
+#include <stdio.h>
 
 #include "opus_header.h"
 #include "et_core.h"
@@ -40,30 +42,124 @@ et_opus_error_quark (void)
     return g_quark_from_static_string ("et-opus-error-quark");
 }
 
+/*
+ * et_opus_read_func:
+ * @datasource: the input stream
+ * @ptr: the buffer to fill with data
+ * @nbytes: the number of bytes to read
+ *
+ * Read a number of bytes from the Opus file.
+ *
+ * Returns: the number of bytes read, 0 on end-of-file, or -1 on error
+ */
+static int
+et_opus_read_func (void *datasource,
+                   unsigned char *ptr,
+                   int nbytes)
+{
+    GInputStream *istream = G_INPUT_STREAM (datasource);
+    gssize bytes_read;
+
+    bytes_read = g_input_stream_read (istream, ptr, nbytes, NULL, NULL);
+
+    return bytes_read;
+}
+
+/*
+ * et_opus_seek_func:
+ * @datasource: the input stream
+ * @offset: the number of bytes to seek
+ * @whence: either %SEEK_SET, %SEEK_CUR or %SEEK_END
+ *
+ * Seek in the currently-open Opus file.
+ *
+ * Returns: 0 on success, -1 on error
+ */
+static int
+et_opus_seek_func (void *datasource,
+                   opus_int64 offset,
+                   int whence)
+{
+    GSeekable *seekable = G_SEEKABLE (datasource);
+    GSeekType seektype;
+
+    switch (whence)
+    {
+        case SEEK_SET:
+            seektype = G_SEEK_SET;
+            break;
+        case SEEK_CUR:
+            seektype = G_SEEK_CUR;
+            break;
+        case SEEK_END:
+            seektype = G_SEEK_END;
+            break;
+        default:
+            return -1;
+    }
+
+    return g_seekable_seek (seekable, offset, seektype, NULL, NULL) ? 0 : -1;
+}
+
+/*
+ * et_opus_tell_func:
+ * @datasource: the input stream
+ *
+ * Returns: the current position in the Opus file
+ */
+static opus_int64
+et_opus_tell_func (void *datasource)
+{
+    return g_seekable_tell (G_SEEKABLE (datasource));
+}
+
+/*
+ * et_opus_close_func:
+ * @datasource: the input stream
+ *
+ * Release the stream when opusfile is finished with it.
+ *
+ * Returns: 0
+ */
+static int
+et_opus_close_func (void *datasource)
+{
+    g_object_unref (datasource);
+
+    return 0;
+}
+
 /*
  * et_opus_open_file:
- * @filename: Filepath to open
+ * @session: the read session of the file to open
  * @error: GError or %NULL
  *
- * Opens an Opus file.
+ * Opens an Opus file, reading through the buffers of @session.
  *
  * Returns: a OggOpusFile on success or %NULL on error.
  */
 OggOpusFile *
-et_opus_open_file (GFile *gfile, GError **error)
+et_opus_open_file (EtReadSession *session, GError **error)
 {
     OggOpusFile *file;
-    gchar *path;
+    GFileInputStream *istream;
+    const OpusFileCallbacks callbacks = { et_opus_read_func,
+                                          et_opus_seek_func,
+                                          et_opus_tell_func,
+                                          et_opus_close_func };
     int error_val;
 
     g_return_val_if_fail (error == NULL || *error == NULL, NULL);
-    g_return_val_if_fail (gfile != NULL, NULL);
+    g_return_val_if_fail (session != NULL, NULL);
+
+    istream = et_read_session_open_stream (session);
+    file = op_open_callbacks (istream, &callbacks, NULL, 0, &error_val);
 
-    path = g_file_get_path (gfile);
-    /* Opusfile does the UTF-8 to UTF-16 translation on Windows
-     * automatically. */
-    file = op_open_file (path, &error_val);
-    g_free (path);
+    if (!file)
+    {
+        /* The stream is only closed by opusfile on success. */
+        g_object_unref (istream);
+    }
 
     if (!file)
     {
@@ -134,7 +230,7 @@ et_opus_open_file (GFile *gfile, GError **error)
 
 /*
  * et_opus_read_file_info:
- * @file: file to read info from
+ * @session: the read session of the file to read info from
  * @ETFileInfo: ET_File_Info to put information into
  * @error: a GError or %NULL
  *
@@ -143,17 +239,16 @@ et_opus_open_file (GFile *gfile, GError **error)
  * Returns: %TRUE if successful otherwise %FALSE
  */
 gboolean
-et_opus_read_file_info (GFile *gfile, ET_File_Info *ETFileInfo,
+et_opus_read_file_info (EtReadSession *session, ET_File_Info *ETFileInfo,
                         GError **error)
 {
     OggOpusFile *file;
     const OpusHead* head;
-    GFileInfo *info;
 
-    g_return_val_if_fail (gfile != NULL && ETFileInfo != NULL, FALSE);
+    g_return_val_if_fail (session != NULL && ETFileInfo != NULL, FALSE);
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-    file = et_opus_open_file (gfile, error);
+    file = et_opus_open_file (session, error);
 
     if (!file)
     {
@@ -182,18 +277,7 @@ et_opus_read_file_info (GFile *gfile, ET_File_Info *ETFileInfo,
     ETFileInfo->duration = op_pcm_total (file, -1) / 48000;
     op_free (file);
 
-    info = g_file_query_info (gfile, G_FILE_ATTRIBUTE_STANDARD_SIZE,
-                              G_FILE_QUERY_INFO_NONE, NULL, NULL);
-
-    if (info)
-    {
-        ETFileInfo->size = g_file_info_get_size (info);
-        g_object_unref (info);
-    }
-    else
-    {
-        ETFileInfo->size = 0;
-    }
+    ETFileInfo->size = et_read_session_get_size (session);
 
     g_assert (error == NULL || *error == NULL);
     return TRUE;
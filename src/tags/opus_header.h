@@ -23,6 +23,7 @@
 #include <opus/opusfile.h>
 
 #include "et_core.h"
+#include "read_session.h"
 
 /*
  * Error domain and codes for errors while reading/writing Opus files
@@ -58,8 +59,8 @@ typedef enum
     ET_OPUS_ERROR_BADTIMESTAMP,
 } EtOpusError;
 
-gboolean et_opus_read_file_info (GFile *gfile, ET_File_Info *ETFileInfo, GError **error);
-OggOpusFile * et_opus_open_file (GFile *gfile, GError **error);
+gboolean et_opus_read_file_info (EtReadSession *session, ET_File_Info *ETFileInfo, GError **error);
+OggOpusFile * et_opus_open_file (EtReadSession *session, GError **error);
 EtFileHeaderFields * et_opus_header_display_file_info_to_ui (const ET_File *ETFile);
 void et_opus_file_header_fields_free (EtFileHeaderFields *fields);
 
@@ -37,7 +37,7 @@
 
 /*
  * et_opus_tag_read_file_tag:
- * @filename: file from which to read tags
+ * @session: the read session of the file from which to read tags
  * @FileTag: File_Tag to read tag into
  * @error: a GError or %NULL
  *
@@ -46,16 +46,16 @@
  * Returns: %TRUE if successful otherwise %FALSE
  */
 gboolean
-et_opus_tag_read_file_tag (GFile *gfile, File_Tag *FileTag,
+et_opus_tag_read_file_tag (EtReadSession *session, File_Tag *FileTag,
                            GError **error)
 {
     OggOpusFile *file;
     const OpusTags *tags;
 
-    g_return_val_if_fail (gfile != NULL && FileTag != NULL, FALSE);
+    g_return_val_if_fail (session != NULL && FileTag != NULL, FALSE);
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-    file = et_opus_open_file (gfile, error);
+    file = et_opus_open_file (session, error);
 
     if (!file)
     {
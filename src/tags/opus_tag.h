@@ -21,10 +21,11 @@
 
 #include <glib.h>
 #include "et_core.h"
+#include "read_session.h"
 
 G_BEGIN_DECLS
 
-gboolean et_opus_tag_read_file_tag (GFile *file, File_Tag *FileTag, GError **error);
+gboolean et_opus_tag_read_file_tag (EtReadSession *session, File_Tag *FileTag, GError **error);
 
 G_END_DECLS
 
@@ -374,9 +374,19 @@ err_out:
     return(1);
 }
 
+/*
+ * vcedit_open:
+ * @state: the state to fill
+ * @istream: (transfer none): a stream positioned at the start of the file
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Read the headers of an Ogg file into @state. The stream is not closed.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
 gboolean
 vcedit_open (EtOggState *state,
-             GFile *file,
+             GFileInputStream *istream,
              GError **error)
 {
     char *buffer;
@@ -390,18 +400,10 @@ vcedit_open (EtOggState *state,
     ogg_packet  header_comments;
     ogg_packet  header_codebooks;
     ogg_page    og;
-    GFileInputStream *istream;
 
+    g_return_val_if_fail (istream != NULL, FALSE);
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-    istream = g_file_read (file, NULL, error);
-
-    if (!istream)
-    {
-        g_assert (error == NULL || *error != NULL);
-        return FALSE;
-    }
-
     state->oy = g_slice_new (ogg_sync_state);
     ogg_sync_init (state->oy);
 
@@ -670,14 +672,11 @@ vcedit_open (EtOggState *state,
 
     /* Headers are done! */
     g_assert (error == NULL || *error == NULL);
-    /* TODO: Handle error during stream close. */
-    g_object_unref (istream);
 
     return TRUE;
 
 err:
     g_assert (error == NULL || *error != NULL);
-    g_object_unref (istream);
     vcedit_clear_internals (state);
     return FALSE;
 }
@@ -111,7 +111,7 @@ vorbis_comment * vcedit_comments (EtOggState *state);
 #ifdef ENABLE_SPEEX
 const SpeexHeader * vcedit_speex_header (EtOggState *state);
 #endif /* ENABLE_SPEEX */
-int vcedit_open (EtOggState *state, GFile *in, GError **error);
+int vcedit_open (EtOggState *state, GFileInputStream *istream, GError **error);
 int vcedit_write (EtOggState *state, GFile *file, GError **error);
 
 #endif /* ENABLE_OGG */
@@ -31,7 +31,7 @@
 
 
 gboolean
-et_wavpack_header_read_file_info (GFile *file,
+et_wavpack_header_read_file_info (EtReadSession *session,
                                   ET_File_Info *ETFileInfo,
                                   GError **error)
 {
@@ -43,18 +43,11 @@ et_wavpack_header_read_file_info (GFile *file,
     WavpackContext *wpc;
     gchar message[80];
 
-    g_return_val_if_fail (file != NULL && ETFileInfo != NULL, FALSE);
+    g_return_val_if_fail (session != NULL && ETFileInfo != NULL, FALSE);
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
     state.error = NULL;
-    state.istream = g_file_read (file, NULL, &state.error);
-
-    if (!state.istream)
-    {
-        g_propagate_error (error, state.error);
-        return FALSE;
-    }
-
+    state.istream = et_read_session_open_stream (session);
     state.seekable = G_SEEKABLE (state.istream);
 
     /* NULL for the WavPack correction file. */
@@ -60,7 +60,7 @@
  * Read tag data from a Wavpack file.
  */
 gboolean
-wavpack_tag_read_file_tag (GFile *file,
+wavpack_tag_read_file_tag (EtReadSession *session,
                            File_Tag *FileTag,
                            GError **error)
 {
@@ -76,18 +76,11 @@ wavpack_tag_read_file_tag (GFile *file,
     guint length;
     const int open_flags = OPEN_TAGS;
 
-    g_return_val_if_fail (file != NULL && FileTag != NULL, FALSE);
+    g_return_val_if_fail (session != NULL && FileTag != NULL, FALSE);
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
     state.error = NULL;
-    state.istream = g_file_read (file, NULL, &state.error);
-
-    if (!state.istream)
-    {
-        g_propagate_error (error, state.error);
-        return FALSE;
-    }
-
+    state.istream = et_read_session_open_stream (session);
     state.seekable = G_SEEKABLE (state.istream);
 
     /* NULL for the WavPack correction file. */
@@ -22,10 +22,11 @@
 
 #include <glib.h>
 #include "et_core.h"
+#include "read_session.h"
 
 G_BEGIN_DECLS
 
-gboolean wavpack_tag_read_file_tag (GFile *file, File_Tag *FileTag, GError **error);
+gboolean wavpack_tag_read_file_tag (EtReadSession *session, File_Tag *FileTag, GError **error);
 gboolean wavpack_tag_write_file_tag (const ET_File *ETFile, GError **error);
 
 G_END_DECLS
@@ -0,0 +1,595 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "thumbnail_cache.h"
+
+#include <glib/gi18n.h>
+
+struct _EtThumbnailCache
+{
+    guint max_entries;
+    /* Key (a string) to EtThumbnailEntry. */
+    GHashTable *entries;
+    /* Most recently used entries first. */
+    GQueue lru;
+    /* Key to EtThumbnailPending, for the images which are being decoded. */
+    GHashTable *pending;
+};
+
+typedef struct
+{
+    gchar *key;
+    GdkPixbuf *pixbuf;
+    /* Size of the original image. */
+    gint width;
+    gint height;
+    /* Link in the LRU queue, with the entry as data. */
+    GList link;
+} EtThumbnailEntry;
+
+typedef struct
+{
+    GBytes *bytes;
+    gint size;
+} EtThumbnailRequest;
+
+typedef struct
+{
+    GdkPixbuf *pixbuf;
+    gint width;
+    gint height;
+} EtThumbnailResult;
+
+/*
+ * A decode in progress. Requests for the same key while it runs wait for it,
+ * rather than decoding the image again.
+ */
+typedef struct
+{
+    /* %NULL once the cache has been freed. */
+    EtThumbnailCache *cache;
+    gchar *key;
+    /* The GTask of each request, most recent first. */
+    GSList *waiters;
+} EtThumbnailPending;
+
+typedef struct
+{
+    gint size;
+    gint width;
+    gint height;
+    gint target_width;
+    gint target_height;
+} EtThumbnailSize;
+
+static void
+et_thumbnail_entry_free (EtThumbnailEntry *entry)
+{
+    g_free (entry->key);
+    g_object_unref (entry->pixbuf);
+    g_slice_free (EtThumbnailEntry, entry);
+}
+
+static void
+et_thumbnail_request_free (EtThumbnailRequest *request)
+{
+    g_bytes_unref (request->bytes);
+    g_slice_free (EtThumbnailRequest, request);
+}
+
+static void
+et_thumbnail_result_free (EtThumbnailResult *result)
+{
+    g_clear_object (&result->pixbuf);
+    g_slice_free (EtThumbnailResult, result);
+}
+
+static EtThumbnailResult *
+et_thumbnail_result_copy (const EtThumbnailResult *result)
+{
+    EtThumbnailResult *copy;
+
+    copy = g_slice_new (EtThumbnailResult);
+    copy->pixbuf = g_object_ref (result->pixbuf);
+    copy->width = result->width;
+    copy->height = result->height;
+
+    return copy;
+}
+
+/*
+ * The key is a hash of the image data, so that the same cover art in several
+ * files is only decoded once.
+ */
+static gchar *
+get_key (GBytes *bytes,
+         gint size)
+{
+    gchar *checksum;
+    gchar *key;
+
+    checksum = g_compute_checksum_for_bytes (G_CHECKSUM_SHA1, bytes);
+    key = g_strdup_printf ("%s:%d", checksum, size);
+    g_free (checksum);
+
+    return key;
+}
+
+EtThumbnailCache *
+et_thumbnail_cache_new (guint max_entries)
+{
+    EtThumbnailCache *cache;
+
+    g_return_val_if_fail (max_entries > 0, NULL);
+
+    cache = g_slice_new (EtThumbnailCache);
+    cache->max_entries = max_entries;
+    cache->entries = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                            (GDestroyNotify)et_thumbnail_entry_free);
+    g_queue_init (&cache->lru);
+    /* The keys are owned by the pending decodes. */
+    cache->pending = g_hash_table_new (g_str_hash, g_str_equal);
+
+    return cache;
+}
+
+void
+et_thumbnail_cache_free (EtThumbnailCache *cache)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_return_if_fail (cache != NULL);
+
+    /* The decodes in progress still complete their requests, but their
+     * results are no longer added to the cache. */
+    g_hash_table_iter_init (&iter, cache->pending);
+
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        EtThumbnailPending *pending = value;
+
+        pending->cache = NULL;
+    }
+
+    g_hash_table_destroy (cache->pending);
+
+    /* The links are owned by the entries. */
+    g_hash_table_destroy (cache->entries);
+    g_slice_free (EtThumbnailCache, cache);
+}
+
+static EtThumbnailEntry *
+lookup_entry (EtThumbnailCache *cache,
+              const gchar *key)
+{
+    EtThumbnailEntry *entry;
+
+    entry = g_hash_table_lookup (cache->entries, key);
+
+    if (entry)
+    {
+        g_queue_unlink (&cache->lru, &entry->link);
+        g_queue_push_head_link (&cache->lru, &entry->link);
+    }
+
+    return entry;
+}
+
+static void
+insert_entry (EtThumbnailCache *cache,
+              const gchar *key,
+              EtThumbnailResult *result)
+{
+    EtThumbnailEntry *entry;
+
+    /* The image may have been requested without looking it up first. */
+    if (lookup_entry (cache, key))
+    {
+        return;
+    }
+
+    entry = g_slice_new (EtThumbnailEntry);
+    entry->key = g_strdup (key);
+    entry->pixbuf = g_object_ref (result->pixbuf);
+    entry->width = result->width;
+    entry->height = result->height;
+    entry->link.data = entry;
+    entry->link.prev = NULL;
+    entry->link.next = NULL;
+
+    g_hash_table_insert (cache->entries, entry->key, entry);
+    g_queue_push_head_link (&cache->lru, &entry->link);
+
+    while (cache->lru.length > cache->max_entries)
+    {
+        GList *link = g_queue_pop_tail_link (&cache->lru);
+        EtThumbnailEntry *old = link->data;
+
+        g_hash_table_remove (cache->entries, old->key);
+    }
+}
+
+/*
+ * et_thumbnail_cache_lookup:
+ * @cache: the cache
+ * @bytes: the image data
+ * @size: the size of the longest side of the thumbnail, in device pixels
+ * @width: return location for the width of the original image
+ * @height: return location for the height of the original image
+ *
+ * Look for a thumbnail which was already decoded.
+ *
+ * Returns: a new reference to the thumbnail, or %NULL if it is not cached
+ */
+GdkPixbuf *
+et_thumbnail_cache_lookup (EtThumbnailCache *cache,
+                           GBytes *bytes,
+                           gint size,
+                           gint *width,
+                           gint *height)
+{
+    gchar *key;
+    EtThumbnailEntry *entry;
+
+    g_return_val_if_fail (cache != NULL && bytes != NULL, NULL);
+
+    key = get_key (bytes, size);
+    entry = lookup_entry (cache, key);
+    g_free (key);
+
+    if (!entry)
+    {
+        return NULL;
+    }
+
+    if (width)
+    {
+        *width = entry->width;
+    }
+
+    if (height)
+    {
+        *height = entry->height;
+    }
+
+    return g_object_ref (entry->pixbuf);
+}
+
+/*
+ * Keep the aspect ratio of the image, and fit the longest side to the size of
+ * the thumbnail.
+ */
+static void
+get_target_size (EtThumbnailSize *size)
+{
+    if (size->width > size->height)
+    {
+        size->target_width = size->size;
+        size->target_height = size->size * size->height / size->width;
+    }
+    else
+    {
+        size->target_width = size->size * size->width / size->height;
+        size->target_height = size->size;
+    }
+
+    size->target_width = MAX (size->target_width, 1);
+    size->target_height = MAX (size->target_height, 1);
+}
+
+/*
+ * Called once the header of the image has been parsed. Asking the loader for
+ * a smaller size lets loaders which support it, such as the JPEG loader,
+ * decode at a reduced size rather than decoding the whole image.
+ */
+static void
+on_size_prepared (GdkPixbufLoader *loader,
+                  gint width,
+                  gint height,
+                  gpointer user_data)
+{
+    EtThumbnailSize *size = user_data;
+
+    size->width = width;
+    size->height = height;
+
+    if (width <= 0 || height <= 0)
+    {
+        return;
+    }
+
+    get_target_size (size);
+
+    if (size->target_width < width && size->target_height < height)
+    {
+        gdk_pixbuf_loader_set_size (loader, size->target_width,
+                                    size->target_height);
+    }
+}
+
+static GdkPixbuf *
+decode_thumbnail (GBytes *bytes,
+                  EtThumbnailSize *size,
+                  GError **error)
+{
+    GdkPixbufLoader *loader;
+    GdkPixbuf *pixbuf;
+    GError *close_error = NULL;
+
+    loader = gdk_pixbuf_loader_new ();
+    g_signal_connect (loader, "size-prepared", G_CALLBACK (on_size_prepared),
+                      size);
+
+    if (!gdk_pixbuf_loader_write_bytes (loader, bytes, error))
+    {
+        gdk_pixbuf_loader_close (loader, NULL);
+        g_object_unref (loader);
+        return NULL;
+    }
+
+    /* A truncated image may still be partially displayed. */
+    gdk_pixbuf_loader_close (loader, &close_error);
+
+    pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
+
+    if (pixbuf)
+    {
+        g_object_ref (pixbuf);
+        g_clear_error (&close_error);
+    }
+    else if (close_error)
+    {
+        g_propagate_error (error, close_error);
+    }
+    else
+    {
+        g_set_error (error, GDK_PIXBUF_ERROR, GDK_PIXBUF_ERROR_CORRUPT_IMAGE,
+                     "%s",
+                     _("Not enough data has been read to determine how to create the image buffer"));
+    }
+
+    g_object_unref (loader);
+
+    return pixbuf;
+}
+
+static void
+load_thread (GTask *task,
+             gpointer source_object,
+             gpointer task_data,
+             GCancellable *cancellable)
+{
+    EtThumbnailRequest *request = task_data;
+    EtThumbnailSize size = { request->size, 0, 0, 0, 0 };
+    EtThumbnailResult *result;
+    GdkPixbuf *pixbuf;
+    GError *error = NULL;
+
+    pixbuf = decode_thumbnail (request->bytes, &size, &error);
+
+    if (!pixbuf)
+    {
+        g_task_return_error (task, error);
+        return;
+    }
+
+    /* Loaders which cannot decode at a reduced size, and images which are
+     * smaller than the thumbnail, are scaled afterwards. */
+    if (size.width <= 0 || size.height <= 0)
+    {
+        size.width = gdk_pixbuf_get_width (pixbuf);
+        size.height = gdk_pixbuf_get_height (pixbuf);
+        get_target_size (&size);
+    }
+
+    if (gdk_pixbuf_get_width (pixbuf) != size.target_width
+        || gdk_pixbuf_get_height (pixbuf) != size.target_height)
+    {
+        GdkPixbuf *scaled_pixbuf;
+
+        scaled_pixbuf = gdk_pixbuf_scale_simple (pixbuf, size.target_width,
+                                                 size.target_height,
+                                                 GDK_INTERP_BILINEAR);
+        g_object_unref (pixbuf);
+        pixbuf = scaled_pixbuf;
+    }
+
+    result = g_slice_new (EtThumbnailResult);
+    result->pixbuf = pixbuf;
+    result->width = size.width;
+    result->height = size.height;
+
+    g_task_return_pointer (task, result,
+                           (GDestroyNotify)et_thumbnail_result_free);
+}
+
+/*
+ * Called in the main thread once the image has been decoded. The thumbnail is
+ * cached even if every request was cancelled meanwhile, as the work is done,
+ * and the same image is likely to be shown again.
+ */
+static void
+on_decoded (GObject *source_object,
+            GAsyncResult *res,
+            gpointer user_data)
+{
+    EtThumbnailPending *pending = user_data;
+    EtThumbnailResult *result;
+    GSList *l;
+    GError *error = NULL;
+
+    result = g_task_propagate_pointer (G_TASK (res), &error);
+
+    if (pending->cache)
+    {
+        if (result)
+        {
+            insert_entry (pending->cache, pending->key, result);
+        }
+
+        g_hash_table_remove (pending->cache->pending, pending->key);
+    }
+
+    /* The requests are completed in the order in which they were made. A
+     * request whose cancellable was cancelled returns %G_IO_ERROR_CANCELLED
+     * instead. */
+    pending->waiters = g_slist_reverse (pending->waiters);
+
+    for (l = pending->waiters; l != NULL; l = g_slist_next (l))
+    {
+        GTask *task = l->data;
+
+        if (result)
+        {
+            g_task_return_pointer (task, et_thumbnail_result_copy (result),
+                                   (GDestroyNotify)et_thumbnail_result_free);
+        }
+        else
+        {
+            g_task_return_error (task, g_error_copy (error));
+        }
+
+        g_object_unref (task);
+    }
+
+    if (result)
+    {
+        et_thumbnail_result_free (result);
+    }
+    else
+    {
+        g_error_free (error);
+    }
+
+    g_slist_free (pending->waiters);
+    g_free (pending->key);
+    g_slice_free (EtThumbnailPending, pending);
+}
+
+/*
+ * et_thumbnail_cache_load_async:
+ * @cache: the cache
+ * @bytes: the image data
+ * @size: the size of the longest side of the thumbnail, in device pixels
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: called when the thumbnail has been decoded
+ * @user_data: data to pass to @callback
+ *
+ * Decode a thumbnail of the image in a worker thread, unless the same image is
+ * already being decoded at that size. Call et_thumbnail_cache_load_finish()
+ * from @callback to get the thumbnail. The thumbnail is added to the cache
+ * once it is decoded, even if @cancellable is cancelled.
+ */
+void
+et_thumbnail_cache_load_async (EtThumbnailCache *cache,
+                               GBytes *bytes,
+                               gint size,
+                               GCancellable *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer user_data)
+{
+    GTask *task;
+    GTask *decode_task;
+    gchar *key;
+    EtThumbnailPending *pending;
+    EtThumbnailRequest *request;
+
+    g_return_if_fail (cache != NULL && bytes != NULL && size > 0);
+
+    task = g_task_new (NULL, cancellable, callback, user_data);
+    g_task_set_source_tag (task, et_thumbnail_cache_load_async);
+
+    key = get_key (bytes, size);
+    pending = g_hash_table_lookup (cache->pending, key);
+
+    if (pending)
+    {
+        pending->waiters = g_slist_prepend (pending->waiters, task);
+        g_free (key);
+        return;
+    }
+
+    pending = g_slice_new (EtThumbnailPending);
+    pending->cache = cache;
+    pending->key = key;
+    pending->waiters = g_slist_prepend (NULL, task);
+    g_hash_table_insert (cache->pending, pending->key, pending);
+
+    request = g_slice_new (EtThumbnailRequest);
+    request->bytes = g_bytes_ref (bytes);
+    request->size = size;
+
+    /* Not cancellable, so that the result is always cached. */
+    decode_task = g_task_new (NULL, NULL, on_decoded, pending);
+    g_task_set_task_data (decode_task, request,
+                          (GDestroyNotify)et_thumbnail_request_free);
+    g_task_run_in_thread (decode_task, load_thread);
+    g_object_unref (decode_task);
+}
+
+/*
+ * et_thumbnail_cache_load_finish:
+ * @cache: the cache
+ * @result: the result passed to the callback
+ * @width: return location for the width of the original image
+ * @height: return location for the height of the original image
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Finish decoding a thumbnail.
+ *
+ * Returns: a new reference to the thumbnail, or %NULL on error
+ */
+GdkPixbuf *
+et_thumbnail_cache_load_finish (EtThumbnailCache *cache,
+                                GAsyncResult *result,
+                                gint *width,
+                                gint *height,
+                                GError **error)
+{
+    EtThumbnailResult *thumbnail;
+    GdkPixbuf *pixbuf;
+
+    g_return_val_if_fail (cache != NULL, NULL);
+    g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+    g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+    thumbnail = g_task_propagate_pointer (G_TASK (result), error);
+
+    if (!thumbnail)
+    {
+        return NULL;
+    }
+
+    if (width)
+    {
+        *width = thumbnail->width;
+    }
+
+    if (height)
+    {
+        *height = thumbnail->height;
+    }
+
+    pixbuf = g_object_ref (thumbnail->pixbuf);
+    et_thumbnail_result_free (thumbnail);
+
+    return pixbuf;
+}
@@ -0,0 +1,45 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ET_THUMBNAIL_CACHE_H_
+#define ET_THUMBNAIL_CACHE_H_
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/*
+ * EtThumbnailCache:
+ *
+ * Cache of downscaled images, keyed on the content of the image data and the
+ * size of the thumbnail. The cache must only be used from the main thread,
+ * but the images are decoded in a worker thread.
+ */
+typedef struct _EtThumbnailCache EtThumbnailCache;
+
+EtThumbnailCache * et_thumbnail_cache_new (guint max_entries);
+void et_thumbnail_cache_free (EtThumbnailCache *cache);
+
+GdkPixbuf * et_thumbnail_cache_lookup (EtThumbnailCache *cache, GBytes *bytes, gint size, gint *width, gint *height);
+void et_thumbnail_cache_load_async (EtThumbnailCache *cache, GBytes *bytes, gint size, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+GdkPixbuf * et_thumbnail_cache_load_finish (EtThumbnailCache *cache, GAsyncResult *result, gint *width, gint *height, GError **error);
+
+G_END_DECLS
+
+#endif /* !ET_THUMBNAIL_CACHE_H_ */
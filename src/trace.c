@@ -0,0 +1,466 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "trace.h"
+
+#include <errno.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "log.h"
+
+/*
+ * EtTraceStat:
+ * @category: the category of the timed operation
+ * @name: the name of the timed operation
+ * @count: the number of times the operation was timed
+ * @total: the total duration of the operation, in microseconds
+ * @max: the longest duration of the operation, in microseconds
+ * @max_detail: the detail, such as the file, of the longest operation
+ *
+ * The statistics of an operation, since they were last logged.
+ */
+typedef struct
+{
+    const gchar *category;
+    const gchar *name;
+    guint count;
+    gint64 total;
+    gint64 max;
+    gchar *max_detail;
+} EtTraceStat;
+
+/*
+ * EtTraceEvent:
+ * @category: the category of the operation
+ * @name: the name of the operation
+ * @detail: the detail of the operation, or %NULL
+ * @start: the monotonic time at which the operation started
+ * @duration: the duration of the operation, in microseconds
+ * @thread: the number of the thread in which the operation ran
+ *
+ * A timed operation, to export in the trace file.
+ */
+typedef struct
+{
+    const gchar *category;
+    const gchar *name;
+    gchar *detail;
+    gint64 start;
+    gint64 duration;
+    guint thread;
+} EtTraceEvent;
+
+/* Set once, before any operation is timed, so it is read without locking. */
+static gboolean trace_enabled = FALSE;
+
+static GMutex trace_mutex;
+static gchar *trace_path = NULL;
+static GHashTable *trace_stats = NULL;
+static GArray *trace_events = NULL;
+static GHashTable *trace_threads = NULL;
+
+static guint
+et_trace_stat_hash (gconstpointer key)
+{
+    const EtTraceStat *stat = key;
+
+    return g_str_hash (stat->category) * 31 + g_str_hash (stat->name);
+}
+
+static gboolean
+et_trace_stat_equal (gconstpointer a,
+                     gconstpointer b)
+{
+    const EtTraceStat *stat_a = a;
+    const EtTraceStat *stat_b = b;
+
+    return strcmp (stat_a->category, stat_b->category) == 0
+           && strcmp (stat_a->name, stat_b->name) == 0;
+}
+
+static void
+et_trace_stat_free (gpointer data)
+{
+    EtTraceStat *stat = data;
+
+    g_free (stat->max_detail);
+    g_slice_free (EtTraceStat, stat);
+}
+
+static GHashTable *
+et_trace_stats_new (void)
+{
+    return g_hash_table_new_full (et_trace_stat_hash, et_trace_stat_equal,
+                                  et_trace_stat_free, NULL);
+}
+
+/*
+ * et_trace_init:
+ * @path: (allow-none): the file to write the trace to, an empty string to
+ *        only collect statistics, or %NULL to use the value of the
+ *        %ET_TRACE_ENVIRONMENT_VARIABLE environment variable
+ *
+ * Enable the timing of the operations which are instrumented with
+ * et_trace_begin() and et_trace_end(), unless @path is %NULL and the
+ * environment variable is not set. Must be called before any thread times an
+ * operation, and only the first call which enables tracing has an effect.
+ */
+void
+et_trace_init (const gchar *path)
+{
+    if (trace_enabled)
+    {
+        return;
+    }
+
+    if (path == NULL)
+    {
+        path = g_getenv (ET_TRACE_ENVIRONMENT_VARIABLE);
+
+        if (path == NULL)
+        {
+            return;
+        }
+    }
+
+    trace_path = *path != '\0' ? g_strdup (path) : NULL;
+    trace_stats = et_trace_stats_new ();
+    trace_threads = g_hash_table_new (NULL, NULL);
+
+    if (trace_path)
+    {
+        trace_events = g_array_new (FALSE, FALSE, sizeof (EtTraceEvent));
+    }
+
+    trace_enabled = TRUE;
+}
+
+/*
+ * et_trace_begin:
+ *
+ * Start timing an operation, which is finished with et_trace_end().
+ *
+ * Returns: the start time to pass to et_trace_end(), or 0 if tracing is
+ * disabled
+ */
+gint64
+et_trace_begin (void)
+{
+    return trace_enabled ? g_get_monotonic_time () : 0;
+}
+
+/*
+ * et_trace_end:
+ * @start: the value returned by et_trace_begin()
+ * @category: the category of the operation, such as "read-tag"
+ * @name: the name of the operation, such as the file extension for the
+ *        operations which depend on the format
+ * @detail: (allow-none): the path of the file which the operation was done
+ *          on, in the file system encoding, or %NULL
+ *
+ * Finish timing an operation, adding it to the statistics, and to the trace
+ * if one is written. @category and @name must be static strings, as they
+ * are not copied. Can be called from any thread.
+ */
+void
+et_trace_end (gint64 start,
+              const gchar *category,
+              const gchar *name,
+              const gchar *detail)
+{
+    gint64 duration;
+    EtTraceStat key;
+    EtTraceStat *stat;
+
+    if (start == 0)
+    {
+        return;
+    }
+
+    duration = g_get_monotonic_time () - start;
+    key.category = category;
+    key.name = name;
+
+    g_mutex_lock (&trace_mutex);
+
+    stat = g_hash_table_lookup (trace_stats, &key);
+
+    if (stat == NULL)
+    {
+        stat = g_slice_new0 (EtTraceStat);
+        stat->category = category;
+        stat->name = name;
+        g_hash_table_add (trace_stats, stat);
+    }
+
+    stat->count++;
+    stat->total += duration;
+
+    if (duration > stat->max || stat->count == 1)
+    {
+        stat->max = duration;
+        g_free (stat->max_detail);
+        stat->max_detail = g_strdup (detail);
+    }
+
+    if (trace_events)
+    {
+        EtTraceEvent event;
+        gpointer thread = g_thread_self ();
+
+        event.category = category;
+        event.name = name;
+        event.detail = g_strdup (detail);
+        event.start = start;
+        event.duration = duration;
+        event.thread = GPOINTER_TO_UINT (g_hash_table_lookup (trace_threads,
+                                                              thread));
+
+        if (event.thread == 0)
+        {
+            event.thread = g_hash_table_size (trace_threads) + 1;
+            g_hash_table_insert (trace_threads, thread,
+                                 GUINT_TO_POINTER (event.thread));
+        }
+
+        g_array_append_val (trace_events, event);
+    }
+
+    g_mutex_unlock (&trace_mutex);
+}
+
+static gint
+compare_stats_by_total (gconstpointer a,
+                        gconstpointer b)
+{
+    const EtTraceStat *stat_a = *(EtTraceStat * const *)a;
+    const EtTraceStat *stat_b = *(EtTraceStat * const *)b;
+
+    return (stat_a->total < stat_b->total) - (stat_a->total > stat_b->total);
+}
+
+/*
+ * et_trace_log_statistics:
+ * @title: the name of what was timed, such as "Loading files"
+ *
+ * Print to the log area the statistics of the operations timed since the
+ * statistics were last printed, slowest first, with the file on which each
+ * operation took the longest, and reset them. Does nothing if tracing is
+ * disabled. Must be called from the main thread.
+ */
+void
+et_trace_log_statistics (const gchar *title)
+{
+    GHashTable *stats;
+    GHashTableIter iter;
+    gpointer key;
+    GPtrArray *sorted;
+    guint i;
+
+    if (!trace_enabled)
+    {
+        return;
+    }
+
+    /* Take the statistics, so that the log is written without locking. */
+    g_mutex_lock (&trace_mutex);
+    stats = trace_stats;
+    trace_stats = et_trace_stats_new ();
+    g_mutex_unlock (&trace_mutex);
+
+    sorted = g_ptr_array_sized_new (g_hash_table_size (stats));
+    g_hash_table_iter_init (&iter, stats);
+
+    while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+        g_ptr_array_add (sorted, key);
+    }
+
+    g_ptr_array_sort (sorted, compare_stats_by_total);
+
+    for (i = 0; i < sorted->len; i++)
+    {
+        const EtTraceStat *stat = sorted->pdata[i];
+        gchar *detail_utf8;
+
+        detail_utf8 = stat->max_detail ? g_filename_display_name (stat->max_detail)
+                                       : g_strdup ("");
+        Log_Print (LOG_INFO,
+                   _("%s: %s %s: %u times in %.1f ms, at most %.1f ms ‘%s’"),
+                   title, stat->category, stat->name, stat->count,
+                   stat->total / 1000.0, stat->max / 1000.0, detail_utf8);
+        g_free (detail_utf8);
+    }
+
+    g_ptr_array_free (sorted, TRUE);
+    g_hash_table_destroy (stats);
+}
+
+static void
+append_json_string (GString *buffer,
+                    const gchar *string)
+{
+    const gchar *p;
+
+    g_string_append_c (buffer, '"');
+
+    for (p = string; *p != '\0'; p++)
+    {
+        switch (*p)
+        {
+            case '"':
+                g_string_append (buffer, "\\\"");
+                break;
+            case '\\':
+                g_string_append (buffer, "\\\\");
+                break;
+            default:
+                if ((guchar)*p < 0x20)
+                {
+                    g_string_append_printf (buffer, "\\u%04x", (guchar)*p);
+                }
+                else
+                {
+                    g_string_append_c (buffer, *p);
+                }
+                break;
+        }
+    }
+
+    g_string_append_c (buffer, '"');
+}
+
+/*
+ * Write the trace in the Trace Event Format, as complete events, which can be
+ * opened in chrome://tracing or Perfetto.
+ */
+static void
+et_trace_write_events (void)
+{
+    FILE *file;
+    GString *buffer;
+    guint i;
+
+    file = g_fopen (trace_path, "w");
+
+    if (file == NULL)
+    {
+        gchar *display_path = g_filename_display_name (trace_path);
+
+        g_warning ("Cannot write trace file ‘%s’: %s", display_path,
+                   g_strerror (errno));
+        g_free (display_path);
+        return;
+    }
+
+    buffer = g_string_new ("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    for (i = 0; i < trace_events->len; i++)
+    {
+        const EtTraceEvent *event = &g_array_index (trace_events,
+                                                    EtTraceEvent, i);
+
+        g_string_append (buffer, "{\"name\":");
+        append_json_string (buffer, event->name);
+        g_string_append (buffer, ",\"cat\":");
+        append_json_string (buffer, event->category);
+        g_string_append_printf (buffer,
+                                ",\"ph\":\"X\",\"ts\":%" G_GINT64_FORMAT
+                                ",\"dur\":%" G_GINT64_FORMAT
+                                ",\"pid\":1,\"tid\":%u",
+                                event->start, event->duration,
+                                event->thread);
+
+        if (event->detail)
+        {
+            gchar *detail_utf8 = g_filename_display_name (event->detail);
+
+            g_string_append (buffer, ",\"args\":{\"file\":");
+            append_json_string (buffer, detail_utf8);
+            g_string_append_c (buffer, '}');
+            g_free (detail_utf8);
+        }
+
+        g_string_append (buffer, i + 1 < trace_events->len ? "},\n" : "}\n");
+
+        /* Write the events in blocks, as there may be many. */
+        if (buffer->len >= 64 * 1024)
+        {
+            fwrite (buffer->str, 1, buffer->len, file);
+            g_string_truncate (buffer, 0);
+        }
+    }
+
+    g_string_append (buffer, "]}\n");
+    fwrite (buffer->str, 1, buffer->len, file);
+
+    if (fclose (file) != 0)
+    {
+        gchar *display_path = g_filename_display_name (trace_path);
+
+        g_warning ("Cannot write trace file ‘%s’: %s", display_path,
+                   g_strerror (errno));
+        g_free (display_path);
+    }
+
+    g_string_free (buffer, TRUE);
+}
+
+/*
+ * et_trace_shutdown:
+ *
+ * Write the trace file, if one was requested, and free the statistics. Must
+ * be called once all the threads which time operations are finished.
+ */
+void
+et_trace_shutdown (void)
+{
+    if (!trace_enabled)
+    {
+        return;
+    }
+
+    trace_enabled = FALSE;
+
+    if (trace_events)
+    {
+        guint i;
+
+        et_trace_write_events ();
+
+        for (i = 0; i < trace_events->len; i++)
+        {
+            g_free (g_array_index (trace_events, EtTraceEvent, i).detail);
+        }
+
+        g_array_free (trace_events, TRUE);
+        trace_events = NULL;
+    }
+
+    g_hash_table_destroy (trace_stats);
+    trace_stats = NULL;
+    g_hash_table_destroy (trace_threads);
+    trace_threads = NULL;
+    g_free (trace_path);
+    trace_path = NULL;
+}
@@ -0,0 +1,41 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ET_TRACE_H_
+#define ET_TRACE_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Environment variable which enables tracing, as the --trace option does. Its
+ * value is the file to write the trace to, or empty to only collect
+ * statistics. */
+#define ET_TRACE_ENVIRONMENT_VARIABLE "EASYTAG_TRACE"
+
+void et_trace_init (const gchar *path);
+void et_trace_shutdown (void);
+
+gint64 et_trace_begin (void);
+void et_trace_end (gint64 start, const gchar *category, const gchar *name, const gchar *detail);
+
+void et_trace_log_statistics (const gchar *title);
+
+G_END_DECLS
+
+#endif /* !ET_TRACE_H_ */
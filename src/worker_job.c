@@ -0,0 +1,225 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "worker_job.h"
+
+/*
+ * EtWorkerJob:
+ * @func: the function which processes an item
+ * @user_data: the data to pass to @func
+ * @n_items: the number of items
+ * @next: the index of the next item to process
+ * @n_done: the number of items processed so far, accessed atomically
+ * @cancelled: whether the workers should stop taking new items
+ * @threads: (array length=n_threads): the worker threads
+ * @n_threads: the number of worker threads
+ * @context: the main context to wake up after each item
+ * @mutex: protects @next and @cancelled
+ */
+struct _EtWorkerJob
+{
+    EtWorkerJobFunc func;
+    gpointer user_data;
+    guint n_items;
+    guint next;
+    gint n_done;
+    gboolean cancelled;
+    GThread **threads;
+    guint n_threads;
+    GMainContext *context;
+    GMutex mutex;
+};
+
+static gpointer
+et_worker_job_thread (gpointer user_data)
+{
+    EtWorkerJob *job = user_data;
+
+    for (;;)
+    {
+        guint index;
+
+        g_mutex_lock (&job->mutex);
+
+        if (job->cancelled || job->next >= job->n_items)
+        {
+            g_mutex_unlock (&job->mutex);
+            break;
+        }
+
+        index = job->next++;
+        g_mutex_unlock (&job->mutex);
+
+        job->func (index, job->user_data);
+
+        g_atomic_int_inc (&job->n_done);
+        /* Let the caller update its progress. */
+        g_main_context_wakeup (job->context);
+    }
+
+    return NULL;
+}
+
+/*
+ * et_worker_job_new:
+ * @name: the name of the worker threads, for debugging
+ * @n_items: the number of items to process
+ * @max_threads: the maximum number of items to process at the same time
+ * @func: called on a worker thread for each item
+ * @user_data: data to pass to @func
+ *
+ * Start processing the items on up to @max_threads worker threads. The
+ * thread-default main context of the caller is woken up each time that an
+ * item has been processed, so that the caller can show the progress with
+ * et_worker_job_get_n_done() while iterating it. If no thread can be
+ * started, the items are processed before this returns.
+ *
+ * Returns: a new #EtWorkerJob, to be freed with et_worker_job_free()
+ */
+EtWorkerJob *
+et_worker_job_new (const gchar *name,
+                   guint n_items,
+                   guint max_threads,
+                   EtWorkerJobFunc func,
+                   gpointer user_data)
+{
+    EtWorkerJob *job;
+    guint n_started = 0;
+    guint i;
+
+    g_return_val_if_fail (max_threads > 0, NULL);
+    g_return_val_if_fail (func != NULL, NULL);
+
+    job = g_slice_new0 (EtWorkerJob);
+    job->func = func;
+    job->user_data = user_data;
+    job->n_items = n_items;
+    job->context = g_main_context_ref_thread_default ();
+    g_mutex_init (&job->mutex);
+
+    job->n_threads = MIN (max_threads, n_items);
+    job->threads = g_new0 (GThread *, job->n_threads);
+
+    for (i = 0; i < job->n_threads; i++)
+    {
+        job->threads[i] = g_thread_try_new (name, et_worker_job_thread, job,
+                                            NULL);
+
+        if (job->threads[i])
+        {
+            n_started++;
+        }
+    }
+
+    if (n_started == 0)
+    {
+        et_worker_job_thread (job);
+    }
+
+    return job;
+}
+
+guint
+et_worker_job_get_n_items (EtWorkerJob *job)
+{
+    g_return_val_if_fail (job != NULL, 0);
+
+    return job->n_items;
+}
+
+/*
+ * et_worker_job_get_n_done:
+ * @job: the job
+ *
+ * Returns: the number of items which have been processed so far
+ */
+guint
+et_worker_job_get_n_done (EtWorkerJob *job)
+{
+    g_return_val_if_fail (job != NULL, 0);
+
+    return g_atomic_int_get (&job->n_done);
+}
+
+/*
+ * et_worker_job_is_finished:
+ * @job: the job
+ *
+ * Returns: %TRUE if all the items have been processed, %FALSE otherwise
+ */
+gboolean
+et_worker_job_is_finished (EtWorkerJob *job)
+{
+    g_return_val_if_fail (job != NULL, TRUE);
+
+    return et_worker_job_get_n_done (job) == job->n_items;
+}
+
+/*
+ * et_worker_job_wait:
+ * @job: the job
+ * @cancel: %TRUE to skip the items which have not been started yet
+ *
+ * Wait for the worker threads to finish. Calling this again has no effect.
+ */
+void
+et_worker_job_wait (EtWorkerJob *job,
+                    gboolean cancel)
+{
+    guint i;
+
+    g_return_if_fail (job != NULL);
+
+    if (cancel)
+    {
+        g_mutex_lock (&job->mutex);
+        job->cancelled = TRUE;
+        g_mutex_unlock (&job->mutex);
+    }
+
+    for (i = 0; i < job->n_threads; i++)
+    {
+        if (job->threads[i])
+        {
+            g_thread_join (job->threads[i]);
+            job->threads[i] = NULL;
+        }
+    }
+}
+
+/*
+ * et_worker_job_free:
+ * @job: the job
+ *
+ * Cancel the items which have not been started yet, wait for the worker
+ * threads, and free @job.
+ */
+void
+et_worker_job_free (EtWorkerJob *job)
+{
+    g_return_if_fail (job != NULL);
+
+    et_worker_job_wait (job, TRUE);
+
+    g_free (job->threads);
+    g_main_context_unref (job->context);
+    g_mutex_clear (&job->mutex);
+    g_slice_free (EtWorkerJob, job);
+}
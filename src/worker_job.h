@@ -0,0 +1,61 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ET_WORKER_JOB_H_
+#define ET_WORKER_JOB_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * ET_WORKER_JOB_MAX_FILE_THREADS:
+ *
+ * The number of files to read at the same time, as reading more than this
+ * only makes the disk seek more.
+ */
+#define ET_WORKER_JOB_MAX_FILE_THREADS MIN (g_get_num_processors (), 4)
+
+/*
+ * EtWorkerJobFunc:
+ * @index: the index of the item to process
+ * @user_data: the data passed to et_worker_job_new()
+ *
+ * Process one item, on a worker thread. Each item is processed once, and
+ * items with different indices may be processed at the same time.
+ */
+typedef void (*EtWorkerJobFunc) (guint index, gpointer user_data);
+
+/*
+ * EtWorkerJob:
+ *
+ * Processes a number of items on a bounded number of worker threads, so that
+ * the main loop keeps running while, for example, files are read.
+ */
+typedef struct _EtWorkerJob EtWorkerJob;
+
+EtWorkerJob * et_worker_job_new (const gchar *name, guint n_items, guint max_threads, EtWorkerJobFunc func, gpointer user_data);
+guint et_worker_job_get_n_items (EtWorkerJob *job);
+guint et_worker_job_get_n_done (EtWorkerJob *job);
+gboolean et_worker_job_is_finished (EtWorkerJob *job);
+void et_worker_job_wait (EtWorkerJob *job, gboolean cancel);
+void et_worker_job_free (EtWorkerJob *job);
+
+G_END_DECLS
+
+#endif /* !ET_WORKER_JOB_H_ */
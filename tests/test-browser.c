@@ -0,0 +1,312 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * The browser cannot be created without the main window, so these tests fill
+ * a bare list store with the columns of the file list, in the same way as
+ * et_browser_load_file_list().
+ */
+
+#include <gtk/gtk.h>
+
+/* The columns of the file list in browser.c. */
+enum
+{
+    LIST_FILE_NAME,
+    LIST_FILE_TITLE,
+    LIST_FILE_ARTIST,
+    LIST_FILE_ALBUM_ARTIST,
+    LIST_FILE_ALBUM,
+    LIST_FILE_YEAR,
+    LIST_FILE_DISCNO,
+    LIST_FILE_TRACK,
+    LIST_FILE_GENRE,
+    LIST_FILE_COMMENT,
+    LIST_FILE_COMPOSER,
+    LIST_FILE_ORIG_ARTIST,
+    LIST_FILE_COPYRIGHT,
+    LIST_FILE_URL,
+    LIST_FILE_ENCODED_BY,
+    LIST_FILE_POINTER,
+    LIST_FILE_KEY,
+    LIST_FILE_OTHERDIR,
+    LIST_FONT_WEIGHT,
+    LIST_ROW_BACKGROUND,
+    LIST_ROW_FOREGROUND,
+    LIST_COLUMN_COUNT
+};
+
+static const GdkRGBA LIGHT_BLUE = { 0.866, 0.933, 1.0, 1.0 };
+
+/*
+ * Like Browser_List_Sort_Func(), which compares the files of the rows. Here,
+ * the pointer is the filename.
+ */
+static gint
+sort_func (GtkTreeModel *model,
+           GtkTreeIter *a,
+           GtkTreeIter *b,
+           gpointer user_data)
+{
+    const gchar *filename1;
+    const gchar *filename2;
+
+    gtk_tree_model_get (model, a, LIST_FILE_POINTER, &filename1, -1);
+    gtk_tree_model_get (model, b, LIST_FILE_POINTER, &filename2, -1);
+
+    return g_utf8_collate (filename1, filename2);
+}
+
+static GtkListStore *
+create_model (void)
+{
+    GtkListStore *model;
+
+    model = gtk_list_store_new (LIST_COLUMN_COUNT, G_TYPE_STRING,
+                                G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
+                                G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
+                                G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
+                                G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
+                                G_TYPE_STRING, G_TYPE_STRING, G_TYPE_POINTER,
+                                G_TYPE_UINT, G_TYPE_BOOLEAN, G_TYPE_INT,
+                                GDK_TYPE_RGBA, GDK_TYPE_RGBA);
+    gtk_tree_sortable_set_sort_func (GTK_TREE_SORTABLE (model), 0, sort_func,
+                                     NULL, NULL);
+    gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (model), 0,
+                                          GTK_SORT_ASCENDING);
+
+    return model;
+}
+
+/*
+ * @n_files filenames in directories of 10 files, in ascending order or, if
+ * @descending is %TRUE, in descending order.
+ */
+static gchar **
+create_filenames (guint n_files,
+                  gboolean descending)
+{
+    gchar **filenames;
+    guint i;
+
+    filenames = g_new (gchar *, n_files + 1);
+
+    for (i = 0; i < n_files; i++)
+    {
+        guint number = descending ? n_files - 1 - i : i;
+
+        filenames[i] = g_strdup_printf ("/music/%06u/%06u.mp3", number / 10,
+                                        number);
+    }
+
+    filenames[n_files] = NULL;
+
+    return filenames;
+}
+
+static void
+insert_row (GtkListStore *model,
+            GtkTreeIter *iter,
+            const gchar *filename,
+            guint key)
+{
+    gtk_list_store_insert_with_values (model, iter, G_MAXINT,
+                                       LIST_FILE_NAME, filename,
+                                       LIST_FILE_POINTER, filename,
+                                       LIST_FILE_KEY, key,
+                                       LIST_FILE_OTHERDIR, key % 20 >= 10,
+                                       LIST_FILE_TITLE, "Title",
+                                       LIST_FILE_ARTIST, "Artist",
+                                       LIST_FILE_ALBUM_ARTIST, "Album Artist",
+                                       LIST_FILE_ALBUM, "Album",
+                                       LIST_FILE_YEAR, "2016",
+                                       LIST_FILE_DISCNO, "1/1",
+                                       LIST_FILE_TRACK, "01/10",
+                                       LIST_FILE_GENRE, "Rock",
+                                       LIST_FILE_COMMENT, NULL,
+                                       LIST_FILE_COMPOSER, NULL,
+                                       LIST_FILE_ORIG_ARTIST, NULL,
+                                       LIST_FILE_COPYRIGHT, NULL,
+                                       LIST_FILE_URL, NULL,
+                                       LIST_FILE_ENCODED_BY, NULL,
+                                       LIST_FONT_WEIGHT, PANGO_WEIGHT_NORMAL,
+                                       LIST_ROW_BACKGROUND,
+                                       key % 20 >= 10 ? &LIGHT_BLUE : NULL,
+                                       LIST_ROW_FOREGROUND, NULL, -1);
+}
+
+/*
+ * As et_browser_load_file_list() does: fill the model unsorted, and restore
+ * the sort column once.
+ */
+static void
+fill_model (GtkListStore *model,
+            gchar **filenames,
+            guint select_key,
+            GtkTreeIter *select_iter)
+{
+    GtkTreeSortable *sortable = GTK_TREE_SORTABLE (model);
+    gint sort_column_id;
+    GtkSortType sort_order;
+    guint i;
+
+    gtk_tree_sortable_get_sort_column_id (sortable, &sort_column_id,
+                                          &sort_order);
+    gtk_tree_sortable_set_sort_column_id (sortable,
+                                          GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID,
+                                          GTK_SORT_ASCENDING);
+
+    for (i = 0; filenames[i] != NULL; i++)
+    {
+        GtkTreeIter iter;
+
+        insert_row (model, &iter, filenames[i], i);
+
+        if (i == select_key)
+        {
+            *select_iter = iter;
+        }
+    }
+
+    gtk_tree_sortable_set_sort_column_id (sortable, sort_column_id,
+                                          sort_order);
+}
+
+/*
+ * As et_browser_load_file_list() did before: insert each row into the sorted
+ * model, then set its appearance.
+ */
+static void
+fill_model_sorted (GtkListStore *model,
+                   gchar **filenames)
+{
+    guint i;
+
+    for (i = 0; filenames[i] != NULL; i++)
+    {
+        GtkTreeIter iter;
+
+        insert_row (model, &iter, filenames[i], i);
+        gtk_list_store_set (model, &iter,
+                            LIST_FONT_WEIGHT, PANGO_WEIGHT_NORMAL,
+                            LIST_ROW_BACKGROUND,
+                            i % 20 >= 10 ? &LIGHT_BLUE : NULL,
+                            LIST_ROW_FOREGROUND, NULL, -1);
+    }
+}
+
+static void
+browser_fill (void)
+{
+    GtkListStore *model;
+    gchar **filenames;
+    GtkTreeIter iter;
+    GtkTreeIter select_iter;
+    gchar *previous = NULL;
+    guint key;
+    guint n_rows = 0;
+    gboolean valid;
+
+    model = create_model ();
+
+    /* The rows are sorted once the sort column is restored, and the iter of
+     * the row to select is still valid. */
+    filenames = create_filenames (100, TRUE);
+    fill_model (model, filenames, 42, &select_iter);
+
+    gtk_tree_model_get (GTK_TREE_MODEL (model), &select_iter, LIST_FILE_KEY,
+                        &key, -1);
+    g_assert_cmpuint (key, ==, 42);
+
+    for (valid = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (model), &iter);
+         valid;
+         valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (model), &iter))
+    {
+        gchar *filename;
+
+        gtk_tree_model_get (GTK_TREE_MODEL (model), &iter, LIST_FILE_NAME,
+                            &filename, -1);
+
+        if (previous)
+        {
+            g_assert_cmpint (g_utf8_collate (previous, filename), <, 0);
+            g_free (previous);
+        }
+
+        previous = filename;
+        n_rows++;
+    }
+
+    g_assert_cmpuint (n_rows, ==, 100);
+
+    g_free (previous);
+    g_strfreev (filenames);
+    g_object_unref (model);
+}
+
+static void
+browser_perf_fill (gconstpointer user_data)
+{
+    guint n_files = GPOINTER_TO_UINT (user_data);
+    GtkListStore *model;
+    gchar **filenames;
+    GtkTreeIter select_iter;
+    gdouble time;
+    gdouble sorted_time;
+
+    /* Already sorted, as by ET_Sort_File_List(). */
+    filenames = create_filenames (n_files, FALSE);
+
+    model = create_model ();
+    g_test_timer_start ();
+    fill_model_sorted (model, filenames);
+    sorted_time = g_test_timer_elapsed ();
+    g_object_unref (model);
+
+    model = create_model ();
+    g_test_timer_start ();
+    fill_model (model, filenames, 0, &select_iter);
+    time = g_test_timer_elapsed ();
+    g_object_unref (model);
+
+    g_test_message ("%u rows, inserted into the sorted model: %.3f seconds",
+                    n_files, sorted_time);
+    g_test_minimized_result (time, "%u rows: %6.3f seconds", n_files, time);
+
+    g_strfreev (filenames);
+}
+
+int
+main (int argc, char** argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/browser/fill", browser_fill);
+
+    if (g_test_perf ())
+    {
+        g_test_add_data_func ("/browser/perf/fill/10000",
+                              GUINT_TO_POINTER (10000), browser_perf_fill);
+        g_test_add_data_func ("/browser/perf/fill/100000",
+                              GUINT_TO_POINTER (100000), browser_perf_fill);
+        g_test_add_data_func ("/browser/perf/fill/500000",
+                              GUINT_TO_POINTER (500000), browser_perf_fill);
+    }
+
+    return g_test_run ();
+}
@@ -0,0 +1,308 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "charset.h"
+
+#include <string.h>
+
+#include "log.h"
+
+GSettings *MainSettings;
+
+void
+Log_Print (EtLogAreaKind error_type,
+           const gchar * const format,
+           ...)
+{
+    /* Only used when a conversion fails in convert_string(). */
+}
+
+/*
+ * Check that et_charset_convert() gives the same result, error and byte
+ * counts as g_convert().
+ */
+static void
+check_convert (const gchar *string,
+               gssize length,
+               const gchar *to_codeset,
+               const gchar *from_codeset)
+{
+    gchar *expected;
+    gchar *result;
+    gsize expected_read = G_MAXSIZE;
+    gsize expected_written = G_MAXSIZE;
+    gsize bytes_read = G_MAXSIZE;
+    gsize bytes_written = G_MAXSIZE;
+    GError *expected_error = NULL;
+    GError *error = NULL;
+
+    expected = g_convert (string, length, to_codeset, from_codeset,
+                          &expected_read, &expected_written, &expected_error);
+    result = et_charset_convert (string, length, to_codeset, from_codeset,
+                                 &bytes_read, &bytes_written, &error);
+
+    if (expected_error)
+    {
+        g_assert (result == NULL);
+        g_assert_error (error, expected_error->domain, expected_error->code);
+        g_assert_cmpuint (bytes_read, ==, expected_read);
+
+        g_error_free (expected_error);
+        g_error_free (error);
+    }
+    else
+    {
+        g_assert_no_error (error);
+        g_assert_cmpuint (bytes_read, ==, expected_read);
+        g_assert_cmpuint (bytes_written, ==, expected_written);
+        g_assert (memcmp (result, expected, expected_written + 1) == 0);
+
+        g_free (expected);
+        g_free (result);
+    }
+}
+
+static void
+charset_utf8_validate (void)
+{
+    gsize i;
+
+    static const struct
+    {
+        const gchar *string;
+        gssize length;
+    } strings[] =
+    {
+        { "", -1 },
+        { "", 0 },
+        { "Title", -1 },
+        { "Title", 3 },
+        /* Longer than a word, so that the ASCII fast path is used. */
+        { "A rather longer title, with some words", -1 },
+        { "A rather longer title\xc3\xa9\xe2\x82\xac\xf0\x9d\x84\x9e", -1 },
+        { "A rather longer title\xff, with invalid bytes", -1 },
+        { "A rather longer title\xc3", -1 },
+        { "A rather longer title\xc3\xa9", 22 },
+        /* Overlong and surrogate encodings. */
+        { "Title\xc0\x80", -1 },
+        { "Title\xed\xa0\x80", -1 },
+        { "Title\xf4\x90\x80\x80", -1 },
+        /* Nul bytes within the length are invalid. */
+        { "A rather\0longer title", 21 },
+        { "Title\0", 6 },
+        { "Title\xc3\xa9\0", 8 }
+    };
+
+    for (i = 0; i < G_N_ELEMENTS (strings); i++)
+    {
+        const gchar *end;
+        const gchar *expected_end;
+        gboolean result;
+
+        result = et_charset_utf8_validate (strings[i].string,
+                                           strings[i].length, &end);
+        g_assert_cmpint (result, ==, g_utf8_validate (strings[i].string,
+                                                      strings[i].length,
+                                                      &expected_end));
+        g_assert (end == expected_end);
+
+        g_assert_cmpint (et_charset_utf8_validate (strings[i].string,
+                                                   strings[i].length, NULL),
+                         ==, result);
+    }
+}
+
+static void
+charset_convert_ascii (void)
+{
+    gchar ascii[128];
+    gsize i;
+
+    static const struct
+    {
+        const gchar *to_codeset;
+        const gchar *from_codeset;
+    } codesets[] =
+    {
+        { "UTF-8", "ISO-8859-15" },
+        { "ISO-8859-15", "UTF-8" },
+        { "UTF8", "ISO8859-1" },
+        { "ISO_8859-2", "LATIN1" },
+        { "WINDOWS-1252", "KOI8-R" },
+        { "CP1251", "ASCII" },
+        { "US-ASCII", "ANSI_X3.4-1968" },
+        /* Not ASCII compatible, so iconv is used. */
+        { "UTF-16LE", "UTF-8" },
+        { "UTF-8", "SHIFT_JIS" }
+    };
+
+    for (i = 0; i < G_N_ELEMENTS (ascii); i++)
+    {
+        ascii[i] = i + 1;
+    }
+
+    ascii[G_N_ELEMENTS (ascii) - 1] = '\0';
+
+    for (i = 0; i < G_N_ELEMENTS (codesets); i++)
+    {
+        check_convert ("", -1, codesets[i].to_codeset,
+                       codesets[i].from_codeset);
+        check_convert ("Title", -1, codesets[i].to_codeset,
+                       codesets[i].from_codeset);
+        check_convert ("Title", 3, codesets[i].to_codeset,
+                       codesets[i].from_codeset);
+        check_convert (ascii, -1, codesets[i].to_codeset,
+                       codesets[i].from_codeset);
+    }
+}
+
+static void
+charset_convert_latin1 (void)
+{
+    gchar latin1[sizeof ("A rather longer title") + 128];
+    gsize i;
+
+    static const gchar * const codesets[] =
+    {
+        "ISO-8859-1", "ISO8859-1", "ISO_8859-1", "LATIN1", "latin1"
+    };
+
+    strcpy (latin1, "A rather longer title");
+
+    for (i = 0; i < 128; i++)
+    {
+        latin1[strlen ("A rather longer title") + i] = 0x80 + i;
+    }
+
+    latin1[G_N_ELEMENTS (latin1) - 1] = '\0';
+
+    for (i = 0; i < G_N_ELEMENTS (codesets); i++)
+    {
+        /* Only the high half. */
+        check_convert (latin1 + strlen ("A rather longer title"), 128,
+                       "UTF-8", codesets[i]);
+        check_convert (latin1, -1, "UTF-8", codesets[i]);
+        check_convert (latin1, -1, "utf8", codesets[i]);
+    }
+}
+
+static void
+charset_convert_invalid (void)
+{
+    gsize i;
+
+    static const struct
+    {
+        const gchar *string;
+        gssize length;
+    } strings[] =
+    {
+        { "Title\xff", -1 },
+        { "A rather longer title\xc3\x28, with an invalid sequence", -1 },
+        { "A rather longer title\xed\xa0\x80", -1 },
+        /* Partial input. */
+        { "A rather longer title\xc3", -1 },
+        { "A rather longer title\xe2\x82\xac", 23 },
+        /* Valid, but with a nul byte within the length. */
+        { "A rather\0longer title\xc3\xa9", 23 }
+    };
+
+    for (i = 0; i < G_N_ELEMENTS (strings); i++)
+    {
+        check_convert (strings[i].string, strings[i].length, "UTF-8",
+                       "UTF-8");
+        check_convert (strings[i].string, strings[i].length, "ISO-8859-1",
+                       "UTF-8");
+    }
+}
+
+static void
+charset_convert_unsupported (void)
+{
+    gchar *result;
+    gsize bytes_read = G_MAXSIZE;
+    gsize bytes_written = G_MAXSIZE;
+    GError *error = NULL;
+
+    result = et_charset_convert ("Title\xc3\xa9", -1, "UTF-8",
+                                 "NOT-A-CODESET", &bytes_read, &bytes_written,
+                                 &error);
+    g_assert (result == NULL);
+    g_assert_error (error, G_CONVERT_ERROR, G_CONVERT_ERROR_NO_CONVERSION);
+    g_assert_cmpuint (bytes_read, ==, 0);
+    g_assert_cmpuint (bytes_written, ==, 0);
+    g_clear_error (&error);
+
+    /* The failure is not cached. */
+    bytes_read = G_MAXSIZE;
+    bytes_written = G_MAXSIZE;
+    result = et_charset_convert ("Title\xc3\xa9", -1, "NOT-A-CODESET",
+                                 "UTF-8", &bytes_read, &bytes_written,
+                                 &error);
+    g_assert (result == NULL);
+    g_assert_error (error, G_CONVERT_ERROR, G_CONVERT_ERROR_NO_CONVERSION);
+    g_assert_cmpuint (bytes_read, ==, 0);
+    g_assert_cmpuint (bytes_written, ==, 0);
+    g_clear_error (&error);
+
+    check_convert ("Title\xc3\xa9", -1, "UTF-8", "NOT-A-CODESET");
+}
+
+static void
+charset_convert_stateful (void)
+{
+    gsize i;
+
+    /* 日本 in UTF-8, and in ISO-2022-JP, where the second string is left in
+     * the JIS X 0208 shift state. */
+    static const gchar utf8[] = "\xe6\x97\xa5\xe6\x9c\xac";
+    static const gchar * const jis[] =
+    {
+        "\x1b$BF|K\\\x1b(B", "\x1b$BF|K\\", "F|K\\"
+    };
+
+    /* The cached descriptor is reused for each conversion, and must be
+     * returned to its initial state. */
+    for (i = 0; i < 2; i++)
+    {
+        check_convert (utf8, -1, "ISO-2022-JP", "UTF-8");
+        check_convert ("Title", -1, "ISO-2022-JP", "UTF-8");
+    }
+
+    for (i = 0; i < G_N_ELEMENTS (jis); i++)
+    {
+        check_convert (jis[i], -1, "UTF-8", "ISO-2022-JP");
+        check_convert (jis[i], -1, "UTF-8", "ISO-2022-JP");
+    }
+}
+
+int
+main (int argc, char** argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/charset/utf8-validate", charset_utf8_validate);
+    g_test_add_func ("/charset/convert/ascii", charset_convert_ascii);
+    g_test_add_func ("/charset/convert/invalid", charset_convert_invalid);
+    g_test_add_func ("/charset/convert/latin1", charset_convert_latin1);
+    g_test_add_func ("/charset/convert/stateful", charset_convert_stateful);
+    g_test_add_func ("/charset/convert/unsupported",
+                     charset_convert_unsupported);
+
+    return g_test_run ();
+}
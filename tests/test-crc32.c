@@ -0,0 +1,193 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "crc32.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+
+/* The CRC32 of "123456789". */
+static const guint32 CHECK_VALUE = 0xcbf43926;
+
+/*
+ * Create a file in @dir containing @audio, between an ID3v2 tag and an ID3v1
+ * tag, which are both skipped by the CRC.
+ */
+static GFile *
+create_file (const gchar *dir,
+             const gchar *name,
+             const gchar *audio)
+{
+    GString *contents;
+    gchar *path;
+    GFile *file;
+    GError *error = NULL;
+
+    contents = g_string_new (NULL);
+    /* An empty ID3v2.3 tag, with 10 bytes of padding. */
+    g_string_append_len (contents, "ID3\x03\x00\x00\x00\x00\x00\x0a", 10);
+    g_string_append_len (contents, "\0\0\0\0\0\0\0\0\0\0", 10);
+    g_string_append (contents, audio);
+    g_string_append (contents, "TAG");
+    g_string_set_size (contents, contents->len + 125);
+    memset (contents->str + contents->len - 125, 0, 125);
+
+    path = g_build_filename (dir, name, NULL);
+    g_file_set_contents (path, contents->str, contents->len, &error);
+    g_assert_no_error (error);
+    file = g_file_new_for_path (path);
+
+    g_free (path);
+    g_string_free (contents, TRUE);
+
+    return file;
+}
+
+static void
+crc32_file (void)
+{
+    gchar *dir;
+    GFile *file;
+    guint32 crc32_value = 0;
+    GError *error = NULL;
+
+    dir = g_dir_make_tmp ("easytag-test-crc32-XXXXXX", NULL);
+    g_assert (dir != NULL);
+    file = create_file (dir, "file.mp3", "123456789");
+
+    g_assert (crc32_file_with_ID3_tag (file, &crc32_value, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (crc32_value, ==, CHECK_VALUE);
+
+    g_file_delete (file, NULL, NULL);
+    g_object_unref (file);
+    g_rmdir (dir);
+    g_free (dir);
+}
+
+static void
+crc32_cached (void)
+{
+    gchar *dir;
+    GFile *file;
+    guint32 crc32_value = 0;
+    GError *error = NULL;
+
+    dir = g_dir_make_tmp ("easytag-test-crc32-XXXXXX", NULL);
+    g_assert (dir != NULL);
+    file = create_file (dir, "file.mp3", "123456789");
+
+    g_assert (et_crc32_file_cached (file, &crc32_value, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (crc32_value, ==, CHECK_VALUE);
+
+    g_assert (et_crc32_file_cached (file, &crc32_value, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (crc32_value, ==, CHECK_VALUE);
+
+    /* A change of size invalidates the cached value. */
+    g_object_unref (file);
+    file = create_file (dir, "file.mp3", "1234567890");
+
+    g_assert (et_crc32_file_cached (file, &crc32_value, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (crc32_value, !=, CHECK_VALUE);
+
+    g_file_delete (file, NULL, NULL);
+
+    g_assert (!et_crc32_file_cached (file, &crc32_value, &error));
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+    g_clear_error (&error);
+
+    g_object_unref (file);
+
+    g_rmdir (dir);
+    g_free (dir);
+}
+
+static void
+crc32_job (void)
+{
+    gchar *dir;
+    GList *files = NULL;
+    GList *l;
+    EtCrc32Job *job;
+    gsize i;
+    guint32 crc32_value;
+    GError *error = NULL;
+
+    dir = g_dir_make_tmp ("easytag-test-crc32-XXXXXX", NULL);
+    g_assert (dir != NULL);
+
+    for (i = 0; i < 20; i++)
+    {
+        gchar *name = g_strdup_printf ("%" G_GSIZE_FORMAT ".mp3", i);
+
+        files = g_list_prepend (files, create_file (dir, name, "123456789"));
+        g_free (name);
+    }
+
+    /* A missing file, which fails on its own. */
+    files = g_list_prepend (files, g_file_new_for_path ("/nonexistent"));
+    files = g_list_reverse (files);
+
+    job = et_crc32_job_new (files, 4);
+
+    while (!et_worker_job_is_finished (et_crc32_job_get_worker_job (job)))
+    {
+        g_main_context_iteration (NULL, TRUE);
+    }
+
+    et_crc32_job_wait (job, FALSE);
+    g_assert_cmpuint (et_worker_job_get_n_done (et_crc32_job_get_worker_job (job)),
+                      ==, 21);
+
+    for (i = 0; i < 20; i++)
+    {
+        g_assert (et_crc32_job_get_result (job, i, &crc32_value, &error));
+        g_assert_no_error (error);
+        g_assert_cmpuint (crc32_value, ==, CHECK_VALUE);
+    }
+
+    g_assert (!et_crc32_job_get_result (job, 20, &crc32_value, &error));
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+    g_clear_error (&error);
+
+    et_crc32_job_free (job);
+
+    for (l = files; l != NULL; l = g_list_next (l))
+    {
+        g_file_delete (G_FILE (l->data), NULL, NULL);
+    }
+
+    g_list_free_full (files, g_object_unref);
+    g_rmdir (dir);
+    g_free (dir);
+}
+
+int
+main (int argc, char** argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/crc32/file", crc32_file);
+    g_test_add_func ("/crc32/cached", crc32_cached);
+    g_test_add_func ("/crc32/job", crc32_job);
+
+    return g_test_run ();
+}
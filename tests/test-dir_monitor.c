@@ -0,0 +1,241 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "dir_monitor.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+
+/* Generous, as the file monitor may have to fall back to polling. */
+static const guint TIMEOUT_SECONDS = 20;
+
+typedef struct
+{
+    GMainLoop *loop;
+    GHashTable *seen;
+    guint n_calls;
+    guint n_refusals;
+    /* Other files, such as temporary ones, are not counted. */
+    const gchar * const *expected;
+} Changes;
+
+static gboolean
+is_expected (const Changes *changes,
+             const gchar *basename)
+{
+    const gchar * const *name;
+
+    for (name = changes->expected; *name != NULL; name++)
+    {
+        if (strcmp (*name, basename) == 0)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static gboolean
+on_changes (GList *files,
+            gpointer user_data)
+{
+    Changes *changes = user_data;
+    GList *l;
+
+    changes->n_calls++;
+
+    if (changes->n_refusals > 0)
+    {
+        changes->n_refusals--;
+        return FALSE;
+    }
+
+    for (l = files; l != NULL; l = g_list_next (l))
+    {
+        gchar *basename = g_file_get_basename (G_FILE (l->data));
+
+        if (is_expected (changes, basename))
+        {
+            g_hash_table_add (changes->seen, basename);
+        }
+        else
+        {
+            g_free (basename);
+        }
+    }
+
+    if (g_hash_table_size (changes->seen)
+        == g_strv_length ((gchar **)changes->expected))
+    {
+        g_main_loop_quit (changes->loop);
+    }
+
+    return TRUE;
+}
+
+static gboolean
+on_timeout (gpointer user_data)
+{
+    g_assert_not_reached ();
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+write_file (const gchar *dir,
+            const gchar *basename)
+{
+    gchar *path;
+    FILE *file;
+
+    /* Written in place, as g_file_set_contents() would create a temporary
+     * file in the directory too. */
+    path = g_build_filename (dir, basename, NULL);
+    file = g_fopen (path, "wb");
+    g_assert (file != NULL);
+    g_assert_cmpuint (fwrite ("x", 1, 1, file), ==, 1);
+    g_assert_cmpint (fclose (file), ==, 0);
+    g_free (path);
+}
+
+static void
+remove_file (const gchar *dir,
+             const gchar *basename)
+{
+    gchar *path;
+
+    path = g_build_filename (dir, basename, NULL);
+    g_remove (path);
+    g_free (path);
+}
+
+static void
+wait_for_changes (Changes *changes)
+{
+    guint timeout_id;
+
+    timeout_id = g_timeout_add_seconds (TIMEOUT_SECONDS, on_timeout, NULL);
+    g_main_loop_run (changes->loop);
+    g_source_remove (timeout_id);
+}
+
+static void
+dir_monitor_batch (void)
+{
+    gchar *dir;
+    GFile *file;
+    EtDirMonitor *monitor;
+    static const gchar * const expected[] = { "a.mp3", "b.mp3", "c.mp3",
+                                              NULL };
+    Changes changes = { NULL, NULL, 0, 1, expected };
+
+    dir = g_dir_make_tmp ("easytag-test-dir-monitor-XXXXXX", NULL);
+    g_assert (dir != NULL);
+
+    changes.loop = g_main_loop_new (NULL, FALSE);
+    changes.seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                          NULL);
+
+    file = g_file_new_for_path (dir);
+    monitor = et_dir_monitor_new (FALSE, FALSE, on_changes, &changes);
+    et_dir_monitor_add (monitor, file);
+
+    /* Each file is written in several steps, but reported once, and the
+     * changes refused the first time are reported again. */
+    write_file (dir, "a.mp3");
+    write_file (dir, "b.mp3");
+    write_file (dir, "a.mp3");
+    write_file (dir, "c.mp3");
+
+    wait_for_changes (&changes);
+
+    g_assert_cmpuint (changes.n_refusals, ==, 0);
+    g_assert_cmpuint (g_hash_table_size (changes.seen), ==, 3);
+    g_assert (g_hash_table_contains (changes.seen, "a.mp3"));
+    g_assert (g_hash_table_contains (changes.seen, "b.mp3"));
+    g_assert (g_hash_table_contains (changes.seen, "c.mp3"));
+
+    et_dir_monitor_free (monitor);
+    g_object_unref (file);
+
+    remove_file (dir, "a.mp3");
+    remove_file (dir, "b.mp3");
+    remove_file (dir, "c.mp3");
+    g_rmdir (dir);
+
+    g_hash_table_destroy (changes.seen);
+    g_main_loop_unref (changes.loop);
+    g_free (dir);
+}
+
+static void
+dir_monitor_new_dir (void)
+{
+    gchar *dir;
+    gchar *subdir;
+    GFile *file;
+    EtDirMonitor *monitor;
+    static const gchar * const expected[] = { "album", "track.ogg", NULL };
+    Changes changes = { NULL, NULL, 0, 0, expected };
+
+    dir = g_dir_make_tmp ("easytag-test-dir-monitor-XXXXXX", NULL);
+    g_assert (dir != NULL);
+    subdir = g_build_filename (dir, "album", NULL);
+
+    changes.loop = g_main_loop_new (NULL, FALSE);
+    changes.seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                          NULL);
+
+    file = g_file_new_for_path (dir);
+    monitor = et_dir_monitor_new (TRUE, FALSE, on_changes, &changes);
+    et_dir_monitor_add (monitor, file);
+
+    /* A new directory is watched in turn, so that the file created in it is
+     * reported too. */
+    g_assert_cmpint (g_mkdir (subdir, 0700), ==, 0);
+    write_file (subdir, "track.ogg");
+
+    wait_for_changes (&changes);
+
+    g_assert (g_hash_table_contains (changes.seen, "album"));
+    g_assert (g_hash_table_contains (changes.seen, "track.ogg"));
+
+    et_dir_monitor_free (monitor);
+    g_object_unref (file);
+
+    remove_file (subdir, "track.ogg");
+    g_rmdir (subdir);
+    g_rmdir (dir);
+
+    g_hash_table_destroy (changes.seen);
+    g_main_loop_unref (changes.loop);
+    g_free (subdir);
+    g_free (dir);
+}
+
+int
+main (int argc, char** argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/dir_monitor/batch", dir_monitor_batch);
+    g_test_add_func ("/dir_monitor/new-dir", dir_monitor_new_dir);
+
+    return g_test_run ();
+}
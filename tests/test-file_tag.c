@@ -21,6 +21,9 @@
 #include "misc.h"
 #include "picture.h"
 
+#define G_SETTINGS_ENABLE_BACKEND
+#include <gio/gsettingsbackend.h>
+
 GtkWidget *MainWindow;
 GSettings *MainSettings;
 
@@ -158,9 +161,100 @@ file_tag_difference (void)
     et_file_tag_free (tag1);
 }
 
+static void
+file_tag_needs_corrections (void)
+{
+    File_Tag *file_tag;
+
+    file_tag = et_file_tag_new ();
+
+    g_assert (!et_file_tag_needs_corrections (file_tag));
+
+    et_file_tag_set_title (file_tag, "foo bar");
+    et_file_tag_set_comment (file_tag, "baz");
+    g_assert (!et_file_tag_needs_corrections (file_tag));
+
+    /* Whitespace is stripped. */
+    et_file_tag_set_title (file_tag, "foo bar ");
+    g_assert (et_file_tag_needs_corrections (file_tag));
+
+    et_file_tag_set_title (file_tag, "\tfoo bar");
+    g_assert (et_file_tag_needs_corrections (file_tag));
+
+    /* Empty strings are replaced by NULL, but et_file_tag_set_*() never stores
+     * them. */
+    et_file_tag_set_title (file_tag, NULL);
+    g_free (file_tag->comment);
+    file_tag->comment = g_strdup ("");
+    g_assert (et_file_tag_needs_corrections (file_tag));
+
+    et_file_tag_free (file_tag);
+}
+
+static void
+file_tag_needs_corrections_number (void)
+{
+    File_Tag *file_tag;
+
+    file_tag = et_file_tag_new ();
+
+    /* Padded to two digits. */
+    g_settings_set_boolean (MainSettings, "tag-number-padded", TRUE);
+    g_settings_set_uint (MainSettings, "tag-number-length", 2);
+    g_settings_set_boolean (MainSettings, "tag-disc-padded", TRUE);
+    g_settings_set_uint (MainSettings, "tag-disc-length", 2);
+
+    et_file_tag_set_track_number (file_tag, "05");
+    g_assert (!et_file_tag_needs_corrections (file_tag));
+
+    et_file_tag_set_track_number (file_tag, "5");
+    g_assert (et_file_tag_needs_corrections (file_tag));
+
+    /* The total is split from the track number when saving. */
+    et_file_tag_set_track_number (file_tag, "05/12");
+    g_assert (et_file_tag_needs_corrections (file_tag));
+
+    /* Replaced by NULL, which et_file_tag_set_*() never stores. */
+    et_file_tag_set_track_number (file_tag, NULL);
+    file_tag->track = g_strdup ("");
+    g_assert (et_file_tag_needs_corrections (file_tag));
+
+    et_file_tag_set_track_number (file_tag, "05");
+    et_file_tag_set_disc_total (file_tag, "2");
+    g_assert (et_file_tag_needs_corrections (file_tag));
+
+    et_file_tag_set_disc_total (file_tag, "02");
+    g_assert (!et_file_tag_needs_corrections (file_tag));
+
+    /* Without padding. */
+    g_settings_set_boolean (MainSettings, "tag-number-padded", FALSE);
+    g_settings_set_boolean (MainSettings, "tag-disc-padded", FALSE);
+    g_assert (et_file_tag_needs_corrections (file_tag));
+
+    et_file_tag_set_track_number (file_tag, "5");
+    et_file_tag_set_disc_total (file_tag, "2");
+    g_assert (!et_file_tag_needs_corrections (file_tag));
+
+    /* Padded to three digits. */
+    g_settings_set_boolean (MainSettings, "tag-number-padded", TRUE);
+    g_settings_set_uint (MainSettings, "tag-number-length", 3);
+    g_assert (et_file_tag_needs_corrections (file_tag));
+
+    et_file_tag_set_track_number (file_tag, "005");
+    g_assert (!et_file_tag_needs_corrections (file_tag));
+
+    et_file_tag_free (file_tag);
+}
+
 int
 main (int argc, char** argv)
 {
+    GSettingsSchemaSource *source;
+    GSettingsSchema *schema;
+    GSettingsBackend *backend;
+    gint result;
+    GError *error = NULL;
+
     g_test_init (&argc, &argv, NULL);
     g_test_bug_base ("https://bugzilla.gnome.org/show_bug.cgi?id=");
 
@@ -168,6 +262,29 @@ main (int argc, char** argv)
     g_test_add_func ("/file_tag/copy", file_tag_copy);
     g_test_add_func ("/file_tag/copy-other", file_tag_copy_other);
     g_test_add_func ("/file_tag/difference", file_tag_difference);
-
-    return g_test_run ();
+    g_test_add_func ("/file_tag/needs-corrections",
+                     file_tag_needs_corrections);
+    g_test_add_func ("/file_tag/needs-corrections-number",
+                     file_tag_needs_corrections_number);
+
+    /* The schema compiled for the tests, with settings which are only kept
+     * in memory. */
+    source = g_settings_schema_source_new_from_directory (TEST_SCHEMA_DIR,
+                                                          NULL, FALSE,
+                                                          &error);
+    g_assert_no_error (error);
+    schema = g_settings_schema_source_lookup (source, "org.gnome.EasyTAG",
+                                              FALSE);
+    g_assert (schema != NULL);
+    backend = g_memory_settings_backend_new ();
+    MainSettings = g_settings_new_full (schema, backend, NULL);
+
+    result = g_test_run ();
+
+    g_object_unref (MainSettings);
+    g_object_unref (backend);
+    g_settings_schema_unref (schema);
+    g_settings_schema_source_unref (source);
+
+    return result;
 }
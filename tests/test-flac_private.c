@@ -0,0 +1,539 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "flac_private.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+
+#ifdef ENABLE_FLAC
+
+enum
+{
+    BLOCK_STREAMINFO = 0,
+    BLOCK_PADDING = 1,
+    BLOCK_VORBIS_COMMENT = 4,
+    BLOCK_PICTURE = 6
+};
+
+static void
+append_be24 (GString *data,
+             guint32 value)
+{
+    g_string_append_c (data, (value >> 16) & 0xff);
+    g_string_append_c (data, (value >> 8) & 0xff);
+    g_string_append_c (data, value & 0xff);
+}
+
+static void
+append_be32 (GString *data,
+             guint32 value)
+{
+    g_string_append_c (data, (value >> 24) & 0xff);
+    append_be24 (data, value);
+}
+
+static void
+append_le32 (GString *data,
+             guint32 value)
+{
+    g_string_append_c (data, value & 0xff);
+    g_string_append_c (data, (value >> 8) & 0xff);
+    g_string_append_c (data, (value >> 16) & 0xff);
+    g_string_append_c (data, (value >> 24) & 0xff);
+}
+
+static void
+append_zeros (GString *data,
+              gsize count)
+{
+    gsize i;
+
+    for (i = 0; i < count; i++)
+    {
+        g_string_append_c (data, '\0');
+    }
+}
+
+static void
+append_block_header (GString *data,
+                     guint type,
+                     gboolean is_last,
+                     guint32 length)
+{
+    g_string_append_c (data, (is_last ? 0x80 : 0) | type);
+    append_be24 (data, length);
+}
+
+/*
+ * A file which starts with the stream marker and a STREAMINFO block.
+ */
+static GString *
+create_flac (guint32 sample_rate,
+             guint channels,
+             guint64 total_samples,
+             gboolean is_last)
+{
+    GString *data;
+    guint64 fields;
+    gint shift;
+
+    data = g_string_new ("fLaC");
+    append_block_header (data, BLOCK_STREAMINFO, is_last, 34);
+
+    /* Block and frame sizes. */
+    g_string_append_len (data, "\x10\x00\x10\x00\x00\x00\x00\x00\x00\x00", 10);
+
+    /* 20 bits of sample rate, 3 bits of channels - 1, 5 bits of bits per
+     * sample - 1 (16 here) and 36 bits of total samples. */
+    fields = ((guint64)sample_rate << 44) | ((guint64)(channels - 1) << 41)
+             | ((guint64)15 << 36) | total_samples;
+
+    for (shift = 56; shift >= 0; shift -= 8)
+    {
+        g_string_append_c (data, (fields >> shift) & 0xff);
+    }
+
+    /* MD5 of the audio. */
+    g_string_append_len (data, "0123456789abcdef", 16);
+
+    return data;
+}
+
+/*
+ * Append a VORBIS_COMMENT block with @vendor and the nul-terminated
+ * @comments.
+ */
+static void
+append_vorbis_comment (GString *data,
+                       gboolean is_last,
+                       const gchar *vendor,
+                       const gchar * const *comments)
+{
+    gsize length = 4 + strlen (vendor) + 4;
+    gsize n_comments = 0;
+    gsize i;
+
+    for (i = 0; comments[i] != NULL; i++)
+    {
+        length += 4 + strlen (comments[i]);
+        n_comments++;
+    }
+
+    append_block_header (data, BLOCK_VORBIS_COMMENT, is_last, length);
+    append_le32 (data, strlen (vendor));
+    g_string_append (data, vendor);
+    append_le32 (data, n_comments);
+
+    for (i = 0; comments[i] != NULL; i++)
+    {
+        append_le32 (data, strlen (comments[i]));
+        g_string_append (data, comments[i]);
+    }
+}
+
+/*
+ * Write @data to a file in @dir, and parse its metadata in a new read
+ * session, which is returned in @session.
+ */
+static EtFlacMetadata *
+read_metadata (const gchar *dir,
+               GString *data,
+               EtReadSession **session,
+               GError **error)
+{
+    gchar *path;
+    GFile *file;
+    EtFlacMetadata *metadata;
+    GError *tmp_error = NULL;
+
+    path = g_build_filename (dir, "test.flac", NULL);
+    g_file_set_contents (path, data->str, data->len, &tmp_error);
+    g_assert_no_error (tmp_error);
+
+    file = g_file_new_for_path (path);
+    *session = et_read_session_new (file, &tmp_error);
+    g_assert_no_error (tmp_error);
+
+    metadata = et_flac_metadata_get (*session, error);
+
+    g_object_unref (file);
+    g_free (path);
+    g_string_free (data, TRUE);
+
+    return metadata;
+}
+
+/*
+ * Check that parsing @data fails, as the file is invalid.
+ */
+static void
+check_invalid (const gchar *dir,
+               GString *data)
+{
+    EtReadSession *session;
+    GError *error = NULL;
+
+    g_assert (read_metadata (dir, data, &session, &error) == NULL);
+    g_assert_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED);
+
+    g_error_free (error);
+    et_read_session_free (session);
+}
+
+static void
+remove_test_file (const gchar *dir)
+{
+    gchar *path;
+
+    path = g_build_filename (dir, "test.flac", NULL);
+    g_remove (path);
+    g_free (path);
+    g_rmdir (dir);
+}
+
+static void
+flac_private_streaminfo (void)
+{
+    gchar *dir;
+    GString *data;
+    GString *flac;
+    EtReadSession *session;
+    EtFlacMetadata *metadata;
+    GError *error = NULL;
+
+    dir = g_dir_make_tmp ("easytag-test-flac-XXXXXX", NULL);
+    g_assert (dir != NULL);
+
+    /* More than 32 bits of samples. */
+    data = create_flac (96000, 6, G_GUINT64_CONSTANT (0x923456789), TRUE);
+    metadata = read_metadata (dir, data, &session, &error);
+    g_assert_no_error (error);
+
+    g_assert_cmpuint (metadata->sample_rate, ==, 96000);
+    g_assert_cmpuint (metadata->channels, ==, 6);
+    g_assert_cmpuint (metadata->total_samples, ==,
+                      G_GUINT64_CONSTANT (0x923456789));
+    g_assert_cmpuint (metadata->metadata_len, ==, 34);
+    g_assert_cmpuint (metadata->vorbis_comments->len, ==, 0);
+    g_assert_cmpuint (metadata->pictures->len, ==, 0);
+
+    /* The metadata is only parsed once per session. */
+    g_assert (et_flac_metadata_get (session, &error) == metadata);
+
+    et_read_session_free (session);
+
+    /* An ID3v2 tag before the stream marker is skipped. */
+    flac = create_flac (44100, 2, 0, TRUE);
+    data = g_string_new (NULL);
+    g_string_append_len (data, "ID3\x04\x00\x00\x00\x00\x00\x05", 10);
+    append_zeros (data, 5);
+    g_string_append_len (data, flac->str, flac->len);
+    g_string_free (flac, TRUE);
+    metadata = read_metadata (dir, data, &session, &error);
+    g_assert_no_error (error);
+    g_assert_cmpuint (metadata->sample_rate, ==, 44100);
+    g_assert_cmpuint (metadata->channels, ==, 2);
+    g_assert_cmpuint (metadata->total_samples, ==, 0);
+    et_read_session_free (session);
+
+    /* Not a FLAC file. */
+    data = g_string_new ("OggS");
+    append_zeros (data, 8);
+    check_invalid (dir, data);
+
+    /* The first block must be STREAMINFO. */
+    data = g_string_new ("fLaC");
+    append_block_header (data, BLOCK_PADDING, TRUE, 4);
+    append_zeros (data, 4);
+    check_invalid (dir, data);
+
+    /* A STREAMINFO block which is too short. */
+    data = g_string_new ("fLaC");
+    append_block_header (data, BLOCK_STREAMINFO, TRUE, 20);
+    append_zeros (data, 20);
+    check_invalid (dir, data);
+
+    remove_test_file (dir);
+    g_free (dir);
+}
+
+static void
+flac_private_last_block (void)
+{
+    static const gchar * const comments[] = { "TITLE=Title", NULL };
+    gchar *dir;
+    GString *data;
+    EtReadSession *session;
+    EtFlacMetadata *metadata;
+    GError *error = NULL;
+
+    dir = g_dir_make_tmp ("easytag-test-flac-XXXXXX", NULL);
+    g_assert (dir != NULL);
+
+    /* The audio frames after the last block are not parsed as metadata. */
+    data = create_flac (44100, 2, 0, FALSE);
+    append_vorbis_comment (data, TRUE, "vendor", comments);
+    g_string_append_len (data, "\xff\xf8\x69\x18\x00\x00", 6);
+    metadata = read_metadata (dir, data, &session, &error);
+    g_assert_no_error (error);
+    g_assert_cmpuint (metadata->vorbis_comments->len, ==, 1);
+    g_assert_cmpuint (metadata->metadata_len, ==,
+                      34 + 4 + 6 + 4 + 4 + strlen (comments[0]));
+    et_read_session_free (session);
+
+    /* Without the last block flag, the file ends where a block header is
+     * expected. */
+    data = create_flac (44100, 2, 0, FALSE);
+    append_vorbis_comment (data, FALSE, "vendor", comments);
+    check_invalid (dir, data);
+
+    /* A truncated block header. */
+    data = create_flac (44100, 2, 0, FALSE);
+    g_string_append_len (data, "\x84\x00", 2);
+    check_invalid (dir, data);
+
+    /* A block which is longer than the rest of the file. */
+    data = create_flac (44100, 2, 0, FALSE);
+    append_block_header (data, BLOCK_VORBIS_COMMENT, TRUE, 1000);
+    append_le32 (data, 0);
+    append_le32 (data, 0);
+    check_invalid (dir, data);
+
+    /* Skipped blocks are still counted in the metadata length. */
+    data = create_flac (44100, 2, 0, FALSE);
+    append_block_header (data, BLOCK_PADDING, TRUE, 100);
+    append_zeros (data, 100);
+    metadata = read_metadata (dir, data, &session, &error);
+    g_assert_no_error (error);
+    g_assert_cmpuint (metadata->metadata_len, ==, 34 + 100);
+    et_read_session_free (session);
+
+    remove_test_file (dir);
+    g_free (dir);
+}
+
+static void
+flac_private_vorbis_comment (void)
+{
+    static const gchar * const comments[] = { "TITLE=Title", "NOEQUALS", "",
+                                              NULL };
+    static const gchar * const other_comments[] = { "ARTIST=Artist", NULL };
+    gchar *dir;
+    GString *data;
+    EtReadSession *session;
+    EtFlacMetadata *metadata;
+    const FLAC__StreamMetadata_VorbisComment *vc;
+    GError *error = NULL;
+
+    dir = g_dir_make_tmp ("easytag-test-flac-XXXXXX", NULL);
+    g_assert (dir != NULL);
+
+    /* A comment without a separator is kept, for the tag reader to skip. */
+    data = create_flac (44100, 2, 0, FALSE);
+    append_vorbis_comment (data, TRUE, "vendor", comments);
+    metadata = read_metadata (dir, data, &session, &error);
+    g_assert_no_error (error);
+    g_assert_cmpuint (metadata->vorbis_comments->len, ==, 1);
+
+    vc = &g_array_index (metadata->vorbis_comments, EtFlacVorbisComment,
+                         0).comment;
+    g_assert_cmpuint (vc->vendor_string.length, ==, 6);
+    g_assert_cmpstr ((const gchar *)vc->vendor_string.entry, ==, "vendor");
+    g_assert_cmpuint (vc->num_comments, ==, 3);
+    g_assert_cmpuint (vc->comments[0].length, ==, 11);
+    g_assert_cmpstr ((const gchar *)vc->comments[0].entry, ==, "TITLE=Title");
+    g_assert_cmpuint (vc->comments[1].length, ==, 8);
+    g_assert_cmpstr ((const gchar *)vc->comments[1].entry, ==, "NOEQUALS");
+    g_assert_cmpuint (vc->comments[2].length, ==, 0);
+    g_assert_cmpstr ((const gchar *)vc->comments[2].entry, ==, "");
+    et_read_session_free (session);
+
+    /* The comments of a second block are read too, as libFLAC does. */
+    data = create_flac (44100, 2, 0, FALSE);
+    append_vorbis_comment (data, FALSE, "vendor", comments);
+    append_vorbis_comment (data, TRUE, "other", other_comments);
+    metadata = read_metadata (dir, data, &session, &error);
+    g_assert_no_error (error);
+    g_assert_cmpuint (metadata->vorbis_comments->len, ==, 2);
+
+    vc = &g_array_index (metadata->vorbis_comments, EtFlacVorbisComment,
+                         1).comment;
+    g_assert_cmpstr ((const gchar *)vc->vendor_string.entry, ==, "other");
+    g_assert_cmpuint (vc->num_comments, ==, 1);
+    g_assert_cmpstr ((const gchar *)vc->comments[0].entry, ==,
+                     "ARTIST=Artist");
+    et_read_session_free (session);
+
+    /* A vendor string which runs past the block. */
+    data = create_flac (44100, 2, 0, FALSE);
+    append_block_header (data, BLOCK_VORBIS_COMMENT, TRUE, 12);
+    append_le32 (data, 100);
+    g_string_append (data, "vendor");
+    append_zeros (data, 2);
+    check_invalid (dir, data);
+
+    /* A block which ends before the number of comments. */
+    data = create_flac (44100, 2, 0, FALSE);
+    append_block_header (data, BLOCK_VORBIS_COMMENT, TRUE, 6);
+    append_le32 (data, 0);
+    append_zeros (data, 2);
+    check_invalid (dir, data);
+
+    /* More comments than can fit in the block. */
+    data = create_flac (44100, 2, 0, FALSE);
+    append_block_header (data, BLOCK_VORBIS_COMMENT, TRUE, 16);
+    append_le32 (data, 0);
+    append_le32 (data, 1000);
+    append_le32 (data, 0);
+    append_le32 (data, 0);
+    check_invalid (dir, data);
+
+    /* A comment which runs past the block. */
+    data = create_flac (44100, 2, 0, FALSE);
+    append_block_header (data, BLOCK_VORBIS_COMMENT, TRUE, 16);
+    append_le32 (data, 0);
+    append_le32 (data, 1);
+    append_le32 (data, 5);
+    g_string_append (data, "A=B!");
+    check_invalid (dir, data);
+
+    remove_test_file (dir);
+    g_free (dir);
+}
+
+static void
+flac_private_picture (void)
+{
+    static const gchar image[] = "not really a PNG";
+    gchar *dir;
+    GString *data;
+    GString *picture;
+    EtReadSession *session;
+    EtFlacMetadata *metadata;
+    const EtFlacPictureBlock *block;
+    goffset offset;
+    guint32 type;
+    gchar *description;
+    GBytes *bytes;
+    GError *error = NULL;
+
+    dir = g_dir_make_tmp ("easytag-test-flac-XXXXXX", NULL);
+    g_assert (dir != NULL);
+
+    /* Type, MIME type, description, size and colors, and the image. */
+    picture = g_string_new (NULL);
+    append_be32 (picture, 3);
+    append_be32 (picture, strlen ("image/png"));
+    g_string_append (picture, "image/png");
+    append_be32 (picture, strlen ("Cover"));
+    g_string_append (picture, "Cover");
+    append_be32 (picture, 300);
+    append_be32 (picture, 200);
+    append_be32 (picture, 24);
+    append_be32 (picture, 0);
+    append_be32 (picture, strlen (image));
+    g_string_append (picture, image);
+
+    data = create_flac (44100, 2, 0, FALSE);
+    append_block_header (data, BLOCK_PADDING, FALSE, 8);
+    append_zeros (data, 8);
+    append_block_header (data, BLOCK_PICTURE, TRUE, picture->len);
+    offset = data->len;
+    g_string_append_len (data, picture->str, picture->len);
+
+    metadata = read_metadata (dir, data, &session, &error);
+    g_assert_no_error (error);
+    g_assert_cmpuint (metadata->pictures->len, ==, 1);
+
+    /* The block is only located while parsing. */
+    block = &g_array_index (metadata->pictures, EtFlacPictureBlock, 0);
+    g_assert_cmpint (block->offset, ==, offset);
+    g_assert_cmpuint (block->length, ==, picture->len);
+
+    g_assert (et_flac_metadata_read_picture (session, block, &type,
+                                             &description, &bytes, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (type, ==, 3);
+    g_assert_cmpstr (description, ==, "Cover");
+    g_assert_cmpuint (g_bytes_get_size (bytes), ==, strlen (image));
+    g_assert (memcmp (g_bytes_get_data (bytes, NULL), image,
+                      strlen (image)) == 0);
+
+    g_free (description);
+    g_bytes_unref (bytes);
+    et_read_session_free (session);
+
+    /* An image length which runs past the block. */
+    g_string_truncate (picture, picture->len - strlen (image) - 4);
+    append_be32 (picture, 1000);
+    g_string_append (picture, image);
+
+    data = create_flac (44100, 2, 0, FALSE);
+    append_block_header (data, BLOCK_PICTURE, TRUE, picture->len);
+    g_string_append_len (data, picture->str, picture->len);
+
+    metadata = read_metadata (dir, data, &session, &error);
+    g_assert_no_error (error);
+    block = &g_array_index (metadata->pictures, EtFlacPictureBlock, 0);
+    g_assert (!et_flac_metadata_read_picture (session, block, &type,
+                                              &description, &bytes, &error));
+    g_assert_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED);
+    g_clear_error (&error);
+    et_read_session_free (session);
+
+    /* A MIME type length which runs past the block. */
+    data = create_flac (44100, 2, 0, FALSE);
+    append_block_header (data, BLOCK_PICTURE, TRUE, 12);
+    append_be32 (data, 3);
+    append_be32 (data, 1000);
+    g_string_append (data, "imag");
+
+    metadata = read_metadata (dir, data, &session, &error);
+    g_assert_no_error (error);
+    block = &g_array_index (metadata->pictures, EtFlacPictureBlock, 0);
+    g_assert (!et_flac_metadata_read_picture (session, block, &type,
+                                              &description, &bytes, &error));
+    g_assert_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED);
+    g_clear_error (&error);
+    et_read_session_free (session);
+
+    g_string_free (picture, TRUE);
+    remove_test_file (dir);
+    g_free (dir);
+}
+
+#endif /* ENABLE_FLAC */
+
+int
+main (int argc, char** argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+#ifdef ENABLE_FLAC
+    g_test_add_func ("/flac_private/last-block", flac_private_last_block);
+    g_test_add_func ("/flac_private/picture", flac_private_picture);
+    g_test_add_func ("/flac_private/streaminfo", flac_private_streaminfo);
+    g_test_add_func ("/flac_private/vorbis-comment",
+                     flac_private_vorbis_comment);
+#endif /* ENABLE_FLAC */
+
+    return g_test_run ();
+}
@@ -38,12 +38,88 @@ genres_genre_no (void)
     }
 }
 
+static const gsize PERF_ITERATIONS = 100000;
+
+static void
+genres_lookup (void)
+{
+    gsize i;
+
+    /* The sorted index must follow the table. */
+    for (i = 0; i <= GENRE_MAX; i++)
+    {
+        gchar *upper;
+        gchar *lower;
+
+        upper = g_ascii_strup (id3_genres[i], -1);
+        lower = g_ascii_strdown (id3_genres[i], -1);
+
+        g_assert_cmpint (et_genre_lookup (id3_genres[i]), ==, i);
+        g_assert_cmpint (et_genre_lookup (upper), ==, i);
+        g_assert_cmpint (et_genre_lookup (lower), ==, i);
+
+        g_free (upper);
+        g_free (lower);
+    }
+
+    g_assert_cmpint (et_genre_lookup (""), ==, -1);
+    g_assert_cmpint (et_genre_lookup ("Unknown"), ==, -1);
+    g_assert_cmpint (et_genre_lookup ("Rock "), ==, -1);
+    g_assert_cmpint (et_genre_lookup ("EuroDance"), ==, -1);
+}
+
+static void
+genres_parse_reference (void)
+{
+    g_assert_cmpstr (et_genre_parse_reference ("(3)"), ==, "Dance");
+    g_assert_cmpstr (et_genre_parse_reference ("3"), ==, "Dance");
+    g_assert_cmpstr (et_genre_parse_reference ("(3)EuroDance"), ==,
+                     "EuroDance");
+    g_assert_cmpstr (et_genre_parse_reference ("Dance"), ==, "Dance");
+    g_assert_cmpstr (et_genre_parse_reference ("(Dance)"), ==, "(Dance)");
+    g_assert_cmpstr (et_genre_parse_reference ("(3"), ==, "(3");
+    g_assert_cmpstr (et_genre_parse_reference ("(191)"), ==, "Psybient");
+    g_assert (et_genre_parse_reference ("(255)") == NULL);
+    g_assert (et_genre_parse_reference ("-1") == NULL);
+}
+
+static void
+genres_perf_lookup (void)
+{
+    gsize i;
+    gsize j;
+    gdouble time;
+
+    g_test_timer_start ();
+
+    for (i = 0; i < PERF_ITERATIONS; i++)
+    {
+        for (j = 0; j <= GENRE_MAX; j += 16)
+        {
+            g_assert_cmpint (et_genre_lookup (id3_genres[j]), ==, j);
+        }
+
+        g_assert_cmpint (et_genre_lookup ("EuroDance"), ==, -1);
+    }
+
+    time = g_test_timer_elapsed ();
+
+    g_test_minimized_result (time, "%6.1f seconds", time);
+}
+
 int
 main (int argc, char** argv)
 {
     g_test_init (&argc, &argv, NULL);
 
     g_test_add_func ("/genres/genre_no", genres_genre_no);
+    g_test_add_func ("/genres/lookup", genres_lookup);
+    g_test_add_func ("/genres/parse-reference", genres_parse_reference);
+
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/genres/perf/lookup", genres_perf_lookup);
+    }
 
     return g_test_run ();
 }
@@ -0,0 +1,649 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "payload_index.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+
+static const gchar audio[] = "audio frames, which do not change";
+static const gchar other_audio[] = "audio frames of another recording";
+
+static void
+append_be32 (GString *data,
+             guint32 value)
+{
+    g_string_append_c (data, (value >> 24) & 0xff);
+    g_string_append_c (data, (value >> 16) & 0xff);
+    g_string_append_c (data, (value >> 8) & 0xff);
+    g_string_append_c (data, value & 0xff);
+}
+
+static void
+append_le32 (GString *data,
+             guint32 value)
+{
+    g_string_append_c (data, value & 0xff);
+    g_string_append_c (data, (value >> 8) & 0xff);
+    g_string_append_c (data, (value >> 16) & 0xff);
+    g_string_append_c (data, (value >> 24) & 0xff);
+}
+
+static void
+append_zeros (GString *data,
+              gsize count)
+{
+    gsize i;
+
+    for (i = 0; i < count; i++)
+    {
+        g_string_append_c (data, '\0');
+    }
+}
+
+/*
+ * Write @data to a file named @name in @dir, and hash it.
+ */
+static void
+hash_data (const gchar *dir,
+           const gchar *name,
+           GString *data,
+           ET_File_Type type,
+           guint8 *digest)
+{
+    gchar *path;
+    GError *error = NULL;
+
+    path = g_build_filename (dir, name, NULL);
+    g_file_set_contents (path, data->str, data->len, &error);
+    g_assert_no_error (error);
+
+    g_assert (et_payload_hash_file (path, type, digest, &error));
+    g_assert_no_error (error);
+
+    g_remove (path);
+    g_free (path);
+    g_string_free (data, TRUE);
+}
+
+/*
+ * An MP3 file, optionally with an ID3v2 tag, an APEv2 tag with a header, and
+ * an ID3v1 tag.
+ */
+static GString *
+create_tagged (const gchar *payload,
+               gboolean with_tags)
+{
+    GString *data;
+
+    data = g_string_new (NULL);
+
+    if (with_tags)
+    {
+        /* An empty ID3v2.4 tag, with 20 bytes of padding. */
+        g_string_append_len (data, "ID3\x04\x00\x00\x00\x00\x00\x14", 10);
+        append_zeros (data, 20);
+    }
+
+    g_string_append (data, payload);
+
+    if (with_tags)
+    {
+        const guint32 flags[] = { 0xa0000000, 0x80000000 };
+        gsize i;
+
+        /* Header and footer of an empty APEv2 tag. */
+        for (i = 0; i < G_N_ELEMENTS (flags); i++)
+        {
+            g_string_append (data, "APETAGEX");
+            append_le32 (data, 2000);
+            append_le32 (data, 32);
+            append_le32 (data, 0);
+            append_le32 (data, flags[i]);
+            append_zeros (data, 8);
+        }
+
+        g_string_append (data, "TAG");
+        append_zeros (data, 125);
+    }
+
+    return data;
+}
+
+static void
+payload_index_tagged (void)
+{
+    gchar *dir;
+    guint8 bare[ET_PAYLOAD_DIGEST_SIZE];
+    guint8 tagged[ET_PAYLOAD_DIGEST_SIZE];
+    guint8 other[ET_PAYLOAD_DIGEST_SIZE];
+
+    dir = g_dir_make_tmp ("easytag-test-payload-XXXXXX", NULL);
+    g_assert (dir != NULL);
+
+    hash_data (dir, "bare.mp3", create_tagged (audio, FALSE), MP3_FILE, bare);
+    hash_data (dir, "tagged.mp3", create_tagged (audio, TRUE), MP3_FILE,
+               tagged);
+    hash_data (dir, "other.mp3", create_tagged (other_audio, TRUE), MP3_FILE,
+               other);
+
+    g_assert (memcmp (bare, tagged, ET_PAYLOAD_DIGEST_SIZE) == 0);
+    g_assert (memcmp (bare, other, ET_PAYLOAD_DIGEST_SIZE) != 0);
+
+    g_rmdir (dir);
+    g_free (dir);
+}
+
+/*
+ * A FLAC file with a STREAMINFO block, which holds @md5, and a comment block.
+ */
+static GString *
+create_flac (const guint8 *md5,
+             const gchar *comment)
+{
+    GString *data;
+
+    data = g_string_new ("fLaC");
+    append_be32 (data, 34);
+    append_zeros (data, 18);
+    g_string_append_len (data, (const gchar *)md5, ET_PAYLOAD_DIGEST_SIZE);
+    /* Last block, VORBIS_COMMENT. */
+    append_be32 (data, 0x84000000 | strlen (comment));
+    g_string_append (data, comment);
+    g_string_append (data, audio);
+
+    return data;
+}
+
+static void
+payload_index_flac (void)
+{
+    static const guint8 md5[ET_PAYLOAD_DIGEST_SIZE] =
+    {
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+        0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10
+    };
+    static const guint8 unset[ET_PAYLOAD_DIGEST_SIZE] = { 0, };
+    gchar *dir;
+    guint8 digest[ET_PAYLOAD_DIGEST_SIZE];
+    guint8 other[ET_PAYLOAD_DIGEST_SIZE];
+
+    dir = g_dir_make_tmp ("easytag-test-payload-XXXXXX", NULL);
+    g_assert (dir != NULL);
+
+    /* The MD5 of the decoded audio is used as is. */
+    hash_data (dir, "md5.flac", create_flac (md5, "ARTIST=A"), FLAC_FILE,
+               digest);
+    g_assert (memcmp (digest, md5, ET_PAYLOAD_DIGEST_SIZE) == 0);
+
+    /* Otherwise, the frames after the metadata blocks are hashed. */
+    hash_data (dir, "a.flac", create_flac (unset, "ARTIST=A"), FLAC_FILE,
+               digest);
+    hash_data (dir, "b.flac", create_flac (unset, "ARTIST=Another"),
+               FLAC_FILE, other);
+    g_assert (memcmp (digest, other, ET_PAYLOAD_DIGEST_SIZE) == 0);
+    g_assert (memcmp (digest, md5, ET_PAYLOAD_DIGEST_SIZE) != 0);
+
+    g_rmdir (dir);
+    g_free (dir);
+}
+
+/*
+ * Add the lacing values and body of a packet, which may be @complete on this
+ * page or continue on the next one.
+ */
+static void
+add_ogg_packet (GString *lacing,
+                GString *body,
+                const gchar *packet,
+                gsize length,
+                gboolean complete)
+{
+    gsize remaining;
+
+    for (remaining = length; remaining >= 255; remaining -= 255)
+    {
+        g_string_append_c (lacing, (gchar)255);
+    }
+
+    if (complete)
+    {
+        g_string_append_c (lacing, remaining);
+    }
+    else
+    {
+        g_assert_cmpuint (remaining, ==, 0);
+    }
+
+    g_string_append_len (body, packet, length);
+}
+
+/*
+ * Append a page with @lacing and @body to @data, and empty them.
+ */
+static void
+append_ogg_page (GString *data,
+                 guint64 granule,
+                 guint32 sequence,
+                 GString *lacing,
+                 GString *body)
+{
+    g_assert_cmpuint (lacing->len, <=, 255);
+
+    g_string_append_len (data, "OggS\0\0", 6);
+    append_le32 (data, granule & 0xffffffff);
+    append_le32 (data, granule >> 32);
+    /* Serial number, sequence number and checksum. */
+    append_le32 (data, 0x1234);
+    append_le32 (data, sequence);
+    append_le32 (data, g_random_int ());
+    g_string_append_c (data, lacing->len);
+    g_string_append_len (data, lacing->str, lacing->len);
+    g_string_append_len (data, body->str, body->len);
+
+    g_string_truncate (lacing, 0);
+    g_string_truncate (body, 0);
+}
+
+/*
+ * An Ogg file, with an identification header on the first page and a comment
+ * header of @comment_length bytes, which spans several pages if it is long.
+ * Vorbis also has a setup header, on the last page of the comment header.
+ */
+static GString *
+create_ogg (const gchar *identification,
+            gsize comment_length,
+            gboolean with_setup,
+            const gchar *payload)
+{
+    /* Four segments, which do not complete a packet. */
+    const gsize chunk_length = 4 * 255;
+    GString *data;
+    GString *lacing;
+    GString *body;
+    gchar *comment;
+    gsize offset;
+    guint32 sequence = 0;
+
+    data = g_string_new (NULL);
+    lacing = g_string_new (NULL);
+    body = g_string_new (NULL);
+
+    add_ogg_packet (lacing, body, identification, 64, TRUE);
+    append_ogg_page (data, 0, sequence++, lacing, body);
+
+    /* The pages on which no packet is completed have a granule position of
+     * -1. */
+    comment = g_strnfill (comment_length, 'c');
+
+    for (offset = 0; comment_length - offset > chunk_length;
+         offset += chunk_length)
+    {
+        add_ogg_packet (lacing, body, comment + offset, chunk_length, FALSE);
+        append_ogg_page (data, G_MAXUINT64, sequence++, lacing, body);
+    }
+
+    add_ogg_packet (lacing, body, comment + offset, comment_length - offset,
+                    TRUE);
+
+    if (with_setup)
+    {
+        add_ogg_packet (lacing, body, "setup header", 12, TRUE);
+    }
+
+    append_ogg_page (data, 0, sequence++, lacing, body);
+
+    add_ogg_packet (lacing, body, payload, strlen (payload), TRUE);
+    append_ogg_page (data, 1024, sequence++, lacing, body);
+    add_ogg_packet (lacing, body, payload, strlen (payload), TRUE);
+    append_ogg_page (data, 2048, sequence++, lacing, body);
+
+    g_free (comment);
+    g_string_free (body, TRUE);
+    g_string_free (lacing, TRUE);
+
+    return data;
+}
+
+/*
+ * Check that the files with the same audio, but a comment header which spans
+ * a different number of pages, have the same digest, and that different
+ * audio gives a different one.
+ */
+static void
+check_ogg (const gchar *dir,
+           const gchar *identification,
+           gboolean with_setup,
+           ET_File_Type type)
+{
+    guint8 digest[ET_PAYLOAD_DIGEST_SIZE];
+    guint8 longer[ET_PAYLOAD_DIGEST_SIZE];
+    guint8 other[ET_PAYLOAD_DIGEST_SIZE];
+
+    hash_data (dir, "a.ogg",
+               create_ogg (identification, 100, with_setup, audio), type,
+               digest);
+    /* Like cover art in METADATA_BLOCK_PICTURE. */
+    hash_data (dir, "b.ogg",
+               create_ogg (identification, 5000, with_setup, audio), type,
+               longer);
+    hash_data (dir, "c.ogg",
+               create_ogg (identification, 100, with_setup, other_audio),
+               type, other);
+
+    g_assert (memcmp (digest, longer, ET_PAYLOAD_DIGEST_SIZE) == 0);
+    g_assert (memcmp (digest, other, ET_PAYLOAD_DIGEST_SIZE) != 0);
+}
+
+static void
+payload_index_ogg (void)
+{
+    gchar identification[64] = { 0, };
+    gchar *dir;
+
+    dir = g_dir_make_tmp ("easytag-test-payload-XXXXXX", NULL);
+    g_assert (dir != NULL);
+
+    memcpy (identification, "\x01vorbis", 7);
+    check_ogg (dir, identification, TRUE, OGG_FILE);
+
+    memset (identification, 0, sizeof (identification));
+    memcpy (identification, "OpusHead", 8);
+    check_ogg (dir, identification, FALSE, OPUS_FILE);
+
+    /* An unknown codec, for which the header pages are found by their
+     * granule positions. */
+    memset (identification, 0, sizeof (identification));
+    memcpy (identification, "unknown", 7);
+    check_ogg (dir, identification, FALSE, OGG_FILE);
+
+    g_rmdir (dir);
+    g_free (dir);
+}
+
+static void
+append_box (GString *data,
+            const gchar *type,
+            const gchar *contents)
+{
+    append_be32 (data, 8 + strlen (contents));
+    g_string_append (data, type);
+    g_string_append (data, contents);
+}
+
+static void
+payload_index_mp4 (void)
+{
+    gchar *dir;
+    GString *data;
+    guint8 digest[ET_PAYLOAD_DIGEST_SIZE];
+    guint8 moved[ET_PAYLOAD_DIGEST_SIZE];
+    guint8 other[ET_PAYLOAD_DIGEST_SIZE];
+
+    dir = g_dir_make_tmp ("easytag-test-payload-XXXXXX", NULL);
+    g_assert (dir != NULL);
+
+    data = g_string_new (NULL);
+    append_box (data, "ftyp", "M4A ");
+    append_box (data, "moov", "short tags");
+    append_box (data, "mdat", audio);
+    hash_data (dir, "a.m4a", data, MP4_FILE, digest);
+
+    /* The metadata may also follow the audio. */
+    data = g_string_new (NULL);
+    append_box (data, "ftyp", "M4A ");
+    append_box (data, "mdat", audio);
+    append_box (data, "moov", "much longer tags");
+    hash_data (dir, "b.m4a", data, MP4_FILE, moved);
+
+    data = g_string_new (NULL);
+    append_box (data, "ftyp", "M4A ");
+    append_box (data, "moov", "short tags");
+    append_box (data, "mdat", other_audio);
+    hash_data (dir, "c.m4a", data, MP4_FILE, other);
+
+    g_assert (memcmp (digest, moved, ET_PAYLOAD_DIGEST_SIZE) == 0);
+    g_assert (memcmp (digest, other, ET_PAYLOAD_DIGEST_SIZE) != 0);
+
+    g_rmdir (dir);
+    g_free (dir);
+}
+
+static gchar *
+write_file (const gchar *dir,
+            const gchar *name,
+            GString *data)
+{
+    gchar *path;
+    GError *error = NULL;
+
+    path = g_build_filename (dir, name, NULL);
+    g_file_set_contents (path, data->str, data->len, &error);
+    g_assert_no_error (error);
+    g_string_free (data, TRUE);
+
+    return path;
+}
+
+/*
+ * Scan @paths, and check that the files with the same payload are grouped.
+ */
+static void
+check_groups (EtPayloadIndex *index,
+              gchar **paths)
+{
+    EtPayloadScan *scan;
+    EtWorkerJob *job;
+    GList *groups;
+    GList *group;
+    gsize i;
+
+    scan = et_payload_scan_new (index);
+
+    for (i = 0; paths[i] != NULL; i++)
+    {
+        et_payload_scan_add (scan, paths[i], MP3_FILE, GSIZE_TO_POINTER (i));
+    }
+
+    job = et_payload_scan_start (scan, 2);
+
+    while (!et_worker_job_is_finished (job))
+    {
+        g_main_context_iteration (NULL, TRUE);
+    }
+
+    et_payload_scan_wait (scan, FALSE);
+
+    /* The missing file. */
+    g_assert (et_payload_scan_get_error (scan, 0) == NULL);
+    g_assert (et_payload_scan_get_error (scan, 4) != NULL);
+
+    groups = et_payload_scan_get_groups (scan);
+    g_assert_cmpuint (g_list_length (groups), ==, 1);
+
+    group = groups->data;
+    g_assert_cmpuint (g_list_length (group), ==, 3);
+    g_assert_cmpuint (GPOINTER_TO_SIZE (group->data), ==, 0);
+    g_assert_cmpuint (GPOINTER_TO_SIZE (group->next->data), ==, 1);
+    g_assert_cmpuint (GPOINTER_TO_SIZE (group->next->next->data), ==, 3);
+
+    g_list_free (group);
+    g_list_free (groups);
+    et_payload_scan_free (scan);
+}
+
+static void
+payload_index_scan (void)
+{
+    gchar *dir;
+    gchar *paths[6];
+    gchar *index_path;
+    EtPayloadIndex *index;
+    GError *error = NULL;
+    gsize i;
+
+    dir = g_dir_make_tmp ("easytag-test-payload-XXXXXX", NULL);
+    g_assert (dir != NULL);
+
+    paths[0] = write_file (dir, "0.mp3", create_tagged (audio, FALSE));
+    paths[1] = write_file (dir, "1.mp3", create_tagged (audio, TRUE));
+    paths[2] = write_file (dir, "2.mp3", create_tagged (other_audio, TRUE));
+    paths[3] = write_file (dir, "3.mp3", create_tagged (audio, TRUE));
+    paths[4] = g_build_filename (dir, "missing.mp3", NULL);
+    paths[5] = NULL;
+
+    index = et_payload_index_new ();
+    check_groups (index, paths);
+    g_assert_cmpuint (et_payload_index_get_length (index), ==, 4);
+
+    /* The digests are kept in the index file. */
+    index_path = g_build_filename (dir, "cache", "payload-index", NULL);
+    g_assert (et_payload_index_save (index, index_path, &error));
+    g_assert_no_error (error);
+    et_payload_index_free (index);
+
+    index = et_payload_index_new ();
+    g_assert (et_payload_index_load (index, index_path, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (et_payload_index_get_length (index), ==, 4);
+
+    /* The files are found in the index, rather than read again. */
+    check_groups (index, paths);
+    g_assert_cmpuint (et_payload_index_get_length (index), ==, 4);
+    et_payload_index_free (index);
+
+    for (i = 0; paths[i] != NULL; i++)
+    {
+        g_remove (paths[i]);
+        g_free (paths[i]);
+    }
+
+    g_remove (index_path);
+    g_free (index_path);
+    index_path = g_build_filename (dir, "cache", NULL);
+    g_rmdir (index_path);
+    g_free (index_path);
+    g_rmdir (dir);
+    g_free (dir);
+}
+
+/*
+ * Scan @paths, without checking the results.
+ */
+static void
+scan_files (EtPayloadIndex *index,
+            gchar **paths)
+{
+    EtPayloadScan *scan;
+    gsize i;
+
+    scan = et_payload_scan_new (index);
+
+    for (i = 0; paths[i] != NULL; i++)
+    {
+        et_payload_scan_add (scan, paths[i], MP3_FILE, NULL);
+    }
+
+    et_payload_scan_start (scan, 2);
+    et_payload_scan_wait (scan, FALSE);
+    et_payload_scan_free (scan);
+}
+
+static void
+payload_index_prune (void)
+{
+    gchar *dir;
+    gchar *paths[4];
+    gchar *scanned[2];
+    gchar *index_path;
+    gchar *contents;
+    EtPayloadIndex *index;
+    GError *error = NULL;
+    gsize i;
+
+    dir = g_dir_make_tmp ("easytag-test-payload-XXXXXX", NULL);
+    g_assert (dir != NULL);
+
+    paths[0] = write_file (dir, "0.mp3", create_tagged (audio, FALSE));
+    paths[1] = write_file (dir, "1.mp3", create_tagged (audio, TRUE));
+    paths[2] = write_file (dir, "2.mp3", create_tagged (other_audio, TRUE));
+    paths[3] = NULL;
+
+    /* An entry in a directory which is not scanned, and which may be on a
+     * disk which is not mounted. */
+    index_path = g_build_filename (dir, "payload-index", NULL);
+    contents = g_strconcat ("EasyTAG payload index 2\n",
+                            "000102030405060708090a0b0c0d0e0f 1 2 ",
+                            dir, "-unmounted", G_DIR_SEPARATOR_S, "0.mp3\n",
+                            NULL);
+    g_file_set_contents (index_path, contents, -1, &error);
+    g_assert_no_error (error);
+    g_free (contents);
+
+    index = et_payload_index_new ();
+    g_assert (et_payload_index_load (index, index_path, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (et_payload_index_get_length (index), ==, 1);
+
+    scan_files (index, paths);
+    g_assert_cmpuint (et_payload_index_get_length (index), ==, 4);
+
+    /* The entry of a removed file in a scanned directory is dropped, but not
+     * the entry of a file which was not scanned, but still exists. */
+    g_assert_cmpint (g_remove (paths[1]), ==, 0);
+    scanned[0] = paths[0];
+    scanned[1] = NULL;
+    scan_files (index, scanned);
+    g_assert_cmpuint (et_payload_index_get_length (index), ==, 3);
+
+    g_assert_cmpint (g_remove (paths[2]), ==, 0);
+    scan_files (index, scanned);
+    g_assert_cmpuint (et_payload_index_get_length (index), ==, 2);
+
+    /* A scanned file which was removed. */
+    g_assert_cmpint (g_remove (paths[0]), ==, 0);
+    scan_files (index, scanned);
+    g_assert_cmpuint (et_payload_index_get_length (index), ==, 1);
+
+    et_payload_index_free (index);
+
+    for (i = 0; paths[i] != NULL; i++)
+    {
+        g_free (paths[i]);
+    }
+
+    g_remove (index_path);
+    g_free (index_path);
+    g_rmdir (dir);
+    g_free (dir);
+}
+
+int
+main (int argc, char** argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/payload-index/flac", payload_index_flac);
+    g_test_add_func ("/payload-index/mp4", payload_index_mp4);
+    g_test_add_func ("/payload-index/ogg", payload_index_ogg);
+    g_test_add_func ("/payload-index/prune", payload_index_prune);
+    g_test_add_func ("/payload-index/scan", payload_index_scan);
+    g_test_add_func ("/payload-index/tagged", payload_index_tagged);
+
+    return g_test_run ();
+}
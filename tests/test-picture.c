@@ -17,6 +17,7 @@
  */
 
 #include "picture.h"
+#include "picture_probe.h"
 
 #include <gtk/gtk.h>
 #include <string.h>
@@ -233,6 +234,139 @@ picture_format_from_data (void)
     }
 }
 
+static void
+picture_probe (void)
+{
+    gsize i;
+
+    static const struct
+    {
+        const gchar *data;
+        gsize size;
+        Picture_Format format;
+        gboolean result;
+        guint width;
+        guint height;
+        guint depth;
+        guint colors;
+    } pictures[] =
+    {
+        /* PNG, RGB. */
+        { "\x89PNG\x0d\x0a\x1a\x0a\x00\x00\x00\x0dIHDR\x00\x00\x02\x80"
+          "\x00\x00\x01\xe0\x08\x02\x00\x00\x00\xba\xb3K\xb3\x00\x00"
+          "\x00\x00IDAT",
+          41, PICTURE_FORMAT_PNG, TRUE, 640, 480, 24, 0 },
+        /* PNG, 16-bit RGBA. */
+        { "\x89PNG\x0d\x0a\x1a\x0a\x00\x00\x00\x0dIHDR\x00\x00\x00\x01"
+          "\x00\x00\x00\x01\x10\x06\x00\x00\x00O\x85\x18\xca",
+          33, PICTURE_FORMAT_PNG, TRUE, 1, 1, 64, 0 },
+        /* PNG, indexed, palette after another chunk. */
+        { "\x89PNG\x0d\x0a\x1a\x0a\x00\x00\x00\x0dIHDR\x00\x00\x00\x10"
+          "\x00\x00\x00\x10\x04\x03\x00\x00\x01\x9a\xda\xd2\xc4\x00"
+          "\x00\x00\x04gAMA\x00\x00\xb1\x8f\x0b\xfc" "a\x05\x00\x00"
+          "\x00" "0PLTE",
+          57, PICTURE_FORMAT_PNG, TRUE, 16, 16, 4, 16 },
+        /* GIF, global colour table. */
+        { "GIF89a,\x01\xc8\x00\xf7\x00\x00",
+          13, PICTURE_FORMAT_GIF, TRUE, 300, 200, 8, 256 },
+        /* GIF, no global colour table. */
+        { "GIF87a\x01\x00\x01\x00\x00\x00\x00,",
+          14, PICTURE_FORMAT_GIF, TRUE, 1, 1, 1, 0 },
+        /* JPEG, JFIF. */
+        { "\xff\xd8\xff\xe0\x00\x10JFIF\x00\x01\x01\x00\x00\x01\x00"
+          "\x01\x00\x00\xff\xc0\x00\x11\x08\x01\xe0\x02\x80\x03\x01"
+          "\x22\x00\x02\x11\x01\x03\x11\x01",
+          39, PICTURE_FORMAT_JPEG, TRUE, 640, 480, 24, 0 },
+        /* JPEG, progressive greyscale, Exif and fill bytes. */
+        { "\xff\xd8\xff\xe1\x00\x08" "Exif\x00\x00\xff\xff\xff\xc2\x00"
+          "\x0b\x08\x04\xb0\x06\x40\x01\x01\x11\x00",
+          27, PICTURE_FORMAT_JPEG, TRUE, 1600, 1200, 8, 0 },
+        /* JPEG, start of scan before frame header. */
+        { "\xff\xd8\xff\xe0\x00\x10JFIF\x00\x01\x01\x00\x00\x01\x00"
+          "\x01\x00\x00\xff\xda\x00\x08\x00\x00\x00\x00\x00\x00",
+          30, PICTURE_FORMAT_JPEG, FALSE, 0, 0, 0, 0 },
+        /* BMP, top-down. */
+        { "BM6\x84\x03\x00\x00\x00\x00\x00" "6\x00\x00\x00\x28\x00\x00"
+          "\x00\x40\x01\x00\x00\x10\xff\xff\xff\x01\x00\x18\x00\x00"
+          "\x00\x00\x00\x00\x00\x00\x00\x13\x0b\x00\x00\x13\x0b\x00"
+          "\x00\x00\x00\x00\x00\x00\x00\x00\x00",
+          54, PICTURE_FORMAT_BMP, TRUE, 320, 240, 24, 0 },
+        /* BMP, indexed. */
+        { "BM\x00\x00\x00\x00\x00\x00\x00\x00" "6\x04\x00\x00\x28\x00"
+          "\x00\x00\x40\x00\x00\x00\x40\x00\x00\x00\x01\x00\x08\x00"
+          "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+          "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00",
+          54, PICTURE_FORMAT_BMP, TRUE, 64, 64, 8, 256 },
+        /* BMP, OS/2 header. */
+        { "BM\x00\x00\x00\x00\x00\x00\x00\x00 \x00\x00\x00\x0c\x00\x00"
+          "\x00 \x00\x10\x00\x01\x00\x01\x00",
+          26, PICTURE_FORMAT_BMP, TRUE, 32, 16, 1, 2 },
+        /* WebP, lossy. */
+        { "RIFF\xc8\x00\x00\x00WEBPVP8 d\x00\x00\x00P\x02\x00\x9d\x01"
+          "\x2a\x26\x02p\x01",
+          30, PICTURE_FORMAT_WEBP, TRUE, 550, 368, 24, 0 },
+        /* WebP, lossless with alpha. */
+        { "RIFF\xc8\x00\x00\x00WEBPVP8Ld\x00\x00\x00\x2f\x8f\x01K\x10"
+          "\x00",
+          26, PICTURE_FORMAT_WEBP, TRUE, 400, 301, 32, 0 },
+        /* WebP, extended. */
+        { "RIFF\xc8\x00\x00\x00WEBPVP8X\x0a\x00\x00\x00\x10\x00\x00"
+          "\x00\x7f\x07\x00" "7\x04\x00",
+          30, PICTURE_FORMAT_WEBP, TRUE, 1920, 1080, 32, 0 },
+        /* Unknown. */
+        { "foobar baz",
+          10, PICTURE_FORMAT_UNKNOWN, FALSE, 0, 0, 0, 0 }
+    };
+
+    for (i = 0; i < G_N_ELEMENTS (pictures); i++)
+    {
+        EtPictureInfo info;
+        gsize j;
+
+        g_assert (et_picture_probe (pictures[i].data, pictures[i].size, &info)
+                  == pictures[i].result);
+        g_assert_cmpint (info.format, ==, pictures[i].format);
+        g_assert_cmpuint (info.width, ==, pictures[i].width);
+        g_assert_cmpuint (info.height, ==, pictures[i].height);
+        g_assert_cmpuint (info.depth, ==, pictures[i].depth);
+        g_assert_cmpuint (info.colors, ==, pictures[i].colors);
+
+        /* Truncated headers must not be read past the end. */
+        for (j = 0; j < pictures[i].size; j++)
+        {
+            gchar *data = g_memdup (pictures[i].data, j);
+
+            et_picture_probe (data, j, &info);
+            g_free (data);
+        }
+    }
+}
+
+static void
+picture_new_probe (void)
+{
+    static const gchar png[] = "\x89PNG\x0d\x0a\x1a\x0a\x00\x00\x00\x0dIHDR"
+                               "\x00\x00\x02\x80\x00\x00\x01\xe0\x08\x02"
+                               "\x00\x00\x00";
+    GBytes *bytes;
+    EtPicture *pic;
+
+    bytes = g_bytes_new_static (png, sizeof (png) - 1);
+
+    /* Unknown dimensions are read from the header. */
+    pic = et_picture_new (ET_PICTURE_TYPE_FRONT_COVER, "", 0, 0, bytes);
+    g_assert_cmpint (pic->width, ==, 640);
+    g_assert_cmpint (pic->height, ==, 480);
+    et_picture_free (pic);
+
+    pic = et_picture_new (ET_PICTURE_TYPE_FRONT_COVER, "", 320, 240, bytes);
+    g_assert_cmpint (pic->width, ==, 320);
+    g_assert_cmpint (pic->height, ==, 240);
+    et_picture_free (pic);
+
+    g_bytes_unref (bytes);
+}
+
 int
 main (int argc, char** argv)
 {
@@ -241,6 +375,8 @@ main (int argc, char** argv)
     g_test_add_func ("/picture/copy", picture_copy);
     g_test_add_func ("/picture/difference", picture_difference);
     g_test_add_func ("/picture/format-from-data", picture_format_from_data);
+    g_test_add_func ("/picture/new-probe", picture_new_probe);
+    g_test_add_func ("/picture/probe", picture_probe);
     g_test_add_func ("/picture/type-from-filename",
                      picture_type_from_filename);
 
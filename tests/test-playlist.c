@@ -0,0 +1,257 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "playlist.h"
+
+#include <glib/gstdio.h>
+
+typedef struct
+{
+    const gchar *filename;
+    gint duration;
+    const gchar *title;
+} Entry;
+
+static const Entry entries[] =
+{
+    { "/music/album/01 One.mp3", 61, NULL },
+    { "/music/album/cd2/02 Two.ogg", 122, "Artist & Band - Two" },
+    { "/elsewhere/03 Three.flac", 183, NULL }
+};
+
+/*
+ * Write the entries to a playlist in a temporary directory, and return the
+ * content of the playlist.
+ */
+static gchar *
+write_entries (EtPlaylistFormat format,
+               EtPlaylistContent content,
+               const gchar *basedir,
+               gboolean dos_separator)
+{
+    gchar *dir;
+    gchar *path;
+    GFile *file;
+    EtPlaylistWriter *writer;
+    gchar *contents;
+    gsize i;
+    GError *error = NULL;
+
+    dir = g_dir_make_tmp ("easytag-test-playlist-XXXXXX", NULL);
+    g_assert (dir != NULL);
+    path = g_build_filename (dir, "playlist", NULL);
+    file = g_file_new_for_path (path);
+
+    writer = et_playlist_writer_new (file, format, content, basedir,
+                                     dos_separator, &error);
+    g_assert_no_error (error);
+
+    for (i = 0; i < G_N_ELEMENTS (entries); i++)
+    {
+        g_assert (et_playlist_writer_add (writer, entries[i].filename,
+                                          entries[i].duration,
+                                          entries[i].title, &error));
+        g_assert_no_error (error);
+    }
+
+    g_assert (et_playlist_writer_close (writer, &error));
+    g_assert_no_error (error);
+    et_playlist_writer_free (writer);
+
+    g_file_get_contents (path, &contents, NULL, &error);
+    g_assert_no_error (error);
+
+    g_remove (path);
+    g_rmdir (dir);
+    g_object_unref (file);
+    g_free (path);
+    g_free (dir);
+
+    return contents;
+}
+
+static void
+playlist_m3u (void)
+{
+    gchar *contents;
+
+    contents = write_entries (ET_PLAYLIST_FORMAT_M3U,
+                              ET_PLAYLIST_CONTENT_FILENAMES, NULL, FALSE);
+    g_assert_cmpstr (contents, ==,
+                     "/music/album/01 One.mp3\r\n"
+                     "/music/album/cd2/02 Two.ogg\r\n"
+                     "/elsewhere/03 Three.flac\r\n");
+    g_free (contents);
+
+    contents = write_entries (ET_PLAYLIST_FORMAT_M3U,
+                              ET_PLAYLIST_CONTENT_EXTENDED, NULL, FALSE);
+    g_assert_cmpstr (contents, ==,
+                     "#EXTM3U\r\n"
+                     "#EXTINF:61,01 One.mp3\r\n"
+                     "/music/album/01 One.mp3\r\n"
+                     "#EXTINF:122,Artist & Band - Two\r\n"
+                     "/music/album/cd2/02 Two.ogg\r\n"
+                     "#EXTINF:183,03 Three.flac\r\n"
+                     "/elsewhere/03 Three.flac\r\n");
+    g_free (contents);
+}
+
+static void
+playlist_relative (void)
+{
+    gchar *contents;
+
+    /* Files outside the base directory are skipped. */
+    contents = write_entries (ET_PLAYLIST_FORMAT_M3U8,
+                              ET_PLAYLIST_CONTENT_FILENAMES, "/music/album",
+                              FALSE);
+    g_assert_cmpstr (contents, ==, "01 One.mp3\r\ncd2/02 Two.ogg\r\n");
+    g_free (contents);
+
+    contents = write_entries (ET_PLAYLIST_FORMAT_M3U,
+                              ET_PLAYLIST_CONTENT_FILENAMES, "/music/", TRUE);
+    g_assert_cmpstr (contents, ==,
+                     "album\\01 One.mp3\r\nalbum\\cd2\\02 Two.ogg\r\n");
+    g_free (contents);
+
+    /* A directory with a name which starts like the base directory is not
+     * below it. */
+    contents = write_entries (ET_PLAYLIST_FORMAT_M3U,
+                              ET_PLAYLIST_CONTENT_FILENAMES, "/music/alb",
+                              FALSE);
+    g_assert_cmpstr (contents, ==, "");
+    g_free (contents);
+}
+
+static void
+playlist_pls (void)
+{
+    gchar *contents;
+
+    contents = write_entries (ET_PLAYLIST_FORMAT_PLS,
+                              ET_PLAYLIST_CONTENT_EXTENDED, "/music", FALSE);
+    g_assert_cmpstr (contents, ==,
+                     "[playlist]\r\n"
+                     "File1=album/01 One.mp3\r\n"
+                     "Title1=01 One.mp3\r\n"
+                     "Length1=61\r\n"
+                     "File2=album/cd2/02 Two.ogg\r\n"
+                     "Title2=Artist & Band - Two\r\n"
+                     "Length2=122\r\n"
+                     "NumberOfEntries=2\r\n"
+                     "Version=2\r\n");
+    g_free (contents);
+}
+
+static void
+playlist_xspf (void)
+{
+    gchar *contents;
+
+    contents = write_entries (ET_PLAYLIST_FORMAT_XSPF,
+                              ET_PLAYLIST_CONTENT_EXTENDED, NULL, TRUE);
+    g_assert_cmpstr (contents, ==,
+                     "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                     "<playlist version=\"1\" xmlns=\"http://xspf.org/ns/0/\">\n"
+                     "  <trackList>\n"
+                     "    <track>\n"
+                     "      <location>file:///music/album/01%20One.mp3</location>\n"
+                     "      <title>01 One.mp3</title>\n"
+                     "      <duration>61000</duration>\n"
+                     "    </track>\n"
+                     "    <track>\n"
+                     "      <location>file:///music/album/cd2/02%20Two.ogg</location>\n"
+                     "      <title>Artist &amp; Band - Two</title>\n"
+                     "      <duration>122000</duration>\n"
+                     "    </track>\n"
+                     "    <track>\n"
+                     "      <location>file:///elsewhere/03%20Three.flac</location>\n"
+                     "      <title>03 Three.flac</title>\n"
+                     "      <duration>183000</duration>\n"
+                     "    </track>\n"
+                     "  </trackList>\n"
+                     "</playlist>\n");
+    g_free (contents);
+}
+
+static const gsize PERF_ENTRIES = 1000000;
+
+static void
+playlist_perf_write (void)
+{
+    gchar *dir;
+    gchar *path;
+    GFile *file;
+    EtPlaylistWriter *writer;
+    gsize i;
+    gdouble time;
+    GError *error = NULL;
+
+    dir = g_dir_make_tmp ("easytag-test-playlist-XXXXXX", NULL);
+    g_assert (dir != NULL);
+    path = g_build_filename (dir, "playlist.m3u", NULL);
+    file = g_file_new_for_path (path);
+
+    g_test_timer_start ();
+
+    writer = et_playlist_writer_new (file, ET_PLAYLIST_FORMAT_M3U,
+                                     ET_PLAYLIST_CONTENT_EXTENDED, "/music",
+                                     FALSE, &error);
+    g_assert_no_error (error);
+
+    for (i = 0; i < PERF_ENTRIES; i++)
+    {
+        const Entry *entry = &entries[i % G_N_ELEMENTS (entries)];
+
+        g_assert (et_playlist_writer_add (writer, entry->filename,
+                                          entry->duration, entry->title,
+                                          &error));
+    }
+
+    g_assert (et_playlist_writer_close (writer, &error));
+    g_assert_no_error (error);
+    et_playlist_writer_free (writer);
+
+    time = g_test_timer_elapsed ();
+
+    g_test_minimized_result (time, "%6.1f seconds", time);
+
+    g_remove (path);
+    g_rmdir (dir);
+    g_object_unref (file);
+    g_free (path);
+    g_free (dir);
+}
+
+int
+main (int argc, char** argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/playlist/m3u", playlist_m3u);
+    g_test_add_func ("/playlist/relative", playlist_relative);
+    g_test_add_func ("/playlist/pls", playlist_pls);
+    g_test_add_func ("/playlist/xspf", playlist_xspf);
+
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/playlist/perf/write", playlist_perf_write);
+    }
+
+    return g_test_run ();
+}
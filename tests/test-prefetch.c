@@ -0,0 +1,237 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "prefetch.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include "read_session.h"
+
+/* Large enough for both the head and the tail of the read session. */
+static const gsize FILE_SIZE = 256 * 1024;
+static const guint PERF_FILES = 200;
+
+static GList *
+create_files (const gchar *dir,
+              guint n_files)
+{
+    GList *files = NULL;
+    gchar *contents;
+    guint i;
+
+    contents = g_malloc (FILE_SIZE);
+    memset (contents, 'x', FILE_SIZE);
+
+    for (i = 0; i < n_files; i++)
+    {
+        gchar *basename;
+        gchar *path;
+        GError *error = NULL;
+
+        basename = g_strdup_printf ("%04u.mp3", i);
+        path = g_build_filename (dir, basename, NULL);
+        g_file_set_contents (path, contents, FILE_SIZE, &error);
+        g_assert_no_error (error);
+
+        files = g_list_prepend (files, g_file_new_for_path (path));
+
+        g_free (path);
+        g_free (basename);
+    }
+
+    g_free (contents);
+
+    return g_list_reverse (files);
+}
+
+static void
+delete_files (const gchar *dir,
+              GList *files)
+{
+    GList *l;
+
+    for (l = files; l != NULL; l = g_list_next (l))
+    {
+        g_file_delete (G_FILE (l->data), NULL, NULL);
+    }
+
+    g_list_free_full (files, g_object_unref);
+    g_rmdir (dir);
+}
+
+/* Read the regions of a file which the tag and header readers look at. */
+static void
+load_file (GFile *file)
+{
+    EtReadSession *session;
+    GFileInputStream *istream;
+    guchar buffer[128];
+    gsize bytes_read;
+    GError *error = NULL;
+
+    session = et_read_session_new (file, &error);
+    g_assert_no_error (error);
+    g_assert_cmpint (et_read_session_get_size (session), ==, FILE_SIZE);
+
+    istream = et_read_session_open_stream (session);
+
+    g_input_stream_read_all (G_INPUT_STREAM (istream), buffer,
+                             sizeof (buffer), &bytes_read, NULL, &error);
+    g_assert_no_error (error);
+    g_assert_cmpuint (bytes_read, ==, sizeof (buffer));
+    g_assert_cmpint (buffer[0], ==, 'x');
+
+    g_seekable_seek (G_SEEKABLE (istream), -(goffset)sizeof (buffer),
+                     G_SEEK_END, NULL, &error);
+    g_assert_no_error (error);
+    g_input_stream_read_all (G_INPUT_STREAM (istream), buffer,
+                             sizeof (buffer), &bytes_read, NULL, &error);
+    g_assert_no_error (error);
+    g_assert_cmpuint (bytes_read, ==, sizeof (buffer));
+    g_assert_cmpint (buffer[sizeof (buffer) - 1], ==, 'x');
+
+    g_object_unref (istream);
+    et_read_session_free (session);
+}
+
+static void
+load_files (GList *files,
+            guint depth,
+            guint stop_at)
+{
+    EtPrefetch *prefetch;
+    GList *l;
+    guint i;
+
+    prefetch = et_prefetch_new (files, depth);
+
+    for (l = files, i = 0; l != NULL && i < stop_at; l = g_list_next (l), i++)
+    {
+        et_prefetch_advance (prefetch, i);
+        load_file (G_FILE (l->data));
+    }
+
+    et_prefetch_free (prefetch);
+}
+
+static void
+prefetch_depth (void)
+{
+    gchar *dir;
+    GList *files;
+    gsize i;
+
+    static const guint depths[] = { 0, 1, 4, 64 };
+
+    dir = g_dir_make_tmp ("easytag-test-prefetch-XXXXXX", NULL);
+    g_assert (dir != NULL);
+    files = create_files (dir, 10);
+
+    for (i = 0; i < G_N_ELEMENTS (depths); i++)
+    {
+        load_files (files, depths[i], G_MAXUINT);
+    }
+
+    delete_files (dir, files);
+    g_free (dir);
+}
+
+static void
+prefetch_stop (void)
+{
+    gchar *dir;
+    GList *files;
+
+    dir = g_dir_make_tmp ("easytag-test-prefetch-XXXXXX", NULL);
+    g_assert (dir != NULL);
+    files = create_files (dir, 10);
+
+    /* As when the user stops the loading, the worker must not outlive the
+     * prefetcher. */
+    load_files (files, 4, 3);
+    load_files (files, 4, 0);
+
+    delete_files (dir, files);
+    g_free (dir);
+}
+
+static void
+prefetch_missing (void)
+{
+    GList *files = NULL;
+    EtPrefetch *prefetch;
+
+    /* Files which cannot be opened are skipped. */
+    files = g_list_prepend (files,
+                            g_file_new_for_path ("/nonexistent/easytag.mp3"));
+    files = g_list_prepend (files,
+                            g_file_new_for_uri ("http://example.com/a.mp3"));
+
+    prefetch = et_prefetch_new (files, 4);
+    et_prefetch_advance (prefetch, 0);
+    et_prefetch_advance (prefetch, 1);
+    et_prefetch_free (prefetch);
+
+    g_list_free_full (files, g_object_unref);
+}
+
+static void
+prefetch_perf_load (gconstpointer user_data)
+{
+    gchar *dir;
+    GList *files;
+    gdouble time;
+
+    dir = g_dir_make_tmp ("easytag-test-prefetch-XXXXXX", NULL);
+    g_assert (dir != NULL);
+    files = create_files (dir, PERF_FILES);
+
+    /* The files were just written, so this measures the overhead of the
+     * prefetch stage on a warm cache rather than the latency it hides. */
+    g_test_timer_start ();
+
+    load_files (files, GPOINTER_TO_UINT (user_data), G_MAXUINT);
+
+    time = g_test_timer_elapsed ();
+
+    g_test_minimized_result (time, "%6.3f seconds", time);
+
+    delete_files (dir, files);
+    g_free (dir);
+}
+
+int
+main (int argc, char** argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/prefetch/depth", prefetch_depth);
+    g_test_add_func ("/prefetch/stop", prefetch_stop);
+    g_test_add_func ("/prefetch/missing", prefetch_missing);
+
+    if (g_test_perf ())
+    {
+        g_test_add_data_func ("/prefetch/perf/load-depth-0",
+                              GUINT_TO_POINTER (0), prefetch_perf_load);
+        g_test_add_data_func ("/prefetch/perf/load-depth-8",
+                              GUINT_TO_POINTER (8), prefetch_perf_load);
+    }
+
+    return g_test_run ();
+}
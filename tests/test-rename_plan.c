@@ -0,0 +1,439 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "rename_plan.h"
+
+#include <glib/gstdio.h>
+
+/*
+ * Create a file in @dir, containing its own name.
+ */
+static gchar *
+create_file (const gchar *dir,
+             const gchar *name)
+{
+    gchar *path;
+    GError *error = NULL;
+
+    path = g_build_filename (dir, name, NULL);
+    g_file_set_contents (path, name, -1, &error);
+    g_assert_no_error (error);
+
+    return path;
+}
+
+/*
+ * Check that the file at @name in @dir contains @contents.
+ */
+static void
+check_file (const gchar *dir,
+            const gchar *name,
+            const gchar *contents)
+{
+    gchar *path;
+    gchar *actual;
+    GError *error = NULL;
+
+    path = g_build_filename (dir, name, NULL);
+    g_file_get_contents (path, &actual, NULL, &error);
+    g_assert_no_error (error);
+    g_assert_cmpstr (actual, ==, contents);
+
+    g_free (actual);
+    g_free (path);
+}
+
+static void
+add_rename (EtRenamePlan *plan,
+            const gchar *dir,
+            const gchar *old_name,
+            const gchar *new_name)
+{
+    gchar *old_path;
+    gchar *new_path;
+
+    old_path = g_build_filename (dir, old_name, NULL);
+    new_path = g_build_filename (dir, new_name, NULL);
+    et_rename_plan_add (plan, old_path, new_path, NULL);
+    g_free (old_path);
+    g_free (new_path);
+}
+
+static void
+count_failures (const gchar *old_path,
+                const gchar *new_path,
+                const GError *error,
+                gpointer data,
+                gpointer user_data)
+{
+    if (error)
+    {
+        (*(guint *)user_data)++;
+    }
+}
+
+/*
+ * Remove the temporary directory and everything in it.
+ */
+static void
+remove_tree (const gchar *path)
+{
+    GDir *dir;
+
+    dir = g_dir_open (path, 0, NULL);
+
+    if (dir)
+    {
+        const gchar *name;
+
+        while ((name = g_dir_read_name (dir)) != NULL)
+        {
+            gchar *child = g_build_filename (path, name, NULL);
+
+            remove_tree (child);
+            g_free (child);
+        }
+
+        g_dir_close (dir);
+        g_rmdir (path);
+    }
+    else
+    {
+        g_remove (path);
+    }
+}
+
+static void
+rename_plan_directories (void)
+{
+    gchar *dir;
+    EtRenamePlan *plan;
+    gsize i;
+
+    static const gchar * const names[][2] =
+    {
+        { "1", "artist/album/01 one" },
+        { "2", "artist/album/02 two" },
+        { "3", "artist/other/01 three" }
+    };
+
+    dir = g_dir_make_tmp ("easytag-test-rename-XXXXXX", NULL);
+    g_assert (dir != NULL);
+    plan = et_rename_plan_new ();
+
+    for (i = 0; i < G_N_ELEMENTS (names); i++)
+    {
+        g_free (create_file (dir, names[i][0]));
+        add_rename (plan, dir, names[i][0], names[i][1]);
+    }
+
+    g_assert_cmpuint (et_rename_plan_get_length (plan), ==, 3);
+    g_assert (et_rename_plan_execute (plan));
+
+    for (i = 0; i < G_N_ELEMENTS (names); i++)
+    {
+        check_file (dir, names[i][1], names[i][0]);
+    }
+
+    et_rename_plan_free (plan);
+    remove_tree (dir);
+    g_free (dir);
+}
+
+static void
+rename_plan_cycles (void)
+{
+    gchar *dir;
+    EtRenamePlan *plan;
+
+    dir = g_dir_make_tmp ("easytag-test-rename-XXXXXX", NULL);
+    g_assert (dir != NULL);
+    g_free (create_file (dir, "a"));
+    g_free (create_file (dir, "b"));
+    g_free (create_file (dir, "c"));
+    g_free (create_file (dir, "d"));
+    g_free (create_file (dir, "e"));
+
+    plan = et_rename_plan_new ();
+
+    /* Swap two files. */
+    add_rename (plan, dir, "a", "b");
+    add_rename (plan, dir, "b", "a");
+
+    /* Rotate three files. */
+    add_rename (plan, dir, "c", "d");
+    add_rename (plan, dir, "d", "e");
+    add_rename (plan, dir, "e", "c");
+
+    g_assert_cmpuint (et_rename_plan_check (plan), ==, 0);
+    g_assert (et_rename_plan_execute (plan));
+
+    check_file (dir, "a", "b");
+    check_file (dir, "b", "a");
+    check_file (dir, "c", "e");
+    check_file (dir, "d", "c");
+    check_file (dir, "e", "d");
+
+    et_rename_plan_free (plan);
+    remove_tree (dir);
+    g_free (dir);
+}
+
+static void
+rename_plan_chain (void)
+{
+    gchar *dir;
+    EtRenamePlan *plan;
+    gsize i;
+
+    dir = g_dir_make_tmp ("easytag-test-rename-XXXXXX", NULL);
+    g_assert (dir != NULL);
+    plan = et_rename_plan_new ();
+
+    /* Renumbering shifts each file onto the name of the next. */
+    for (i = 1; i <= 100; i++)
+    {
+        gchar *old_name = g_strdup_printf ("%03" G_GSIZE_FORMAT, i);
+        gchar *new_name = g_strdup_printf ("%03" G_GSIZE_FORMAT, i + 1);
+
+        g_free (create_file (dir, old_name));
+        add_rename (plan, dir, old_name, new_name);
+
+        g_free (old_name);
+        g_free (new_name);
+    }
+
+    g_assert (et_rename_plan_execute (plan));
+
+    for (i = 2; i <= 101; i++)
+    {
+        gchar *name = g_strdup_printf ("%03" G_GSIZE_FORMAT, i);
+        gchar *contents = g_strdup_printf ("%03" G_GSIZE_FORMAT, i - 1);
+
+        check_file (dir, name, contents);
+
+        g_free (name);
+        g_free (contents);
+    }
+
+    et_rename_plan_free (plan);
+    remove_tree (dir);
+    g_free (dir);
+}
+
+static void
+rename_plan_conflicts (void)
+{
+    gchar *dir;
+    EtRenamePlan *plan;
+    guint n_failures = 0;
+
+    dir = g_dir_make_tmp ("easytag-test-rename-XXXXXX", NULL);
+    g_assert (dir != NULL);
+    g_free (create_file (dir, "a"));
+    g_free (create_file (dir, "b"));
+    g_free (create_file (dir, "c"));
+    g_free (create_file (dir, "d"));
+    g_free (create_file (dir, "e"));
+
+    plan = et_rename_plan_new ();
+
+    /* Two files renamed to the same name. */
+    add_rename (plan, dir, "a", "x");
+    add_rename (plan, dir, "b", "x");
+    /* A file which is not renamed is in the way. */
+    add_rename (plan, dir, "c", "e");
+    /* The file in the way is itself blocked. */
+    add_rename (plan, dir, "d", "c");
+
+    g_assert_cmpuint (et_rename_plan_check (plan), ==, 3);
+
+    /* Nothing is touched by checking. */
+    check_file (dir, "a", "a");
+    check_file (dir, "c", "c");
+    check_file (dir, "d", "d");
+
+    g_assert (!et_rename_plan_execute (plan));
+    et_rename_plan_foreach_result (plan, count_failures, &n_failures);
+    g_assert_cmpuint (n_failures, ==, 3);
+
+    check_file (dir, "x", "a");
+    check_file (dir, "b", "b");
+    check_file (dir, "c", "c");
+    check_file (dir, "d", "d");
+    check_file (dir, "e", "e");
+
+    et_rename_plan_free (plan);
+    remove_tree (dir);
+    g_free (dir);
+}
+
+/*
+ * Check that one of the files in @dir contains @contents.
+ */
+static void
+check_contents_exist (const gchar *dir,
+                      const gchar *contents)
+{
+    GDir *gdir;
+    const gchar *name;
+    gboolean found = FALSE;
+
+    gdir = g_dir_open (dir, 0, NULL);
+    g_assert (gdir != NULL);
+
+    while (!found && (name = g_dir_read_name (gdir)) != NULL)
+    {
+        gchar *path;
+        gchar *actual;
+
+        path = g_build_filename (dir, name, NULL);
+
+        if (g_file_get_contents (path, &actual, NULL, NULL))
+        {
+            found = g_strcmp0 (actual, contents) == 0;
+            g_free (actual);
+        }
+
+        g_free (path);
+    }
+
+    g_dir_close (gdir);
+    g_assert (found);
+}
+
+static void
+rename_plan_swap_failure (void)
+{
+    gchar *dir;
+    gchar *path;
+    EtRenamePlan *plan;
+    guint n_failures = 0;
+
+    dir = g_dir_make_tmp ("easytag-test-rename-XXXXXX", NULL);
+    g_assert (dir != NULL);
+    g_free (create_file (dir, "a"));
+    g_free (create_file (dir, "b"));
+
+    plan = et_rename_plan_new ();
+
+    /* "a" is moved aside, "b" is renamed to "a", and then the rename of "a"
+     * to "b" fails. The file which was moved aside must not replace the
+     * renamed "b". */
+    add_rename (plan, dir, "a", "b");
+    add_rename (plan, dir, "b", "a");
+    path = g_build_filename (dir, "b", NULL);
+    _et_rename_plan_set_fail_path (plan, path);
+    g_free (path);
+
+    g_assert (!et_rename_plan_execute (plan));
+    et_rename_plan_foreach_result (plan, count_failures, &n_failures);
+    g_assert_cmpuint (n_failures, ==, 1);
+
+    check_file (dir, "a", "b");
+    check_contents_exist (dir, "a");
+
+    et_rename_plan_free (plan);
+    remove_tree (dir);
+    g_free (dir);
+}
+
+static void
+rename_plan_case (void)
+{
+    gchar *dir;
+    EtRenamePlan *plan;
+
+    dir = g_dir_make_tmp ("easytag-test-rename-XXXXXX", NULL);
+    g_assert (dir != NULL);
+    g_free (create_file (dir, "name"));
+
+    plan = et_rename_plan_new ();
+
+    /* Renaming to a new filename, differing only by case, should succeed, even
+     * in the case of a case-insensitive filesystem. */
+    add_rename (plan, dir, "name", "NAME");
+
+    g_assert (et_rename_plan_execute (plan));
+    check_file (dir, "NAME", "name");
+
+    et_rename_plan_free (plan);
+    remove_tree (dir);
+    g_free (dir);
+}
+
+static const gsize PERF_FILES = 10000;
+
+static void
+rename_plan_perf (void)
+{
+    gchar *dir;
+    EtRenamePlan *plan;
+    gsize i;
+    gdouble time;
+
+    dir = g_dir_make_tmp ("easytag-test-rename-XXXXXX", NULL);
+    g_assert (dir != NULL);
+    plan = et_rename_plan_new ();
+
+    for (i = 0; i < PERF_FILES; i++)
+    {
+        gchar *old_name = g_strdup_printf ("%" G_GSIZE_FORMAT, i);
+        gchar *new_name = g_strdup_printf ("artist %" G_GSIZE_FORMAT
+                                           "/album/%" G_GSIZE_FORMAT,
+                                           i / 100, i % 100);
+
+        g_free (create_file (dir, old_name));
+        add_rename (plan, dir, old_name, new_name);
+
+        g_free (old_name);
+        g_free (new_name);
+    }
+
+    g_test_timer_start ();
+
+    g_assert (et_rename_plan_execute (plan));
+
+    time = g_test_timer_elapsed ();
+
+    g_test_minimized_result (time, "%6.1f seconds", time);
+
+    et_rename_plan_free (plan);
+    remove_tree (dir);
+    g_free (dir);
+}
+
+int
+main (int argc, char** argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/rename-plan/case", rename_plan_case);
+    g_test_add_func ("/rename-plan/chain", rename_plan_chain);
+    g_test_add_func ("/rename-plan/conflicts", rename_plan_conflicts);
+    g_test_add_func ("/rename-plan/cycles", rename_plan_cycles);
+    g_test_add_func ("/rename-plan/directories", rename_plan_directories);
+    g_test_add_func ("/rename-plan/swap-failure", rename_plan_swap_failure);
+
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/rename-plan/perf/execute", rename_plan_perf);
+    }
+
+    return g_test_run ();
+}
@@ -19,6 +19,8 @@
 
 #include "scan.h"
 
+#include <string.h>
+
 /* TODO: Add more test strings. */
 
 static const gsize PERF_ITERATIONS = 500000;
@@ -243,6 +245,194 @@ scan_letters_uppercase (void)
     }
 }
 
+/* Apply the options one after the other, as the scanner used to. */
+static gchar *
+process_fields_reference (EtScanPipelineFlags flags,
+                          const gchar *string)
+{
+    gchar *str;
+    gchar *res;
+
+    str = g_strdup (string);
+
+    if (flags & ET_SCAN_PIPELINE_CONVERT_SPACES)
+    {
+        Scan_Convert_Underscore_Into_Space (str);
+        Scan_Convert_P20_Into_Space (str);
+    }
+    else if (flags & ET_SCAN_PIPELINE_CONVERT_UNDERSCORES)
+    {
+        Scan_Convert_Space_Into_Underscore (str);
+    }
+
+    if (flags & ET_SCAN_PIPELINE_INSERT_SPACES)
+    {
+        res = Scan_Process_Fields_Insert_Space (str);
+        g_free (str);
+        str = res;
+    }
+
+    if (flags & ET_SCAN_PIPELINE_KEEP_ONE_SPACE)
+    {
+        Scan_Process_Fields_Keep_One_Space (str);
+    }
+
+    if (flags & ET_SCAN_PIPELINE_UPPERCASE_ALL)
+    {
+        res = Scan_Process_Fields_All_Uppercase (str);
+        g_free (str);
+        str = res;
+    }
+
+    if (flags & ET_SCAN_PIPELINE_LOWERCASE_ALL)
+    {
+        res = Scan_Process_Fields_All_Downcase (str);
+        g_free (str);
+        str = res;
+    }
+
+    if (flags & ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTER)
+    {
+        res = Scan_Process_Fields_Letter_Uppercase (str);
+        g_free (str);
+        str = res;
+    }
+
+    if (flags & ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTERS)
+    {
+        Scan_Process_Fields_First_Letters_Uppercase (&str,
+                                                     flags & ET_SCAN_PIPELINE_UPPERCASE_PREPOSITIONS,
+                                                     flags & ET_SCAN_PIPELINE_DETECT_ROMAN_NUMERALS);
+    }
+
+    if (flags & ET_SCAN_PIPELINE_REMOVE_SPACES)
+    {
+        Scan_Process_Fields_Remove_Space (str);
+    }
+
+    return str;
+}
+
+static void
+scan_pipeline (void)
+{
+    gsize i;
+    guint convert;
+    guint options;
+    GString *buffer;
+    /* Each string starts with an ASCII character, as inserting spaces
+     * truncates a first character which is not. */
+    const gchar * const cases[] = { "a", "I", "%20", "_", " ",
+                                    "foo_bar%20baz", "Foo__Bar  Baz",
+                                    "FooBarBaz", "fooBAR_bAz", "%2%200%20",
+                                    "the man of the year", "a i i b",
+                                    "vibrate (single version)",
+                                    "Foo Bar The III (single version)",
+                                    "mcmxc_and_xiv", "01 02 caps ", "x ii\t",
+                                    "feat. foo", "{a} [b] \"c\" d:e.f`g-h",
+                                    "Am\xc3\xa9lie_\xc3\x89t\xc3\xa9",
+                                    "b\xc3\xa4rs Ca\xc3\xb1on%20\xc3\x9f" };
+    const EtScanPipelineFlags conversions[] = { 0,
+                                                ET_SCAN_PIPELINE_CONVERT_SPACES,
+                                                ET_SCAN_PIPELINE_CONVERT_UNDERSCORES };
+    const EtScanPipelineFlags others[] = { ET_SCAN_PIPELINE_INSERT_SPACES,
+                                           ET_SCAN_PIPELINE_KEEP_ONE_SPACE,
+                                           ET_SCAN_PIPELINE_UPPERCASE_ALL,
+                                           ET_SCAN_PIPELINE_LOWERCASE_ALL,
+                                           ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTER,
+                                           ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTERS,
+                                           ET_SCAN_PIPELINE_UPPERCASE_PREPOSITIONS,
+                                           ET_SCAN_PIPELINE_DETECT_ROMAN_NUMERALS,
+                                           ET_SCAN_PIPELINE_REMOVE_SPACES };
+
+    buffer = g_string_new (NULL);
+
+    /* Every combination of options gives the same result as the functions
+     * applied one after the other. */
+    for (convert = 0; convert < G_N_ELEMENTS (conversions); convert++)
+    {
+        for (options = 0; options < 1 << G_N_ELEMENTS (others); options++)
+        {
+            EtScanPipeline *pipeline;
+            EtScanPipelineFlags flags = conversions[convert];
+            gsize j;
+
+            for (j = 0; j < G_N_ELEMENTS (others); j++)
+            {
+                if (options & (1 << j))
+                {
+                    flags |= others[j];
+                }
+            }
+
+            pipeline = et_scan_pipeline_new (flags, NULL, NULL, NULL);
+            g_assert (pipeline != NULL);
+
+            for (i = 0; i < G_N_ELEMENTS (cases); i++)
+            {
+                gchar *expected;
+
+                expected = process_fields_reference (flags, cases[i]);
+                et_scan_pipeline_apply (pipeline, cases[i], buffer);
+                g_assert_cmpstr (buffer->str, ==, expected);
+                g_assert_cmpuint (buffer->len, ==, strlen (expected));
+                g_free (expected);
+            }
+
+            et_scan_pipeline_free (pipeline);
+        }
+    }
+
+    g_string_free (buffer, TRUE);
+}
+
+static void
+scan_pipeline_convert_characters (void)
+{
+    EtScanPipeline *pipeline;
+    GString *buffer;
+    GError *error = NULL;
+
+    buffer = g_string_new (NULL);
+
+    pipeline = et_scan_pipeline_new (ET_SCAN_PIPELINE_CONVERT_CHARACTERS
+                                     | ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTERS,
+                                     "([a-z]+)-([0-9]+)", "\\2 \\1", &error);
+    g_assert_no_error (error);
+    et_scan_pipeline_apply (pipeline, "track-01 of the album", buffer);
+    g_assert_cmpstr (buffer->str, ==, "01 Track of the Album");
+    et_scan_pipeline_free (pipeline);
+
+    /* An invalid regular expression is reported. */
+    pipeline = et_scan_pipeline_new (ET_SCAN_PIPELINE_CONVERT_CHARACTERS,
+                                     "(", "", &error);
+    g_assert (pipeline == NULL);
+    g_assert_error (error, G_REGEX_ERROR, G_REGEX_ERROR_MISSING_PARENTHESIS);
+    g_clear_error (&error);
+
+    g_string_free (buffer, TRUE);
+}
+
+static void
+scan_pipeline_perf (void)
+{
+    EtScanPipeline *pipeline;
+    GString *buffer;
+    const EtScanPipelineFlags flags = ET_SCAN_PIPELINE_CONVERT_SPACES
+                                      | ET_SCAN_PIPELINE_KEEP_ONE_SPACE
+                                      | ET_SCAN_PIPELINE_UPPERCASE_FIRST_LETTERS
+                                      | ET_SCAN_PIPELINE_DETECT_ROMAN_NUMERALS;
+
+    pipeline = et_scan_pipeline_new (flags, NULL, NULL, NULL);
+    buffer = g_string_new (NULL);
+
+    et_scan_pipeline_apply (pipeline, "foo__bar%20the_baz_ii", buffer);
+    g_assert_cmpstr (buffer->str, ==, "Foo Bar the Baz II");
+
+    g_string_free (buffer, TRUE);
+    et_scan_pipeline_free (pipeline);
+}
+
 static void
 scan_perf (gconstpointer user_data)
 {
@@ -274,6 +464,9 @@ main (int argc, char** argv)
     g_test_add_func ("/scan/all-lowercase", scan_all_lowercase);
     g_test_add_func ("/scan/letter-uppercase", scan_letter_uppercase);
     g_test_add_func ("/scan/letters-uppercase", scan_letters_uppercase);
+    g_test_add_func ("/scan/pipeline", scan_pipeline);
+    g_test_add_func ("/scan/pipeline/convert-characters",
+                     scan_pipeline_convert_characters);
 
     if (g_test_perf ())
     {
@@ -293,6 +486,8 @@ main (int argc, char** argv)
                               scan_letter_uppercase, scan_perf);
         g_test_add_data_func ("/scan/perf/letters-uppercase",
                               scan_letters_uppercase, scan_perf);
+        g_test_add_data_func ("/scan/perf/pipeline", scan_pipeline_perf,
+                              scan_perf);
     }
 
     return g_test_run ();
@@ -0,0 +1,340 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "thumbnail_cache.h"
+
+/*
+ * The result of a load, filled in by on_loaded().
+ */
+typedef struct
+{
+    EtThumbnailCache *cache;
+    GdkPixbuf *pixbuf;
+    gint width;
+    gint height;
+    GError *error;
+    /* The order in which the load finished, from 1, or 0 if it has not. */
+    guint order;
+} Load;
+
+static guint n_loaded;
+
+static GBytes *
+create_image (gint width,
+              gint height,
+              guint32 pixel)
+{
+    GdkPixbuf *pixbuf;
+    gchar *buffer;
+    gsize length;
+    GError *error = NULL;
+
+    pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8, width, height);
+    gdk_pixbuf_fill (pixbuf, pixel);
+    gdk_pixbuf_save_to_buffer (pixbuf, &buffer, &length, "png", &error, NULL);
+    g_assert_no_error (error);
+    g_object_unref (pixbuf);
+
+    return g_bytes_new_take (buffer, length);
+}
+
+static void
+on_loaded (GObject *source_object,
+           GAsyncResult *result,
+           gpointer user_data)
+{
+    Load *load = user_data;
+
+    load->pixbuf = et_thumbnail_cache_load_finish (load->cache, result,
+                                                   &load->width,
+                                                   &load->height,
+                                                   &load->error);
+    load->order = ++n_loaded;
+}
+
+static void
+start_load (Load *load,
+            EtThumbnailCache *cache,
+            GBytes *bytes,
+            gint size,
+            GCancellable *cancellable)
+{
+    load->cache = cache;
+    load->pixbuf = NULL;
+    load->width = 0;
+    load->height = 0;
+    load->error = NULL;
+    load->order = 0;
+
+    et_thumbnail_cache_load_async (cache, bytes, size, cancellable, on_loaded,
+                                   load);
+}
+
+static void
+wait_for_load (Load *load)
+{
+    while (load->order == 0)
+    {
+        g_main_context_iteration (NULL, TRUE);
+    }
+}
+
+static void
+clear_load (Load *load)
+{
+    g_clear_object (&load->pixbuf);
+    g_clear_error (&load->error);
+}
+
+/*
+ * Decode @bytes into @cache, and check the size of the thumbnail.
+ */
+static void
+check_load (EtThumbnailCache *cache,
+            GBytes *bytes,
+            gint size,
+            gint width,
+            gint height,
+            gint thumbnail_width,
+            gint thumbnail_height)
+{
+    Load load;
+
+    start_load (&load, cache, bytes, size, NULL);
+    wait_for_load (&load);
+
+    g_assert_no_error (load.error);
+    g_assert (load.pixbuf != NULL);
+    g_assert_cmpint (load.width, ==, width);
+    g_assert_cmpint (load.height, ==, height);
+    g_assert_cmpint (gdk_pixbuf_get_width (load.pixbuf), ==, thumbnail_width);
+    g_assert_cmpint (gdk_pixbuf_get_height (load.pixbuf), ==,
+                     thumbnail_height);
+
+    clear_load (&load);
+}
+
+/*
+ * Check whether @bytes is cached at @size, with the size of the original
+ * image.
+ */
+static gboolean
+is_cached (EtThumbnailCache *cache,
+           GBytes *bytes,
+           gint size,
+           gint width,
+           gint height)
+{
+    GdkPixbuf *pixbuf;
+    gint cached_width = 0;
+    gint cached_height = 0;
+
+    pixbuf = et_thumbnail_cache_lookup (cache, bytes, size, &cached_width,
+                                        &cached_height);
+
+    if (!pixbuf)
+    {
+        return FALSE;
+    }
+
+    g_assert_cmpint (cached_width, ==, width);
+    g_assert_cmpint (cached_height, ==, height);
+    g_object_unref (pixbuf);
+
+    return TRUE;
+}
+
+static void
+thumbnail_cache_lru (void)
+{
+    EtThumbnailCache *cache;
+    GBytes *wide;
+    GBytes *tall;
+    GBytes *small;
+
+    wide = create_image (40, 20, 0xff000000);
+    tall = create_image (20, 40, 0x00ff0000);
+    small = create_image (4, 2, 0x0000ff00);
+    cache = et_thumbnail_cache_new (2);
+
+    g_assert (!is_cached (cache, wide, 10, 40, 20));
+    check_load (cache, wide, 10, 40, 20, 10, 5);
+    g_assert (is_cached (cache, wide, 10, 40, 20));
+
+    /* Each size is cached separately. */
+    g_assert (!is_cached (cache, wide, 20, 40, 20));
+
+    check_load (cache, tall, 10, 20, 40, 5, 10);
+    g_assert (is_cached (cache, tall, 10, 20, 40));
+
+    /* The least recently used thumbnail is evicted, which is the first one
+     * loaded, unless it was looked up since. */
+    g_assert (is_cached (cache, wide, 10, 40, 20));
+
+    /* Images which are smaller than the thumbnail are scaled up. */
+    check_load (cache, small, 10, 4, 2, 10, 5);
+    g_assert (is_cached (cache, small, 10, 4, 2));
+    g_assert (is_cached (cache, wide, 10, 40, 20));
+    g_assert (!is_cached (cache, tall, 10, 20, 40));
+
+    check_load (cache, tall, 10, 20, 40, 5, 10);
+    g_assert (is_cached (cache, tall, 10, 20, 40));
+    g_assert (is_cached (cache, wide, 10, 40, 20));
+    g_assert (!is_cached (cache, small, 10, 4, 2));
+
+    et_thumbnail_cache_free (cache);
+    g_bytes_unref (small);
+    g_bytes_unref (tall);
+    g_bytes_unref (wide);
+}
+
+static void
+thumbnail_cache_pending (void)
+{
+    EtThumbnailCache *cache;
+    GBytes *bytes;
+    GBytes *copy;
+    GdkPixbuf *pixbuf;
+    Load first;
+    Load second;
+    Load other_size;
+
+    bytes = create_image (40, 20, 0xff000000);
+    /* The same image from another file. */
+    copy = g_bytes_new (g_bytes_get_data (bytes, NULL),
+                        g_bytes_get_size (bytes));
+    cache = et_thumbnail_cache_new (4);
+
+    start_load (&first, cache, bytes, 10, NULL);
+    start_load (&second, cache, copy, 10, NULL);
+    start_load (&other_size, cache, bytes, 20, NULL);
+    wait_for_load (&first);
+    wait_for_load (&second);
+    wait_for_load (&other_size);
+
+    /* Both waiters get the result of a single decode, in the order in which
+     * they were made. */
+    g_assert_no_error (first.error);
+    g_assert_no_error (second.error);
+    g_assert (first.pixbuf != NULL);
+    g_assert (first.pixbuf == second.pixbuf);
+    g_assert_cmpuint (first.order, <, second.order);
+    g_assert_cmpint (second.width, ==, 40);
+    g_assert_cmpint (second.height, ==, 20);
+
+    g_assert_no_error (other_size.error);
+    g_assert (other_size.pixbuf != first.pixbuf);
+    g_assert_cmpint (gdk_pixbuf_get_width (other_size.pixbuf), ==, 20);
+
+    pixbuf = et_thumbnail_cache_lookup (cache, bytes, 10, NULL, NULL);
+    g_assert (pixbuf == first.pixbuf);
+    g_object_unref (pixbuf);
+
+    clear_load (&other_size);
+    clear_load (&second);
+    clear_load (&first);
+    et_thumbnail_cache_free (cache);
+    g_bytes_unref (copy);
+    g_bytes_unref (bytes);
+}
+
+static void
+thumbnail_cache_cancel (void)
+{
+    EtThumbnailCache *cache;
+    GBytes *bytes;
+    GCancellable *cancellable;
+    Load cancelled;
+    Load waiter;
+
+    bytes = create_image (40, 20, 0xff000000);
+    cache = et_thumbnail_cache_new (4);
+    cancellable = g_cancellable_new ();
+
+    start_load (&cancelled, cache, bytes, 10, cancellable);
+    start_load (&waiter, cache, bytes, 10, NULL);
+    g_cancellable_cancel (cancellable);
+    wait_for_load (&cancelled);
+    wait_for_load (&waiter);
+
+    /* Only the cancelled request fails. */
+    g_assert_error (cancelled.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+    g_assert (cancelled.pixbuf == NULL);
+    g_assert_no_error (waiter.error);
+    g_assert (waiter.pixbuf != NULL);
+    clear_load (&waiter);
+    clear_load (&cancelled);
+
+    /* The decode is still cached when its only request is cancelled. */
+    g_assert (is_cached (cache, bytes, 10, 40, 20));
+
+    g_cancellable_reset (cancellable);
+    start_load (&cancelled, cache, bytes, 20, cancellable);
+    g_cancellable_cancel (cancellable);
+    wait_for_load (&cancelled);
+    g_assert_error (cancelled.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+    clear_load (&cancelled);
+
+    /* The request only completes once the decode has finished. */
+    g_assert (is_cached (cache, bytes, 20, 40, 20));
+
+    et_thumbnail_cache_free (cache);
+    g_object_unref (cancellable);
+    g_bytes_unref (bytes);
+}
+
+static void
+thumbnail_cache_invalid (void)
+{
+    EtThumbnailCache *cache;
+    GBytes *bytes;
+    Load first;
+    Load second;
+
+    bytes = g_bytes_new_static ("not an image", 12);
+    cache = et_thumbnail_cache_new (4);
+
+    start_load (&first, cache, bytes, 10, NULL);
+    start_load (&second, cache, bytes, 10, NULL);
+    wait_for_load (&first);
+    wait_for_load (&second);
+
+    g_assert (first.pixbuf == NULL);
+    g_assert (first.error != NULL);
+    g_assert (second.pixbuf == NULL);
+    g_assert (second.error != NULL);
+    g_assert (!is_cached (cache, bytes, 10, 0, 0));
+
+    clear_load (&second);
+    clear_load (&first);
+    et_thumbnail_cache_free (cache);
+    g_bytes_unref (bytes);
+}
+
+int
+main (int argc, char** argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/thumbnail_cache/cancel", thumbnail_cache_cancel);
+    g_test_add_func ("/thumbnail_cache/invalid", thumbnail_cache_invalid);
+    g_test_add_func ("/thumbnail_cache/lru", thumbnail_cache_lru);
+    g_test_add_func ("/thumbnail_cache/pending", thumbnail_cache_pending);
+
+    return g_test_run ();
+}
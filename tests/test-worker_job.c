@@ -0,0 +1,108 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2016  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "worker_job.h"
+
+#define N_ITEMS 100
+
+static void
+count_item (guint index,
+            gpointer user_data)
+{
+    gint *counts = user_data;
+
+    g_atomic_int_inc (&counts[index]);
+}
+
+static void
+worker_job_all (void)
+{
+    gint counts[N_ITEMS] = { 0, };
+    EtWorkerJob *job;
+    gsize i;
+
+    job = et_worker_job_new ("test", N_ITEMS, 4, count_item, counts);
+    g_assert_cmpuint (et_worker_job_get_n_items (job), ==, N_ITEMS);
+
+    /* The job wakes up the main context after each item. */
+    while (!et_worker_job_is_finished (job))
+    {
+        g_main_context_iteration (NULL, TRUE);
+    }
+
+    et_worker_job_wait (job, FALSE);
+    g_assert_cmpuint (et_worker_job_get_n_done (job), ==, N_ITEMS);
+
+    /* Each item is processed exactly once. */
+    for (i = 0; i < N_ITEMS; i++)
+    {
+        g_assert_cmpint (counts[i], ==, 1);
+    }
+
+    et_worker_job_free (job);
+}
+
+static void
+slow_item (guint index,
+           gpointer user_data)
+{
+    count_item (index, user_data);
+    g_usleep (G_USEC_PER_SEC / 10);
+}
+
+static void
+worker_job_cancel (void)
+{
+    gint counts[N_ITEMS] = { 0, };
+    EtWorkerJob *job;
+
+    /* The item which was started is finished, and the others are skipped. */
+    job = et_worker_job_new ("test", N_ITEMS, 1, slow_item, counts);
+    et_worker_job_wait (job, TRUE);
+
+    g_assert_cmpuint (et_worker_job_get_n_done (job), <=, 1);
+    g_assert (!et_worker_job_is_finished (job));
+
+    /* Waiting again does nothing. */
+    et_worker_job_wait (job, FALSE);
+    g_assert_cmpuint (et_worker_job_get_n_done (job), <=, 1);
+
+    et_worker_job_free (job);
+}
+
+static void
+worker_job_empty (void)
+{
+    EtWorkerJob *job;
+
+    job = et_worker_job_new ("test", 0, 4, count_item, NULL);
+    g_assert (et_worker_job_is_finished (job));
+    et_worker_job_free (job);
+}
+
+int
+main (int argc, char** argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/worker_job/all", worker_job_all);
+    g_test_add_func ("/worker_job/cancel", worker_job_cancel);
+    g_test_add_func ("/worker_job/empty", worker_job_empty);
+
+    return g_test_run ();
+}